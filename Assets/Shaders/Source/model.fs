@@ -10,7 +10,13 @@ uniform float specular_power;
 uniform sampler2D normal_tex: 3;
 #endif
 #if USE_SHADOW_MAP
-uniform sampler2DShadow shadow_tex: 15;
+// A map, transform and split per cascade, C3_SHADOW_CASCADES of them.
+uniform sampler2DShadow shadow_tex0: 12;
+uniform sampler2DShadow shadow_tex1: 13;
+uniform sampler2DShadow shadow_tex2: 14;
+uniform sampler2DShadow shadow_tex3: 15;
+uniform mat4[4] light_transform;
+uniform vec4 shadow_splits;   // view depth where each cascade ends.
 #endif
 
 uniform int light_type;
@@ -26,7 +32,8 @@ in vec3 light_ref_dir_varying; 	 // light's center dir (world or tangent space)
 in vec3 light_vec_varying;		 // from light's pos to fragment's pos (world or tangent space)
 in vec3 eye_vec_varying;		 // from fragment's pos to camera
 #if USE_SHADOW_MAP
-in vec4 light_coord_varying;
+in vec3 shadow_pos_varying;
+in float view_depth_varying;
 #endif
 
 out vec4 color_out;
@@ -79,7 +86,17 @@ void main() {
 #endif
 
 #if USE_SHADOW_MAP
-  float shadow_factor = texture(shadow_tex, light_coord_varying.xyz);
+  // Nearest cascade whose split holds the pixel.
+  int cascade = 3;
+  if (view_depth_varying < shadow_splits.x) cascade = 0;
+  else if (view_depth_varying < shadow_splits.y) cascade = 1;
+  else if (view_depth_varying < shadow_splits.z) cascade = 2;
+  vec3 light_coord = (vec4(shadow_pos_varying, 1.0) * light_transform[cascade]).xyz;
+  float shadow_factor;
+  if (cascade == 0) shadow_factor = texture(shadow_tex0, light_coord);
+  else if (cascade == 1) shadow_factor = texture(shadow_tex1, light_coord);
+  else if (cascade == 2) shadow_factor = texture(shadow_tex2, light_coord);
+  else shadow_factor = texture(shadow_tex3, light_coord);
   color = AMBIENT_LIGHT + color * shadow_factor;
 #endif
 
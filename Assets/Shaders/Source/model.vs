@@ -4,6 +4,13 @@ in vec3 a_normal;
 in vec4 a_tangent;
 #endif
 in vec2 a_texcoord0;
+#if USE_INSTANCING
+// Model matrix of each instance, columns as u_model holds them.
+in vec4 i_data0;
+in vec4 i_data1;
+in vec4 i_data2;
+in vec4 i_data3;
+#endif
 
 out vec3 normal_varying;
 #if USE_NORMAL_MAP
@@ -15,7 +22,8 @@ out vec3 light_ref_dir_varying;
 out vec3 light_vec_varying;
 out vec3 eye_vec_varying;
 #if USE_SHADOW_MAP
-out vec4 light_coord_varying;
+out vec3 shadow_pos_varying;
+out float view_depth_varying;
 #endif
 
 uniform mat4 u_model;
@@ -26,19 +34,22 @@ uniform int light_type;
 uniform vec3 light_pos;
 uniform vec3 light_dir;
 
-uniform mat4 light_transform;
-
 //const vec3 LIGHT_DIR = vec3(0.1294095, 0.9659258, 0.2241439);
 //const vec3 LIGHT_DIR = vec3(0.0, 1.0, 0.0);
 
 void main() {
-  vec4 pos = vec4(a_position, 1.0) * u_model;
+#if USE_INSTANCING
+  mat4 model = mat4(i_data0, i_data1, i_data2, i_data3);
+#else
+  mat4 model = u_model;
+#endif
+  vec4 pos = vec4(a_position, 1.0) * model;
   vec4 pos_out = pos * u_view_proj;
   POSITION = pos_out;
-  normal_varying = a_normal * mat3(u_model);
+  normal_varying = a_normal * mat3(model);
 #if USE_NORMAL_MAP
   tangent_varying = a_tangent.rgb;
-  mat3 w2t = transpose(mat3(u_model)) * transpose(mat3(a_tangent.rgb, cross(a_normal, a_tangent.rgb) * a_tangent.a, a_normal));
+  mat3 w2t = transpose(mat3(model)) * transpose(mat3(a_tangent.rgb, cross(a_normal, a_tangent.rgb) * a_tangent.a, a_normal));
   if (light_type == 0) light_vec_varying = light_dir * w2t;
   else light_vec_varying = (pos.xyz - light_pos) * w2t;
   eye_vec_varying = (u_eye - pos.xyz) * w2t;
@@ -51,6 +62,8 @@ void main() {
 #endif
   texcoord_varying = a_texcoord0;
 #if USE_SHADOW_MAP
-  light_coord_varying = vec4(a_position + 5.0 * a_normal, 1.0) * u_model * light_transform;
+  // Looked up 5 units along the normal, model.fs picks the cascade per pixel.
+  shadow_pos_varying = (vec4(a_position + 5.0 * a_normal, 1.0) * model).xyz;
+  view_depth_varying = pos_out.w;
 #endif
 }
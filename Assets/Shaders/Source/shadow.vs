@@ -1,7 +1,21 @@
 in vec3 a_position;
+#if USE_INSTANCING
+in vec4 i_data0;
+in vec4 i_data1;
+in vec4 i_data2;
+in vec4 i_data3;
+#endif
 
+#if USE_INSTANCING
+uniform mat4 u_view_proj;
+#else
 uniform mat4 u_model_view_proj;
+#endif
 
 void main() {
+#if USE_INSTANCING
+  POSITION = vec4(a_position, 1.0) * mat4(i_data0, i_data1, i_data2, i_data3) * u_view_proj;
+#else
   POSITION = vec4(a_position, 1.0) * u_model_view_proj;
+#endif
 }
@@ -0,0 +1,108 @@
+#pragma once
+#include "Algorithm/RadixSort.h"
+#include "Job/JobScheduler.h"
+
+#define RADIX_SORT_MAX_CHUNKS 8
+#define RADIX_SORT_MIN_CHUNK_SIZE 2048
+
+// Per chunk histograms of radix_sort_parallel, 384KB for 64 bit keys.
+template <typename K>
+struct RadixSortParallelScratch {
+  RadixSortHistograms<K> chunks[RADIX_SORT_MAX_CHUNKS];
+  RadixSortHistograms<K> total;
+  bool chunk_sorted[RADIX_SORT_MAX_CHUNKS];
+};
+
+// Same result as radix_sort. Keys are split into one chunk per worker, chunks
+// count and scatter on job workers, offsets are summed up on the calling thread.
+// Chunk boundaries are fixed so items of one digit keep their order. Must be
+// called from a job (or main), see JobScheduler::ParallelFor.
+template <typename K, typename T>
+u32 radix_sort_parallel(K* __restrict keys, K* __restrict temp_keys, T* __restrict values, T* __restrict temp_values,
+                        u32 size, RadixSortParallelScratch<K>* scratch) {
+  const u32 num_passes = RadixSortHistograms<K>::NUM_PASSES;
+  auto JS = JobScheduler::Instance();
+  u32 num_chunks = min<u32>(min<u32>(size / RADIX_SORT_MIN_CHUNK_SIZE, JS->GetNumWorkers()), RADIX_SORT_MAX_CHUNKS);
+  if (num_chunks < 2) return radix_sort(keys, temp_keys, values, temp_values, size, &scratch->total);
+  auto chunk_begin = [size, num_chunks](u32 chunk) { return (u32)((u64)size * chunk / num_chunks); };
+
+  // All digit counts per chunk, the first pass done below reuses them.
+  JS->ParallelFor(0, num_chunks, 1, [&](int begin, int end) {
+    for (int c = begin; c < end; ++c) {
+      u32 b = chunk_begin(c);
+      scratch->chunk_sorted[c] = radix_sort_count(keys, b, chunk_begin(c + 1), &scratch->chunks[c]) &&
+                                 (b == 0 || keys[b - 1] <= keys[b]);
+    }
+  });
+  bool sorted = true;
+  memset(scratch->total.counts, 0, sizeof(scratch->total.counts));
+  for (u32 c = 0; c < num_chunks; ++c) {
+    sorted &= scratch->chunk_sorted[c];
+    for (u32 pass = 0; pass < num_passes; ++pass) {
+      u32* total = scratch->total.counts[pass];
+      const u32* counts = scratch->chunks[c].counts[pass];
+      for (u32 ii = 0; ii < RADIX_SORT_HISTOGRAM_SIZE; ++ii) total[ii] += counts[ii];
+    }
+  }
+  if (sorted) return 0;
+
+  K* dst_keys = keys;
+  T* dst_values = values;
+  u32 num_scatters = 0;
+  for (u32 pass = 0; pass < num_passes; ++pass) {
+    if (radix_sort_skip_pass(scratch->total, pass, keys[0], size)) continue;
+    u32 shift = pass * RADIX_SORT_BITS;
+    if (num_scatters > 0) {
+      // Keys moved since they were counted.
+      JS->ParallelFor(0, num_chunks, 1, [&](int begin, int end) {
+        for (int c = begin; c < end; ++c) {
+          u32* histogram = scratch->chunks[c].counts[pass];
+          memset(histogram, 0, sizeof(u32) * RADIX_SORT_HISTOGRAM_SIZE);
+          for (u32 ii = chunk_begin(c), e = chunk_begin(c + 1); ii < e; ++ii) {
+            ++histogram[(keys[ii] >> shift) & RADIX_SORT_BIT_MASK];
+          }
+        }
+      });
+    }
+
+    // Digit major, chunk minor: chunk c writes a digit after the same digit of chunks before it.
+    u32 offset = 0;
+    for (u32 ii = 0; ii < RADIX_SORT_HISTOGRAM_SIZE; ++ii) {
+      for (u32 c = 0; c < num_chunks; ++c) {
+        u32& count = scratch->chunks[c].counts[pass][ii];
+        u32 n = count;
+        count = offset;
+        offset += n;
+      }
+    }
+
+    K* src_keys = keys;
+    K* out_keys = temp_keys;
+    T* src_values = values;
+    T* out_values = temp_values;
+    JS->ParallelFor(0, num_chunks, 1, [&](int begin, int end) {
+      for (int c = begin; c < end; ++c) {
+        u32* histogram = scratch->chunks[c].counts[pass];
+        for (u32 ii = chunk_begin(c), e = chunk_begin(c + 1); ii < e; ++ii) {
+          K key = src_keys[ii];
+          u32 dest = histogram[(key >> shift) & RADIX_SORT_BIT_MASK]++;
+          out_keys[dest] = key;
+          out_values[dest] = src_values[ii];
+        }
+      }
+    });
+
+    swap(keys, temp_keys);
+    swap(values, temp_values);
+    ++num_scatters;
+  }
+
+  if (keys != dst_keys) {
+    // Odd number of passes needs to do copy to the destination.
+    memcpy(dst_keys, keys, size * sizeof(K));
+    for (u32 ii = 0; ii < size; ++ii) {
+      dst_values[ii] = values[ii];
+    }
+  }
+  return num_scatters;
+}
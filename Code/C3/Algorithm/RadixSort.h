@@ -5,86 +5,54 @@
 #define RADIX_SORT_HISTOGRAM_SIZE (1<<RADIX_SORT_BITS)
 #define RADIX_SORT_BIT_MASK (RADIX_SORT_HISTOGRAM_SIZE-1)
 
-template <typename T>
-void radix_sort32(u32* __restrict keys, u32* __restrict temp_keys, T* __restrict values, T* __restrict temp_values, u32 size) {
-  u32 histogram[RADIX_SORT_HISTOGRAM_SIZE];
-  u16 shift = 0;
-  u32 pass = 0;
-  for (; pass < 3; ++pass) {
-    memset(histogram, 0, sizeof(u32) * RADIX_SORT_HISTOGRAM_SIZE);
-
-    bool sorted = true;
-    {
-      u32 key = keys[0];
-      u32 prevKey = key;
-      for (u32 ii = 0; ii < size; ++ii, prevKey = key) {
-        key = keys[ii];
-        u16 index = (key >> shift) & RADIX_SORT_BIT_MASK;
-        ++histogram[index];
-        sorted &= prevKey <= key;
-      }
-    }
-
-    if (sorted) goto done;
-
-    u32 offset = 0;
-    for (u32 ii = 0; ii < RADIX_SORT_HISTOGRAM_SIZE; ++ii) {
-      u32 count = histogram[ii];
-      histogram[ii] = offset;
-      offset += count;
-    }
-
-    for (u32 ii = 0; ii < size; ++ii) {
-      u32 key = keys[ii];
-      u16 index = (key >> shift) & RADIX_SORT_BIT_MASK;
-      u32 dest = histogram[index]++;
-      temp_keys[dest] = key;
-      temp_values[dest] = values[ii];
-    }
-
-    u32* swap_keys = temp_keys;
-    temp_keys = keys;
-    keys = swap_keys;
-
-    T* swap_values = temp_values;
-    temp_values = values;
-    values = swap_values;
-
-    shift += RADIX_SORT_BITS;
-  }
-
-done:
-  if (0 != (pass & 1)) {
-    // Odd number of passes needs to do copy to the destination.
-    memcpy(keys, temp_keys, size * sizeof(u32));
-    for (u32 ii = 0; ii < size; ++ii) {
-      values[ii] = temp_values[ii];
+// Digit counts of every pass, filled by a single read of the keys. 24KB for
+// 32 bit and 48KB for 64 bit keys, keep them off fiber stacks.
+template <typename K>
+struct RadixSortHistograms {
+  enum { NUM_PASSES = (sizeof(K) * 8 + RADIX_SORT_BITS - 1) / RADIX_SORT_BITS };
+  u32 counts[NUM_PASSES][RADIX_SORT_HISTOGRAM_SIZE];
+};
+
+// Counts digits of all passes for keys [begin, end), returns true if they are in order.
+template <typename K>
+bool radix_sort_count(const K* __restrict keys, u32 begin, u32 end, RadixSortHistograms<K>* histograms) {
+  const u32 num_passes = RadixSortHistograms<K>::NUM_PASSES;
+  memset(histograms->counts, 0, sizeof(histograms->counts));
+  bool sorted = true;
+  K prev_key = begin < end ? keys[begin] : 0;
+  for (u32 ii = begin; ii < end; ++ii) {
+    K key = keys[ii];
+    sorted &= prev_key <= key;
+    prev_key = key;
+    for (u32 pass = 0; pass < num_passes; ++pass) {
+      ++histograms->counts[pass][(key >> (pass * RADIX_SORT_BITS)) & RADIX_SORT_BIT_MASK];
     }
   }
+  return sorted;
 }
 
-template <typename T>
-void radix_sort64(u64* __restrict keys, u64* __restrict temp_keys, T* __restrict values, T* __restrict temp_values, u32 size) {
-  u32 histogram[RADIX_SORT_HISTOGRAM_SIZE];
-  u16 shift = 0;
-  u32 pass = 0;
-  for (; pass < 6; ++pass) {
-    memset(histogram, 0, sizeof(u32)*RADIX_SORT_HISTOGRAM_SIZE);
-
-    bool sorted = true;
-    {
-      u64 key = keys[0];
-      u64 prevKey = key;
-      for (u32 ii = 0; ii < size; ++ii, prevKey = key) {
-        key = keys[ii];
-        u16 index = (key >> shift) & RADIX_SORT_BIT_MASK;
-        ++histogram[index];
-        sorted &= prevKey <= key;
-      }
-    }
-
-    if (sorted) goto done;
+// A pass whose digit is the same for every key would only copy, e.g. view
+// and sequence bits of sort keys are mostly uniform.
+template <typename K>
+bool radix_sort_skip_pass(const RadixSortHistograms<K>& histograms, u32 pass, K any_key, u32 size) {
+  return histograms.counts[pass][(any_key >> (pass * RADIX_SORT_BITS)) & RADIX_SORT_BIT_MASK] == size;
+}
 
+// Stable LSD sort of keys and values, temp arrays are scratch of the same size.
+// Returns the number of scatter passes done, 0 if keys were already sorted.
+template <typename K, typename T>
+u32 radix_sort(K* __restrict keys, K* __restrict temp_keys, T* __restrict values, T* __restrict temp_values,
+               u32 size, RadixSortHistograms<K>* histograms) {
+  if (size < 2) return 0;
+  if (radix_sort_count(keys, 0, size, histograms)) return 0;
+
+  K* dst_keys = keys;
+  T* dst_values = values;
+  u32 num_scatters = 0;
+  for (u32 pass = 0; pass < RadixSortHistograms<K>::NUM_PASSES; ++pass) {
+    if (radix_sort_skip_pass(*histograms, pass, keys[0], size)) continue;
+
+    u32* histogram = histograms->counts[pass];
     u32 offset = 0;
     for (u32 ii = 0; ii < RADIX_SORT_HISTOGRAM_SIZE; ++ii) {
       u32 count = histogram[ii];
@@ -92,37 +60,37 @@ void radix_sort64(u64* __restrict keys, u64* __restrict temp_keys, T* __restrict
       offset += count;
     }
 
+    u32 shift = pass * RADIX_SORT_BITS;
     for (u32 ii = 0; ii < size; ++ii) {
-      u64 key = keys[ii];
-      u16 index = (key >> shift) & RADIX_SORT_BIT_MASK;
-      u32 dest = histogram[index]++;
+      K key = keys[ii];
+      u32 dest = histogram[(key >> shift) & RADIX_SORT_BIT_MASK]++;
       temp_keys[dest] = key;
       temp_values[dest] = values[ii];
     }
 
-    u64* swap_keys = temp_keys;
-    temp_keys = keys;
-    keys = swap_keys;
-
-    T* swap_values = temp_values;
-    temp_values = values;
-    values = swap_values;
-
-    shift += RADIX_SORT_BITS;
+    swap(keys, temp_keys);
+    swap(values, temp_values);
+    ++num_scatters;
   }
 
-done:
-  if (0 != (pass & 1)) {
+  if (keys != dst_keys) {
     // Odd number of passes needs to do copy to the destination.
-    memcpy(keys, temp_keys, size * sizeof(u64));
+    memcpy(dst_keys, keys, size * sizeof(K));
     for (u32 ii = 0; ii < size; ++ii) {
-      values[ii] = temp_values[ii];
+      dst_values[ii] = values[ii];
     }
   }
+  return num_scatters;
 }
 
-#undef RADIX_SORT_BITS
-#undef RADIX_SORT_HISTOGRAM_SIZE
-#undef RADIX_SORT_BIT_MASK
-
+template <typename T>
+u32 radix_sort32(u32* __restrict keys, u32* __restrict temp_keys, T* __restrict values, T* __restrict temp_values,
+                 u32 size, RadixSortHistograms<u32>* histograms) {
+  return radix_sort(keys, temp_keys, values, temp_values, size, histograms);
+}
 
+template <typename T>
+u32 radix_sort64(u64* __restrict keys, u64* __restrict temp_keys, T* __restrict values, T* __restrict temp_values,
+                 u32 size, RadixSortHistograms<u64>* histograms) {
+  return radix_sort(keys, temp_keys, values, temp_values, size, histograms);
+}
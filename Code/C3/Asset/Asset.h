@@ -37,6 +37,16 @@ struct AssetOperations {
   void(*_unload_fn)(Asset* asset);
 };
 
+// Clock ticks of the last load, see AssetManager::LogLoadTimeline.
+struct AssetLoadTiming {
+  tick_t _request;      // LoadAsync started it.
+  tick_t _read;         // file read by the I/O thread.
+  tick_t _start;        // decode job running.
+  tick_t _wait;         // own data done, waiting for dependencies.
+  tick_t _end;          // ready or failed.
+  int _worker;          // thread index of the loader job.
+};
+
 struct AssetMemoryHeader;
 struct Asset {
   atomic<AssetState> _state;
@@ -45,8 +55,29 @@ struct Asset {
   AssetDesc _desc;
   AssetOperations* _ops;
   AssetMemoryHeader* _header;
+  AssetLoadTiming _timing;
+  atomic_u32 _last_used;    // frame it was last drawn, see asset_touch.
+  u32 _gpu_size;            // GPU bytes set by the loader, counted with _header against the budget.
+  // Loads started while the asset is loading or unloading wait on _busy_label,
+  // created by the first of them and signaled when the state settles.
+  SpinLock _busy_lock;
+  atomic_int* _busy_label;
 };
 
+// Loader jobs mark their phases for the load timeline.
+void asset_load_begin(Asset* asset);
+void asset_load_wait(Asset* asset);
+// Sets the final state of the load.
+void asset_load_end(Asset* asset, AssetState state);
+// Leaves LOADING/UNLOADING for state, starts the loads waiting meanwhile.
+void asset_end_busy(Asset* asset, AssetState state);
+// Unload functions free the header last, after releasing what it refers to.
+void asset_free_header(Asset* asset);
+// Marks the asset used by the frame, unreferenced assets are evicted least recently used first.
+inline void asset_touch(Asset* asset, u32 frame) {
+  asset->_last_used.store(frame, memory_order_relaxed);
+}
+
 #define ASSET_MEMORY_SIZE(num_depends, content_size) \
   ALIGN_MASK(ALIGN_MASK(sizeof(AssetMemoryHeader) + (num_depends) * sizeof(AssetDesc), POINTER_ALIGN_MASK) + (content_size), POINTER_SIZE)
 struct AssetMemoryHeader {
@@ -0,0 +1,152 @@
+#include "C3PCH.h"
+#include "AssetIO.h"
+
+AssetIO::AssetIO()
+: _queue(C3_MAX_ASSET_IO_REQUESTS, mem_allocator(MEMORY_TAG_ASSET)), _num_in_flight(0), _num_decoding(0),
+  _exit(false), _num_reads(0), _bytes_read(0), _read_ticks(0), _num_decoded(0), _decode_ticks(0) {}
+
+AssetIO::~AssetIO() {
+  Shutdown();
+}
+
+void AssetIO::Init() {
+  _exit = false;
+  _thread.Init(&AssetIO::ThreadEntry, this, 0, "AssetIO");
+}
+
+void AssetIO::Shutdown() {
+  if (!_thread.IsRunning()) return;
+  _exit = true;
+  _wake.Post();
+  _thread.Shutdown();
+  // Reads never done end as missing files, nothing waits forever.
+  Request* request;
+  while (_queue.Read(request)) {
+    ++_num_in_flight;
+    JobScheduler::Instance()->SignalLabel(request->_read_label);
+  }
+}
+
+AssetIO::Request* AssetIO::NewRequest(const char* filename, u32 offset, u32 size) {
+  auto request = C3_NEW(mem_allocator(MEMORY_TAG_ASSET), Request);
+  strcpy(request->_filename, filename);
+  request->_io = this;
+  request->_asset = nullptr;
+  request->_decode_fn = nullptr;
+  request->_read_label = JobScheduler::Instance()->NewLabel(1);
+  request->_offset = offset;
+  request->_size = size;
+  request->_mem = nullptr;
+  return request;
+}
+
+void AssetIO::Push(Request* request) {
+  auto JS = JobScheduler::Instance();
+  while (!_queue.Write(request)) {
+    // Also called outside jobs, e.g. by the main thread deserializing a world.
+    if (JS->IsInJob()) JS->Yield();
+    else std::this_thread::yield();
+  }
+  _wake.Post();
+}
+
+atomic_int* AssetIO::ReadAsync(Asset* asset, AssetDecodeFn decode_fn, u32 offset, u32 size) {
+  Request* request = NewRequest(asset->_desc._filename, offset, size);
+  request->_asset = asset;
+  request->_decode_fn = decode_fn;
+  Job job;
+  job.InitWorkerJob(&AssetIO::DecodeJob, request, FIBER_STACK_LARGE);
+  atomic_int* label = JobScheduler::Instance()->SubmitJobsAfter(request->_read_label, &job, 1);
+  Push(request);
+  return label;
+}
+
+const MemoryRegion* AssetIO::Read(const char* filename, u32 offset, u32 size) {
+  Request* request = NewRequest(filename, offset, size);
+  atomic_int* read_label = request->_read_label;
+  Push(request);
+  JobScheduler::Instance()->WaitAndFreeJobs(read_label);
+  const MemoryRegion* mem = request->_mem;
+  C3_DELETE(mem_allocator(MEMORY_TAG_ASSET), request);
+  EndInFlight();
+  return mem;
+}
+
+void AssetIO::GetStats(AssetIOStats* stats) const {
+  stats->num_queued = (u32)_queue.SizeGuess();
+  stats->num_in_flight = _num_in_flight.load(memory_order_relaxed);
+  stats->num_decoding = _num_decoding.load(memory_order_relaxed);
+  stats->num_reads = _num_reads.load(memory_order_relaxed);
+  stats->bytes_read = _bytes_read.load(memory_order_relaxed);
+  stats->read_ms = Clock::TicksToMillisecondsD(_read_ticks.load(memory_order_relaxed));
+  stats->num_decoded = _num_decoded.load(memory_order_relaxed);
+  stats->decode_ms = Clock::TicksToMillisecondsD(_decode_ticks.load(memory_order_relaxed));
+}
+
+void AssetIO::DoRead(Request* request) {
+  ++_num_in_flight;
+  tick_t start_tick = Clock::Tick();
+  auto FS = FileSystem::Instance();
+  auto f = FS->OpenRead(request->_filename);
+  if (f) {
+    u32 file_size = (u32)f->GetSize();
+    u32 offset = min(request->_offset, file_size);
+    u32 size = file_size - offset;
+    if (request->_size) size = min(size, request->_size);
+    auto mem = mem_alloc(size + 1);
+    if (offset) f->Seek(offset);
+    size = (u32)max(f->ReadBytes(mem->data, (int)size), 0);
+    FS->Close(f);
+    // Text decoders parse in place.
+    ((u8*)mem->data)[size] = 0;
+    mem->size = size;
+    request->_mem = mem;
+    _bytes_read.fetch_add(size, memory_order_relaxed);
+  }
+  tick_t end_tick = Clock::Tick();
+  _num_reads.fetch_add(1, memory_order_relaxed);
+  _read_ticks.fetch_add(end_tick - start_tick, memory_order_relaxed);
+  if (request->_asset) request->_asset->_timing._read = end_tick;
+  // The request belongs to the waiting job after this.
+  JobScheduler::Instance()->SignalLabel(request->_read_label);
+}
+
+void AssetIO::EndInFlight() {
+  --_num_in_flight;
+  _wake.Post();
+}
+
+i32 AssetIO::ThreadEntry(void* user_data) {
+  auto io = (AssetIO*)user_data;
+  while (!io->_exit) {
+    io->_wake.Wait();
+    Request* request;
+    while (!io->_exit && io->_num_in_flight < C3_ASSET_IO_WINDOW && io->_queue.Read(request)) io->DoRead(request);
+  }
+  return 0;
+}
+
+void AssetIO::DecodeJob(void* arg) {
+  auto request = (Request*)arg;
+  auto io = request->_io;
+  // Read is done, the label only needs freeing.
+  JobScheduler::Instance()->WaitAndFreeJobs(request->_read_label);
+  Asset* asset = request->_asset;
+  const MemoryRegion* mem = request->_mem;
+  AssetDecodeFn decode_fn = request->_decode_fn;
+  C3_DELETE(mem_allocator(MEMORY_TAG_ASSET), request);
+  io->EndInFlight();
+
+  asset_load_begin(asset);
+  if (!mem) {
+    asset_load_end(asset, ASSET_STATE_EMPTY);
+    return;
+  }
+  ++io->_num_decoding;
+  decode_fn(asset, mem);
+  --io->_num_decoding;
+  const auto& timing = asset->_timing;
+  tick_t decoded_tick = timing._wait ? timing._wait : timing._end;
+  io->_num_decoded.fetch_add(1, memory_order_relaxed);
+  if (decoded_tick > timing._start) io->_decode_ticks.fetch_add(decoded_tick - timing._start, memory_order_relaxed);
+}
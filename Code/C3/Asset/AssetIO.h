@@ -0,0 +1,77 @@
+#pragma once
+#include "Asset.h"
+#include "Data/MPSCQueue.h"
+#include "Memory/MemoryRegion.h"
+
+// Decode stage of a load, runs as a worker job after the I/O thread read the
+// asset file. mem holds the file, or the range asked for, and a terminating 0,
+// the decoder owns it.
+typedef void (*AssetDecodeFn)(Asset* asset, const MemoryRegion* mem);
+
+struct AssetIOStats {
+  u32 num_queued;           // reads waiting for the I/O thread.
+  u32 num_in_flight;        // read, decode not started yet.
+  u32 num_decoding;         // including ones waiting for dependencies.
+  u64 num_reads;
+  u64 bytes_read;
+  double read_ms;           // I/O thread busy reading.
+  u64 num_decoded;
+  double decode_ms;         // decoders until they wait for dependencies.
+};
+
+/*
+* AssetIO does all file reads of asset loading on one thread, workers never
+* block on the disk. At most C3_ASSET_IO_WINDOW files are in flight, read but
+* not yet picked up by a decode job, so reads don't run ahead of the workers.
+* Decode jobs parse and hand GPU resources to the renderer's upload queue, see
+* GraphicsRenderer::UploadTexture.
+*/
+class AssetIO {
+public:
+  AssetIO();
+  ~AssetIO();
+
+  void Init();
+  void Shutdown();
+  // Reads the asset file then runs decode_fn as a worker job, returns its label.
+  // A missing file ends the load as ASSET_STATE_EMPTY without decode_fn. size
+  // bytes from offset are read, 0 reads to the end, both are clamped to the file.
+  atomic_int* ReadAsync(Asset* asset, AssetDecodeFn decode_fn, u32 offset = 0, u32 size = 0);
+  // Fiber waits for the file, nullptr if it is missing. Must be called from a job (or main).
+  const MemoryRegion* Read(const char* filename, u32 offset = 0, u32 size = 0);
+  void GetStats(AssetIOStats* stats) const;
+
+private:
+  struct Request {
+    char _filename[MAX_ASSET_NAME];
+    AssetIO* _io;
+    Asset* _asset;
+    AssetDecodeFn _decode_fn;
+    atomic_int* _read_label;
+    u32 _offset;
+    u32 _size;
+    const MemoryRegion* _mem;
+  };
+
+  Request* NewRequest(const char* filename, u32 offset, u32 size);
+  // Yields while the queue is full.
+  void Push(Request* request);
+  void DoRead(Request* request);
+  void EndInFlight();
+  static i32 ThreadEntry(void* user_data);
+  static void DecodeJob(void* arg);
+
+  Thread _thread;
+  Semaphore _wake;                  // request queued, window slot freed or exit.
+  MPSCQueue<Request*> _queue;
+  atomic_u32 _num_in_flight;
+  atomic_u32 _num_decoding;
+  atomic_bool _exit;
+  // Written by the I/O thread.
+  atomic<u64> _num_reads;
+  atomic<u64> _bytes_read;
+  atomic<tick_t> _read_ticks;
+  // Written by decode jobs.
+  atomic<u64> _num_decoded;
+  atomic<tick_t> _decode_ticks;
+};
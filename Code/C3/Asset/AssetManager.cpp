@@ -8,11 +8,12 @@ DEFINE_SINGLETON_INSTANCE(AssetManager);
 
 static AssetOperations NULL_ASSET_OPS = {
   [](Asset* asset) -> atomic_int* {
-    asset->_state = ASSET_STATE_EMPTY;
+    asset_load_end(asset, ASSET_STATE_EMPTY);
     return nullptr;
   },
   [](Asset* asset) {
-    asset->_state = ASSET_STATE_EMPTY;
+    // Evict sets the state, waiting loads start then.
+    asset_free_header(asset);
   },
 };
 
@@ -22,6 +23,17 @@ struct AssetLoaderType {
   AssetOperations* _ops;
 };
 
+static const u64 ASSET_BUDGETS[ASSET_TYPE_COUNT] = {
+  C3_ASSET_BUDGET_TEXTURE,
+  C3_ASSET_BUDGET_MATERIAL_SHADER,
+  C3_ASSET_BUDGET_MATERIAL,
+  C3_ASSET_BUDGET_MODEL,
+};
+
+static u32 asset_resident_size(const Asset* asset) {
+  return (asset->_header ? asset->_header->_size : 0) + asset->_gpu_size;
+}
+
 static AssetLoaderType ASSET_LOADERS[] = {
   {ASSET_TYPE_TEXTURE, ".dds", &DDS_TEXTURE_OPS},
   {ASSET_TYPE_MODEL, ".mex", &MEX_MODEL_OPS},
@@ -29,11 +41,98 @@ static AssetLoaderType ASSET_LOADERS[] = {
   {ASSET_TYPE_MATERIAL, ".mat", &MATERIAL_OPS},
 };
 
-AssetManager::AssetManager(): _num_assets(0) {
-  _asset_map.reserve(C3_MAX_ASSETS);
+void asset_load_begin(Asset* asset) {
+  asset->_timing._start = Clock::Tick();
+  asset->_timing._wait = 0;
+  asset->_timing._worker = ThreadAffinity::GetWorkerThreadIndex();
+}
+
+void asset_load_wait(Asset* asset) {
+  asset->_timing._wait = Clock::Tick();
+}
+
+void asset_load_end(Asset* asset, AssetState state) {
+  asset->_timing._end = Clock::Tick();
+  if (state == ASSET_STATE_READY) {
+    auto AM = AssetManager::Instance();
+    u32 type = asset->_desc._type;
+    AM->_resident_bytes[type].fetch_add(asset_resident_size(asset), memory_order_relaxed);
+    ++AM->_num_resident[type];
+  }
+  asset_end_busy(asset, state);
+}
+
+void asset_end_busy(Asset* asset, AssetState state) {
+  atomic_int* label;
+  {
+    SpinLockGuard lock_guard(&asset->_busy_lock);
+    asset->_state = state;
+    label = asset->_busy_label;
+    asset->_busy_label = nullptr;
+  }
+  if (!label) return;
+  auto JS = JobScheduler::Instance();
+  JS->SignalLabel(label);
+  // Done, waiting only frees it.
+  JS->WaitAndFreeJobs(label);
+}
+
+void asset_free_header(Asset* asset) {
+  if (asset->_header) C3_FREE(mem_allocator(MEMORY_TAG_ASSET), asset->_header);
+  asset->_header = nullptr;
 }
 
-AssetManager::~AssetManager() {}
+// Queued once someone else's load or unload of the asset ended.
+DEFINE_JOB_ENTRY(load_asset_after_busy) {
+  // Loaded again if it was unloaded meanwhile.
+  AssetManager::Instance()->Load((Asset*)arg);
+}
+
+// Chains a load after the current load or unload of the asset, so LoadAsync
+// doesn't block callers starting more loads. nullptr if it ended already.
+static atomic_int* load_after_busy(Asset* asset) {
+  auto JS = JobScheduler::Instance();
+  SpinLockGuard lock_guard(&asset->_busy_lock);
+  AssetState state = asset->_state;
+  if (state != ASSET_STATE_LOADING && state != ASSET_STATE_UNLOADING) return nullptr;
+  if (!asset->_busy_label) asset->_busy_label = JS->NewLabel(1);
+  Job job;
+  job.InitWorkerJob(load_asset_after_busy, asset);
+  return JS->SubmitJobsAfter(asset->_busy_label, &job, 1);
+}
+
+Asset* AssetLoadGroup::Add(Asset* asset) {
+  auto label = AssetManager::Instance()->LoadAsync(asset);
+  if (label) _labels.push_back(label);
+  return asset;
+}
+
+Asset* AssetLoadGroup::Add(AssetType type, const char* filename) {
+  Asset* asset = AssetManager::Instance()->Get(type, filename);
+  if (asset) Add(asset);
+  return asset;
+}
+
+void AssetLoadGroup::Wait() {
+  auto JS = JobScheduler::Instance();
+  for (auto label : _labels) JS->WaitAndFreeJobs(label);
+  _labels.clear();
+}
+
+AssetManager::AssetManager(): _last_evicted(0) {
+  for (int i = 0; i < ASSET_TYPE_COUNT; ++i) {
+    _budget[i] = ASSET_BUDGETS[i];
+    _resident_bytes[i] = 0;
+    _num_resident[i] = 0;
+    _num_evicted[i] = 0;
+    _evicted_bytes[i] = 0;
+  }
+  _io.Init();
+}
+
+AssetManager::~AssetManager() {
+  _io.Shutdown();
+}
 
 Asset* AssetManager::Get(AssetType type, const char* filename) {
   AssetDesc desc;
@@ -44,7 +143,7 @@ Asset* AssetManager::Get(AssetType type, const char* filename) {
 }
 
 void AssetManager::Load(Asset* asset) {
-  JobScheduler::Instance()->WaitJobs(LoadAsync(asset));
+  JobScheduler::Instance()->WaitAndFreeJobs(LoadAsync(asset));
 }
 
 Asset* AssetManager::Load(AssetType type, const char* filename) {
@@ -59,16 +158,21 @@ Asset* AssetManager::Load(AssetType type, const char* filename) {
 
 atomic_int* AssetManager::LoadAsync(Asset* asset) {
   c3_assert_return_x(asset, nullptr);
-  AssetState old_state;
-retry:
-  old_state = asset->_state;
-  while (old_state == ASSET_STATE_LOADING || old_state == ASSET_STATE_UNLOADING) {
-    JobScheduler::Instance()->Yield();
-    old_state = asset->_state;
-  }
-  if (old_state == ASSET_STATE_READY) return nullptr;
-  while (!asset->_state.compare_exchange_strong(old_state, ASSET_STATE_LOADING))
-    goto retry;
+  AssetState old_state = asset->_state;
+  for (;;) {
+    if (old_state == ASSET_STATE_READY) return nullptr;
+    if (old_state == ASSET_STATE_LOADING || old_state == ASSET_STATE_UNLOADING) {
+      atomic_int* label = load_after_busy(asset);
+      if (label) return label;
+      // Settled meanwhile.
+      old_state = asset->_state;
+      continue;
+    }
+    if (asset->_state.compare_exchange_strong(old_state, ASSET_STATE_LOADING)) break;
+  }
+  memset(&asset->_timing, 0, sizeof(asset->_timing));
+  asset->_timing._request = Clock::Tick();
+  asset->_gpu_size = 0;
   return asset->_ops->_load_async_fn(asset);
 }
 
@@ -81,15 +185,79 @@ atomic_int* AssetManager::LoadAsync(AssetType type, const char* filename) {
   return LoadAsync(asset);
 }
 
-// TODO: check asset->_state
 void AssetManager::Unload(Asset* asset) {
   c3_assert_return(asset);
-  if (asset->_ref == 0) return;
-  u32 ref = asset->_ref.fetch_sub(1);
-  if (ref == 1 && asset->_state == ASSET_STATE_READY) {
-    asset->_state = ASSET_STATE_UNLOADING;
+  // Never below 0 when several threads release the last reference.
+  u32 ref = asset->_ref.load(memory_order_relaxed);
+  while (ref > 0 && !asset->_ref.compare_exchange_weak(ref, ref - 1));
+}
+
+void AssetManager::UpdateResidency(u32 frame) {
+  _last_evicted = 0;
+  // Dependents first, evicting them releases their dependencies.
+  for (int type = ASSET_TYPE_COUNT - 1; type >= 0; --type) {
+    if (_resident_bytes[type].load(memory_order_relaxed) <= _budget[type]) continue;
+    _evict_candidates.clear();
+    u32 num_assets = _registry.GetCount();
+    for (u32 i = 0; i < num_assets; ++i) {
+      Asset* asset = _registry.GetAsset(i);
+      // State first, assets being created read as empty.
+      if (asset->_state != ASSET_STATE_READY || asset->_desc._type != (u32)type || asset->_ref != 0) continue;
+      // The previous frame may still be on the render thread.
+      if (frame - asset->_last_used.load(memory_order_relaxed) < 2) continue;
+      _evict_candidates.push_back(asset);
+    }
+    sort(_evict_candidates.begin(), _evict_candidates.end(), [](const Asset* a, const Asset* b) {
+      return a->_last_used.load(memory_order_relaxed) < b->_last_used.load(memory_order_relaxed);
+    });
+    for (auto asset : _evict_candidates) {
+      if (_resident_bytes[type].load(memory_order_relaxed) <= _budget[type]) break;
+      if (Evict(asset)) ++_last_evicted;
+    }
+  }
+  _texture_streamer.Update(frame);
+}
+
+bool AssetManager::Evict(Asset* asset) {
+  AssetState old_state = ASSET_STATE_READY;
+  if (!asset->_state.compare_exchange_strong(old_state, ASSET_STATE_UNLOADING)) return false;
+  // Referenced meanwhile, its LoadAsync saw it ready.
+  if (asset->_ref != 0) {
+    asset_end_busy(asset, ASSET_STATE_READY);
+    return false;
+  }
+  u32 type = asset->_desc._type;
+  u32 size = asset_resident_size(asset);
+  // Dependencies were used as recently as the asset, they are released by the unload.
+  u32 last_used = asset->_last_used.load(memory_order_relaxed);
+  const AssetMemoryHeader* header = asset->_header;
+  for (u16 i = 0; header && i < header->_num_depends; ++i) {
+    Asset* dep = Find(header->_depends[i]._filename);
+    if (dep && dep->_last_used.load(memory_order_relaxed) < last_used) asset_touch(dep, last_used);
+  }
+  {
+    SpinLockGuard lock_guard(&asset->_lock);
     asset->_ops->_unload_fn(asset);
+    c3_assert(!asset->_header);
+    asset->_gpu_size = 0;
+    asset_end_busy(asset, ASSET_STATE_EMPTY);
+  }
+  _resident_bytes[type].fetch_sub(size, memory_order_relaxed);
+  --_num_resident[type];
+  ++_num_evicted[type];
+  _evicted_bytes[type] += size;
+  return true;
+}
+
+void AssetManager::GetResidencyStats(AssetResidencyStats* stats) const {
+  for (int i = 0; i < ASSET_TYPE_COUNT; ++i) {
+    stats->num_resident[i] = _num_resident[i].load(memory_order_relaxed);
+    stats->resident_bytes[i] = _resident_bytes[i].load(memory_order_relaxed);
+    stats->budget[i] = _budget[i];
+    stats->num_evicted[i] = _num_evicted[i];
+    stats->evicted_bytes[i] = _evicted_bytes[i];
   }
+  stats->last_evicted = _last_evicted;
 }
 
 struct BuiltinTexture {
@@ -118,10 +286,11 @@ void AssetManager::InitBuiltinAssets() {
     auto asset = GetOrCreateAsset(desc, &NULL_ASSET_OPS);
     asset->_state = ASSET_STATE_READY;
     auto asset_mem_size = ASSET_MEMORY_SIZE(0, sizeof(Texture));
-    asset->_header = (AssetMemoryHeader*)C3_ALLOC(g_allocator, asset_mem_size);
+    asset->_header = (AssetMemoryHeader*)C3_ALLOC(mem_allocator(MEMORY_TAG_ASSET), asset_mem_size);
     asset->_header->_size = asset_mem_size;
     asset->_header->_num_depends = 0;
     auto texture = (Texture*)asset->_header->GetData();
+    texture->_stream = nullptr;
     texture->_handle = GR->CreateTexture2D(2, 2, 1, RGBA_8_TEXTURE_FORMAT, 0,
                                            mem_ref(s_builtin_textures[i].data,
                                                    sizeof(s_builtin_textures[i].data)),
@@ -130,15 +299,55 @@ void AssetManager::InitBuiltinAssets() {
 }
 
 void AssetManager::Serialize(BlobWriter& writer) {
-  for (u32 i = 0; i < _num_assets; ++i) {
-    writer.Write(_assets[i]._desc);
+  u32 num_assets = _registry.GetCount();
+  for (u32 i = 0; i < num_assets; ++i) {
+    writer.Write(_registry.GetAsset(i)->_desc);
   }
 }
 
 int AssetManager::GetAssetDenseIndex(Asset* asset) const {
-  auto asset_id = String::GetID(asset->_desc._filename);
-  auto it = _asset_map.find(asset_id);
-  return it == _asset_map.end() ? -1: it->second;
+  return asset ? (int)_registry.GetIndex(asset) : -1;
+}
+
+void AssetManager::LogLoadTimeline(tick_t since) const {
+  vector<const Asset*> loaded;
+  const Asset* last = nullptr;
+  u32 num_assets = _registry.GetCount();
+  for (u32 i = 0; i < num_assets; ++i) {
+    const Asset* asset = _registry.GetAsset(i);
+    const auto& timing = asset->_timing;
+    if (timing._request == 0 || timing._request < since) continue;
+    loaded.push_back(asset);
+    if (!last || timing._end > last->_timing._end) last = asset;
+  }
+  if (!last) return;
+  sort(loaded.begin(), loaded.end(), [](const Asset* a, const Asset* b) {
+    return a->_timing._start < b->_timing._start;
+  });
+  auto ms = [since](tick_t tick) { return tick ? Clock::TimespanToMillisecondsD(since, tick) : 0.0; };
+  c3_log("[C3] Asset load timeline, %d assets in %.2f ms (ms: request, read, start, wait, end, worker):\n",
+         (int)loaded.size(), ms(last->_timing._end));
+  for (auto asset : loaded) {
+    const auto& timing = asset->_timing;
+    c3_log("  %9.2f %9.2f %9.2f %9.2f %9.2f  w%-2d %s%s\n", ms(timing._request), ms(timing._read),
+           ms(timing._start), ms(timing._wait), ms(timing._end), timing._worker, asset->_desc._filename,
+           asset->_state == ASSET_STATE_READY ? "" : " (failed)");
+  }
+  // Dependencies are waited for last, the one finishing last held the asset up.
+  c3_log("[C3] Critical path:\n");
+  const Asset* asset = last;
+  for (size_t depth = 0; asset && depth < loaded.size(); ++depth) {
+    const auto& timing = asset->_timing;
+    c3_log("  %9.2f .. %9.2f %s\n", ms(timing._start), ms(timing._end), asset->_desc._filename);
+    const Asset* next = nullptr;
+    const AssetMemoryHeader* header = asset->_state == ASSET_STATE_READY ? asset->_header : nullptr;
+    for (u16 i = 0; header && i < header->_num_depends; ++i) {
+      const Asset* dep = Find(header->_depends[i]._filename);
+      if (!dep || dep->_timing._request == 0 || dep->_timing._request < since) continue;
+      if (!next || dep->_timing._end > next->_timing._end) next = dep;
+    }
+    asset = next;
+  }
 }
 
 bool AssetManager::Resolve(AssetType type, const char* filename, AssetDesc& out_desc, AssetOperations*& out_ops) {
@@ -166,25 +375,13 @@ bool AssetManager::Resolve(AssetType type, const char* filename, AssetDesc& out_
   return true;
 }
 
+Asset* AssetManager::Find(const char* filename) const {
+  return _registry.Find(filename);
+}
+
 Asset* AssetManager::GetOrCreateAsset(const AssetDesc& desc, AssetOperations* ops) {
-  auto asset_id = String::GetID(desc._filename);
-  auto it = _asset_map.find(asset_id);
-  if (it != _asset_map.end()) {
-    auto asset = _assets + it->second;
-    ++asset->_ref;
-    return asset;
-  }
-  if (_num_assets >= C3_MAX_ASSETS) {
-    c3_log("Asset usage reach limit C3_MAX_ASSETS = %s.\n", C3_MAX_ASSETS);
-    return nullptr;
-  }
-  Asset* asset = _assets + _num_assets;
-  _asset_map[asset_id] = _num_assets;
-  ++_num_assets;
-  asset->_state = ASSET_STATE_EMPTY;
-  asset->_desc = desc;
-  asset->_ops = ops;
-  asset->_header = nullptr;
-  asset->_ref = 1;
+  bool created;
+  Asset* asset = _registry.FindOrCreate(desc, ops, &created);
+  if (asset && !created) ++asset->_ref;
   return asset;
 }
@@ -1,7 +1,45 @@
 #pragma once
 #include "Asset.h"
+#include "AssetIO.h"
+#include "AssetRegistry.h"
+#include "TextureStreamer.h"
 #include "Data/Blob.h";
 
+// Loads started together and waited for once. Loaders start the loads of
+// their dependencies before their own work and wait for them after it.
+class AssetLoadGroup {
+public:
+  AssetLoadGroup() {}
+  ~AssetLoadGroup() { Wait(); }
+
+  // Starts loading, the asset is returned right away.
+  Asset* Add(Asset* asset);
+  Asset* Add(AssetType type, const char* filename);
+  // Returns after all added loads finished. Must be called from a job (or main).
+  void Wait();
+
+private:
+  AssetLoadGroup(const AssetLoadGroup&);
+  AssetLoadGroup& operator =(const AssetLoadGroup&);
+
+  vector<atomic_int*> _labels;
+};
+
+struct AssetResidencyStats {
+  u32 num_resident[ASSET_TYPE_COUNT];
+  u64 resident_bytes[ASSET_TYPE_COUNT];   // header and GPU bytes of the ready assets.
+  u64 budget[ASSET_TYPE_COUNT];
+  u32 num_evicted[ASSET_TYPE_COUNT];      // since start.
+  u64 evicted_bytes[ASSET_TYPE_COUNT];
+  u32 last_evicted;                       // by the last UpdateResidency.
+};
+
+/*
+* Assets are referenced by Get/Load and released by Unload. An unreferenced
+* asset stays resident, loading it again is free, until its type goes over
+* budget. UpdateResidency then evicts the unreferenced ones least recently
+* drawn first, which releases their dependencies in turn.
+*/
 class AssetManager {
 public:
   AssetManager();
@@ -11,20 +49,48 @@ public:
   Asset* Load(AssetType type, const char* filename);
   atomic_int* LoadAsync(AssetType type, const char* filename);
   void Load(Asset* asset);
+  // Never waits, an asset loading already gets a label which is done when it is.
+  // The caller owns the label, free it with JobScheduler::WaitAndFreeJobs.
   atomic_int* LoadAsync(Asset* asset);
+  // One more reference to an asset the caller holds already.
+  void AddRef(Asset* asset) { ++asset->_ref; }
+  // Releases a reference, the asset stays resident until evicted.
   void Unload(Asset* asset);
+  // Main thread once a frame, after the frame's asset_touch calls. Assets
+  // drawn by the frame in flight on the render thread are not evicted, then
+  // the texture streamer updates.
+  void UpdateResidency(u32 frame);
+  void SetBudget(AssetType type, u64 bytes) { _budget[type] = bytes; }
+  void GetResidencyStats(AssetResidencyStats* stats) const;
 
   void InitBuiltinAssets();
-  u32 GetUsed() const { return _num_assets; }
+  u32 GetUsed() const { return _registry.GetCount(); }
+  AssetIO* GetIO() { return &_io; }
+  TextureStreamer* GetTextureStreamer() { return &_texture_streamer; }
   void Serialize(BlobWriter& writer);
   int GetAssetDenseIndex(Asset* asset) const;
+  // Logs the assets requested since the tick in start order, and the chain of
+  // dependencies which finished last.
+  void LogLoadTimeline(tick_t since) const;
 
   static bool Resolve(AssetType type, const char* filename, AssetDesc& out_desc, AssetOperations*& out_ops);
 
 private:
   Asset* GetOrCreateAsset(const AssetDesc& desc, AssetOperations* ops);
-  unordered_map<stringid, int> _asset_map;
-  Asset _assets[C3_MAX_ASSETS];
-  u32 _num_assets;
+  Asset* Find(const char* filename) const;
+  bool Evict(Asset* asset);
+  friend void asset_load_end(Asset* asset, AssetState state);
+  // Loaders on job workers create assets of their dependencies.
+  AssetRegistry _registry;
+  AssetIO _io;
+  TextureStreamer _texture_streamer;
+  u64 _budget[ASSET_TYPE_COUNT];
+  atomic<u64> _resident_bytes[ASSET_TYPE_COUNT];
+  atomic_u32 _num_resident[ASSET_TYPE_COUNT];
+  // Main thread.
+  u32 _num_evicted[ASSET_TYPE_COUNT];
+  u64 _evicted_bytes[ASSET_TYPE_COUNT];
+  u32 _last_evicted;
+  vector<Asset*> _evict_candidates;
   SUPPORT_SINGLETON(AssetManager);
 };
@@ -0,0 +1,94 @@
+#include "C3PCH.h"
+#include "AssetRegistry.h"
+
+AssetRegistry::AssetRegistry(): _num_assets(0), _num_collisions(0) {
+  for (auto& slot : _slots) slot.store(SLOT_EMPTY, memory_order_relaxed);
+  // Entries taken but not initialized yet read as empty assets.
+  for (auto& asset : _assets) {
+    asset._state = ASSET_STATE_EMPTY;
+    asset._ref = 0;
+    asset._desc._type = (u32)ASSET_TYPE_INVALID;
+    asset._desc._flags = 0;
+    asset._desc._filename[0] = 0;
+    asset._ops = nullptr;
+    asset._header = nullptr;
+    memset(&asset._timing, 0, sizeof(asset._timing));
+    asset._last_used = 0;
+    asset._gpu_size = 0;
+    asset._busy_label = nullptr;
+  }
+}
+
+u32 AssetRegistry::WaitSlotIndex(u32 slot_index) const {
+  u32 index;
+  while ((index = (u32)_slots[slot_index].load(memory_order_acquire)) == INDEX_PENDING) std::this_thread::yield();
+  return index;
+}
+
+u32 AssetRegistry::AllocIndex() {
+  u32 index = _num_assets.load(memory_order_relaxed);
+  do {
+    if (index >= C3_MAX_ASSETS) return INDEX_FAILED;
+  } while (!_num_assets.compare_exchange_weak(index, index + 1, memory_order_relaxed));
+  return index;
+}
+
+Asset* AssetRegistry::Find(const char* filename) const {
+  stringid id = String::GetID(filename);
+  u32 slot_index = id & (NUM_SLOTS - 1);
+  for (u32 i = 0; i < NUM_SLOTS; ++i, slot_index = (slot_index + 1) & (NUM_SLOTS - 1)) {
+    u64 slot = _slots[slot_index].load(memory_order_acquire);
+    if (slot == SLOT_EMPTY) return nullptr;
+    if ((stringid)(slot >> 32) != id) continue;
+    u32 index = WaitSlotIndex(slot_index);
+    if (index == INDEX_FAILED) continue;
+    const Asset* asset = _assets + index - 1;
+    if (strcmp(asset->_desc._filename, filename) == 0) return (Asset*)asset;
+  }
+  return nullptr;
+}
+
+Asset* AssetRegistry::FindOrCreate(const AssetDesc& desc, AssetOperations* ops, bool* created_out) {
+  *created_out = false;
+  stringid id = String::GetID(desc._filename);
+  const Asset* collided = nullptr;
+  u32 slot_index = id & (NUM_SLOTS - 1);
+  for (u32 i = 0; i < NUM_SLOTS; ++i, slot_index = (slot_index + 1) & (NUM_SLOTS - 1)) {
+    u64 slot = _slots[slot_index].load(memory_order_acquire);
+    // A failed CAS loads the winner's slot, checked below like any other.
+    if (slot == SLOT_EMPTY &&
+        _slots[slot_index].compare_exchange_strong(slot, MakeSlot(id, INDEX_PENDING), memory_order_acq_rel)) {
+      u32 index = AllocIndex();
+      if (index == INDEX_FAILED) {
+        _slots[slot_index].store(MakeSlot(id, INDEX_FAILED), memory_order_release);
+        c3_log("[C3] AssetRegistry: more than C3_MAX_ASSETS = %d assets, '%s' not created.\n", C3_MAX_ASSETS,
+               desc._filename);
+        return nullptr;
+      }
+      Asset* asset = _assets + index;
+      asset->_desc = desc;
+      asset->_ops = ops;
+      asset->_header = nullptr;
+      memset(&asset->_timing, 0, sizeof(asset->_timing));
+      asset->_last_used = 0;
+      asset->_gpu_size = 0;
+      asset->_ref = 1;
+      asset->_state = ASSET_STATE_EMPTY;
+      _slots[slot_index].store(MakeSlot(id, index + 1), memory_order_release);
+      if (collided) {
+        _num_collisions.fetch_add(1, memory_order_relaxed);
+        c3_log("[C3] AssetRegistry: '%s' and '%s' have the same string id %08x.\n", collided->_desc._filename,
+               desc._filename, id);
+      }
+      *created_out = true;
+      return asset;
+    }
+    if ((stringid)(slot >> 32) != id) continue;
+    u32 index = WaitSlotIndex(slot_index);
+    if (index == INDEX_FAILED) continue;
+    Asset* asset = _assets + index - 1;
+    if (strcmp(asset->_desc._filename, desc._filename) == 0) return asset;
+    collided = asset;
+  }
+  return nullptr;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "Asset.h"
+
+/*
+* AssetRegistry owns the asset slab and maps filenames to it. The map is an
+* open addressing table of C3_MAX_ASSETS * 2 slots, a slot holds the stringid
+* of the filename and the slab index in one 64 bit word. Lookups are lock
+* free, an insert claims an empty slot with a CAS, takes the next slab entry
+* and publishes it. Matching ids are confirmed with the full filename, files
+* whose ids collide get separate assets.
+*/
+class AssetRegistry {
+public:
+  AssetRegistry();
+
+  // nullptr if the file has no asset.
+  Asset* Find(const char* filename) const;
+  // Asset of desc._filename, created_out is set if this call created it with
+  // state ASSET_STATE_EMPTY and one reference. nullptr when the slab is full.
+  Asset* FindOrCreate(const AssetDesc& desc, AssetOperations* ops, bool* created_out);
+
+  // Assets are never removed, indices below GetCount stay valid.
+  u32 GetCount() const { return _num_assets.load(memory_order_acquire); }
+  Asset* GetAsset(u32 index) { return _assets + index; }
+  const Asset* GetAsset(u32 index) const { return _assets + index; }
+  u32 GetIndex(const Asset* asset) const { return u32(asset - _assets); }
+  u32 GetNumCollisions() const { return _num_collisions.load(memory_order_relaxed); }
+
+private:
+  static const u32 NUM_SLOTS = C3_MAX_ASSETS * 2;
+  static const u64 SLOT_EMPTY = 0;
+  static const u32 INDEX_PENDING = 0xffffffff;    // slot claimed, asset being initialized.
+  static const u32 INDEX_FAILED = 0xfffffffe;     // slot claimed, the slab was full.
+  static_assert((NUM_SLOTS & (NUM_SLOTS - 1)) == 0, "NUM_SLOTS must be a power of two.");
+
+  static u64 MakeSlot(stringid id, u32 index) { return ((u64)id << 32) | index; }
+  // Slab index of a published slot, spins while it is pending.
+  u32 WaitSlotIndex(u32 slot_index) const;
+  u32 AllocIndex();
+
+  atomic<u64> _slots[NUM_SLOTS];    // id << 32 | slab index + 1.
+  Asset _assets[C3_MAX_ASSETS];
+  atomic_u32 _num_assets;
+  atomic_u32 _num_collisions;
+};
@@ -1,36 +1,67 @@
 #include "C3PCH.h"
 #include "DDSTextureLoader.h"
 
-DEFINE_JOB_ENTRY(load_dds_texture) {
-  auto asset = (Asset*)arg;
-  auto f = FileSystem::Instance()->OpenRead(asset->_desc._filename);
-  if (!f) {
-    asset->_state = ASSET_STATE_EMPTY;
-    return;
+// mem holds the start of the file, 2D textures with mips are created from
+// their tail mips and stream the rest in when drawn, see TextureStreamer.
+static void decode_dds_texture(Asset* asset, const MemoryRegion* mem) {
+  auto AM = AssetManager::Instance();
+  u32 asset_mem_size = ASSET_MEMORY_SIZE(0, sizeof(Texture) + sizeof(TextureStream));
+  auto asset_header = (AssetMemoryHeader*)C3_ALLOC(mem_allocator(MEMORY_TAG_ASSET), asset_mem_size);
+  asset_header->_size = asset_mem_size;
+  asset_header->_num_depends = 0;
+  auto texture = (Texture*)asset_header->GetData();
+  auto stream = (TextureStream*)(texture + 1);
+  texture->_handle = TextureHandle();
+  texture->_stream = nullptr;
+  // Samples black until the render thread created it.
+  u32 upload;
+  if (TextureStreamer::InitStream(stream, asset, texture, mem, C3_TEXTURE_MAG_ANISOTROPIC)) {
+    u32 offset = stream->_mip_offsets[stream->_tail_skip];
+    u32 size = stream->_mip_offsets[stream->_image.num_mips] - offset;
+    mem_free(mem);
+    auto tail = AM->GetIO()->Read(asset->_desc._filename, offset, size);
+    if (tail && tail->size == size) {
+      texture->_handle = TextureStreamer::UploadMips(stream, stream->_tail_skip, tail, &texture->_info, &upload);
+      if (texture->_handle) texture->_stream = stream;
+    }
+    if (tail) mem_free(tail);
+  } else {
+    // Only the rest of the file is read, after the header bytes already here.
+    if (mem->size >= IMAGE_DDS_MAX_HEADER_SIZE) {
+      auto rest = AM->GetIO()->Read(asset->_desc._filename, mem->size);
+      if (rest && rest->size) {
+        auto whole = mem_alloc(mem->size + rest->size);
+        memcpy(whole->data, mem->data, mem->size);
+        memcpy((u8*)whole->data + mem->size, rest->data, rest->size);
+        mem_free(mem);
+        mem = whole;
+      }
+      if (rest) mem_free(rest);
+    }
+    if (mem) texture->_handle = GraphicsRenderer::Instance()->UploadTexture(mem, C3_TEXTURE_MAG_ANISOTROPIC, 0,
+                                                                           &texture->_info, &upload);
   }
-  auto mem = mem_alloc(f->GetSize());
-  f->ReadBytes(mem->data, mem->size);
-  FileSystem::Instance()->Close(f);
-
-  SpinLockGuard lock_guard(&asset->_lock);
-  asset->_header = (AssetMemoryHeader*)C3_ALLOC(g_allocator, ASSET_MEMORY_SIZE(0, sizeof(Texture)));
-  asset->_header->_size = ASSET_MEMORY_SIZE(0, sizeof(Texture));
-  asset->_header->_num_depends = 0;
-  auto texture = (Texture*)asset->_header->GetData();
-  texture->_handle = GraphicsRenderer::Instance()->CreateTexture(mem, C3_TEXTURE_MAG_ANISOTROPIC, 0, &texture->_info);
-  asset->_state = ASSET_STATE_READY;
+  {
+    SpinLockGuard lock_guard(&asset->_lock);
+    asset->_header = asset_header;
+    // The tail, streamed mips are counted by the texture streamer.
+    asset->_gpu_size = texture->_handle ? texture->_info.storage_size : 0;
+    asset_load_end(asset, ASSET_STATE_READY);
+  }
+  if (texture->_stream) AM->GetTextureStreamer()->Add(stream);
 }
 
 static atomic_int* dds_load_async(Asset* asset) {
   c3_assert(asset->_state == ASSET_STATE_LOADING);
-  auto JS = JobScheduler::Instance();
-  Job job;
-  job.InitWorkerJob(load_dds_texture, asset);
-  return JS->SubmitJobs(&job, 1);
+  return AssetManager::Instance()->GetIO()->ReadAsync(asset, &decode_dds_texture, 0, IMAGE_DDS_MAX_HEADER_SIZE);
 }
 
 static void dds_unload(Asset* asset) {
   c3_assert(asset->_state == ASSET_STATE_UNLOADING);
+  auto texture = (Texture*)asset->_header->GetData();
+  if (texture->_stream) AssetManager::Instance()->GetTextureStreamer()->Remove(texture->_stream);
+  GraphicsRenderer::Instance()->DestroyTexture(texture->_handle);
+  asset_free_header(asset);
 }
 
 AssetOperations DDS_TEXTURE_OPS = {
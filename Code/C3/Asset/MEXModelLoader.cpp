@@ -1,49 +1,55 @@
 #include "C3PCH.h"
 #include "MEXModelLoader.h"
 
-DEFINE_JOB_ENTRY(load_mex_model) {
-  auto asset = (Asset*)arg;
-  auto f = FileSystem::Instance()->OpenRead(asset->_desc._filename);
-  if (!f) {
-    asset->_state = ASSET_STATE_EMPTY;
-    return;
-  }
-
+static void decode_mex_model(Asset* asset, const MemoryRegion* mem) {
+  BlobReader reader(mem->data, mem->size);
   MeshHeader header;
-  f->ReadBytes(&header, sizeof(header));
+  reader.Read(header);
 
-  SpinLockGuard lock_guard(&asset->_lock);
+  // Published under the asset lock once the materials are ready.
   auto model_size = Model::ComputeSize(header.num_materials, header.num_parts);
   u32 asset_mem_size = ASSET_MEMORY_SIZE(header.num_materials, model_size);
-  asset->_header = (AssetMemoryHeader*)C3_ALLOC(g_allocator, asset_mem_size);
-  asset->_header->_size = asset_mem_size;
-  asset->_header->_num_depends = header.num_materials;
-  auto model = (Model*)asset->_header->GetData();
+  auto asset_header = (AssetMemoryHeader*)C3_ALLOC(mem_allocator(MEMORY_TAG_ASSET), asset_mem_size);
+  asset_header->_size = asset_mem_size;
+  asset_header->_num_depends = header.num_materials;
+  auto model = (Model*)asset_header->GetData();
   model->Init(header.num_materials, header.num_parts);
   strcpy(model->_filename, asset->_desc._filename);
 
+  // Materials load while the mesh is decoded.
+  AssetLoadGroup loads;
   MeshMaterial mesh_material;
   char material_filename[MAX_ASSET_NAME];
-  auto AM = AssetManager::Instance();
-  f->Seek(header.material_data_offset);
+  reader.Seek(header.material_data_offset);
   for (int i = 0; i < header.num_materials; ++i) {
-    f->ReadBytes(&mesh_material, sizeof(MeshMaterial));
+    reader.Read(mesh_material);
     strcpy(material_filename, asset->_desc._filename);
     auto p = strrchr(material_filename, '/');
     if (!p) p = material_filename;
     else ++p;
     strcpy(p, mesh_material.filename);
-    model->_materials[i] = AM->Load(ASSET_TYPE_MATERIAL, material_filename);
-    asset->_header->_depends[i] = model->_materials[i]->_desc;
+    model->_materials[i] = loads.Add(ASSET_TYPE_MATERIAL, material_filename);
+    if (!model->_materials[i]) {
+      c3_log("[C3] Model '%s': no asset for material '%s', model not loaded.\n", asset->_desc._filename,
+             material_filename);
+      // Materials started already are released once loaded.
+      loads.Wait();
+      for (int j = 0; j < i; ++j) AssetManager::Instance()->Unload(model->_materials[j]);
+      C3_FREE(mem_allocator(MEMORY_TAG_ASSET), asset_header);
+      mem_free(mem);
+      asset_load_end(asset, ASSET_STATE_EMPTY);
+      return;
+    }
+    asset_header->_depends[i] = model->_materials[i]->_desc;
   }
 
   model->_num_parts = header.num_parts;
   ModelPart* part = model->_parts;
   ModelPart* part_end = model->_parts + header.num_parts;
   MeshPart mesh_part;
-  f->Seek(header.part_data_offset);
+  reader.Seek(header.part_data_offset);
   for (; part < part_end; ++part) {
-    f->ReadBytes(&mesh_part, sizeof(MeshPart));
+    reader.Read(mesh_part);
     part->_start_index = mesh_part.start_index;
     part->_num_indices = mesh_part.num_indices;
     part->_aabb.minPoint = mesh_part.aabb_min;
@@ -53,14 +59,15 @@ DEFINE_JOB_ENTRY(load_mex_model) {
 
   model->_aabb.minPoint = header.aabb_min;
   model->_aabb.maxPoint = header.aabb_max;
-  auto vb_mem = mem_alloc(header.num_vertices * header.vertex_stride);
+  // Copied out so the file can go before the renderer gets to the buffers.
+  u32 vb_size = header.num_vertices * header.vertex_stride;
   int index_size = header.num_indices >= 0x10000 ? 4 : 2;
-  auto ib_mem = mem_alloc(header.num_indices * index_size);
-  f->Seek(header.vertex_data_offset);
-  f->ReadBytes(vb_mem->data, vb_mem->size);
-  f->Seek(header.index_data_offset);
-  f->ReadBytes(ib_mem->data, ib_mem->size);
-  FileSystem::Instance()->Close(f);
+  u32 ib_size = header.num_indices * index_size;
+  reader.Seek(header.vertex_data_offset);
+  auto vb_mem = mem_copy(reader.Skip((int)vb_size), vb_size);
+  reader.Seek(header.index_data_offset);
+  auto ib_mem = mem_copy(reader.Skip((int)ib_size), ib_size);
+  mem_free(mem);
 
   VertexDecl vd;
   vd.Begin();
@@ -72,22 +79,36 @@ DEFINE_JOB_ENTRY(load_mex_model) {
   vd.End();
 
   auto GR = GraphicsRenderer::Instance();
-  model->_vb = GR->CreateVertexBuffer(vb_mem, vd);
+  u32 vb_upload, ib_upload;
+  model->_vb = GR->UploadVertexBuffer(vb_mem, vd, C3_BUFFER_NONE, &vb_upload);
   u32 ib_flags = header.num_indices >= 0x10000 ? C3_BUFFER_INDEX32 : C3_BUFFER_NONE;
-  model->_ib = GR->CreateIndexBuffer(ib_mem, ib_flags);
+  model->_ib = GR->UploadIndexBuffer(ib_mem, ib_flags, &ib_upload);
+  model->_upload = max(vb_upload, ib_upload);
+  asset->_gpu_size = vb_size + ib_size;
 
-  asset->_state = ASSET_STATE_READY;
+  asset_load_wait(asset);
+  loads.Wait();
+  SpinLockGuard lock_guard(&asset->_lock);
+  asset->_header = asset_header;
+  asset_load_end(asset, ASSET_STATE_READY);
 }
 
 static atomic_int* mex_load_async(Asset* asset) {
   c3_assert(asset->_state == ASSET_STATE_LOADING);
-  auto JS = JobScheduler::Instance();
-  Job job;
-  job.InitWorkerJob(load_mex_model, asset);
-  return JS->SubmitJobs(&job, 1);
+  return AssetManager::Instance()->GetIO()->ReadAsync(asset, &decode_mex_model);
 }
 
-static void mex_unload(Asset* asset) {}
+static void mex_unload(Asset* asset) {
+  c3_assert(asset->_state == ASSET_STATE_UNLOADING);
+  auto model = (Model*)asset->_header->GetData();
+  auto GR = GraphicsRenderer::Instance();
+  GR->DestroyVertexBuffer(model->_vb);
+  GR->DestroyIndexBuffer(model->_ib);
+  for (u16 i = 0; i < model->_num_materials; ++i) {
+    if (model->_materials[i]) AssetManager::Instance()->Unload(model->_materials[i]);
+  }
+  asset_free_header(asset);
+}
 
 AssetOperations MEX_MODEL_OPS = {
   &mex_load_async,
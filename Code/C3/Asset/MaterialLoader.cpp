@@ -3,13 +3,8 @@
 #include "Graphics/Material/Material.h"
 
 static ShaderHandle load_bare_shader(const char* filename, ShaderInfo::Header* header = nullptr) {
-  auto file = FileSystem::Instance()->OpenRead(filename);
-  if (file) {
-    auto mem = mem_alloc(file->GetSize());
-    file->ReadBytes(mem->data, mem->size);
-    FileSystem::Instance()->Close(file);
-    return GraphicsRenderer::Instance()->CreateShader(mem, header);
-  }
+  auto mem = AssetManager::Instance()->GetIO()->Read(filename);
+  if (mem) return GraphicsRenderer::Instance()->CreateShader(mem, header);
   return ShaderHandle();
 }
 
@@ -41,7 +36,7 @@ static bool compute_shader_binary_filename(JsonReader& reader, SubShader* _shade
   return false;
 }
 
-static Asset* load_texture_asset(const char* model_filename, const char* filename) {
+static Asset* load_texture_asset(AssetLoadGroup* loads, const char* model_filename, const char* filename) {
   String path(MAX_ASSET_NAME);
   if (strchr(filename, '.')) {
     path.Set(model_filename);
@@ -49,10 +44,10 @@ static Asset* load_texture_asset(const char* model_filename, const char* filenam
     path.Append('/');
     path.Append(filename);
   } else path.Set(filename);
-  return AssetManager::Instance()->Load(ASSET_TYPE_TEXTURE, path.GetCString());
+  return loads->Add(ASSET_TYPE_TEXTURE, path.GetCString());
 }
 
-static bool load_material_shader_param(const char* asset_filename, JsonReader& reader,
+static bool load_material_shader_param(AssetLoadGroup* loads, const char* asset_filename, JsonReader& reader,
                                        MaterialParam& param) {
   auto GR = GraphicsRenderer::Instance();
   char type_str[MAX_MATERIAL_KEY_LEN] = "";
@@ -172,7 +167,7 @@ static bool load_material_shader_param(const char* asset_filename, JsonReader& r
         char texture_filename[MAX_ASSET_NAME];
         char flag_str[MAX_MATERIAL_KEY_LEN];
         if (reader.ReadString("value", texture_filename, sizeof(texture_filename))) {
-          param._tex2d._asset = load_texture_asset(asset_filename, texture_filename);
+          param._tex2d._asset = load_texture_asset(loads, asset_filename, texture_filename);
         }
         if (reader.ReadString("flags", flag_str, sizeof(flag_str))) {
           if (strcmp(flag_str, "UV_CLAMP") == 0) param._tex2d._flags |= C3_TEXTURE_U_CLAMP | C3_TEXTURE_V_CLAMP;
@@ -186,7 +181,7 @@ static bool load_material_shader_param(const char* asset_filename, JsonReader& r
   return false;
 }
 
-static bool load_material_param(const char* asset_filename, JsonReader& reader,
+static bool load_material_param(AssetLoadGroup* loads, const char* asset_filename, JsonReader& reader,
                                 MaterialParam& param) {
   char type_str[MAX_MATERIAL_KEY_LEN] = "";
   char value_str[MAX_MATERIAL_KEY_LEN] = "";
@@ -288,7 +283,7 @@ static bool load_material_param(const char* asset_filename, JsonReader& reader,
       char texture_filename[MAX_ASSET_NAME];
       char flag_str[MAX_MATERIAL_KEY_LEN];
       if (reader.ReadString("value", texture_filename, sizeof(texture_filename))) {
-        param._tex2d._asset = load_texture_asset(asset_filename, texture_filename);
+        param._tex2d._asset = load_texture_asset(loads, asset_filename, texture_filename);
       }
       if (reader.ReadString("flags", flag_str, sizeof(flag_str))) {
         if (strcmp(flag_str, "UV_CLAMP") == 0) param._tex2d._flags = C3_TEXTURE_U_CLAMP | C3_TEXTURE_V_CLAMP;
@@ -301,19 +296,10 @@ static bool load_material_param(const char* asset_filename, JsonReader& reader,
   return false;
 }
 
-DEFINE_JOB_ENTRY(load_material_shader) {
-  auto asset = (Asset*)arg;
-  auto f = FileSystem::Instance()->OpenRead(asset->_desc._filename);
-  if (!f) {
-    asset->_state = ASSET_STATE_EMPTY;
-    return;
-  }
-  auto mem = mem_alloc(f->GetSize() + 1);
-  f->ReadBytes(mem->data, f->GetSize());
-  *((u8*)mem->data + f->GetSize()) = 0;
-  FileSystem::Instance()->Close(f);
-  
-  SpinLockGuard lock_guard(&asset->_lock);
+static void decode_material_shader(Asset* asset, const MemoryRegion* mem) {
+  // Default textures load while the shaders are created. The lock is not held
+  // while the shader binaries are read, the job yields waiting for them.
+  AssetLoadGroup loads;
   u16 num_textures = 0;
   char shader_binary_filename[MAX_ASSET_NAME];
   MaterialShader material_shader;
@@ -338,6 +324,19 @@ DEFINE_JOB_ENTRY(load_material_shader) {
       fsh = load_bare_shader(shader_binary_filename, &fs_header);
     }
     sub_shader->_program = GraphicsRenderer::Instance()->CreateProgram(vsh, fsh);
+    // Variant drawing the draws merged by auto-instancing, the program keeps it.
+    if (sub_shader->_program && reader.BeginReadArray("vs_instanced_defines")) {
+      reader.EndReadArray();
+      if (compute_shader_binary_filename(reader, sub_shader, "vs_source", "vs_instanced_defines",
+                                         shader_binary_filename, sizeof(shader_binary_filename))) {
+        ShaderHandle instanced_vsh = load_bare_shader(shader_binary_filename);
+        if (instanced_vsh) {
+          auto instanced = GraphicsRenderer::Instance()->CreateProgram(instanced_vsh, fsh);
+          GraphicsRenderer::Instance()->SetInstancedProgram(sub_shader->_program, instanced);
+          if (instanced) GraphicsRenderer::Instance()->DestroyProgram(instanced);
+        }
+      }
+    }
 
     reader.BeginReadObject("properties");
     char mat_key[MAX_MATERIAL_KEY_LEN];
@@ -347,7 +346,7 @@ DEFINE_JOB_ENTRY(load_material_shader) {
       c3_assert(value_type == JSON_VALUE_OBJECT);
       MaterialParam* param = sub_shader->_params + sub_shader->_num_params;
       strncpy(param->_name, mat_key, sizeof(mat_key));
-      if (load_material_shader_param(asset->_desc._filename, reader, *param)) {
+      if (load_material_shader_param(&loads, asset->_desc._filename, reader, *param)) {
         if (param->_type == MATERIAL_PARAM_TEXTURE2D) {
           ++num_textures;
           texture_descs.push_back(param->_tex2d._asset->_desc);
@@ -368,15 +367,20 @@ DEFINE_JOB_ENTRY(load_material_shader) {
 
   mem_free(mem); // json data
 
+  asset->_lock.Lock();
   u32 asset_memory_size = ASSET_MEMORY_SIZE(num_textures, sizeof(MaterialShader));
-  asset->_header = (AssetMemoryHeader*)C3_ALLOC(g_allocator, asset_memory_size);
+  asset->_header = (AssetMemoryHeader*)C3_ALLOC(mem_allocator(MEMORY_TAG_ASSET), asset_memory_size);
   asset->_header->_size = asset_memory_size;
   asset->_header->_num_depends = num_textures;
   if (num_textures > 0) memcpy(asset->_header->_depends, texture_descs.data(),
                                sizeof(AssetDesc) * num_textures);
   auto ms = (MaterialShader*)asset->_header->GetData();
   memcpy(ms, &material_shader, sizeof(MaterialShader));
-  asset->_state = ASSET_STATE_READY;
+  asset->_lock.Unlock();
+
+  asset_load_wait(asset);
+  loads.Wait();
+  asset_load_end(asset, ASSET_STATE_READY);
 }
 
 static MaterialParam* find_material_param(MaterialShader* shader, const char* name) {
@@ -388,18 +392,7 @@ static MaterialParam* find_material_param(MaterialShader* shader, const char* na
   return nullptr;
 }
 
-DEFINE_JOB_ENTRY(load_material) {
-  auto asset = (Asset*)arg;
-  auto f = FileSystem::Instance()->OpenRead(asset->_desc._filename);
-  if (!f) {
-    asset->_state = ASSET_STATE_EMPTY;
-    return;
-  }
-  auto mem = mem_alloc(f->GetSize() + 1);
-  f->ReadBytes(mem->data, f->GetSize());
-  *((u8*)mem->data + f->GetSize()) = 0;
-  FileSystem::Instance()->Close(f);
-
+static void decode_material(Asset* asset, const MemoryRegion* mem) {
   JsonReader reader((const char*)mem->data);
   c3_assert(reader.IsValid());
   char shader_filename[MAX_ASSET_NAME] = "Shaders/";
@@ -408,13 +401,15 @@ DEFINE_JOB_ENTRY(load_material) {
   strcat(shader_filename, ".mas");
   Asset* shader_asset = AssetManager::Instance()->Load(ASSET_TYPE_MATERIAL_SHADER, shader_filename);
   c3_assert(shader_asset);
+  // Textures load in parallel, waited for after the locks are released.
+  AssetLoadGroup loads;
   {
     SpinLockGuard shader_lock_guard(&shader_asset->_lock);
     if (shader_asset->_state == ASSET_STATE_READY) {
       auto shader = (MaterialShader*)shader_asset->_header->GetData();
       SpinLockGuard lock_guard(&asset->_lock);
       u32 asset_mem_size = ASSET_MEMORY_SIZE(1 + shader_asset->_header->_num_depends, sizeof(Material));
-      asset->_header = (AssetMemoryHeader*)C3_ALLOC(g_allocator, asset_mem_size);
+      asset->_header = (AssetMemoryHeader*)C3_ALLOC(mem_allocator(MEMORY_TAG_ASSET), asset_mem_size);
       asset->_header->_size = asset_mem_size;
 
       asset->_header->_num_depends = 1 + shader_asset->_header->_num_depends;
@@ -445,7 +440,7 @@ DEFINE_JOB_ENTRY(load_material) {
         strcpy(param->_name, shader_param->_name);
         param->_constant_handle = shader_param->_constant_handle;
         param->_type = shader_param->_type;
-        load_material_param(asset->_desc._filename, reader, *param);
+        load_material_param(&loads, asset->_desc._filename, reader, *param);
         if (param->_type == MATERIAL_PARAM_TEXTURE2D) {
           asset->_header->_depends[1 + num_textures++] = param->_tex2d._asset->_desc;
         }
@@ -455,31 +450,49 @@ DEFINE_JOB_ENTRY(load_material) {
     }
   }
   mem_free(mem);
-  asset->_state = ASSET_STATE_READY;
+  asset_load_wait(asset);
+  loads.Wait();
+  asset_load_end(asset, ASSET_STATE_READY);
 }
 
 static atomic_int* material_shader_load_async(Asset* asset) {
   c3_assert(asset->_state == ASSET_STATE_LOADING);
-  auto JS = JobScheduler::Instance();
-  Job job;
-  job.InitWorkerJob(load_material_shader, asset);
-  return JS->SubmitJobs(&job, 1);
+  return AssetManager::Instance()->GetIO()->ReadAsync(asset, &decode_material_shader);
+}
+
+static void release_texture_params(MaterialParam* params, u32 num_params) {
+  for (u32 i = 0; i < num_params; ++i) {
+    if (params[i]._type == MATERIAL_PARAM_TEXTURE2D && params[i]._tex2d._asset) {
+      AssetManager::Instance()->Unload(params[i]._tex2d._asset);
+    }
+  }
 }
 
 static void material_shader_unload(Asset* asset) {
   c3_assert(asset->_state == ASSET_STATE_UNLOADING);
+  auto ms = (MaterialShader*)asset->_header->GetData();
+  for (u32 i = 0; i < ms->_num_sub_shaders; ++i) {
+    SubShader* sub_shader = ms->_sub_shaders + i;
+    // The program owns its shaders.
+    if (sub_shader->_program) GraphicsRenderer::Instance()->DestroyProgram(sub_shader->_program);
+    release_texture_params(sub_shader->_params, sub_shader->_num_params);
+  }
+  asset_free_header(asset);
 }
 
 static atomic_int* material_load_async(Asset* asset) {
   c3_assert(asset->_state == ASSET_STATE_LOADING);
-  auto JS = JobScheduler::Instance();
-  Job job;
-  job.InitWorkerJob(load_material, asset);
-  return JS->SubmitJobs(&job, 1);
+  return AssetManager::Instance()->GetIO()->ReadAsync(asset, &decode_material);
 }
 
 static void material_unload(Asset* asset) {
   c3_assert(asset->_state == ASSET_STATE_UNLOADING);
+  // Failed to load without its shader.
+  if (!asset->_header) return;
+  auto mat = (Material*)asset->_header->GetData();
+  release_texture_params(mat->_params, mat->_num_params);
+  AssetManager::Instance()->Unload(mat->_shader_asset);
+  asset_free_header(asset);
 }
 
 AssetOperations MATERIAL_SHADER_OPS = {
@@ -1,33 +1,26 @@
 #include "C3PCH.h"
 #include "SimpleFileLoader.h"
 
-DEFINE_JOB_ENTRY(load_file) {
-  auto asset = (Asset*)arg;
-  auto f = FileSystem::Instance()->OpenRead(asset->_desc._filename);
-  if (!f) {
-    asset->_state = ASSET_STATE_EMPTY;
-    return;
-  }
+static void decode_file(Asset* asset, const MemoryRegion* mem) {
+  u32 asset_mem_size = ASSET_MEMORY_SIZE(0, mem->size);
+  auto asset_header = (AssetMemoryHeader*)C3_ALLOC(mem_allocator(MEMORY_TAG_ASSET), asset_mem_size);
+  asset_header->_size = asset_mem_size;
+  asset_header->_num_depends = 0;
+  memcpy(asset_header->GetData(), mem->data, mem->size);
+  mem_free(mem);
   SpinLockGuard lock_guard(&asset->_lock);
-  asset->_header = (AssetMemoryHeader*)C3_ALLOC(g_allocator, ASSET_MEMORY_SIZE(0, f->GetSize()));
-  asset->_header->_size = ASSET_MEMORY_SIZE(0, f->GetSize());
-  asset->_header->_num_depends = 0;
-  auto data = asset->_header->GetData();
-  f->ReadBytes(data, f->GetSize());
-  FileSystem::Instance()->Close(f);
-  asset->_state = ASSET_STATE_READY;
+  asset->_header = asset_header;
+  asset_load_end(asset, ASSET_STATE_READY);
 }
 
 static atomic_int* file_load_async(Asset* asset) {
   c3_assert(asset->_state == ASSET_STATE_LOADING);
-  auto JS = JobScheduler::Instance();
-  Job job;
-  job.InitWorkerJob(load_file, asset);
-  return JS->SubmitJobs(&job, 1);
+  return AssetManager::Instance()->GetIO()->ReadAsync(asset, &decode_file);
 }
 
 static void file_unload(Asset* asset) {
   c3_assert(asset->_state == ASSET_STATE_UNLOADING);
+  asset_free_header(asset);
 }
 
 AssetOperations SIMPLE_FILE_OPS = {
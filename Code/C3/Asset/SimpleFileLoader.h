@@ -1,4 +1,4 @@
 #pragma once
-#include "Asset.h"
+#include "AssetManager.h"
 
 extern AssetOperations SIMPLE_FILE_OPS;
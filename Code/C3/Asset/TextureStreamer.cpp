@@ -0,0 +1,241 @@
+#include "C3PCH.h"
+#include "TextureStreamer.h"
+#include "AssetManager.h"
+
+// Re-creates a texture with the mips from _skip on, the job only reads the stream.
+struct TextureStreamRequest {
+  TextureStreamer* _streamer;
+  TextureStream* _stream;
+  u8 _skip;
+  atomic_int* _label;
+  // Written by the job.
+  TextureHandle _handle;      // invalid if the mips could not be read.
+  TextureInfo _info;
+  u32 _ticket;
+  atomic_bool _done;
+};
+
+TextureStreamer::TextureStreamer()
+: _budget(C3_TEXTURE_STREAM_POOL), _resident_bytes(0), _committed_bytes(0), _num_streamed_in(0), _num_dropped(0),
+  _bytes_read(0) {}
+
+TextureStreamer::~TextureStreamer() {
+  while (!_requests.empty()) {
+    auto request = _requests.back();
+    JobScheduler::Instance()->WaitAndFreeJobs(request->_label);
+    EndRequest(request);
+  }
+}
+
+bool TextureStreamer::InitStream(TextureStream* stream, Asset* asset, Texture* texture, const MemoryRegion* mem,
+                                 u32 flags) {
+  if (C3_TEXTURE_STREAM_TAIL_SIZE == 0) return false;
+  ImageContainer& image = stream->_image;
+  if (!image_parse(image, mem->data, mem->size)) return false;
+  // Cube maps, volumes and textures without mips load whole.
+  if (image.offset == UINT32_MAX || image.offset > mem->size || image.cube_map || image.depth > 1 ||
+      image.num_mips <= 1 || image.num_mips > MAX_TEXTURE_STREAM_MIPS) return false;
+  // The top mip of a texture must be whole blocks.
+  const ImageBlockInfo& ibi = image_block_info((TextureFormat)image.format);
+  u8 tail_skip = 0;
+  while (tail_skip + 1 < image.num_mips &&
+         max(image.width >> tail_skip, image.height >> tail_skip) > C3_TEXTURE_STREAM_TAIL_SIZE) {
+    u32 width = image.width >> (tail_skip + 1);
+    u32 height = image.height >> (tail_skip + 1);
+    if (!width || !height || width % ibi.block_width || height % ibi.block_height) break;
+    ++tail_skip;
+  }
+  if (tail_skip == 0) return false;
+  for (u8 lod = 0; lod <= image.num_mips; ++lod) stream->_mip_offsets[lod] = image_get_mip_offset(image, lod);
+  memcpy(stream->_header, mem->data, image.offset);
+  stream->_asset = asset;
+  stream->_texture = texture;
+  stream->_flags = flags;
+  stream->_tail_skip = tail_skip;
+  stream->_resident_skip = tail_skip;
+  stream->_pending_skip = tail_skip;
+  stream->_wanted_skip = tail_skip;
+  stream->_wanted_size = 0;
+  stream->_last_requested = 0;
+  stream->_index = -1;
+  stream->_request = nullptr;
+  return true;
+}
+
+TextureHandle TextureStreamer::UploadMips(const TextureStream* stream, u8 skip, const MemoryRegion* data,
+                                          TextureInfo* info_out, u32* ticket_out) {
+  // The file's header rewritten to start at the skipped mip, then its pixels.
+  u32 header_size = stream->_image.offset;
+  auto mem = mem_alloc(header_size + data->size);
+  memcpy(mem->data, stream->_header, header_size);
+  image_dds_set_top_mip(mem->data, stream->_image, skip);
+  memcpy((u8*)mem->data + header_size, data->data, data->size);
+  TextureHandle handle = GraphicsRenderer::Instance()->UploadTexture(mem, stream->_flags, 0, info_out, ticket_out);
+  if (!handle) mem_free(mem);
+  return handle;
+}
+
+void TextureStreamer::Add(TextureStream* stream) {
+  SpinLockGuard lock_guard(&_lock);
+  _added.push_back(stream);
+}
+
+void TextureStreamer::Remove(TextureStream* stream) {
+  if (auto request = stream->_request) {
+    // The job reads the stream, its texture is never swapped in.
+    JobScheduler::Instance()->WaitAndFreeJobs(request->_label);
+    if (request->_handle) GraphicsRenderer::Instance()->DestroyTexture(request->_handle);
+    EndRequest(request);
+  }
+  _committed_bytes -= GetDetailBytes(stream, stream->_pending_skip);
+  _resident_bytes -= GetDetailBytes(stream, stream->_resident_skip);
+  if (stream->_index < 0) {
+    SpinLockGuard lock_guard(&_lock);
+    _added.erase(find(_added.begin(), _added.end(), stream));
+    return;
+  }
+  _streams[stream->_index] = _streams.back();
+  _streams[stream->_index]->_index = stream->_index;
+  _streams.pop_back();
+  stream->_index = -1;
+}
+
+void TextureStreamer::EndRequest(TextureStreamRequest* request) {
+  request->_stream->_request = nullptr;
+  *find(_requests.begin(), _requests.end(), request) = _requests.back();
+  _requests.pop_back();
+  C3_DELETE(mem_allocator(MEMORY_TAG_ASSET), request);
+}
+
+u8 TextureStreamer::GetSkipForSize(const TextureStream* stream, u32 screen_size) {
+  u32 size = max(stream->_image.width, stream->_image.height);
+  // Smallest mip still as large as the screen size.
+  u8 skip = 0;
+  while (skip < stream->_tail_skip && (size >> (skip + 1)) >= screen_size) ++skip;
+  return skip;
+}
+
+void TextureStreamer::StreamTo(TextureStream* stream, u8 skip) {
+  auto request = C3_NEW(mem_allocator(MEMORY_TAG_ASSET), TextureStreamRequest);
+  request->_streamer = this;
+  request->_stream = stream;
+  request->_skip = skip;
+  request->_handle = TextureHandle();
+  request->_ticket = 0;
+  request->_done = false;
+  _committed_bytes += GetDetailBytes(stream, skip) - GetDetailBytes(stream, stream->_pending_skip);
+  stream->_pending_skip = skip;
+  stream->_request = request;
+  _requests.push_back(request);
+  Job job;
+  job.InitWorkerJob(&TextureStreamer::StreamJob, request, FIBER_STACK_LARGE);
+  request->_label = JobScheduler::Instance()->SubmitJobs(&job, 1);
+}
+
+void TextureStreamer::StreamJob(void* arg) {
+  auto request = (TextureStreamRequest*)arg;
+  const TextureStream* stream = request->_stream;
+  u32 offset = stream->_mip_offsets[request->_skip];
+  u32 size = stream->_mip_offsets[stream->_image.num_mips] - offset;
+  auto data = AssetManager::Instance()->GetIO()->Read(stream->_asset->_desc._filename, offset, size);
+  if (data) {
+    request->_streamer->_bytes_read.fetch_add(data->size, memory_order_relaxed);
+    if (data->size == size) request->_handle = UploadMips(stream, request->_skip, data, &request->_info, &request->_ticket);
+    mem_free(data);
+  }
+  request->_done.store(true, memory_order_release);
+}
+
+void TextureStreamer::Update(u32 frame) {
+  auto GR = GraphicsRenderer::Instance();
+  {
+    SpinLockGuard lock_guard(&_lock);
+    for (auto stream : _added) {
+      stream->_index = (int)_streams.size();
+      stream->_last_requested = frame;
+      _streams.push_back(stream);
+    }
+    _added.clear();
+  }
+
+  // Swaps in the textures the render thread created, frames drawn with the old
+  // ones were submitted before it is destroyed.
+  for (size_t i = 0; i < _requests.size();) {
+    auto request = _requests[i];
+    if (!request->_done.load(memory_order_acquire) || (request->_handle && !GR->IsUploaded(request->_ticket))) {
+      ++i;
+      continue;
+    }
+    JobScheduler::Instance()->WaitAndFreeJobs(request->_label);
+    TextureStream* stream = request->_stream;
+    if (!request->_handle) {
+      // Keeps the mips it has and stops streaming.
+      c3_log("[C3] TextureStreamer: failed to read the mips of '%s'.\n", stream->_asset->_desc._filename);
+      EndRequest(request);
+      Remove(stream);
+      stream->_texture->_stream = nullptr;
+      continue;
+    }
+    auto texture = stream->_texture;
+    GR->DestroyTexture(texture->_handle);
+    texture->_handle = request->_handle;
+    texture->_info = request->_info;
+    _resident_bytes += GetDetailBytes(stream, request->_skip) - GetDetailBytes(stream, stream->_resident_skip);
+    if (request->_skip < stream->_resident_skip) ++_num_streamed_in;
+    else ++_num_dropped;
+    stream->_resident_skip = request->_skip;
+    EndRequest(request);
+  }
+
+  _upgrades.clear();
+  _drops.clear();
+  for (auto stream : _streams) {
+    u32 wanted_size = stream->_wanted_size.exchange(0, memory_order_relaxed);
+    if (wanted_size) {
+      stream->_wanted_skip = GetSkipForSize(stream, wanted_size);
+      stream->_last_requested = frame;
+    } else if (frame - stream->_last_requested > C3_TEXTURE_STREAM_KEEP_FRAMES) {
+      stream->_wanted_skip = stream->_tail_skip;
+    }
+    if (stream->_request) continue;
+    if (stream->_wanted_skip < stream->_resident_skip) _upgrades.push_back(stream);
+    else if (stream->_resident_skip < stream->_tail_skip) _drops.push_back(stream);
+  }
+
+  // Textures not drawn lately drop their detail, then the least recently drawn
+  // ones while over budget.
+  sort(_drops.begin(), _drops.end(), [](const TextureStream* a, const TextureStream* b) {
+    return a->_last_requested < b->_last_requested;
+  });
+  for (auto stream : _drops) {
+    if (_requests.size() >= C3_TEXTURE_STREAM_REQUESTS) break;
+    bool stale = frame - stream->_last_requested > C3_TEXTURE_STREAM_KEEP_FRAMES;
+    if (!stale && _committed_bytes <= _budget) break;
+    StreamTo(stream, stream->_tail_skip);
+  }
+
+  // Largest lack of detail first, each gets the finest mips fitting the budget.
+  sort(_upgrades.begin(), _upgrades.end(), [](const TextureStream* a, const TextureStream* b) {
+    int a_lack = a->_resident_skip - a->_wanted_skip;
+    int b_lack = b->_resident_skip - b->_wanted_skip;
+    return a_lack != b_lack ? a_lack > b_lack : a->_last_requested > b->_last_requested;
+  });
+  for (auto stream : _upgrades) {
+    if (_requests.size() >= C3_TEXTURE_STREAM_REQUESTS) break;
+    u64 committed = _committed_bytes - GetDetailBytes(stream, stream->_pending_skip);
+    u8 skip = stream->_wanted_skip;
+    while (skip < stream->_resident_skip && committed + GetDetailBytes(stream, skip) > _budget) ++skip;
+    if (skip < stream->_resident_skip) StreamTo(stream, skip);
+  }
+}
+
+void TextureStreamer::GetStats(TextureStreamStats* stats) const {
+  stats->num_streams = (u32)_streams.size();
+  stats->num_requests = (u32)_requests.size();
+  stats->resident_bytes = _resident_bytes;
+  stats->committed_bytes = _committed_bytes;
+  stats->budget = _budget;
+  stats->num_streamed_in = _num_streamed_in;
+  stats->num_dropped = _num_dropped;
+  stats->bytes_read = _bytes_read.load(memory_order_relaxed);
+}
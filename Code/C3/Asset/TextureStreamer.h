@@ -0,0 +1,100 @@
+#pragma once
+#include "Asset.h"
+#include "Graphics/Image/ImageUtils.h"
+#include "Graphics/Material/Texture.h"
+#include "Memory/MemoryRegion.h"
+
+#define MAX_TEXTURE_STREAM_MIPS 16
+
+struct TextureStreamRequest;
+
+// Streaming state of a texture loaded with its tail mips only, kept after the
+// Texture in its asset header. A skip counts the top mips left out of the GPU
+// texture, the file's mips from a skip on are contiguous.
+struct TextureStream {
+  Asset* _asset;
+  Texture* _texture;
+  ImageContainer _image;        // of the file.
+  u8 _header[IMAGE_DDS_MAX_HEADER_SIZE];
+  u32 _mip_offsets[MAX_TEXTURE_STREAM_MIPS + 1];   // in the file, [num_mips] is the end.
+  u32 _flags;                   // texture create flags.
+  u8 _tail_skip;                // loaded with the asset.
+  u8 _resident_skip;
+  u8 _pending_skip;             // being streamed, _resident_skip if none.
+  u8 _wanted_skip;              // finest the recent frames drew.
+  atomic_u32 _wanted_size;      // largest screen size in pixels drawn this frame.
+  u32 _last_requested;          // frame
+  int _index;                   // in TextureStreamer::_streams, -1 while just added.
+  TextureStreamRequest* _request;   // nullptr if none.
+};
+
+struct TextureStreamStats {
+  u32 num_streams;
+  u32 num_requests;             // textures being re-created.
+  u64 resident_bytes;           // mips above the tails.
+  u64 committed_bytes;          // resident once the requests are done.
+  u64 budget;
+  u32 num_streamed_in;          // since start.
+  u32 num_dropped;
+  u64 bytes_read;
+};
+
+/*
+* TextureStreamer keeps the mips of 2D DDS textures above their tails
+* resident as long as they are drawn large enough to need them. The loader
+* reads and creates a texture from its tail mips only. Renderers ask for the
+* screen size a texture is drawn at, Update then re-creates it with the mips
+* the size needs, within the pool budget, from a job reading just those mips,
+* and swaps it in once the render thread created it. Textures not drawn for
+* C3_TEXTURE_STREAM_KEEP_FRAMES drop back to their tail.
+*/
+class TextureStreamer {
+public:
+  TextureStreamer();
+  ~TextureStreamer();
+
+  // Fills stream from the DDS header in mem, false if the texture is loaded whole.
+  static bool InitStream(TextureStream* stream, Asset* asset, Texture* texture, const MemoryRegion* mem, u32 flags);
+  // Texture of the file's mips from skip on, data holds their pixels. Like
+  // GraphicsRenderer::UploadTexture, data is not kept.
+  static TextureHandle UploadMips(const TextureStream* stream, u8 skip, const MemoryRegion* data,
+                                  TextureInfo* info_out, u32* ticket_out);
+  // Any thread, during rendering.
+  static void Request(TextureStream* stream, u32 screen_size) {
+    u32 wanted = stream->_wanted_size.load(memory_order_relaxed);
+    while (wanted < screen_size &&
+           !stream->_wanted_size.compare_exchange_weak(wanted, screen_size, memory_order_relaxed)) {}
+  }
+
+  // Any thread, the stream's texture is ready.
+  void Add(TextureStream* stream);
+  // Main thread, before the texture is destroyed.
+  void Remove(TextureStream* stream);
+  // Main thread once a frame, after rendering.
+  void Update(u32 frame);
+  void SetBudget(u64 bytes) { _budget = bytes; }
+  void GetStats(TextureStreamStats* stats) const;
+
+private:
+  static u64 GetDetailBytes(const TextureStream* stream, u8 skip) {
+    return stream->_mip_offsets[stream->_tail_skip] - stream->_mip_offsets[skip];
+  }
+  static u8 GetSkipForSize(const TextureStream* stream, u32 screen_size);
+  void StreamTo(TextureStream* stream, u8 skip);
+  void EndRequest(TextureStreamRequest* request);
+  static void StreamJob(void* arg);
+
+  SpinLock _lock;
+  vector<TextureStream*> _added;      // under _lock.
+  // Main thread.
+  vector<TextureStream*> _streams;
+  vector<TextureStreamRequest*> _requests;
+  vector<TextureStream*> _upgrades;
+  vector<TextureStream*> _drops;
+  u64 _budget;
+  u64 _resident_bytes;
+  u64 _committed_bytes;
+  u32 _num_streamed_in;
+  u32 _num_dropped;
+  atomic<u64> _bytes_read;
+};
@@ -1,12 +1,18 @@
 #pragma once
-
-#pragma once
-#include "SPSCQueue.h"
+#include "Data/DataType.h"
+#include "Memory/Allocator.h"
 #include "Platform/PlatformSync.h"
+#include <type_traits>
+#include <utility>
 
 /*
-* MPMCQueue is a multiple producer and multiple consumer queue
-* with lock.
+* MPMCQueue is a multiple producer and multiple consumer bounded queue
+* without locks (Dmitry Vyukov's sequence-numbered ring).
+*
+* Every cell carries a sequence number telling which lap it is ready for:
+* seq == pos means empty and writable at pos, seq == pos + 1 means written
+* and readable at pos. Producers and consumers only contend on their own
+* index, each index lives on its own cache line.
 */
 template<class T>
 struct MPMCQueue {
@@ -15,76 +21,127 @@ struct MPMCQueue {
   MPMCQueue(const MPMCQueue&) = delete;
   MPMCQueue& operator = (const MPMCQueue&) = delete;
 
-  // size must be >= 2.
-  //
-  // Also, note that the number of usable slots in the queue at any
-  // given time is actually (size-1), so if you start with an empty queue,
-  // isFull() will return true after size-1 insertions.
+  // size must be >= 2, it is rounded up to power of two and all slots are usable.
   explicit MPMCQueue(u32 size, IAllocator* allocator = g_allocator)
-  : _spsc_queue(size, allocator) {
-    _lock.Reset();
+  : _allocator(allocator) {
+    c3_assert(size >= 2 && size <= (1u << 31));
+    u32 capacity = 2;
+    while (capacity < size) capacity <<= 1;
+    _mask = capacity - 1;
+    _cells = static_cast<Cell*>(C3_ALLOC(allocator, sizeof(Cell) * capacity));
+    c3_assert(_cells);
+    for (u32 i = 0; i < capacity; ++i) new (&_cells[i]._sequence) atomic_u32(i);
+    _write_index.store(0, memory_order_relaxed);
+    _read_index.store(0, memory_order_relaxed);
   }
 
-  ~MPMCQueue() {}
+  ~MPMCQueue() {
+    // Only one thread can be here, drop what is left.
+    if (!std::is_trivially_destructible<T>::value) {
+      u32 end = _write_index.load(memory_order_relaxed);
+      for (u32 pos = _read_index.load(memory_order_relaxed); pos != end; ++pos) {
+        _cells[pos & _mask].Record()->~T();
+      }
+    }
+    C3_FREE(_allocator, _cells);
+  }
 
   template<class ...Args>
   bool Write(Args&&... recordArgs) {
-    _lock.Lock();
-    bool ok = _spsc_queue.Write(std::forward<Args>(recordArgs)...);
-    _lock.Unlock();
-    return ok;
+    Cell* cell;
+    u32 pos = _write_index.load(memory_order_relaxed);
+    for (;;) {
+      cell = &_cells[pos & _mask];
+      i32 diff = (i32)(cell->_sequence.load(memory_order_acquire) - pos);
+      if (diff == 0) {
+        if (_write_index.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        // queue is full
+        return false;
+      } else {
+        pos = _write_index.load(memory_order_relaxed);
+      }
+    }
+    new (cell->Record()) T(std::forward<Args>(recordArgs)...);
+    cell->_sequence.store(pos + 1, memory_order_release);
+    return true;
   }
 
   // move (or copy) the value at the front of the queue to given variable
   bool Read(T& record) {
-    _lock.Lock();
-    bool ok = _spsc_queue.Read(record);
-    _lock.Unlock();
-    return ok;
+    Cell* cell;
+    u32 pos = _read_index.load(memory_order_relaxed);
+    for (;;) {
+      cell = &_cells[pos & _mask];
+      i32 diff = (i32)(cell->_sequence.load(memory_order_acquire) - (pos + 1));
+      if (diff == 0) {
+        if (_read_index.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        // queue is empty
+        return false;
+      } else {
+        pos = _read_index.load(memory_order_relaxed);
+      }
+    }
+    T* ptr = cell->Record();
+    record = std::move(*ptr);
+    ptr->~T();
+    cell->_sequence.store(pos + _mask + 1, memory_order_release);
+    return true;
   }
 
   // pointer to the value at the front of the queue (for use in-place) or
-  // nullptr if empty.
+  // nullptr if empty. Another consumer may take the record meanwhile, so
+  // FrontPtr/PopFront are only safe while consumers are serialized by caller.
   T* FrontPtr() {
-    _lock.Lock();
-    T* ptr = _spsc_queue.FrontPtr();
-    _lock.Unlock();
-    return ptr;
+    u32 pos = _read_index.load(memory_order_relaxed);
+    Cell* cell = &_cells[pos & _mask];
+    if (cell->_sequence.load(memory_order_acquire) != pos + 1) return nullptr;
+    return cell->Record();
   }
 
-  // queue must not be empty
+  // queue must not be empty, see FrontPtr.
   void PopFront() {
-    _lock.Lock();
-    _spsc_queue.PopFront();
-    _lock.Unlock();
+    u32 pos = _read_index.load(memory_order_relaxed);
+    Cell* cell = &_cells[pos & _mask];
+    c3_assert(cell->_sequence.load(memory_order_acquire) == pos + 1);
+    _read_index.store(pos + 1, memory_order_relaxed);
+    cell->Record()->~T();
+    cell->_sequence.store(pos + _mask + 1, memory_order_release);
   }
 
   bool IsEmpty() const {
-    _lock.Lock();
-    bool empty = _spsc_queue.IsEmpty();
-    _lock.Unlock();
-    return empty;
+    u32 pos = _read_index.load(memory_order_relaxed);
+    return _cells[pos & _mask]._sequence.load(memory_order_acquire) != pos + 1;
   }
 
   bool IsFull() const {
-    _lock.Lock();
-    bool full = _spsc_queue.IsFull();
-    _lock.Unlock();
-    return full;
+    u32 pos = _write_index.load(memory_order_relaxed);
+    return _cells[pos & _mask]._sequence.load(memory_order_acquire) != pos;
   }
 
-  // * If called by consumer, then true size may be more (because producer may
-  //   be adding items concurrently).
-  // * If called by producer, then true size may be less (because consumer may
-  //   be removing items concurrently).
-  // * It is undefined to call this from any other thread.
+  // Snapshot only, may be stale by the time it returns.
   size_t SizeGuess() const {
-    return _spsc_queue.SizeGuess();
+    i32 ret = (i32)(_write_index.load(memory_order_acquire) - _read_index.load(memory_order_acquire));
+    return ret > 0 ? min<size_t>(ret, _mask + 1) : 0;
   }
 
+  u32 Capacity() const { return _mask + 1; }
+
 private:
-  SpinLock _lock;
-  SPSCQueue<T> _spsc_queue;
-};
+  struct Cell {
+    atomic_u32 _sequence;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type _storage;
 
+    T* Record() { return reinterpret_cast<T*>(&_storage); }
+  };
 
+  IAllocator* _allocator;
+  Cell* _cells;
+  u32 _mask;
+  u8 _pad0[CACHELINE_SIZE];
+  atomic_u32 _write_index;
+  u8 _pad1[CACHELINE_SIZE - sizeof(atomic_u32)];
+  atomic_u32 _read_index;
+  u8 _pad2[CACHELINE_SIZE - sizeof(atomic_u32)];
+};
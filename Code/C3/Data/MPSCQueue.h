@@ -1,10 +1,19 @@
 #pragma once
-#include "SPSCQueue.h"
+#include "Data/DataType.h"
+#include "Memory/Allocator.h"
 #include "Platform/PlatformSync.h"
+#include <type_traits>
+#include <utility>
 
 /*
-* MPSCQueue is a multiple producer and one consumer queue
-* with producer locks.
+* MPSCQueue is a multiple producer and one consumer bounded queue
+* without locks.
+*
+* Write is wait-free: a producer reserves room with one fetch_add on
+* _num_reserved, claims its slot with one fetch_add on _write_index, then
+* publishes the cell by storing its sequence. Reservation guarantees the
+* claimed slot was already consumed, so producers never retry.
+* Read/FrontPtr/PopFront must only be called from the consumer thread.
 */
 template<class T>
 struct MPSCQueue {
@@ -13,66 +22,102 @@ struct MPSCQueue {
   MPSCQueue(const MPSCQueue&) = delete;
   MPSCQueue& operator = (const MPSCQueue&) = delete;
 
-  // size must be >= 2.
-  //
-  // Also, note that the number of usable slots in the queue at any
-  // given time is actually (size-1), so if you start with an empty queue,
-  // isFull() will return true after size-1 insertions.
+  // size must be >= 2, it is rounded up to power of two and all slots are usable.
   explicit MPSCQueue(u32 size, IAllocator* allocator = g_allocator)
-  : _spsc_queue(size, allocator) {
-    _producer_lock.Reset();
+  : _allocator(allocator) {
+    c3_assert(size >= 2 && size <= (1u << 31));
+    u32 capacity = 2;
+    while (capacity < size) capacity <<= 1;
+    _mask = capacity - 1;
+    _cells = static_cast<Cell*>(C3_ALLOC(allocator, sizeof(Cell) * capacity));
+    c3_assert(_cells);
+    // Cell at slot i first becomes readable with sequence i + 1.
+    for (u32 i = 0; i < capacity; ++i) new (&_cells[i]._sequence) atomic_u32(i);
+    _num_reserved.store(0, memory_order_relaxed);
+    _write_index.store(0, memory_order_relaxed);
+    _read_index = 0;
   }
 
-  ~MPSCQueue() {}
+  ~MPSCQueue() {
+    if (!std::is_trivially_destructible<T>::value) {
+      while (FrontPtr()) PopFront();
+    }
+    C3_FREE(_allocator, _cells);
+  }
 
   template<class ...Args>
   bool Write(Args&&... recordArgs) {
-    _producer_lock.Lock();
-    bool ok = _spsc_queue.Write(std::forward<Args>(recordArgs)...);
-    _producer_lock.Unlock();
-    return ok;
+    if (_num_reserved.fetch_add(1, memory_order_acquire) > _mask) {
+      // queue is full
+      _num_reserved.fetch_sub(1, memory_order_relaxed);
+      return false;
+    }
+    u32 pos = _write_index.fetch_add(1, memory_order_relaxed);
+    Cell* cell = &_cells[pos & _mask];
+    new (cell->Record()) T(std::forward<Args>(recordArgs)...);
+    cell->_sequence.store(pos + 1, memory_order_release);
+    return true;
   }
 
   // move (or copy) the value at the front of the queue to given variable
   bool Read(T& record) {
-    return _spsc_queue.Read(record);
+    T* ptr = FrontPtr();
+    if (!ptr) return false;
+    record = std::move(*ptr);
+    PopFront();
+    return true;
   }
 
   // pointer to the value at the front of the queue (for use in-place) or
-  // nullptr if empty.
+  // nullptr if empty. A record claimed but not yet published reads as empty.
   T* FrontPtr() {
-    return _spsc_queue.FrontPtr();
+    Cell* cell = &_cells[_read_index & _mask];
+    if (cell->_sequence.load(memory_order_acquire) != _read_index + 1) return nullptr;
+    return cell->Record();
   }
 
   // queue must not be empty
   void PopFront() {
-    _spsc_queue.PopFront();
+    Cell* cell = &_cells[_read_index & _mask];
+    c3_assert(cell->_sequence.load(memory_order_relaxed) == _read_index + 1);
+    cell->Record()->~T();
+    ++_read_index;
+    // Hands the slot back to producers.
+    _num_reserved.fetch_sub(1, memory_order_release);
   }
 
   bool IsEmpty() const {
-    _producer_lock.Lock();
-    bool empty = _spsc_queue.IsEmpty();
-    _producer_lock.Unlock();
-    return empty;
+    return _num_reserved.load(memory_order_acquire) == 0;
   }
 
   bool IsFull() const {
-    _producer_lock.Lock();
-    bool full = _spsc_queue.IsFull();
-    _producer_lock.Unlock();
-    return full;
+    return _num_reserved.load(memory_order_acquire) > _mask;
   }
 
-  // * If called by consumer, then true size may be more (because producer may
-  //   be adding items concurrently).
-  // * If called by producer, then true size may be less (because consumer may
-  //   be removing items concurrently).
-  // * It is undefined to call this from any other thread.
+  // Includes records being written, so may be more than Read can return now.
   size_t SizeGuess() const {
-    return _spsc_queue.SizeGuess();
+    return min<u32>(_num_reserved.load(memory_order_acquire), _mask + 1);
   }
 
+  u32 Capacity() const { return _mask + 1; }
+
 private:
-  SpinLock _producer_lock;
-  SPSCQueue<T> _spsc_queue;
+  struct Cell {
+    atomic_u32 _sequence;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type _storage;
+
+    T* Record() { return reinterpret_cast<T*>(&_storage); }
+  };
+
+  IAllocator* _allocator;
+  Cell* _cells;
+  u32 _mask;
+  u8 _pad0[CACHELINE_SIZE];
+  // Producers.
+  atomic_u32 _num_reserved;
+  atomic_u32 _write_index;
+  u8 _pad1[CACHELINE_SIZE - 2 * sizeof(atomic_u32)];
+  // Consumer only.
+  u32 _read_index;
+  u8 _pad2[CACHELINE_SIZE - sizeof(u32)];
 };
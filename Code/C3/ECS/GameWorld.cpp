@@ -12,6 +12,9 @@ GameWorld::GameWorld() {
   _num_transforms = 0;
   INIT_LIST_HEAD(&_entity_list);
   _entity_dense_map_dirty = true;
+  _transform_order_dirty = true;
+  _transform_version = 0;
+  _num_updated_transforms = 0;
 }
 GameWorld::~GameWorld() {}
 
@@ -38,6 +41,7 @@ EntityHandle GameWorld::CreateEntity(EntityHandle parent) {
     _entities[h.idx]._parent = parent;
     list_add_tail(&_entities[h.idx]._sibling_link, &_entities[parent.idx]._child_list);
     _entity_dense_map_dirty = true;
+    _transform_order_dirty = true;
   }
   return h;
 }
@@ -59,29 +63,37 @@ void GameWorld::DestroyEntity(Entity* e) {
   e->_parent = EntityHandle();
   list_del(&e->_sibling_link);
   _entity_dense_map_dirty = true;
+  _transform_order_dirty = true;
 }
 
 void GameWorld::SetEntityParent(EntityHandle e, EntityHandle parent) {
   if (!_entity_alloc.IsValid(e)) return;
   Entity* ent = _entities + e.idx;
-  Entity* old_pent = nullptr;
   Entity* pent = nullptr;
-  if (ent->_parent) old_pent = _entities + ent->_parent.idx;
   if (parent) pent = _entities + parent.idx;
-  if (old_pent) list_del_init(&ent->_sibling_link);
-  if (pent) list_add_tail(&ent->_sibling_link, &pent->_child_list);
+  // An entity can not become a descendant of itself.
+  for (EntityHandle p = parent; p; p = _entities[p.idx]._parent) {
+    if (p.idx == e.idx) {
+      c3_log("SetEntityParent: Entity is an ancestor of its new parent, idx = %d, parent idx = %d\n", e.idx, parent.idx);
+      return;
+    }
+  }
+  // Top level entities are linked into _entity_list.
+  list_del_init(&ent->_sibling_link);
+  list_add_tail(&ent->_sibling_link, pent ? &pent->_child_list : &_entity_list);
+  ent->_parent = parent;
+  _transform_order_dirty = true;
 }
 
 void GameWorld::SerializeEntities(BlobWriter& writer) {
   u32 n = _entity_alloc.GetUsed();
-  u32* parent = (u32*)C3_ALLOC(g_allocator, sizeof(u32) * n);
+  u32* parent = frame_alloc_array<u32>(n);
   auto ehs = _entity_alloc.GetPointer();
   for (u32 i = 0; i < n; ++i) {
     Entity* e = _entities + ehs[i].idx;
     parent[i] = GetEntityDenseIndex(e->_parent);
   }
   writer.Write(parent, sizeof(u32) * n);
-  C3_FREE(g_allocator, parent);
 }
 
 void GameWorld::SerializeTransforms(BlobWriter& writer) {
@@ -193,17 +205,18 @@ int GameWorld::GetAllEntities(Entity* entities, int max_size) {
   return n;
 }
 
+static void walk_sorted_entities(list_head* list, Entity* entities, int max_size, int* n) {
+  Entity* e;
+  list_for_each_entry(e, list, _sibling_link) {
+    if (*n >= max_size) return;
+    entities[(*n)++] = *e;
+    walk_sorted_entities(&e->_child_list, entities, max_size, n);
+  }
+}
+
 int GameWorld::GetSortedEntities(Entity* entities, int max_size) {
   int n = 0;
-  function<void(list_head*)> walk_siblings = [&] (list_head* list) {
-    Entity* e;
-    list_for_each_entry(e, list, _sibling_link) {
-      if (n >= max_size) return;
-      entities[n++] = *e;
-      walk_siblings(&e->_child_list);
-    }
-  };
-  walk_siblings(&_entity_list);
+  walk_sorted_entities(&_entity_list, entities, max_size, &n);
   return n;
 }
 
@@ -220,6 +233,7 @@ void GameWorld::Update(float dt, bool paused) {
 }
 
 void GameWorld::Render(float dt, bool paused) {
+  UpdateTransforms();
   for (auto& sys : _systems) sys->Render(dt, paused);
 }
 
@@ -253,15 +267,19 @@ void GameWorld::DeserializeWorld(BlobReader& reader) {
   c3_assert_return(header._magic == C3_CHUNK_MAGIC_ENT);
   
   EntityResourceDeserializeContext ctx;
-  ctx._assets = (Asset**)C3_ALLOC(g_allocator, sizeof(Asset*) * header._num_asset_refs);
-  auto AM = AssetManager::Instance();
+  ctx._assets = (Asset**)C3_ALLOC(mem_allocator(MEMORY_TAG_ECS), sizeof(Asset*) * header._num_asset_refs);
+  // All loads start before any is waited for, loaders fan out their dependencies too.
+  auto load_start = Clock::Tick();
+  AssetLoadGroup loads;
   reader.Seek(header._asset_refs_data_offset);
   AssetDesc desc;
   for (u32 i = 0; i < header._num_asset_refs; ++i) {
     reader.Read(desc);
-    ctx._assets[i] = AM->Load((AssetType)desc._type, desc._filename);
+    ctx._assets[i] = loads.Add((AssetType)desc._type, desc._filename);
   }
-  ctx._entities = (EntityHandle*)C3_ALLOC(g_allocator, sizeof(Asset*) * header._num_entites);
+  loads.Wait();
+  AssetManager::Instance()->LogLoadTimeline(load_start);
+  ctx._entities = (EntityHandle*)C3_ALLOC(mem_allocator(MEMORY_TAG_ECS), sizeof(Asset*) * header._num_entites);
   for (u32 i = 0; i < header._num_entites; ++i) {
     ctx._entities[i] = CreateEntity();
   }
@@ -273,6 +291,10 @@ void GameWorld::DeserializeWorld(BlobReader& reader) {
   }
   DeserializeComponents(reader, ctx);
   for (auto sys : _systems) sys->DeserializeComponents(reader, ctx);
+  // Components hold their own references, the rest may be evicted.
+  for (u32 i = 0; i < header._num_asset_refs; ++i) {
+    if (ctx._assets[i]) AssetManager::Instance()->Unload(ctx._assets[i]);
+  }
 }
 
 bool GameWorld::OwnComponentType(ComponentType type) const {
@@ -494,8 +516,14 @@ Transform* GameWorld::CreateTransform(EntityHandle e) {
   Transform* transform = _transforms + _num_transforms;
   transform->_entity = e;
   transform->Init();
+  TransformCache* cache = _transform_caches + _num_transforms;
+  cache->_parent = -1;
+  cache->_parent_entity = EntityHandle();
+  cache->_version = 0;
+  cache->_dirty = true;
   _transform_map.insert(EntityMap::value_type(e, _num_transforms));
   ++_num_transforms;
+  _transform_order_dirty = true;
   return transform;
 }
 
@@ -506,10 +534,12 @@ void GameWorld::DestroyTransform(EntityHandle e) {
     --_num_transforms;
     if (index != _num_transforms) {
       memcpy(_transforms + index, _transforms + _num_transforms, sizeof(Transform));
+      memcpy(_transform_caches + index, _transform_caches + _num_transforms, sizeof(TransformCache));
       auto moved_entity = _transforms[index]._entity;
       _transform_map[moved_entity] = index;
     }
     _transform_map.erase(e);
+    _transform_order_dirty = true;
   }
 }
 
@@ -522,3 +552,120 @@ Transform* GameWorld::GetTransforms(int* num_transforms) const {
   *num_transforms = _num_transforms;
   return (Transform*)_transforms;
 }
+
+void GameWorld::SetTransform(EntityHandle e, const vec& position, const Quat& rotation, const vec& scale) {
+  auto it = _transform_map.find(e);
+  if (it == _transform_map.end()) return;
+  Transform* transform = _transforms + it->second;
+  transform->_position = position;
+  transform->_rotation = rotation;
+  transform->_scale = scale;
+  _transform_caches[it->second]._dirty = true;
+}
+
+void GameWorld::SetTransformPosition(EntityHandle e, const vec& position) {
+  auto it = _transform_map.find(e);
+  if (it == _transform_map.end()) return;
+  _transforms[it->second]._position = position;
+  _transform_caches[it->second]._dirty = true;
+}
+
+void GameWorld::SetTransformRotation(EntityHandle e, const Quat& rotation) {
+  auto it = _transform_map.find(e);
+  if (it == _transform_map.end()) return;
+  _transforms[it->second]._rotation = rotation;
+  _transform_caches[it->second]._dirty = true;
+}
+
+void GameWorld::SetTransformScale(EntityHandle e, const vec& scale) {
+  auto it = _transform_map.find(e);
+  if (it == _transform_map.end()) return;
+  _transforms[it->second]._scale = scale;
+  _transform_caches[it->second]._dirty = true;
+}
+
+void GameWorld::MarkTransformDirty(EntityHandle e) {
+  auto it = _transform_map.find(e);
+  if (it != _transform_map.end()) _transform_caches[it->second]._dirty = true;
+}
+
+const float4x4* GameWorld::FindWorldMatrix(EntityHandle e, u32* version) const {
+  auto it = _transform_map.find(e);
+  if (it == _transform_map.end()) return nullptr;
+  const TransformCache* cache = _transform_caches + it->second;
+  if (version) *version = cache->_version;
+  return &cache->_world;
+}
+
+void GameWorld::AddTransformSubtree(Entity* e, int parent, int* n, u8* visited) {
+  auto it = _transform_map.find(e->_handle);
+  if (it != _transform_map.end()) {
+    int index = it->second;
+    TransformCache* cache = _transform_caches + index;
+    EntityHandle parent_entity = (parent >= 0) ? _transforms[parent]._entity : EntityHandle();
+    // Reparented, world matrix changes even if the local one does not.
+    if (cache->_parent_entity.ToRaw() != parent_entity.ToRaw()) cache->_dirty = true;
+    cache->_parent = parent;
+    cache->_parent_entity = parent_entity;
+    visited[index] = 1;
+    _transform_order[(*n)++] = index;
+    parent = index;
+  }
+  Entity* child;
+  list_for_each_entry(child, &e->_child_list, _sibling_link) {
+    AddTransformSubtree(child, parent, n, visited);
+  }
+}
+
+void GameWorld::BuildTransformOrder() {
+  u8* visited = frame_alloc_array<u8>(_num_transforms);
+  memset(visited, 0, _num_transforms);
+  int n = 0;
+  _transform_roots.clear();
+  Entity* e;
+  list_for_each_entry(e, &_entity_list, _sibling_link) {
+    int begin = n;
+    AddTransformSubtree(e, -1, &n, visited);
+    if (n != begin) _transform_roots.push_back(begin);
+  }
+  // Transforms of destroyed entities have no place in the hierarchy.
+  for (u32 i = 0; i < _num_transforms; ++i) {
+    if (visited[i]) continue;
+    TransformCache* cache = _transform_caches + i;
+    if (cache->_parent_entity) cache->_dirty = true;
+    cache->_parent = -1;
+    cache->_parent_entity = EntityHandle();
+    _transform_roots.push_back(n);
+    _transform_order[n++] = i;
+  }
+  _transform_roots.push_back(n);
+  _transform_order_dirty = false;
+}
+
+void GameWorld::UpdateTransforms() {
+  if (_transform_order_dirty) BuildTransformOrder();
+  // 0 means never updated.
+  if (++_transform_version == 0) ++_transform_version;
+  u32 version = _transform_version;
+  atomic_int num_updated(0);
+  int num_roots = (int)_transform_roots.size() - 1;
+  JobScheduler::Instance()->ParallelFor(0, num_roots, 16, [&](int begin, int end) {
+    int updated = 0;
+    for (int k = _transform_roots[begin]; k < _transform_roots[end]; ++k) {
+      int index = _transform_order[k];
+      TransformCache* cache = _transform_caches + index;
+      bool parent_changed = (cache->_parent >= 0 && _transform_caches[cache->_parent]._version == version);
+      if (!cache->_dirty && !parent_changed) continue;
+      if (cache->_dirty) {
+        const Transform* transform = _transforms + index;
+        cache->_local = float4x4::FromTRS(transform->_position, transform->_rotation, transform->_scale);
+        cache->_dirty = false;
+      }
+      cache->_world = (cache->_parent >= 0) ? _transform_caches[cache->_parent]._world * cache->_local : cache->_local;
+      cache->_version = version;
+      ++updated;
+    }
+    num_updated += updated;
+  });
+  _num_updated_transforms = num_updated;
+}
@@ -30,6 +30,16 @@ struct Transform {
   }
 };
 
+// Matrices of a Transform, same index as GameWorld::_transforms and not serialized.
+struct TransformCache {
+  float4x4 _local;
+  float4x4 _world;
+  int _parent;                // transform index of the nearest ancestor with a transform, -1 for none.
+  EntityHandle _parent_entity;
+  u32 _version;               // UpdateTransforms pass which last changed _world, 0 for never.
+  bool _dirty;                // _local is out of date.
+};
+
 class ISystem;
 class GameWorld : public ISystem {
 public:
@@ -65,6 +75,18 @@ public:
   void DestroyTransform(EntityHandle e);
   Transform* FindTransform(EntityHandle e) const;
   Transform* GetTransforms(int* num_transforms) const;
+  void SetTransform(EntityHandle e, const vec& position, const Quat& rotation, const vec& scale);
+  void SetTransformPosition(EntityHandle e, const vec& position);
+  void SetTransformRotation(EntityHandle e, const Quat& rotation);
+  void SetTransformScale(EntityHandle e, const vec& scale);
+  // Call after writing Transform fields directly.
+  void MarkTransformDirty(EntityHandle e);
+  // Recompute local matrices of dirty transforms and world matrices below them,
+  // parents before children, root subtrees in parallel. Called by Render.
+  void UpdateTransforms();
+  // Cached by the last UpdateTransforms, version changes whenever the matrix does.
+  const float4x4* FindWorldMatrix(EntityHandle e, u32* version = nullptr) const;
+  int GetNumUpdatedTransforms() const { return _num_updated_transforms; }
   
   // Camera control
   Camera* CreateCamera(EntityHandle e);
@@ -108,6 +130,8 @@ private:
   void DeserializeTransforms(BlobReader& reader, EntityResourceDeserializeContext& ctx);
   void DeserializeCameras(BlobReader& reader, EntityResourceDeserializeContext& ctx);
   void DeserializeNameAnnotations(BlobReader& reader, EntityResourceDeserializeContext& ctx);
+  void BuildTransformOrder();
+  void AddTransformSubtree(Entity* e, int parent, int* n, u8* visited);
 
   Entity _entities[C3_MAX_ENTITIES];
   list_head _entity_list;
@@ -120,8 +144,15 @@ private:
   EntityMap _name_annotation_map;
 
   Transform _transforms[C3_MAX_TRANSFORMS];
+  TransformCache _transform_caches[C3_MAX_TRANSFORMS];
   u32 _num_transforms;
   EntityMap _transform_map;
+  // Transform indices in depth first order, a root subtree is [_transform_roots[i], _transform_roots[i + 1]).
+  int _transform_order[C3_MAX_TRANSFORMS];
+  vector<int> _transform_roots;
+  bool _transform_order_dirty;
+  u32 _transform_version;
+  int _num_updated_transforms;
 
   Camera _cameras[C3_MAX_CAMERAS];
   u32 _num_cameras;
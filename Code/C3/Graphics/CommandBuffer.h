@@ -42,7 +42,7 @@ struct CommandBuffer {
 
   void Write(const void* data, u32 size_) {
     c3_assert(size == C3_MAX_COMMAND_BUFFER_SIZE && "Called write outside start/finish?");
-    c3_assert(pos < size);
+    c3_assert(pos + size_ < size && "Command buffer overflow.");
     memcpy(buffer + pos, data, size_);
     pos += size_;
   }
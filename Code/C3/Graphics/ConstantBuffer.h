@@ -18,23 +18,20 @@
 class ConstantBuffer {
 public:
   static ConstantBuffer* Create(u32 size_ = 1 << 20) {
-    u32 size = ALIGN_16(max<u32>(size_, sizeof(ConstantBuffer)));
-    void* data = C3_ALLOC(g_allocator, size);
-    return ::new(data)ConstantBuffer(size_);
+    u32 size = ALIGN_16(sizeof(ConstantBuffer) + size_);
+    void* data = C3_ALLOC(mem_allocator(MEMORY_TAG_GRAPHICS), size);
+    return ::new(data)ConstantBuffer((char*)data + sizeof(ConstantBuffer), size_);
   }
 
-  static void Destroy(ConstantBuffer* constant_buffer) {
-    constant_buffer->~ConstantBuffer();
-    C3_FREE(g_allocator, constant_buffer);
+  // Reads and writes memory owned by somebody else, e.g. a FrameRingSegment.
+  static ConstantBuffer* CreateView(void* buffer, u32 size) {
+    void* data = C3_ALLOC(mem_allocator(MEMORY_TAG_GRAPHICS), sizeof(ConstantBuffer));
+    return ::new(data)ConstantBuffer((char*)buffer, size);
   }
 
-  static void Update(ConstantBuffer*& constant_buffer, u32 threshold = 64 << 10, u32 grow = 1 << 20) {
-    if (threshold >= constant_buffer->_size - constant_buffer->_pos) {
-      u32 size = ALIGN_16(max<u32>(constant_buffer->_size + grow, sizeof(ConstantBuffer)));
-      void* data = C3_REALLOC(g_allocator, constant_buffer, size);
-      constant_buffer = (ConstantBuffer*)data;
-      constant_buffer->_size = size;
-    }
+  static void Destroy(ConstantBuffer* constant_buffer) {
+    constant_buffer->~ConstantBuffer();
+    C3_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), constant_buffer);
   }
 
   static u32 EncodeOpcode(ConstantType type_, u16 loc_, u16 num_, u16 copy_) {
@@ -80,6 +77,7 @@ public:
 
   bool IsEmpty() const { return _pos == 0; }
   u32 GetPos() const { return _pos; }
+  const char* GetData(u32 pos) const { return &_buffer[pos]; }
   void Reset(u32 pos = 0) { _pos = pos; }
   void Finish() {
     Write(CONSTANT_END);
@@ -91,11 +89,11 @@ public:
   void WriteMarker(const char* marker);
 
 private:
-  ConstantBuffer(u32 size): _size(size - sizeof(_buffer)), _pos(0) { Finish(); }
+  ConstantBuffer(char* buffer, u32 size): _buffer(buffer), _size(size), _pos(0) { Finish(); }
   ~ConstantBuffer() {}
+  char* _buffer;
   u32 _size;
   u32 _pos;
-  char _buffer[8];
 };
 
 struct ConstantInfo {
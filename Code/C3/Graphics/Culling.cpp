@@ -0,0 +1,117 @@
+#include "C3PCH.h"
+#include "Culling.h"
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define C3_CULL_SSE 1
+#else
+#define C3_CULL_SSE 0
+#endif
+
+void CullBounds::Init(u32 capacity) {
+  Destroy();
+  _capacity = (capacity + C3_CULL_SIMD_WIDTH - 1) & ~(u32)(C3_CULL_SIMD_WIDTH - 1);
+  u32 size = sizeof(float) * _capacity * 6;
+  _data = (float*)C3_ALIGNED_ALLOC(mem_allocator(MEMORY_TAG_GRAPHICS), size, 32);
+  memset(_data, 0, size);
+  _cx = _data;
+  _cy = _cx + _capacity;
+  _cz = _cy + _capacity;
+  _ex = _cz + _capacity;
+  _ey = _ex + _capacity;
+  _ez = _ey + _capacity;
+}
+
+void CullBounds::Destroy() {
+  if (!_data) return;
+  C3_ALIGNED_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), _data, 32);
+  _data = nullptr;
+  _capacity = 0;
+}
+
+void CullPlanes::Set(const PBVolume<6>& volume) {
+  for (int i = 0; i < 6; ++i) {
+    const Plane& plane = volume.p[i];
+    _nx[i] = plane.normal.x;
+    _ny[i] = plane.normal.y;
+    _nz[i] = plane.normal.z;
+    _d[i] = plane.d;
+    _ax[i] = Abs(plane.normal.x);
+    _ay[i] = Abs(plane.normal.y);
+    _az[i] = Abs(plane.normal.z);
+  }
+}
+
+// Lanes of mask at or past end are padding.
+static inline u32 write_visible(u32 mask, u32 index, u32 end, u8 bit, u8* visible) {
+  u32 num_visible = 0;
+  for (u32 k = 0; k < C3_CULL_SIMD_WIDTH && index + k < end; ++k) {
+    if (!(mask & (1 << k))) continue;
+    visible[index + k] |= bit;
+    ++num_visible;
+  }
+  return num_visible;
+}
+
+u32 cull_boxes(const CullBounds& bounds, u32 begin, u32 end, const CullPlanes& planes, u8 bit, u8* visible) {
+  c3_assert((begin & (C3_CULL_SIMD_WIDTH - 1)) == 0);
+  c3_assert(end <= bounds._capacity);
+  u32 num_visible = 0;
+#if defined(__AVX__)
+  for (u32 i = begin; i < end; i += 8) {
+    __m256 cx = _mm256_load_ps(bounds._cx + i);
+    __m256 cy = _mm256_load_ps(bounds._cy + i);
+    __m256 cz = _mm256_load_ps(bounds._cz + i);
+    __m256 ex = _mm256_load_ps(bounds._ex + i);
+    __m256 ey = _mm256_load_ps(bounds._ey + i);
+    __m256 ez = _mm256_load_ps(bounds._ez + i);
+    __m256 outside = _mm256_setzero_ps();
+    for (int p = 0; p < 6; ++p) {
+      __m256 dist = _mm256_mul_ps(_mm256_broadcast_ss(planes._nx + p), cx);
+      dist = _mm256_add_ps(dist, _mm256_mul_ps(_mm256_broadcast_ss(planes._ny + p), cy));
+      dist = _mm256_add_ps(dist, _mm256_mul_ps(_mm256_broadcast_ss(planes._nz + p), cz));
+      dist = _mm256_sub_ps(dist, _mm256_broadcast_ss(planes._d + p));
+      __m256 radius = _mm256_mul_ps(_mm256_broadcast_ss(planes._ax + p), ex);
+      radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_broadcast_ss(planes._ay + p), ey));
+      radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_broadcast_ss(planes._az + p), ez));
+      outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, radius, _CMP_GE_OQ));
+    }
+    u32 mask = ~(u32)_mm256_movemask_ps(outside) & 0xff;
+    num_visible += write_visible(mask, i, end, bit, visible);
+  }
+#elif C3_CULL_SSE
+  for (u32 i = begin; i < end; i += 4) {
+    __m128 cx = _mm_load_ps(bounds._cx + i);
+    __m128 cy = _mm_load_ps(bounds._cy + i);
+    __m128 cz = _mm_load_ps(bounds._cz + i);
+    __m128 ex = _mm_load_ps(bounds._ex + i);
+    __m128 ey = _mm_load_ps(bounds._ey + i);
+    __m128 ez = _mm_load_ps(bounds._ez + i);
+    __m128 outside = _mm_setzero_ps();
+    for (int p = 0; p < 6; ++p) {
+      __m128 dist = _mm_mul_ps(_mm_set1_ps(planes._nx[p]), cx);
+      dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(planes._ny[p]), cy));
+      dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(planes._nz[p]), cz));
+      dist = _mm_sub_ps(dist, _mm_set1_ps(planes._d[p]));
+      __m128 radius = _mm_mul_ps(_mm_set1_ps(planes._ax[p]), ex);
+      radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(planes._ay[p]), ey));
+      radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(planes._az[p]), ez));
+      outside = _mm_or_ps(outside, _mm_cmpge_ps(dist, radius));
+    }
+    u32 mask = ~(u32)_mm_movemask_ps(outside) & 0xf;
+    num_visible += write_visible(mask, i, end, bit, visible);
+  }
+#else
+  for (u32 i = begin; i < end; ++i) {
+    bool outside = false;
+    for (int p = 0; p < 6 && !outside; ++p) {
+      float dist = planes._nx[p] * bounds._cx[i] + planes._ny[p] * bounds._cy[i] + planes._nz[p] * bounds._cz[i] - planes._d[p];
+      float radius = planes._ax[p] * bounds._ex[i] + planes._ay[p] * bounds._ey[i] + planes._az[p] * bounds._ez[i];
+      outside = (dist >= radius);
+    }
+    if (outside) continue;
+    visible[i] |= bit;
+    ++num_visible;
+  }
+#endif
+  return num_visible;
+}
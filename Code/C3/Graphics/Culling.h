@@ -0,0 +1,56 @@
+#pragma once
+#include "Data/DataType.h"
+#include "Memory/C3Memory.h"
+
+// Boxes are tested C3_CULL_SIMD_WIDTH at a time, capacity and ranges are padded to it.
+#if defined(__AVX__)
+#define C3_CULL_SIMD_WIDTH 8
+#else
+#define C3_CULL_SIMD_WIDTH 4
+#endif
+
+// World space AABBs as SoA center/extent arrays.
+struct CullBounds {
+  CullBounds(): _data(nullptr), _capacity(0) {}
+  ~CullBounds() { Destroy(); }
+  void Init(u32 capacity);
+  void Destroy();
+  void Set(u32 index, const AABB& aabb) {
+    vec c = aabb.CenterPoint();
+    vec e = aabb.HalfSize();
+    _cx[index] = c.x;
+    _cy[index] = c.y;
+    _cz[index] = c.z;
+    _ex[index] = e.x;
+    _ey[index] = e.y;
+    _ez[index] = e.z;
+  }
+  AABB Get(u32 index) const {
+    vec c(_cx[index], _cy[index], _cz[index]);
+    vec e(_ex[index], _ey[index], _ez[index]);
+    return AABB(c - e, c + e);
+  }
+
+  float* _data;
+  float* _cx;
+  float* _cy;
+  float* _cz;
+  float* _ex;
+  float* _ey;
+  float* _ez;
+  u32 _capacity;
+};
+
+// Planes of a PBVolume as SoA, normals point outward. _ax.. are the absolute normals.
+struct CullPlanes {
+  void Set(const PBVolume<6>& volume);
+
+  float _nx[6], _ny[6], _nz[6], _d[6];
+  float _ax[6], _ay[6], _az[6];
+};
+
+// Ors bit into visible[i] for boxes in [begin, end) which are not fully outside
+// one of the planes, same test as PBVolume::InsideOrIntersects. begin must be
+// a multiple of C3_CULL_SIMD_WIDTH, boxes up to the next multiple past end are read
+// but not reported. Returns the number of visible boxes.
+u32 cull_boxes(const CullBounds& bounds, u32 begin, u32 end, const CullPlanes& planes, u8 bit, u8* visible);
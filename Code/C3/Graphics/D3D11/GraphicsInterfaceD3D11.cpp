@@ -330,6 +330,16 @@ void BufferD3D11::Update(u32 offset, u32 size, void* data, bool discard) {
   ID3D11DeviceContext* context = g_interface->_context;
   c3_assert(_dynamic && "Must be dynamic!");
 
+  if (discard) {
+    // Contents before offset are lost, the driver renames the buffer instead
+    // of waiting for draws still reading it. No staging buffer per update.
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    DX_CHECK(context->Map(_ptr, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+    memcpy((u8*)mapped.pData + offset, data, size);
+    context->Unmap(_ptr, 0);
+    return;
+  }
+
 #if 1
   D3D11_BUFFER_DESC desc;
   desc.ByteWidth = size;
@@ -523,7 +533,7 @@ void TextureD3D11::Create(const MemoryRegion* mem, u32 flags, u8 skip) {
 
           if (convert) {
             u32 srcpitch = mip.width*bpp / 8;
-            u8* temp = (u8*)C3_ALLOC(g_allocator, mip.width * mip.height * bpp / 8);
+            u8* temp = (u8*)C3_ALLOC(mem_allocator(MEMORY_TAG_GRAPHICS), mip.width * mip.height * bpp / 8);
             image_get_bgra8_data(temp, mip.data, mip.width, mip.height, srcpitch, mip.format);
 
             srd[kk].pSysMem = temp;
@@ -657,7 +667,7 @@ void TextureD3D11::Create(const MemoryRegion* mem, u32 flags, u8 skip) {
       kk = 0;
       for (u8 side = 0, numSides = image_container.cube_map ? 6 : 1; side < numSides; ++side) {
         for (u32 lod = 0, num = num_mips; lod < num; ++lod) {
-          C3_FREE(g_allocator, const_cast<void*>(srd[kk].pSysMem));
+          C3_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), const_cast<void*>(srd[kk].pSysMem));
           ++kk;
         }
       }
@@ -695,7 +705,7 @@ void TextureD3D11::Update(u8 side, u8 mip, const TextureRect& rect, u16 z, u16 d
   u8* temp = NULL;
 
   if (convert) {
-    temp = (u8*)C3_ALLOC(g_allocator, rectpitch*rect.height);
+    temp = (u8*)C3_ALLOC(mem_allocator(MEMORY_TAG_GRAPHICS), rectpitch*rect.height);
     image_get_bgra8_data(temp, data, rect.width, rect.height, srcpitch, _requested_format);
     data = temp;
   } else if (is_compressed((TextureFormat)_texture_format)) {
@@ -708,7 +718,7 @@ void TextureD3D11::Update(u8 side, u8 mip, const TextureRect& rect, u16 z, u16 d
 
   context->UpdateSubresource(_ptr, subres, &box, data, srcpitch, 0);
 
-  if (temp) C3_FREE(g_allocator, temp);
+  if (temp) C3_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), temp);
 }
 
 void TextureD3D11::Commit(u8 stage, u32 flags_, const float palette[][4]) {
@@ -1015,8 +1025,8 @@ GraphicsInterfaceD3D11::GraphicsInterfaceD3D11(GraphicsAPI api, int major_versio
   _wireframe = false;
   _rt_msaa = false;
   
-  _vs_scratch = (u8*)c3_alloc(g_allocator, C3_MAX_CONSTANT_BUFER_SIZE, 16);
-  _fs_scratch = (u8*)c3_alloc(g_allocator, C3_MAX_CONSTANT_BUFER_SIZE, 16);
+  _vs_scratch = (u8*)c3_alloc(mem_allocator(MEMORY_TAG_GRAPHICS), C3_MAX_CONSTANT_BUFER_SIZE, 16);
+  _fs_scratch = (u8*)c3_alloc(mem_allocator(MEMORY_TAG_GRAPHICS), C3_MAX_CONSTANT_BUFER_SIZE, 16);
   _vs_changes = 0;
   _fs_changes = 0;
   memset(_uniforms, 0, sizeof(_uniforms));
@@ -1028,8 +1038,8 @@ GraphicsInterfaceD3D11::GraphicsInterfaceD3D11(GraphicsAPI api, int major_versio
 
 GraphicsInterfaceD3D11::~GraphicsInterfaceD3D11() {
   g_interface = nullptr;
-  c3_free(g_allocator, _vs_scratch, 16);
-  c3_free(g_allocator, _fs_scratch, 16);
+  c3_free(mem_allocator(MEMORY_TAG_GRAPHICS), _vs_scratch, 16);
+  c3_free(mem_allocator(MEMORY_TAG_GRAPHICS), _fs_scratch, 16);
 }
 
 void GraphicsInterfaceD3D11::Init() {
@@ -1255,22 +1265,24 @@ void GraphicsInterfaceD3D11::DestroyFrameBuffer(FrameBufferHandle handle) {
 }
 
 void GraphicsInterfaceD3D11::CreateConstant(ConstantHandle handle, ConstantType type, u16 num, stringid name) {
-  if (_uniforms[handle.idx]) C3_FREE(g_allocator, _uniforms[handle.idx]);
+  if (_uniforms[handle.idx]) C3_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), _uniforms[handle.idx]);
 
   u32 size = ALIGN_16(CONSTANT_TYPE_SIZE[type] * num);
-  void* data = C3_ALLOC(g_allocator, size);
+  void* data = C3_ALLOC(mem_allocator(MEMORY_TAG_GRAPHICS), size);
   memset(data, 0, size);
   _uniforms[handle.idx] = data;
   _uniform_reg.Add(handle, name, data);
 }
 
 void GraphicsInterfaceD3D11::DestroyConstant(ConstantHandle handle) {
-  C3_FREE(g_allocator, _uniforms[handle.idx]);
+  C3_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), _uniforms[handle.idx]);
   _uniforms[handle.idx] = NULL;
 }
 
-void GraphicsInterfaceD3D11::UpdateConstant(u16 loc, const void* data, u32 size) {
+bool GraphicsInterfaceD3D11::UpdateConstant(u16 loc, const void* data, u32 size) {
+  if (memcmp(_uniforms[loc], data, size) == 0) return false;
   memcpy(_uniforms[loc], data, size);
+  return true;
 }
 
 void GraphicsInterfaceD3D11::SetMarker(const char* marker, u32 size) {
@@ -1290,18 +1302,25 @@ void GraphicsInterfaceD3D11::Submit(RenderFrame* render, ClearQuad& clear_quad)
 
   UpdateResolution(render->resolution);
 
-  if (render->ib_offset > 0) {
+  // Sort batches draws into instanced ones, instance data goes to the transient vb.
+  render->Sort();
+  memset(&_frame_stats, 0, sizeof(_frame_stats));
+  _frame_stats.num_items = render->render_item_count;
+  _frame_stats.num_batched_items = render->num_batched_items;
+
+  // Transient data is rewritten from the start every frame, one discarding map each.
+  u32 ib_used = render->index_segment->GetUsed();
+  if (ib_used > 0) {
     TransientIndexBuffer* ib = render->transient_ib;
-    _index_buffers[ib->handle.idx].Update(0, render->ib_offset, ib->data);
+    _index_buffers[ib->handle.idx].Update(0, ib_used, ib->data, true);
   }
 
-  if (render->vb_offset > 0) {
+  u32 vb_used = render->vertex_segment->GetUsed();
+  if (vb_used > 0) {
     TransientVertexBuffer* vb = render->transient_vb;
-    _vertex_buffers[vb->handle.idx].Update(0, render->vb_offset, vb->data);
+    _vertex_buffers[vb->handle.idx].Update(0, vb_used, vb->data, true);
   }
 
-  render->Sort();
-
   RenderItem currentState;
   currentState.Clear();
   currentState.flags = C3_STATE_NONE;
@@ -1354,6 +1373,7 @@ void GraphicsInterfaceD3D11::Submit(RenderFrame* render, ClearQuad& clear_quad)
 #endif
       view = key.view;
       programIdx = UINT16_MAX;
+      ++_frame_stats.num_views;
 
       if (render->fb[view].idx != fbh.idx) {
         fbh = render->fb[view];
@@ -1467,12 +1487,11 @@ void GraphicsInterfaceD3D11::Submit(RenderFrame* render, ClearQuad& clear_quad)
     }
 
     bool programChanged = false;
-    bool constantsChanged = draw.constant_begin < draw.constant_end;
-
-    UpdateConstants(render->constant_buffer, draw.constant_begin, draw.constant_end);
+    bool constantsChanged = UpdateConstants(render->GetConstantBuffer(), draw.constant_begin, draw.constant_end) > 0;
 
     if (key.program != programIdx) {
       programIdx = key.program;
+      ++_frame_stats.num_program_changes;
 
       if (UINT16_MAX == programIdx) {
         _current_program = NULL;
@@ -1516,35 +1535,39 @@ void GraphicsInterfaceD3D11::Submit(RenderFrame* render, ClearQuad& clear_quad)
 
       if (constantsChanged || program._num_predefined > 0) CommitShaderConstants();
 
-      u32 changes = 0;
-      for (u8 stage = 0; stage < MAX_RENDER_ITEM_BINDING_COUNT; ++stage) {
-        const Binding& bind = draw.bind[stage];
-        Binding& current = currentState.bind[stage];
-        if (current.idx != bind.idx || current.flags != bind.flags || programChanged) {
-          if (UINT16_MAX != bind.idx) {
-            TextureD3D11& texture = _textures[bind.idx];
-            texture.Commit(stage, bind.flags, render->color_palette);
-          } else {
-            _texture_stage._srv[stage] = NULL;
-            _texture_stage._sampler[stage] = NULL;
+      // Texture stages outlive program changes, draws of one material share the whole set.
+      if (memcmp(currentState.bind, draw.bind, sizeof(draw.bind)) != 0) {
+        u32 changes = 0;
+        for (u8 stage = 0; stage < MAX_RENDER_ITEM_BINDING_COUNT; ++stage) {
+          const Binding& bind = draw.bind[stage];
+          Binding& current = currentState.bind[stage];
+          if (current.idx != bind.idx || current.flags != bind.flags) {
+            if (UINT16_MAX != bind.idx) {
+              TextureD3D11& texture = _textures[bind.idx];
+              texture.Commit(stage, bind.flags, render->color_palette);
+            } else {
+              _texture_stage._srv[stage] = NULL;
+              _texture_stage._sampler[stage] = NULL;
+            }
+
+            ++changes;
           }
 
-          ++changes;
+          current = bind;
         }
 
-        current = bind;
+        if (changes > 0) CommitTextureStage();
+        _frame_stats.num_texture_binds += changes;
       }
 
-      if (changes > 0) CommitTextureStage();
-
       if (programChanged || currentState.vertex_decl.idx != draw.vertex_decl.idx ||
           currentState.vertex_buffer.idx != draw.vertex_buffer.idx ||
-          //currentState.instance_data_buffer.idx != draw.instance_data_buffer.idx ||
+          currentState.instance_data_buffer.idx != draw.instance_data_buffer.idx ||
           currentState.instance_data_offset != draw.instance_data_offset ||
           currentState.instance_data_stride != draw.instance_data_stride) {
         currentState.vertex_decl = draw.vertex_decl;
         currentState.vertex_buffer = draw.vertex_buffer;
-        //currentState.instance_data_buffer.idx = draw.instance_data_buffer.idx;
+        currentState.instance_data_buffer = draw.instance_data_buffer;
         currentState.instance_data_offset = draw.instance_data_offset;
         currentState.instance_data_stride = draw.instance_data_stride;
 
@@ -1558,19 +1581,15 @@ void GraphicsInterfaceD3D11::Submit(RenderFrame* render, ClearQuad& clear_quad)
           u32 offset = 0;
           context->IASetVertexBuffers(0, 1, &vb._ptr, &stride, &offset);
 
-#if 0
           if (draw.instance_data_buffer) {
             const VertexBufferD3D11& inst = _vertex_buffers[draw.instance_data_buffer.idx];
             u32 instance_stride = draw.instance_data_stride;
             context->IASetVertexBuffers(1, 1, &inst._ptr, &instance_stride, &draw.instance_data_offset);
             SetInputLayout(vertexDecl, program, draw.instance_data_stride / 16);
           } else {
-#endif
             context->IASetVertexBuffers(1, 1, s_zero.m_buffer, s_zero.m_zero, s_zero.m_zero);
             SetInputLayout(vertexDecl, program, 0);
-#if 0
           }
-#endif
         } else {
           context->IASetVertexBuffers(0, 1, s_zero.m_buffer, s_zero.m_zero, s_zero.m_zero);
         }
@@ -1591,6 +1610,8 @@ void GraphicsInterfaceD3D11::Submit(RenderFrame* render, ClearQuad& clear_quad)
       }
 
       if (currentState.vertex_buffer) {
+        ++_frame_stats.num_draws;
+        _frame_stats.num_instances += draw.num_instances;
         u32 numVertices = draw.num_vertices;
         if (UINT32_MAX == numVertices) {
           const VertexBufferD3D11& vb = _vertex_buffers[currentState.vertex_buffer.idx];
@@ -1640,7 +1661,11 @@ void GraphicsInterfaceD3D11::Flip() {
   if (SUCCEEDED(hr)) {
     hr = _swap_chain->Present(syncInterval, DXGI_PRESENT_DO_NOT_WAIT);
     while (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+#if C3_RENDER_THREAD
+      std::this_thread::yield();
+#else
       JobScheduler::Instance()->Yield();
+#endif
       hr = _swap_chain->Present(syncInterval, DXGI_PRESENT_DO_NOT_WAIT);
     }
   }
@@ -1702,6 +1727,7 @@ void GraphicsInterfaceD3D11::CommitShaderConstants() {
       _context->Map(_current_program->_vsh->_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_res);
       memcpy(mapped_res.pData, _vs_scratch, _current_program->_vsh->_byte_width);
       _context->Unmap(_current_program->_vsh->_buffer, 0);
+      _frame_stats.constant_bytes += _current_program->_vsh->_byte_width;
     }
     _vs_changes = 0;
   }
@@ -1711,6 +1737,7 @@ void GraphicsInterfaceD3D11::CommitShaderConstants() {
       _context->Map(_current_program->_fsh->_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_res);
       memcpy(mapped_res.pData, _fs_scratch, _current_program->_fsh->_byte_width);
       _context->Unmap(_current_program->_fsh->_buffer, 0);
+      _frame_stats.constant_bytes += _current_program->_fsh->_byte_width;
     }
     _fs_changes = 0;
   }
@@ -345,7 +345,7 @@ public:
   void DestroyFrameBuffer(FrameBufferHandle handle) override;
   void CreateConstant(ConstantHandle handle, ConstantType type, u16 num, stringid name) override;
   void DestroyConstant(ConstantHandle handle) override;
-  void UpdateConstant(u16 loc, const void* data, u32 size) override;
+  bool UpdateConstant(u16 loc, const void* data, u32 size) override;
   void SetMarker(const char* marker, u32 size) override;
   void Submit(RenderFrame* render, ClearQuad& clear_quad) override;
   void Flip() override;
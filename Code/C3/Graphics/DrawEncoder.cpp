@@ -0,0 +1,237 @@
+#include "C3PCH.h"
+#include "DrawEncoder.h"
+#include "RenderFrame.h"
+#include "ConstantBuffer.h"
+#include "GraphicsRenderer.h"
+
+DrawEncoder::DrawEncoder()
+: _frame(nullptr), _constant_begin(0), _constant_pos(0), _constant_end(0), _item_pos(0), _item_end(0),
+  _matrix_pos(0), _matrix_end(0), _index(0), _discard(false) {
+  _current.Clear();
+  _sort_key.Reset();
+}
+
+DrawEncoder::~DrawEncoder() {
+  Destroy();
+}
+
+void DrawEncoder::Init(RenderFrame* frame, u8 index) {
+  _frame = frame;
+  _index = index;
+}
+
+void DrawEncoder::Destroy() {}
+
+void DrawEncoder::Start() {
+  _constant_begin = _constant_pos = _constant_end = 0;
+  _current.Clear();
+  _item_pos = _item_end = 0;
+  _matrix_pos = _matrix_end = 0;
+  _discard = false;
+}
+
+void DrawEncoder::Finish() {
+  // Give back the unused part of the item chunk, RenderFrame::Finish skips it.
+  for (u32 i = _item_pos; i < _item_end; ++i) _frame->sort_keys[i] = RENDER_ITEM_HOLE;
+  _item_pos = _item_end = 0;
+  _matrix_pos = _matrix_end = 0;
+  _constant_begin = _constant_pos = _constant_end = 0;
+}
+
+u16 DrawEncoder::ReserveMatrices(u16* num) {
+  if (_matrix_pos + *num > _matrix_end) {
+    // Keep the rest of the chunk for later matrices, a new one would leave it
+    // a hole the slack doesn't account for. Only the last chunk is partial.
+    if (_matrix_pos < _matrix_end || *num >= C3_DRAW_ENCODER_CHUNK) return _frame->matrix_cache.Reserve(num);
+    u16 chunk = C3_DRAW_ENCODER_CHUNK;
+    _matrix_pos = _frame->matrix_cache.Reserve(&chunk);
+    _matrix_end = _matrix_pos + chunk;
+    *num = min(*num, chunk);
+  }
+  u16 first = _matrix_pos;
+  _matrix_pos += *num;
+  return first;
+}
+
+u8* DrawEncoder::ReserveConstants(u32 size) {
+  FrameRingSegment* segment = _frame->constant_segment;
+  if (_constant_pos + size > _constant_end) {
+    // Constants of a draw stay contiguous, the ones already written move to the new chunk.
+    u32 pending = _constant_pos - _constant_begin;
+    u32 chunk = max<u32>(C3_DRAW_ENCODER_CONSTANT_CHUNK, pending + size);
+    u32 pos = segment->Alloc(chunk, sizeof(u32));
+    if (pos == UINT32_MAX) {
+      c3_assert(!"Constant segment overflow.");
+      return nullptr;
+    }
+    if (pending > 0) memcpy(segment->data + pos, segment->data + _constant_begin, pending);
+    _constant_begin = pos;
+    _constant_pos = pos + pending;
+    _constant_end = pos + chunk;
+  }
+  u8* data = segment->data + _constant_pos;
+  _constant_pos += size;
+  return data;
+}
+
+void DrawEncoder::SetMarker(const char* marker) {
+  u16 num = (u16)strlen(marker) + 1;
+  u8* data = ReserveConstants(sizeof(u32) + num);
+  if (!data) return;
+  u32 opcode = ConstantBuffer::EncodeOpcode(CONSTANT_COUNT, 0, num, true);
+  memcpy(data, &opcode, sizeof(u32));
+  memcpy(data + sizeof(u32), marker, num);
+}
+
+void DrawEncoder::SetState(u64 state, u32 rgba) {
+  // transparency sort order table
+  u8 blend = ((state & C3_STATE_BLEND_MASK) >> C3_STATE_BLEND_SHIFT) & 0xff;
+  //_sort_key.trans = "\x0\x1\x1\x2\x2\x1\x2\x1\x2\x1\x1\x1\x1\x1\x1\x1\x1\x1\x1"[(blend & 0xf) + (!!blend)];
+  _sort_key.trans = (!!blend);
+  _current.flags = state;
+  _current.rgba = rgba;
+}
+
+u16 DrawEncoder::SetTransform(const float4x4* mtx, u16 num) {
+  if (!mtx) {
+    _current.matrix = 0;
+  } else {
+    _current.matrix = ReserveMatrices(&num);
+    memcpy(&_frame->matrix_cache._cache[_current.matrix], mtx, sizeof(float4x4) * num);
+  }
+  _current.num = num;
+  return _current.matrix;
+}
+
+void DrawEncoder::SetTransform(u16 cache, u16 num) {
+  _current.matrix = cache;
+  _current.num = num;
+}
+
+u16 DrawEncoder::AllocTransform(float4x4*& mtx_out, u16& num_in_out) {
+  u16 first = ReserveMatrices(&num_in_out);
+  mtx_out = (float4x4*)_frame->matrix_cache.GetBuffer(first);
+  return first;
+}
+
+void DrawEncoder::SetVertexBuffer(const TransientVertexBuffer* tvb, u32 start_vertex, u32 num_vertices) {
+  _current.start_vertex = tvb->start_vertex + start_vertex;
+  _current.num_vertices = min(tvb->size / tvb->stride, num_vertices);
+  _current.vertex_buffer = tvb->handle;
+  _current.vertex_decl = tvb->decl;
+}
+
+void DrawEncoder::SetVertexBuffer(VertexBufferHandle handle, u32 start, u32 num) {
+  _current.start_vertex = start;
+  _current.num_vertices = num;
+  _current.vertex_buffer = handle;
+}
+
+void DrawEncoder::SetIndexBuffer(const TransientIndexBuffer* tib, u32 first_index, u32 num_indices) {
+  _current.start_index = tib->start_index + first_index;
+  _current.num_indices = min(tib->size / 2, num_indices);
+  _current.index_buffer = tib->handle;
+  _discard = num_indices == 9;
+}
+
+void DrawEncoder::SetIndexBuffer(IndexBufferHandle handle, u32 start, u32 num) {
+  _current.start_index = start;
+  _current.num_indices = num;
+  _current.index_buffer = handle;
+}
+
+void DrawEncoder::SetInstanceDataBuffer(const InstanceDataBuffer* idb, u32 num) {
+  _current.instance_data_buffer = idb->handle;
+  _current.instance_data_offset = idb->offset;
+  _current.instance_data_stride = idb->stride;
+  _current.num_instances = (u16)min(idb->num, num);
+}
+
+void DrawEncoder::SetInstanceDataBuffer(VertexBufferHandle handle, u32 start_vertex, u32 num, u16 stride) {
+  _current.instance_data_buffer = handle;
+  _current.instance_data_offset = start_vertex * stride;
+  _current.instance_data_stride = stride;
+  _current.num_instances = (u16)num;
+}
+
+void DrawEncoder::SetScissor(i16 x, i16 y, i16 width, i16 height) {
+  _current.scissor = (u16)_frame->rect_cache.Add(x, y, width, height);
+}
+
+void DrawEncoder::SetConstant(ConstantHandle handle, const void* value, u16 num) {
+  if (!handle) return;
+  const ConstantRef& constant = GraphicsRenderer::Instance()->_constant_ref[handle.idx];
+  num = min(num, constant.num);
+  u32 size = CONSTANT_TYPE_SIZE[constant.type] * num;
+  u8* data = ReserveConstants(sizeof(u32) + size);
+  if (!data) return;
+  u32 opcode = ConstantBuffer::EncodeOpcode(constant.type, (u16)handle.idx, num, true);
+  memcpy(data, &opcode, sizeof(u32));
+  memcpy(data + sizeof(u32), value, size);
+}
+
+void DrawEncoder::SetTexture(u8 unit, TextureHandle handle, u32 flags) {
+  _current.bind[unit].idx = (u16)handle.idx;
+  _current.bind[unit].type = Binding::Texture;
+  _current.bind[unit].flags = (flags & C3_SAMPLER_DEFAULT_FLAGS) ? C3_SAMPLER_DEFAULT_FLAGS : flags;
+}
+
+void DrawEncoder::SetTexture(u8 unit, FrameBufferHandle handle, int idx, u32 flags) {
+  TextureHandle texture_handle;
+  if (handle) {
+    const FrameBufferRef& ref = GraphicsRenderer::Instance()->_frame_buffer_ref[handle.idx];
+    c3_assert_return(!ref.window && "Can't sample window frame buffer.");
+    texture_handle = ref.th[idx];
+    c3_assert_return(texture_handle && "Frame buffer texture is invalid.");
+  }
+  SetTexture(unit, texture_handle, flags);
+}
+
+// Draws with the same textures and state get the same material key and sort
+// next to each other within a program, so Submit skips the rebinds.
+static u16 material_key(const RenderItem& item) {
+  u32 h = (u32)item.flags ^ (u32)(item.flags >> 32);
+  for (const Binding& bind : item.bind) {
+    h = (h * 0x9E3779B1u) ^ bind.idx;
+    h = (h * 0x9E3779B1u) ^ bind.flags;
+  }
+  return (u16)((h ^ (h >> 12) ^ (h >> 24)) & SORT_KEY_MATERIAL_MASK);
+}
+
+void DrawEncoder::Submit(u8 view, ProgramHandle program, i32 depth) {
+  if (_discard) {
+    Discard();
+    return;
+  }
+  if (_item_pos == _item_end) {
+    u32 num = C3_DRAW_ENCODER_CHUNK;
+    _item_pos = _frame->ReserveItems(&num);
+    _item_end = _item_pos + num;
+    if (num == 0) {
+      c3_assert(!"Render item overflow.");
+      _current.Clear();
+      return;
+    }
+  }
+  u32 item = _item_pos++;
+  _current.constant_begin = _constant_begin;
+  _current.constant_end = _constant_pos;
+  _frame->render_items[item] = _current;
+
+  auto GR = GraphicsRenderer::Instance();
+  _sort_key.depth = (u32)depth;
+  _sort_key.view = view;
+  _sort_key.program = (u16)program.idx;
+  _sort_key.material = _sort_key.trans ? 0 : material_key(_current);
+  _sort_key.seq = GR->_seq_enabled[view] ? (u16)GR->_seq[view].fetch_add(1, memory_order_relaxed) : 0;
+  _frame->sort_keys[item] = _sort_key.EncodeDraw();
+
+  _current.Clear();
+  _constant_begin = _constant_pos;
+}
+
+void DrawEncoder::Discard() {
+  _discard = true;
+  _current.Clear();
+  _constant_begin = _constant_pos;
+}
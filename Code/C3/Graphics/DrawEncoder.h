@@ -0,0 +1,79 @@
+#pragma once
+#include "Platform/PlatformConfig.h"
+#include "Data/DataType.h"
+#include "Memory/C3Memory.h"
+#include "RenderItem.h"
+#include "GraphicsInterface.h"
+#include "RenderKey.h"
+
+struct RenderFrame;
+
+/*
+* DrawEncoder records draw state and submits draws into the RenderFrame being
+* built. Every thread has its own encoder (GraphicsRenderer::GetThreadEncoder),
+* so job workers can record views in parallel. Render items and matrices are
+* taken from the frame C3_DRAW_ENCODER_CHUNK at a time, constants are written
+* to chunks of the frame's constant segment. RenderFrame::Finish merges all
+* encoders.
+*
+* Draw state stays in the encoder until Submit. Don't wait on jobs in between,
+* another job resumed on the same thread would record into the same encoder.
+*/
+class DrawEncoder {
+public:
+  DrawEncoder();
+  ~DrawEncoder();
+
+  void SetMarker(const char* marker);
+  void SetState(u64 state, u32 rgba = 0);
+  u16 SetTransform(const float4x4* mtx, u16 num = 1);
+  void SetTransform(u16 cache, u16 num = 1);
+  u16 AllocTransform(float4x4*& mtx_out, u16& num_in_out);
+  void SetVertexBuffer(const TransientVertexBuffer* tvb) { SetVertexBuffer(tvb, 0, UINT32_MAX); }
+  void SetVertexBuffer(const TransientVertexBuffer* tvb, u32 start_vertex, u32 num_vertices);
+  void SetVertexBuffer(VertexBufferHandle handle) { SetVertexBuffer(handle, 0, UINT32_MAX); }
+  void SetVertexBuffer(VertexBufferHandle handle, u32 start, u32 num);
+  void SetIndexBuffer(const TransientIndexBuffer* tib) { SetIndexBuffer(tib, 0, UINT32_MAX); }
+  void SetIndexBuffer(const TransientIndexBuffer* tib, u32 first_index, u32 num_indices);
+  void SetIndexBuffer(IndexBufferHandle handle) { SetIndexBuffer(handle, 0, UINT32_MAX); }
+  void SetIndexBuffer(IndexBufferHandle handle, u32 start, u32 num);
+  void SetInstanceDataBuffer(const InstanceDataBuffer* idb, u32 num = UINT32_MAX);
+  void SetInstanceDataBuffer(VertexBufferHandle handle, u32 start_vertex, u32 num, u16 stride);
+  void SetScissor(i16 x, i16 y, i16 width, i16 height);
+  void SetConstant(ConstantHandle handle, const void* value, u16 num = 1);
+  void SetTexture(u8 unit, TextureHandle texture, u32 flags = UINT32_MAX);
+  void SetTexture(u8 unit, FrameBufferHandle framebuffer, int idx, u32 flags = UINT32_MAX);
+  void Touch(u8 view) { Submit(view, ProgramHandle()); }
+  void Submit(u8 view, ProgramHandle program, i32 depth = 0);
+  void Discard();
+
+private:
+  friend struct RenderFrame;
+  DrawEncoder(const DrawEncoder&);
+  DrawEncoder& operator =(const DrawEncoder&);
+
+  void Init(RenderFrame* frame, u8 index);
+  void Destroy();
+  void Start();
+  void Finish();
+  u16 ReserveMatrices(u16* num);
+  // Space for size bytes of constants in the frame's constant segment, nullptr if it is full.
+  u8* ReserveConstants(u32 size);
+
+  RenderFrame* _frame;
+  // Constants of the current draw are [begin, pos), the chunk ends at end.
+  u32 _constant_begin;
+  u32 _constant_pos;
+  u32 _constant_end;
+  RenderItem _current;
+  SortKey _sort_key;
+  // Reserved chunks, [pos, end) not used yet.
+  u32 _item_pos;
+  u32 _item_end;
+  u16 _matrix_pos;
+  u16 _matrix_end;
+  u8 _index;
+  bool _discard;
+  // Encoders of different threads sit next to each other in RenderFrame.
+  u8 _pad[CACHELINE_SIZE];
+};
@@ -0,0 +1,99 @@
+#include "C3PCH.h"
+#include "FrameRing.h"
+
+// Segments start at cache lines so threads filling different frames don't share them.
+#define FRAME_RING_ALIGN CACHELINE_SIZE
+
+u32 FrameRingSegment::Alloc(u32 num_bytes, u32 align) {
+  u32 old_pos = pos.load(memory_order_relaxed);
+  for (;;) {
+    u32 offset = num_align(old_pos, max<u32>(align, 1));
+    if (offset < old_pos || num_bytes > size || offset > size - num_bytes) {
+      num_failed.fetch_add(1, memory_order_relaxed);
+      return UINT32_MAX;
+    }
+    if (pos.compare_exchange_weak(old_pos, offset + num_bytes, memory_order_relaxed)) return offset;
+  }
+}
+
+u32 FrameRingSegment::AllocNum(u32* num, u32 stride) {
+  c3_assert(stride > 0);
+  u32 old_pos = pos.load(memory_order_relaxed);
+  for (;;) {
+    u32 offset = num_align(old_pos, stride);
+    u32 n = offset < size ? min<u32>(*num, (size - offset) / stride) : 0;
+    if (n == 0 && *num > 0) {
+      num_failed.fetch_add(1, memory_order_relaxed);
+      *num = 0;
+      return offset < size ? offset : size;
+    }
+    if (pos.compare_exchange_weak(old_pos, offset + n * stride, memory_order_relaxed)) {
+      if (n < *num) num_failed.fetch_add(1, memory_order_relaxed);
+      *num = n;
+      return offset;
+    }
+  }
+}
+
+bool FrameRingSegment::CheckAvail(u32 num_bytes, u32 align) const {
+  u32 old_pos = pos.load(memory_order_relaxed);
+  u32 offset = num_align(old_pos, max<u32>(align, 1));
+  return offset >= old_pos && num_bytes <= size && offset <= size - num_bytes;
+}
+
+void FrameRingSegment::Reset() {
+  last_used = pos.load(memory_order_relaxed);
+  high_water = max(high_water, last_used);
+  total_failed += num_failed.load(memory_order_relaxed);
+  pos.store(0, memory_order_relaxed);
+  num_failed.store(0, memory_order_relaxed);
+}
+
+FrameRing::FrameRing(): _num_frames(0) {
+  memset(_blocks, 0, sizeof(_blocks));
+}
+
+void FrameRing::Init(u32 num_frames, const u32 sizes[FRAME_RING_COUNT]) {
+  Destroy();
+  c3_assert_return(num_frames > 0 && num_frames <= MAX_FRAMES);
+  _num_frames = num_frames;
+  for (u32 type = 0; type < FRAME_RING_COUNT; ++type) {
+    u32 segment_size = num_align(sizes[type], FRAME_RING_ALIGN);
+    _blocks[type] = (u8*)C3_ALIGNED_ALLOC(mem_allocator(MEMORY_TAG_GRAPHICS), segment_size * num_frames, FRAME_RING_ALIGN);
+    for (u32 frame = 0; frame < num_frames; ++frame) {
+      FrameRingSegment& segment = _segments[frame][type];
+      segment.data = _blocks[type] + segment_size * frame;
+      segment.size = sizes[type];
+      segment.pos = 0;
+      segment.num_failed = 0;
+      segment.last_used = 0;
+      segment.high_water = 0;
+      segment.total_failed = 0;
+    }
+  }
+}
+
+void FrameRing::Destroy() {
+  for (u32 type = 0; type < FRAME_RING_COUNT; ++type) {
+    if (_blocks[type]) C3_ALIGNED_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), _blocks[type], FRAME_RING_ALIGN);
+    _blocks[type] = nullptr;
+    for (auto& frame : _segments) {
+      frame[type].data = nullptr;
+      frame[type].size = 0;
+    }
+  }
+  _num_frames = 0;
+}
+
+void FrameRing::GetStats(FrameRingStats* stats) const {
+  memset(stats, 0, sizeof(FrameRingStats));
+  for (u32 type = 0; type < FRAME_RING_COUNT; ++type) {
+    for (u32 frame = 0; frame < _num_frames; ++frame) {
+      const FrameRingSegment& segment = _segments[frame][type];
+      stats->capacity[type] = segment.size;
+      stats->last_used[type] = max(stats->last_used[type], segment.last_used);
+      stats->high_water[type] = max(stats->high_water[type], segment.high_water);
+      stats->num_failed[type] += segment.total_failed;
+    }
+  }
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "Data/DataType.h"
+#include "Memory/C3Memory.h"
+#include "Platform/PlatformSync.h"
+
+enum FrameRingType {
+  FRAME_RING_VERTEX,      // transient vertices and instance data.
+  FRAME_RING_INDEX,       // transient indices.
+  FRAME_RING_CONSTANT,    // draw constants of all DrawEncoders.
+  FRAME_RING_COUNT
+};
+
+// Transient memory of one frame. Threads suballocate it with an atomic offset,
+// it never grows, what does not fit fails until the frame is reused.
+struct FrameRingSegment {
+  FrameRingSegment(): data(nullptr), size(0), pos(0), num_failed(0), last_used(0), high_water(0), total_failed(0) {}
+
+  u8* data;
+  u32 size;
+  atomic_u32 pos;
+  atomic_u32 num_failed;  // this frame.
+  u32 last_used;          // of the previous frame in this segment.
+  u32 high_water;         // max used since FrameRing::Init.
+  u32 total_failed;
+
+  // Lock free. Returns offset of num_bytes aligned to a multiple of align
+  // (any value, e.g. a vertex stride), UINT32_MAX if the segment is full.
+  u32 Alloc(u32 num_bytes, u32 align);
+  // Like Alloc but takes what is left when num * stride does not fit, num is
+  // set to the count allocated.
+  u32 AllocNum(u32* num, u32 stride);
+  bool CheckAvail(u32 num_bytes, u32 align) const;
+  u32 GetUsed() const { return pos.load(memory_order_relaxed); }
+  // The frame is done with the segment, records usage and starts over.
+  void Reset();
+};
+
+struct FrameRingStats {
+  u32 capacity[FRAME_RING_COUNT];     // per frame.
+  u32 last_used[FRAME_RING_COUNT];    // max over the segments of their previous frame.
+  u32 high_water[FRAME_RING_COUNT];
+  u32 num_failed[FRAME_RING_COUNT];   // allocations dropped since Init.
+};
+
+/*
+* FrameRing holds the transient vertices, indices and constants of the frames
+* in flight. Every type is one block cut into a fixed segment per RenderFrame,
+* a frame resets its segments in RenderFrame::Start, after the render thread
+* is done with them. Nothing is reallocated or copied while a frame is built.
+*/
+class FrameRing {
+public:
+  enum { MAX_FRAMES = 2 };
+
+  FrameRing();
+  ~FrameRing() { Destroy(); }
+
+  void Init(u32 num_frames, const u32 sizes[FRAME_RING_COUNT]);
+  void Destroy();
+  FrameRingSegment* GetSegment(u32 frame, FrameRingType type) { return &_segments[frame][type]; }
+  // Game thread, read between frames.
+  void GetStats(FrameRingStats* stats) const;
+
+private:
+  u8* _blocks[FRAME_RING_COUNT];
+  FrameRingSegment _segments[MAX_FRAMES][FRAME_RING_COUNT];
+  u32 _num_frames;
+};
@@ -1,6 +1,7 @@
 #include "C3PCH.h"
 #include "GraphicsInterface.h"
 #include "GraphicsRenderer.h"
+#include "Null/GraphicsInterfaceNull.h"
 #include "Platform/PlatformConfig.h"
 #if ON_WINDOWS
 #include "D3D11/GraphicsInterfaceD3D11.h"
@@ -17,6 +18,7 @@ GraphicsInterface::GraphicsInterface(GraphicsAPI api, int major_version, int min
 : _api(api), _major_version(major_version), _minor_version(minor_version) {
 
   for (int i = 0; i < C3_MAX_VIEWS; ++i) sprintf(_view_names[i], "%3d   ", i);
+  memset(&_frame_stats, 0, sizeof(_frame_stats));
 }
 
 bool GraphicsInterface::CreateInstances(GraphicsAPI api, int major_version, int minor_version, bool need_auxiliary) {
@@ -34,11 +36,9 @@ bool GraphicsInterface::CreateInstances(GraphicsAPI api, int major_version, int
       auxiliary_instance_creator = [](const GraphicsInterface& main_instance) { return new GraphicsInterfaceGlIos(static_cast<const GraphicsInterfaceGlIos&>(main_instance)); };
       break;
 #endif
-#if 0
     case NULL_GRAPHICS_API:
-      main_instance_creator = [major_version, minor_version]() { return new GraphicsInterfaceNull(NULL_API, major_version, minor_version); };
+      main_instance_creator = [major_version, minor_version]() { return new GraphicsInterfaceNull(NULL_GRAPHICS_API, major_version, minor_version); };
       break;
-#endif
     default:
       c3_log("[C3] Unknown graphics api\n");
       return false;
@@ -65,7 +65,8 @@ void GraphicsInterface::UpdateViewName(u8 view, const char* name) {
   memcpy(&_view_names[view][C3_VIEW_NAME_RESERVED], name, name_len + 1);
 }
 
-void GraphicsInterface::UpdateConstants(ConstantBuffer* constant_buffer, u32 begin, u32 end) {
+u32 GraphicsInterface::UpdateConstants(ConstantBuffer* constant_buffer, u32 begin, u32 end) {
+  u32 changes = 0;
   constant_buffer->Reset(begin);
   while (constant_buffer->GetPos() < end) {
     u32 opcode = constant_buffer->Read();
@@ -81,12 +82,18 @@ void GraphicsInterface::UpdateConstants(ConstantBuffer* constant_buffer, u32 beg
     u32 size = CONSTANT_TYPE_SIZE[type] * num;
     const char* data = constant_buffer->Read(size);
     if (type < CONSTANT_COUNT) {
-      if (copy) UpdateConstant(loc, data, size);
-      else UpdateConstant(loc, *(const char**)(data), size);
+      // Materials set every param per draw, after the sort most repeat the previous draw.
+      if (UpdateConstant(loc, copy ? data : *(const char**)(data), size)) {
+        ++changes;
+        ++_frame_stats.num_constant_updates;
+      } else {
+        ++_frame_stats.num_constants_skipped;
+      }
     } else {
       SetMarker(data, size);
     }
   }
+  return changes;
 }
 
 void ClearQuad::Init() {
@@ -67,6 +67,20 @@ struct Resolution {
   Resolution(): width(C3_RESOLUTION_DEFAULT_WIDTH), height(C3_RESOLUTION_DEFAULT_HEIGHT), flags(C3_RESET_NONE) {}
 };
 
+// Counters of the last submitted frame, filled by the backend's Submit.
+struct GraphicsStats {
+  u64 constant_bytes;           // uploaded to shader constant buffers.
+  u32 num_items;
+  u32 num_draws;
+  u32 num_instances;
+  u32 num_batched_items;        // draws merged into instanced draws by RenderFrame::Batch.
+  u32 num_views;
+  u32 num_program_changes;
+  u32 num_texture_binds;        // stages whose texture or sampler changed.
+  u32 num_constant_updates;
+  u32 num_constants_skipped;    // same value as the constant already held.
+};
+
 inline bool need_border_color(u32 flags) {
 	return C3_TEXTURE_U_BORDER == (flags & C3_TEXTURE_U_BORDER) ||
     C3_TEXTURE_V_BORDER == (flags & C3_TEXTURE_V_BORDER) ||
@@ -110,16 +124,19 @@ public:
   virtual void DestroyFrameBuffer(FrameBufferHandle handle) = 0;
   virtual void CreateConstant(ConstantHandle handle, ConstantType type, u16 num, stringid name) = 0;
   virtual void DestroyConstant(ConstantHandle handle) = 0;
-  virtual void UpdateConstant(u16 loc, const void* data, u32 size) = 0;
+  // Returns false if the constant already holds data.
+  virtual bool UpdateConstant(u16 loc, const void* data, u32 size) = 0;
   virtual void SetMarker(const char* marker, u32 size) = 0;
   virtual void Submit(RenderFrame* render, ClearQuad& clear_quad) = 0;
   virtual void Flip() = 0;
   virtual void SaveScreenshot(const String& path) = 0;
   void UpdateViewName(u8 view, const char* name);
+  const GraphicsStats& GetFrameStats() const { return _frame_stats; }
 
 protected:
   GraphicsInterface(GraphicsAPI api, int major_version, int minor_version); // create the main GI
-  void UpdateConstants(ConstantBuffer* constant_buffer, u32 begin, u32 end);
+  // Returns the number of constants whose value changed, redundant writes are skipped.
+  u32 UpdateConstants(ConstantBuffer* constant_buffer, u32 begin, u32 end);
 
   virtual void _SetConstantFloat(u8 flags, u32 loc, const void* val, u32 num) = 0;
   virtual void _SetConstantVector4(u8 flags, u32 loc, const void* val, u32 num) = 0;
@@ -128,6 +145,7 @@ protected:
   GraphicsAPI _api;
   int _major_version, _minor_version;
   char _view_names[C3_MAX_VIEWS][C3_MAX_VIEW_NAME];
+  GraphicsStats _frame_stats;
 
 private:
   static thread_local GraphicsInterface* __instance;
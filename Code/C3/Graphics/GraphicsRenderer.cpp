@@ -12,12 +12,30 @@ DEFINE_SINGLETON_INSTANCE(GraphicsRenderer);
 static void calc_texture_size(TextureInfo& info_out, u16 width_, u16 height_, u16 depth_, bool cube_map, u8 num_mips, TextureFormat format);
 static void get_texture_size_from_ratio(BackbufferRatio ratio, u16& width_out, u16& height_out);
 
-GraphicsRenderer::GraphicsRenderer(): _ok(false), _gi(nullptr), _frame_counter(0) {
-  _frame = new RenderFrame;
+GraphicsRenderer::GraphicsRenderer()
+: _ok(false), _gi(nullptr), _api(NULL_GRAPHICS_API), _frame_counter(0), _last_frame_draws(0),
+  _sort_label(nullptr), _sort_pending(false), _render_pending(false), _exit(false), _upload_queue(C3_MAX_PENDING_UPLOADS, mem_allocator(MEMORY_TAG_GRAPHICS)) {
+  _submit = new RenderFrame;
+  _render = new RenderFrame;
+  // Empty until Init, transient allocations fail without a graphics interface.
+  u32 frame = 0;
+  for (auto f : {_submit, _render}) {
+    f->vertex_segment = _frame_ring.GetSegment(frame, FRAME_RING_VERTEX);
+    f->index_segment = _frame_ring.GetSegment(frame, FRAME_RING_INDEX);
+    f->constant_segment = _frame_ring.GetSegment(frame, FRAME_RING_CONSTANT);
+    ++frame;
+  }
   _color_palette_dirty = 0;
   _num_views = 0;
+  memset(&_stats, 0, sizeof(_stats));
+  _upload_ticket = 0;
+  _upload_required = 0;
+  _uploaded = 0;
+  _upload_queued_bytes = 0;
+  memset(&_upload_stats, 0, sizeof(_upload_stats));
   memset(_view_flags, C3_VIEW_NONE, sizeof(_view_flags));
   memset(_seq_enabled, 0, sizeof(_seq_enabled));
+  for (auto& seq : _seq) seq = 0;
   memset(_rect, 0, sizeof(_rect));
   memset(_scissor, 0, sizeof(_scissor));
   for (u8 i = 0; i < C3_MAX_VIEWS; ++i) {
@@ -28,26 +46,47 @@ GraphicsRenderer::GraphicsRenderer(): _ok(false), _gi(nullptr), _frame_counter(0
   }
 }
 
-GraphicsRenderer::~GraphicsRenderer() {}
+GraphicsRenderer::~GraphicsRenderer() {
+  delete _submit;
+  delete _render;
+}
 
 bool GraphicsRenderer::Init(GraphicsAPI api) {
   _ok = false;
   c3_log("renderer size: %u, frame size: %u\n", sizeof(GraphicsRenderer), sizeof(RenderFrame));
   init_builtin_vertex_decls(api);
+  _api = api;
 
-  _frame->Create();
-
-  _ok = GraphicsInterface::CreateInstances(D3D11_WIN_API, 11, 0, false);
+  _submit->Create();
+  _render->Create();
 
-  if (!_ok) return false;
+  {
+    // GraphicsInterface is created by the thread which renders.
+    SpinLockGuard lock(&_cmd_lock);
+    GetCommandBuffer(CommandBuffer::RENDERER_INIT).Write(api);
+  }
+#if C3_RENDER_THREAD
+  _exit = false;
+  _render_thread.Init(&GraphicsRenderer::RenderThreadEntry, this, 0, "Render");
+#endif
 
-  _gi = GraphicsInterface::Instance();
-  _gi->Init();
   _clear_quad.Init();
-
-  _frame->transient_vb = CreateTransientVertexBuffer(C3_TRANSIENT_VERTEX_BUFFER_SIZE);
-  _frame->transient_ib = CreateTransientIndexBuffer(C3_TRANSIENT_INDEX_BUFFER_SIZE);
+  const u32 ring_sizes[FRAME_RING_COUNT] = {
+    C3_TRANSIENT_VERTEX_BUFFER_SIZE, C3_TRANSIENT_INDEX_BUFFER_SIZE, C3_TRANSIENT_CONSTANT_BUFFER_SIZE
+  };
+  _frame_ring.Init(FrameRing::MAX_FRAMES, ring_sizes);
+  for (auto frame : {_submit, _render}) {
+    frame->transient_vb = CreateTransientVertexBuffer(C3_TRANSIENT_VERTEX_BUFFER_SIZE, nullptr, frame->vertex_segment->data);
+    frame->transient_ib = CreateTransientIndexBuffer(C3_TRANSIENT_INDEX_BUFFER_SIZE, frame->index_segment->data);
+    frame->constant_buffer = ConstantBuffer::CreateView(frame->constant_segment->data, frame->constant_segment->size);
+  }
   Frame();
+  // Waits for the frame above, RENDERER_INIT has run after this.
+  Frame();
+  if (!_ok) {
+    Shutdown();
+    return false;
+  }
 
   Reset(C3_RESOLUTION_DEFAULT_WIDTH, C3_RESOLUTION_DEFAULT_HEIGHT, C3_RESOLUTION_DEFAULT_FLAGS);
   return true;
@@ -68,7 +107,32 @@ void GraphicsRenderer::Reset(u16 width, u16 height, u32 flags) {
 }
 
 void GraphicsRenderer::Shutdown() {
-  _frame->Destroy();
+  if (_render_thread.IsRunning() || _gi) {
+    {
+      SpinLockGuard lock(&_cmd_lock);
+      GetCommandBuffer(CommandBuffer::RENDERER_SHUTDOWN_BEGIN);
+      GetCommandBuffer(CommandBuffer::RENDERER_SHUTDOWN_END);
+    }
+    Frame();
+    RenderWait();
+    if (_render_thread.IsRunning()) _render_thread.Shutdown();
+  }
+  // Uploads the renderer never got to.
+  while (auto upload = _upload_queue.FrontPtr()) {
+    mem_free(upload->mem);
+    _upload_queue.PopFront();
+  }
+  // GPU side went with the GraphicsInterface.
+  for (auto frame : {_submit, _render}) {
+    if (frame->transient_vb) C3_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), frame->transient_vb);
+    if (frame->transient_ib) C3_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), frame->transient_ib);
+    if (frame->constant_buffer) ConstantBuffer::Destroy(frame->constant_buffer);
+    frame->transient_vb = nullptr;
+    frame->transient_ib = nullptr;
+    frame->constant_buffer = nullptr;
+    frame->Destroy();
+  }
+  _frame_ring.Destroy();
 }
 
 u8 GraphicsRenderer::PushView(const char* name) {
@@ -87,32 +151,47 @@ VertexBufferHandle GraphicsRenderer::CreateVertexBuffer(const MemoryRegion* mem,
   c3_assert(handle && "Failed to allocate vertex buffer handle.");
   VertexDeclHandle decl_handle = FindVertexDecl(decl);
   auto& vb = _vertex_buffers[handle.idx];
+  vb.upload = 0;
   vb.stride = decl.stride;
   vb.size = mem->size;
   vb.flags = flags;
-  _gi->CreateVertexBuffer(handle, mem, decl_handle, flags);
+  SpinLockGuard lock(&_cmd_lock);
+  auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_VERTEX_BUFFER);
+  cmd.Write(handle);
+  cmd.Write(mem);
+  cmd.Write(decl_handle);
+  cmd.Write(flags);
   return handle;
 }
 
 void GraphicsRenderer::DestroyVertexBuffer(VertexBufferHandle handle) {
   if (!handle) return;
-  _gi->DestroyVertexBuffer(handle);
-  _vertex_buffer_handles.Free(handle);
+  SpinLockGuard lock(&_cmd_lock);
+  RequireUpload(_vertex_buffers[handle.idx].upload);
+  GetCommandBuffer(CommandBuffer::DESTROY_VERTEX_BUFFER).Write(handle);
+  _submit->Free(handle);
 }
 
 IndexBufferHandle GraphicsRenderer::CreateIndexBuffer(const MemoryRegion* mem, u16 flags) {
   IndexBufferHandle handle = _index_buffer_handles.Alloc();
   auto& ib = _index_buffers[handle.idx];
+  ib.upload = 0;
   ib.size = mem->size;
   ib.flags = flags;
-  _gi->CreateIndexBuffer(handle, mem, flags);
+  SpinLockGuard lock(&_cmd_lock);
+  auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_INDEX_BUFFER);
+  cmd.Write(handle);
+  cmd.Write(mem);
+  cmd.Write(flags);
   return handle;
 }
 
 void GraphicsRenderer::DestroyIndexBuffer(IndexBufferHandle handle) {
   if (!handle) return;
-  _gi->DestroyIndexBuffer(handle);
-  _index_buffer_handles.Free(handle);
+  SpinLockGuard lock(&_cmd_lock);
+  RequireUpload(_index_buffers[handle.idx].upload);
+  GetCommandBuffer(CommandBuffer::DESTROY_INDEX_BUFFER).Write(handle);
+  _submit->Free(handle);
 }
 
 VertexBufferHandle GraphicsRenderer::CreateDynamicVertexBuffer(u32 num, const VertexDecl& decl, u16 flags) {
@@ -124,7 +203,11 @@ VertexBufferHandle GraphicsRenderer::CreateDynamicVertexBuffer(u32 num, const Ve
   vb.size = num * decl.stride;
   vb.flags = flags;
 
-  _gi->CreateDynamicVertexBuffer(handle, decl.stride * num, flags);
+  SpinLockGuard lock(&_cmd_lock);
+  auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_DYNAMIC_VERTEX_BUFFER);
+  cmd.Write(handle);
+  cmd.Write(vb.size);
+  cmd.Write(flags);
   return handle;
 }
 
@@ -141,13 +224,19 @@ void GraphicsRenderer::UpdateDynamicVertexBuffer(VertexBufferHandle handle, u32
   u32 offset = start_vertex * vb.stride;
   if (offset >= vb.size || offset + mem->size > vb.size) {
     c3_log("[C3] Dynamic vertex buffer update overflow.\n");
+    mem_free(mem);
     return;
   }
   u32 size = min<u32>(vb.size - offset, mem->size);
   if (size < mem->size) {
     c3_log("[C3] Truncating dynamic vertex buffer update (size %d, mem size %d).\n", vb.size, mem->size);
   }
-  _gi->UpdateDynamicVertexBuffer(handle, offset, size, mem);
+  SpinLockGuard lock(&_cmd_lock);
+  auto& cmd = GetCommandBuffer(CommandBuffer::UPDATE_DYNAMIC_VERTEX_BUFFER);
+  cmd.Write(handle);
+  cmd.Write(offset);
+  cmd.Write(size);
+  cmd.Write(mem);
 }
 
 IndexBufferHandle GraphicsRenderer::CreateDynamicIndexBuffer(u32 num, u16 flags) {
@@ -161,7 +250,11 @@ IndexBufferHandle GraphicsRenderer::CreateDynamicIndexBuffer(u32 num, u16 flags)
   auto& ib = _index_buffers[handle.idx];
   ib.size = size;
   ib.flags = flags;
-  _gi->CreateDynamicIndexBuffer(handle, size, flags);
+  SpinLockGuard lock(&_cmd_lock);
+  auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_DYNAMIC_INDEX_BUFFER);
+  cmd.Write(handle);
+  cmd.Write(size);
+  cmd.Write(flags);
   return handle;
 }
 
@@ -178,38 +271,50 @@ void GraphicsRenderer::UpdateDynamicIndexBuffer(IndexBufferHandle handle, u32 st
   u32 offset = start_index * index_size;
   if (offset >= ib.size) {
     c3_log("[C3] Update dynamic index buffer, start_index too large (size %d, offset %d).\n", ib.size, offset);
+    mem_free(mem);
     return;
   }
   u32 size = min(offset + mem->size, ib.size) - offset;
   if (size < mem->size) c3_log("Truncating dynamic index buffer update (size %d, mem size %d).\n", size, mem->size);
-  _gi->UpdateDynamicIndexBuffer(handle, offset, size, mem);
+  SpinLockGuard lock(&_cmd_lock);
+  auto& cmd = GetCommandBuffer(CommandBuffer::UPDATE_DYNAMIC_INDEX_BUFFER);
+  cmd.Write(handle);
+  cmd.Write(offset);
+  cmd.Write(size);
+  cmd.Write(mem);
 }
 
 bool GraphicsRenderer::CheckAvailTransientIndexBuffer(u32 num) {
-  return _frame->CheckAvailTransientIndexBuffer(num);
+  return _submit->CheckAvailTransientIndexBuffer(num);
 }
 
 bool GraphicsRenderer::CheckAvailTransientVertexBuffer(u32 num, const VertexDecl& decl) {
-  return _frame->CheckAvailTransientVertexBuffer(num, decl.stride);
+  return _submit->CheckAvailTransientVertexBuffer(num, decl.stride);
 }
 
 bool GraphicsRenderer::CheckAvailTransientBuffers(u32 num_vertices, const VertexDecl& decl, u32 num_indices) {
-  return _frame->CheckAvailTransientIndexBuffer(num_indices) &&
-    _frame->CheckAvailTransientVertexBuffer(num_vertices, decl.stride);
+  return _submit->CheckAvailTransientIndexBuffer(num_indices) &&
+    _submit->CheckAvailTransientVertexBuffer(num_vertices, decl.stride);
 }
 
 void GraphicsRenderer::AllocTransientVertexBuffer(TransientVertexBuffer* tvb_out, u32 num, const VertexDecl& decl) {
-  TransientVertexBuffer& dvb = *_frame->transient_vb;
-  
-  VertexDeclHandle decl_handle = _decl_ref.Find(decl.hash);
-  if (!decl_handle) {
-    VertexDeclHandle temp = _vertex_decl_handles.Alloc();
-    decl_handle = temp;
-    _gi->CreateVertexDecl(decl_handle, decl);
-    _decl_ref.Add(decl_handle, decl.hash);
+  TransientVertexBuffer& dvb = *_submit->transient_vb;
+
+  VertexDeclHandle decl_handle;
+  {
+    // Encoder threads allocate transient vertices too.
+    SpinLockGuard lock(&_cmd_lock);
+    decl_handle = _decl_ref.Find(decl.hash);
+    if (!decl_handle) {
+      decl_handle = _vertex_decl_handles.Alloc();
+      auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_VERTEX_DECL);
+      cmd.Write(decl_handle);
+      cmd.Write(decl);
+      _decl_ref.Add(decl_handle, decl.hash);
+    }
   }
 
-  u32 offset = _frame->AllocTransientVertexBuffer(num, decl.stride);
+  u32 offset = _submit->AllocTransientVertexBuffer(num, decl.stride);
 
   tvb_out->data = &dvb.data[offset];
   tvb_out->size = num * decl.stride;
@@ -220,8 +325,8 @@ void GraphicsRenderer::AllocTransientVertexBuffer(TransientVertexBuffer* tvb_out
 }
 
 void GraphicsRenderer::AllocTransientIndexBuffer(TransientIndexBuffer* tib_out, u32 num) {
-  u32 offset = _frame->AllocTransientIndexBuffer(num);
-  TransientIndexBuffer& tib = *_frame->transient_ib;
+  u32 offset = _submit->AllocTransientIndexBuffer(num);
+  TransientIndexBuffer& tib = *_submit->transient_ib;
 
   tib_out->data = &tib.data[offset];
   tib_out->size = num * 2;
@@ -242,6 +347,7 @@ ShaderHandle GraphicsRenderer::CreateShader(const MemoryRegion* mem, ShaderInfo:
   ShaderHandle handle = _shader_handles.Alloc();
   if (!handle) {
     c3_log("Failed to alloc shader handle.\n");
+    mem_free(mem);
     return handle;
   }
   ShaderRef& shader = _shader_ref[handle.idx];
@@ -249,12 +355,21 @@ ShaderHandle GraphicsRenderer::CreateShader(const MemoryRegion* mem, ShaderInfo:
   shader.num_constants = 0;
   shader.hash = 0;
   shader.owned = false;
+  shader.instanced = false;
 
   BlobReader blob(mem->data, mem->size);
   ShaderInfo::Header header;
   blob.Read(header);
   c3_assert_return_x(header.magic == C3_CHUNK_MAGIC_VSH || header.magic == C3_CHUNK_MAGIC_FSH, ShaderHandle());
-  shader.constants = (ConstantHandle*)C3_ALLOC(g_allocator, header.num_constants * sizeof(ConstantHandle));
+  if (header.magic == C3_CHUNK_MAGIC_VSH) {
+    u32 instance_attrs = 0;
+    for (u8 i = 0; i < header.num_inputs; ++i) {
+      int attr = semantic_to_vertex_attr(header.inputs[i].semantic);
+      if (attr >= INSTANCE_ATTR_I_DATA0 && attr <= INSTANCE_ATTR_I_DATA3) instance_attrs |= 1 << (attr - INSTANCE_ATTR_I_DATA0);
+    }
+    shader.instanced = instance_attrs == 0xf;
+  }
+  shader.constants = (ConstantHandle*)C3_ALLOC(mem_allocator(MEMORY_TAG_GRAPHICS), header.num_constants * sizeof(ConstantHandle));
   for (u8 i = 0; i < header.num_constants; ++i) {
     auto& c = header.constants[i];
     if (PredefinedConstant::NameToType(c.name) == PREDEFINED_CONSTANT_COUNT) {
@@ -262,14 +377,18 @@ ShaderHandle GraphicsRenderer::CreateShader(const MemoryRegion* mem, ShaderInfo:
       ++shader.num_constants;
     }
   }
-  _gi->CreateShader(handle, mem);
+  {
+    SpinLockGuard lock(&_cmd_lock);
+    auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_SHADER);
+    cmd.Write(handle);
+    cmd.Write(mem);
+  }
   if (out_header) memcpy(out_header, &header, sizeof(header));
   return handle;
 }
 
 void GraphicsRenderer::DestroyShader(ShaderHandle handle) {
   if (!handle) return;
-  _gi->DestroyShader(handle);
   ShaderDecRef(handle);
 }
 
@@ -279,6 +398,7 @@ ProgramHandle GraphicsRenderer::CreateProgram(ShaderHandle vsh, ShaderHandle fsh
     return ProgramHandle();
   }
 
+  SpinLockGuard map_lock(&_map_lock);
   ProgramMap::const_iterator it = _program_map.find(u32(fsh.idx << 16) | vsh.idx);
   if (it != _program_map.end()) {
     ProgramHandle handle = it->second;
@@ -304,10 +424,16 @@ ProgramHandle GraphicsRenderer::CreateProgram(ShaderHandle vsh, ShaderHandle fsh
     pr.vsh = vsh;
     pr.fsh = fsh;
     pr.ref_count = 1;
+    pr.instanced = vsr.instanced;
+    pr.instanced_program = ProgramHandle();
 
     _program_map.insert(make_pair(u32(fsh.idx << 16) | vsh.idx, handle));
 
-    _gi->CreateProgram(handle, vsh, fsh);
+    SpinLockGuard lock(&_cmd_lock);
+    auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_PROGRAM);
+    cmd.Write(handle);
+    cmd.Write(vsh);
+    cmd.Write(fsh);
   }
 
   if (destroy_shaders) {
@@ -320,25 +446,61 @@ ProgramHandle GraphicsRenderer::CreateProgram(ShaderHandle vsh, ShaderHandle fsh
 
 void GraphicsRenderer::DestroyProgram(ProgramHandle handle) {
   ProgramRef& pr = _program_ref[handle.idx];
-  i16 refs = --pr.ref_count;
-  if (refs == 0) {
-    _gi->DestroyProgram(handle);
-    _program_handles.Free(handle);
+  ShaderHandle vsh, fsh;
+  ProgramHandle instanced_program;
+  {
+    SpinLockGuard map_lock(&_map_lock);
+    if (--pr.ref_count != 0) return;
+    vsh = pr.vsh;
+    fsh = pr.fsh;
+    instanced_program = pr.instanced_program;
+    pr.instanced_program = ProgramHandle();
+    u32 hash = vsh.idx;
+    if (fsh) hash |= u32(fsh) << 16;
+    _program_map.erase(hash);
 
-    ShaderDecRef(pr.vsh);
-    u32 hash = pr.vsh.idx;
+    SpinLockGuard lock(&_cmd_lock);
+    GetCommandBuffer(CommandBuffer::DESTROY_PROGRAM).Write(handle);
+    _submit->Free(handle);
+  }
 
-    if (pr.fsh) {
-      ShaderDecRef(pr.fsh);
-      hash |= u32(pr.fsh) << 16;
-    }
+  ShaderDecRef(vsh);
+  if (fsh) ShaderDecRef(fsh);
+  if (instanced_program) DestroyProgram(instanced_program);
+}
 
-    _program_map.erase(hash);
+void GraphicsRenderer::SetInstancedProgram(ProgramHandle program, ProgramHandle instanced) {
+  if (!program) return;
+  ProgramHandle old_instanced;
+  {
+    SpinLockGuard map_lock(&_map_lock);
+    if (instanced && !_program_ref[instanced.idx].instanced) {
+      c3_log("Program %d does not take i_data0-3, not used for instancing.\n", instanced.idx);
+      return;
+    }
+    ProgramRef& pr = _program_ref[program.idx];
+    if (instanced) ++_program_ref[instanced.idx].ref_count;
+    old_instanced = pr.instanced_program;
+    pr.instanced_program = instanced;
   }
+  if (old_instanced) DestroyProgram(old_instanced);
 }
 
 TextureHandle GraphicsRenderer::CreateTexture(const MemoryRegion* mem, u32 flags, u8 skip,
                                               TextureInfo* info_out, BackbufferRatio ratio) {
+  TextureHandle handle = AllocTexture(mem, info_out, ratio);
+  if (handle) {
+    SpinLockGuard lock(&_cmd_lock);
+    auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_TEXTURE);
+    cmd.Write(handle);
+    cmd.Write(mem);
+    cmd.Write(flags);
+    cmd.Write(skip);
+  }
+  return handle;
+}
+
+TextureHandle GraphicsRenderer::AllocTexture(const MemoryRegion* mem, TextureInfo* info_out, BackbufferRatio ratio) {
   TextureInfo ti;
   if (!info_out) info_out = &ti;
 
@@ -360,17 +522,17 @@ TextureHandle GraphicsRenderer::CreateTexture(const MemoryRegion* mem, u32 flags
   }
 
   TextureHandle handle = _texture_handles.Alloc();
-  if (!handle) c3_log("Failed to allocate texture handle.\n");
-  else {
+  if (!handle) {
+    c3_log("Failed to allocate texture handle.\n");
+    mem_free(mem);
+  } else {
     TextureRef& ref = _texture_ref[handle.idx];
+    ref.upload = 0;
     ref.ref_count = 1;
     ref.bb_ratio = u8(ratio);
     ref.format = u8(info_out->format);
     ref.owned = false;
-
-    _gi->CreateTexture(handle, mem, flags, skip);
   }
-
   return handle;
 }
 
@@ -432,12 +594,154 @@ void GraphicsRenderer::DestroyTexture(TextureHandle handle) {
   TextureDecRef(handle);
 }
 
+TextureHandle GraphicsRenderer::UploadTexture(const MemoryRegion* mem, u32 flags, u8 skip, TextureInfo* info_out,
+                                              u32* ticket_out) {
+  *ticket_out = 0;
+  TextureHandle handle = AllocTexture(mem, info_out, BACKBUFFER_RATIO_COUNT);
+  if (!handle) return handle;
+  PendingUpload upload;
+  upload.cmd = CommandBuffer::CREATE_TEXTURE;
+  upload.handle = handle.ToRaw();
+  upload.mem = mem;
+  upload.flags = flags;
+  upload.skip = skip;
+  upload.decl = INVALID_HANDLE_RAW;
+  _texture_ref[handle.idx].upload = *ticket_out = PushUpload(&upload);
+  return handle;
+}
+
+VertexBufferHandle GraphicsRenderer::UploadVertexBuffer(const MemoryRegion* mem, const VertexDecl& decl, u16 flags,
+                                                        u32* ticket_out) {
+  VertexBufferHandle handle = _vertex_buffer_handles.Alloc();
+  c3_assert(handle && "Failed to allocate vertex buffer handle.");
+  VertexDeclHandle decl_handle = FindVertexDecl(decl);
+  auto& vb = _vertex_buffers[handle.idx];
+  vb.stride = decl.stride;
+  vb.size = mem->size;
+  vb.flags = flags;
+  PendingUpload upload;
+  upload.cmd = CommandBuffer::CREATE_VERTEX_BUFFER;
+  upload.handle = handle.ToRaw();
+  upload.mem = mem;
+  upload.flags = flags;
+  upload.skip = 0;
+  upload.decl = decl_handle.ToRaw();
+  vb.upload = *ticket_out = PushUpload(&upload);
+  return handle;
+}
+
+IndexBufferHandle GraphicsRenderer::UploadIndexBuffer(const MemoryRegion* mem, u16 flags, u32* ticket_out) {
+  IndexBufferHandle handle = _index_buffer_handles.Alloc();
+  auto& ib = _index_buffers[handle.idx];
+  ib.size = mem->size;
+  ib.flags = flags;
+  PendingUpload upload;
+  upload.cmd = CommandBuffer::CREATE_INDEX_BUFFER;
+  upload.handle = handle.ToRaw();
+  upload.mem = mem;
+  upload.flags = flags;
+  upload.skip = 0;
+  upload.decl = INVALID_HANDLE_RAW;
+  ib.upload = *ticket_out = PushUpload(&upload);
+  return handle;
+}
+
+u32 GraphicsRenderer::PushUpload(PendingUpload* upload) {
+  SpinLockGuard lock(&_cmd_lock);
+  // Tickets follow queue order, the render thread creates them in order.
+  upload->ticket = _upload_ticket + 1;
+  if (_upload_queue.Write(*upload)) {
+    _upload_ticket = upload->ticket;
+    _upload_queued_bytes.fetch_add(upload->mem->size, memory_order_relaxed);
+    return upload->ticket;
+  }
+  // Created with the frame being built, before anything can draw it.
+  auto& cmd = GetCommandBuffer((CommandBuffer::CommandType)upload->cmd);
+  switch (upload->cmd) {
+  case CommandBuffer::CREATE_TEXTURE:
+    cmd.Write(TextureHandle(upload->handle));
+    cmd.Write(upload->mem);
+    cmd.Write(upload->flags);
+    cmd.Write(upload->skip);
+    break;
+  case CommandBuffer::CREATE_VERTEX_BUFFER:
+    cmd.Write(VertexBufferHandle(upload->handle));
+    cmd.Write(upload->mem);
+    cmd.Write(VertexDeclHandle(upload->decl));
+    cmd.Write((u16)upload->flags);
+    break;
+  case CommandBuffer::CREATE_INDEX_BUFFER:
+    cmd.Write(IndexBufferHandle(upload->handle));
+    cmd.Write(upload->mem);
+    cmd.Write((u16)upload->flags);
+    break;
+  }
+  SpinLockGuard stats_lock(&_stats_lock);
+  ++_upload_stats.num_unqueued;
+  return 0;
+}
+
+void GraphicsRenderer::RequireUpload(u32 ticket) {
+  if (!IsUploaded(ticket)) _upload_required = max(_upload_required, ticket);
+}
+
+void GraphicsRenderer::ExecUploads() {
+  u32 num_uploads = 0;
+  u32 upload_bytes = 0;
+  tick_t start_tick = Clock::Tick();
+  while (auto upload = _upload_queue.FrontPtr()) {
+    // Later ones may need vertex decls of the next frame's cmd_pre.
+    if (upload->ticket > _render->upload_limit) break;
+    u32 size = upload->mem->size;
+    // A resource larger than the budget goes alone.
+    if (upload->ticket > _render->upload_required && num_uploads > 0 && upload_bytes + size > C3_UPLOAD_BUDGET) break;
+    if (_gi) {
+      switch (upload->cmd) {
+      case CommandBuffer::CREATE_TEXTURE:
+        _gi->CreateTexture(TextureHandle(upload->handle), upload->mem, upload->flags, upload->skip);
+        break;
+      case CommandBuffer::CREATE_VERTEX_BUFFER:
+        _gi->CreateVertexBuffer(VertexBufferHandle(upload->handle), upload->mem, VertexDeclHandle(upload->decl),
+                                (u16)upload->flags);
+        break;
+      case CommandBuffer::CREATE_INDEX_BUFFER:
+        _gi->CreateIndexBuffer(IndexBufferHandle(upload->handle), upload->mem, (u16)upload->flags);
+        break;
+      }
+    }
+    mem_free(upload->mem);
+    _uploaded.store(upload->ticket, memory_order_release);
+    _upload_queued_bytes.fetch_sub(size, memory_order_relaxed);
+    _upload_queue.PopFront();
+    ++num_uploads;
+    upload_bytes += size;
+  }
+  double upload_ms = Clock::TimespanToMillisecondsD(start_tick, Clock::Tick());
+  SpinLockGuard lock(&_stats_lock);
+  _upload_stats.num_uploads = num_uploads;
+  _upload_stats.upload_bytes = upload_bytes;
+  _upload_stats.upload_ms = upload_ms;
+  _upload_stats.total_uploads += num_uploads;
+  _upload_stats.total_bytes += upload_bytes;
+  if (num_uploads > 0) _upload_stats.total_ms += upload_ms;
+}
+
+void GraphicsRenderer::GetUploadStats(UploadStats* stats) {
+  {
+    SpinLockGuard lock(&_stats_lock);
+    *stats = _upload_stats;
+  }
+  stats->num_queued = (u32)_upload_queue.SizeGuess();
+  stats->queued_bytes = _upload_queued_bytes.load(memory_order_relaxed);
+}
+
 ConstantHandle GraphicsRenderer::CreateConstant(stringid name, ConstantType type, u16 num) {
   if (PredefinedConstant::NameToType(name) != PREDEFINED_CONSTANT_COUNT) {
     c3_log("%s is predefined uniform name.\n", name);
     return ConstantHandle();
   }
 
+  SpinLockGuard map_lock(&_map_lock);
   ConstantMap::iterator it = _constant_map.find(name);
   if (it != _constant_map.end()) {
     ConstantHandle handle = it->second;
@@ -450,7 +754,12 @@ ConstantHandle GraphicsRenderer::CreateConstant(stringid name, ConstantType type
       constant.type = old_size < new_size ? type : constant.type;
       constant.num = max(constant.num, num);
 
-      _gi->CreateConstant(handle, constant.type, constant.num, name);
+      SpinLockGuard lock(&_cmd_lock);
+      auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_CONSTANT);
+      cmd.Write(handle);
+      cmd.Write(constant.type);
+      cmd.Write(constant.num);
+      cmd.Write(name);
     }
 
     ++constant.ref_count;
@@ -470,13 +779,19 @@ ConstantHandle GraphicsRenderer::CreateConstant(stringid name, ConstantType type
 
     _constant_map.insert(make_pair(name, handle));
 
-    _gi->CreateConstant(handle, type, num, name);
+    SpinLockGuard lock(&_cmd_lock);
+    auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_CONSTANT);
+    cmd.Write(handle);
+    cmd.Write(type);
+    cmd.Write(num);
+    cmd.Write(name);
   }
 
   return handle;
 }
 
 void GraphicsRenderer::DestroyConstant(ConstantHandle handle) {
+  SpinLockGuard map_lock(&_map_lock);
   ConstantRef& constant = _constant_ref[handle.idx];
   i16 refs = --constant.ref_count;
 
@@ -488,8 +803,9 @@ void GraphicsRenderer::DestroyConstant(ConstantHandle handle) {
       }
     }
 
-    _gi->DestroyConstant(handle);
-    _constant_handles.Free(handle);
+    SpinLockGuard lock(&_cmd_lock);
+    GetCommandBuffer(CommandBuffer::DESTROY_CONSTANT).Write(handle);
+    _submit->Free(handle);
   }
 }
 
@@ -510,7 +826,11 @@ FrameBufferHandle GraphicsRenderer::CreateFrameBuffer(u8 num, TextureHandle* han
       TextureIncRef(th);
     }
 
-    _gi->CreateFrameBuffer(handle, num, handles);
+    SpinLockGuard lock(&_cmd_lock);
+    auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_FRAME_BUFFER);
+    cmd.Write(handle);
+    cmd.Write(num);
+    cmd.Write(handles, sizeof(TextureHandle) * num);
   }
 
   if (destroy_textures) {
@@ -522,8 +842,11 @@ FrameBufferHandle GraphicsRenderer::CreateFrameBuffer(u8 num, TextureHandle* han
 
 void GraphicsRenderer::DestroyFrameBuffer(FrameBufferHandle handle) {
   if (!handle) return;
-  _gi->DestroyFrameBuffer(handle);
-  _frame_buffer_handles.Free(handle);
+  {
+    SpinLockGuard lock(&_cmd_lock);
+    GetCommandBuffer(CommandBuffer::DESTROY_FRAME_BUFFER).Write(handle);
+    _submit->Free(handle);
+  }
   FrameBufferRef& ref = _frame_buffer_ref[handle.idx];
   if (!ref.window) {
     for (u32 ii = 0; ii < ARRAY_SIZE(ref.th); ++ii) {
@@ -537,7 +860,11 @@ void GraphicsRenderer::ResizeTexture(TextureHandle handle, u16 width, u16 height
   const TextureRef& texture_ref = _texture_ref[handle.idx];
   get_texture_size_from_ratio((BackbufferRatio)texture_ref.bb_ratio, width, height);
 
-  _gi->ResizeTexture(handle, width, height);
+  SpinLockGuard lock(&_cmd_lock);
+  auto& cmd = GetCommandBuffer(CommandBuffer::RESIZE_TEXTURE);
+  cmd.Write(handle);
+  cmd.Write(width);
+  cmd.Write(height);
 }
 
 void GraphicsRenderer::UpdateTexture2D(TextureHandle handle, u8 mip, u16 x, u16 y, u16 width, u16 height, const MemoryRegion* mem, u16 pitch) {
@@ -549,25 +876,32 @@ void GraphicsRenderer::UpdateTexture2D(TextureHandle handle, u8 mip, u16 x, u16
     rect.y = y;
     rect.width = width;
     rect.height = height;
-    _gi->UpdateTexture(handle, 8, mip, rect, 0, 1, pitch, mem);
+    SpinLockGuard lock(&_cmd_lock);
+    auto& cmd = GetCommandBuffer(CommandBuffer::UPDATE_TEXTURE);
+    cmd.Write(handle);
+    cmd.Write(mip);
+    cmd.Write(rect);
+    cmd.Write(pitch);
+    cmd.Write(mem);
   }
 }
 
 u16 GraphicsRenderer::SetTransform(const float4x4* mtx, u16 num) {
-  return _frame->SetTransform(mtx, num);
+  return _submit->encoders[0].SetTransform(mtx, num);
 }
 
 void GraphicsRenderer::SetTransform(u16 cache, u16 num) {
-  _frame->SetTransform(cache, num);
+  _submit->encoders[0].SetTransform(cache, num);
 }
 
 const InstanceDataBuffer* GraphicsRenderer::AllocInstanceDataBuffer(u32 num, u16 stride) {
-  TransientVertexBuffer& dvb = *_frame->transient_vb;
+  TransientVertexBuffer& dvb = *_submit->transient_vb;
 
   u32 out_num = num;
-  u32 offset = _frame->AllocTransientVertexBuffer(out_num, stride);
+  u32 offset = _submit->AllocTransientVertexBuffer(out_num, stride);
   if (out_num != num) c3_log("[C3] Failed to allocate instance data buffer: num=%d stride=%hd.\n", num, stride);
-  InstanceDataBuffer* idb = (InstanceDataBuffer*)C3_ALLOC(g_allocator, sizeof(InstanceDataBuffer));
+  // Released with the frame arena.
+  InstanceDataBuffer* idb = frame_alloc_array<InstanceDataBuffer>(1);
   idb->data = &dvb.data[offset];
   idb->size = num * stride;
   idb->offset = offset;
@@ -578,52 +912,51 @@ const InstanceDataBuffer* GraphicsRenderer::AllocInstanceDataBuffer(u32 num, u16
 }
 
 bool GraphicsRenderer::CheckAvailInstanceDataBuffer(u32 num, u16 stride) {
-  return _frame->CheckAvailTransientVertexBuffer(num, stride);
+  return _submit->CheckAvailTransientVertexBuffer(num, stride);
+}
+
+void GraphicsRenderer::SetInstanceDataBuffer(const InstanceDataBuffer* idb, u32 num) {
+  _submit->encoders[0].SetInstanceDataBuffer(idb, num);
+}
+
+void GraphicsRenderer::SetInstanceDataBuffer(VertexBufferHandle handle, u32 start_vertex, u32 num, u16 stride) {
+  _submit->encoders[0].SetInstanceDataBuffer(handle, start_vertex, num, stride);
 }
 
 u16 GraphicsRenderer::AllocTransform(float4x4*& mtx_out, u16& num_in_out) {
-  return _frame->AllocTransform(mtx_out, num_in_out);
+  return _submit->encoders[0].AllocTransform(mtx_out, num_in_out);
 }
 
 void GraphicsRenderer::SetVertexBuffer(VertexBufferHandle handle, u32 start, u32 num) {
-  _frame->SetVertexBuffer(handle, start, num);
+  _submit->encoders[0].SetVertexBuffer(handle, start, num);
 }
 
 void GraphicsRenderer::SetVertexBuffer(const TransientVertexBuffer* tvb, u32 start_vertex, u32 num_vertices) {
-  _frame->SetVertexBuffer(tvb, start_vertex, num_vertices);
+  _submit->encoders[0].SetVertexBuffer(tvb, start_vertex, num_vertices);
 }
 
 void GraphicsRenderer::SetIndexBuffer(IndexBufferHandle handle, u32 start, u32 num) {
-  _frame->SetIndexBuffer(handle, start, num);
+  _submit->encoders[0].SetIndexBuffer(handle, start, num);
 }
 
 void GraphicsRenderer::SetIndexBuffer(const TransientIndexBuffer* tib, u32 first_index, u32 num_indices) {
-  _frame->SetIndexBuffer(tib, first_index, num_indices);
+  _submit->encoders[0].SetIndexBuffer(tib, first_index, num_indices);
 }
 
 void GraphicsRenderer::SetScissor(i16 x, i16 y, i16 width, i16 height) {
-  _frame->SetScissor(x, y, width, height);
+  _submit->encoders[0].SetScissor(x, y, width, height);
 }
 
 void GraphicsRenderer::SetConstant(ConstantHandle handle, const void* value, u16 num) {
-  if (!handle) return;
-  ConstantRef& constant = _constant_ref[handle.idx];
-  _frame->SetConstant(handle, constant.type, value, min(num, constant.num));
+  _submit->encoders[0].SetConstant(handle, value, num);
 }
 
 void GraphicsRenderer::SetTexture(u8 unit, FrameBufferHandle handle, int idx, u32 flags) {
-  TextureHandle texture_handle;
-  if (handle) {
-    const FrameBufferRef& ref = _frame_buffer_ref[handle.idx];
-    c3_assert_return(!ref.window && "Can't sample window frame buffer.");
-    texture_handle = ref.th[idx];
-    c3_assert_return(texture_handle && "Frame buffer texture is invalid.");
-  }
-  _frame->SetTexture(unit, texture_handle, flags);
+  _submit->encoders[0].SetTexture(unit, handle, idx, flags);
 }
 
 void GraphicsRenderer::SetTexture(u8 unit, TextureHandle handle, u32 flags) {
-  _frame->SetTexture(unit, handle, flags);
+  _submit->encoders[0].SetTexture(unit, handle, flags);
 }
 
 void GraphicsRenderer::SetViewRect(u8 view, u16 x, u16 y, u16 width, u16 height) {
@@ -697,7 +1030,12 @@ void GraphicsRenderer::SetViewRemap(u8 start_view, u8 num, u8* remap) {
 }
 
 void GraphicsRenderer::SetViewName(u8 view, const char* name) {
-  _gi->UpdateViewName(view, name);
+  u16 len = (u16)min<size_t>(strlen(name), C3_MAX_VIEW_NAME - C3_VIEW_NAME_RESERVED - 1);
+  SpinLockGuard lock(&_cmd_lock);
+  auto& cmd = GetCommandBuffer(CommandBuffer::UPDATE_VIEW_NAME);
+  cmd.Write(view);
+  cmd.Write(len);
+  cmd.Write(name, len);
 }
 
 void GraphicsRenderer::SetPaletteColor(u8 index, u32 rgba) {
@@ -730,71 +1068,425 @@ void GraphicsRenderer::SetPaletteColor(u8 index, const Color& color) {
 }
 
 void GraphicsRenderer::SetState(u64 state, u32 rgba) {
-  _frame->SetState(state, rgba);
+  _submit->encoders[0].SetState(state, rgba);
 }
 
 void GraphicsRenderer::SetMarker(const char* marker) {
-  _frame->SetMarker(marker);
+  _submit->encoders[0].SetMarker(marker);
 }
 
 void GraphicsRenderer::Submit(u8 view, ProgramHandle program, i32 tag) {
-  _frame->Submit(view, program, tag);
+  _submit->encoders[0].Submit(view, program, tag);
 }
 
 void GraphicsRenderer::Discard() {
-  _frame->Discard();
+  _submit->encoders[0].Discard();
+}
+
+void GraphicsRenderer::GetStats(GraphicsStats* stats) {
+  SpinLockGuard lock(&_stats_lock);
+  *stats = _stats;
+}
+
+void GraphicsRenderer::GetFrameRingStats(FrameRingStats* stats) {
+  _frame_ring.GetStats(stats);
+}
+
+DrawEncoder* GraphicsRenderer::GetThreadEncoder() {
+  int index = mem_thread_index();
+  c3_assert_return_x(index >= 0 && index + 1 < C3_MAX_DRAW_ENCODERS, nullptr);
+  return _submit->encoders + index + 1;
 }
 
 void GraphicsRenderer::Frame() {
+  // _render is built into again below, render thread must be done with it.
+  RenderWait();
   FrameNoRenderWait();
+  frame_mem_next_frame();
+  mem_tracking_next_frame();
 }
 
+// Runs on the render thread, or inside Frame() without one.
 i32 GraphicsRenderer::RenderOneFrame() {
-  if (_gi) _gi->Flip();
-  //auto start_time = get_timestamp();
-  _gi->Submit(_frame, _clear_quad);
-  /*
-  auto elapsed_msecs = (get_timestamp() - start_time) * 1000.0;
-  if (elapsed_msecs >= 17.0) {
-  c3_log("[WARN] Time budget exceeds: %.3lf ms.\n", elapsed_msecs);
+  ExecCommands(_render->cmd_pre);
+  ExecUploads();
+  if (_gi) {
+    _gi->Flip();
+    WaitSort();
+    //auto start_time = get_timestamp();
+    _gi->Submit(_render, _clear_quad);
+    /*
+    auto elapsed_msecs = (get_timestamp() - start_time) * 1000.0;
+    if (elapsed_msecs >= 17.0) {
+    c3_log("[WARN] Time budget exceeds: %.3lf ms.\n", elapsed_msecs);
+    }
+    */
+    SpinLockGuard lock(&_stats_lock);
+    _stats = _gi->GetFrameStats();
+  }
+  WaitSort();
+  ExecCommands(_render->cmd_post);
+  return _exit ? 0 : 1;
+}
+
+i32 GraphicsRenderer::RenderThreadEntry(void* user_data) {
+  auto GR = (GraphicsRenderer*)user_data;
+  for (;;) {
+    GR->_render_sem.Wait();
+    i32 result = GR->RenderOneFrame();
+    GR->_game_sem.Post();
+    if (result == 0) break;
+  }
+  return 0;
+}
+
+void GraphicsRenderer::RenderWait() {
+  if (!_render_pending) return;
+  _game_sem.Wait();
+  _render_pending = false;
+  // The job posted _sort_sem before it returned.
+  if (_sort_label) {
+    JobScheduler::Instance()->WaitAndFreeJobs(_sort_label);
+    _sort_label = nullptr;
   }
-  */
-  return 1;
+}
+
+void GraphicsRenderer::SortJob(void* arg) {
+  auto GR = (GraphicsRenderer*)arg;
+  GR->_render->SortKeys(true);
+  GR->_sort_sem.Post();
+}
+
+void GraphicsRenderer::WaitSort() {
+  if (!_sort_pending) return;
+  _sort_sem.Wait();
+  _sort_pending = false;
 }
 
 void GraphicsRenderer::Swap() {
-  _frame->resolution = _resolution;
-  memcpy(_frame->view_remap, _view_remap, sizeof(_view_remap));
-  memcpy(_frame->fb, _fb, sizeof(_fb));
-  memcpy(_frame->view_clear, _view_clear, sizeof(_view_clear));
-  memcpy(_frame->rect, _rect, sizeof(_rect));
-  memcpy(_frame->scissor, _scissor, sizeof(_scissor));
-  memcpy(_frame->_view, _view, sizeof(_view));
-  memcpy(_frame->proj, _proj, sizeof(_proj));
-  memcpy(_frame->view_flags, _view_flags, sizeof(_view_flags));
+  _submit->resolution = _resolution;
+  memcpy(_submit->view_remap, _view_remap, sizeof(_view_remap));
+  memcpy(_submit->fb, _fb, sizeof(_fb));
+  memcpy(_submit->view_clear, _view_clear, sizeof(_view_clear));
+  memcpy(_submit->rect, _rect, sizeof(_rect));
+  memcpy(_submit->scissor, _scissor, sizeof(_scissor));
+  memcpy(_submit->_view, _view, sizeof(_view));
+  memcpy(_submit->proj, _proj, sizeof(_proj));
+  memcpy(_submit->view_flags, _view_flags, sizeof(_view_flags));
   if (_color_palette_dirty > 0) {
     --_color_palette_dirty;
-    memcpy(_frame->color_palette, _color_palette, sizeof(_color_palette));
+    memcpy(_submit->color_palette, _color_palette, sizeof(_color_palette));
   }
-  _frame->Finish();
-  
+  {
+    SpinLockGuard lock(&_cmd_lock);
+    _submit->Finish();
+    _submit->upload_limit = _upload_ticket;
+    _submit->upload_required = _upload_required;
+    swap(_submit, _render);
+    // Handles destroyed while building this frame are done on the render side.
+    FreeAllHandles(_submit);
+    _submit->ResetFreeHandles();
+    _submit->Start();
+  }
+  _last_frame_draws = _render->render_item_count;
   ++_frame_counter;
-  RenderOneFrame();
+  // Render thread is not a job and can not use ParallelFor, a job sorts big
+  // frames while it runs uploads and Flip, Submit waits for it. Smaller ones,
+  // and all without a render thread, are sorted by Submit.
+  if (C3_PARALLEL_SORT_MIN_ITEMS > 0 && _render->render_item_count >= C3_PARALLEL_SORT_MIN_ITEMS &&
+      _render_thread.IsRunning() && JobScheduler::Instance() && JobScheduler::Instance()->GetNumWorkers() > 1) {
+    Job job;
+    job.InitWorkerJob(&GraphicsRenderer::SortJob, this, FIBER_STACK_LARGE);
+    _sort_label = JobScheduler::Instance()->SubmitJobs(&job, 1);
+    _sort_pending = true;
+  }
 
-  _frame->Start();
   memset(_fb, 0xff, sizeof(_fb));
-  memset(_seq, 0, sizeof(_seq));
+  for (auto& seq : _seq) seq.store(0, memory_order_relaxed);
   memset(_seq_enabled, 0, sizeof(_seq_enabled));
   _num_views = 0;
   _current_view = 0;
   memset(_view_clear, 0, sizeof(_view_clear));
   for (u8 i = 0; i < C3_MAX_VIEWS; ++i) _view_remap[i] = i;
-  FreeAllHandles(_frame);
-  _frame->ResetFreeHandles();
 }
 
 void GraphicsRenderer::FrameNoRenderWait() {
   Swap();
+  if (_render_thread.IsRunning()) {
+    _render_pending = true;
+    _render_sem.Post();
+  } else {
+    RenderOneFrame();
+  }
+}
+
+CommandBuffer& GraphicsRenderer::GetCommandBuffer(CommandBuffer::CommandType cmd) {
+  CommandBuffer& cmd_buffer = cmd < CommandBuffer::END ? _submit->cmd_pre : _submit->cmd_post;
+  cmd_buffer.Write((u8)cmd);
+  return cmd_buffer;
+}
+
+void GraphicsRenderer::ExecCommands(CommandBuffer& cmd_buffer) {
+  cmd_buffer.Reset();
+  for (;;) {
+    u8 cmd;
+    cmd_buffer.Read(cmd);
+    switch (cmd) {
+      case CommandBuffer::RENDERER_INIT: {
+        GraphicsAPI api;
+        cmd_buffer.Read(api);
+        _ok = GraphicsInterface::CreateInstances(api, 11, 0, false);
+        if (_ok) {
+          _gi = GraphicsInterface::Instance();
+          _gi->Init();
+        }
+        break;
+      }
+      case CommandBuffer::RENDERER_SHUTDOWN_BEGIN:
+        // Resources destroyed by the game this frame go in RENDERER_SHUTDOWN_END's cmd_post.
+        break;
+      case CommandBuffer::RENDERER_SHUTDOWN_END:
+        if (_gi) {
+          _gi->Shutdown();
+          GraphicsInterface::ReleaseInstances();
+          _gi = nullptr;
+        }
+        _exit = true;
+        break;
+      case CommandBuffer::CREATE_VERTEX_DECL: {
+        VertexDeclHandle handle;
+        VertexDecl decl;
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(decl);
+        if (_gi) _gi->CreateVertexDecl(handle, decl);
+        break;
+      }
+      case CommandBuffer::DESTROY_VERTEX_DECL: {
+        VertexDeclHandle handle;
+        cmd_buffer.Read(handle);
+        if (_gi) _gi->DestroyVertexDecl(handle);
+        break;
+      }
+      case CommandBuffer::CREATE_INDEX_BUFFER: {
+        IndexBufferHandle handle;
+        const MemoryRegion* mem;
+        u16 flags;
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(mem);
+        cmd_buffer.Read(flags);
+        if (_gi) _gi->CreateIndexBuffer(handle, mem, flags);
+        mem_free(mem);
+        break;
+      }
+      case CommandBuffer::DESTROY_INDEX_BUFFER:
+      case CommandBuffer::DESTROY_DYNAMIC_INDEX_BUFFER: {
+        IndexBufferHandle handle;
+        cmd_buffer.Read(handle);
+        if (_gi) _gi->DestroyIndexBuffer(handle);
+        break;
+      }
+      case CommandBuffer::CREATE_VERTEX_BUFFER: {
+        VertexBufferHandle handle;
+        const MemoryRegion* mem;
+        VertexDeclHandle decl_handle;
+        u16 flags;
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(mem);
+        cmd_buffer.Read(decl_handle);
+        cmd_buffer.Read(flags);
+        if (_gi) _gi->CreateVertexBuffer(handle, mem, decl_handle, flags);
+        mem_free(mem);
+        break;
+      }
+      case CommandBuffer::DESTROY_VERTEX_BUFFER:
+      case CommandBuffer::DESTROY_DYNAMIC_VERTEX_BUFFER: {
+        VertexBufferHandle handle;
+        cmd_buffer.Read(handle);
+        if (_gi) _gi->DestroyVertexBuffer(handle);
+        break;
+      }
+      case CommandBuffer::CREATE_DYNAMIC_INDEX_BUFFER: {
+        IndexBufferHandle handle;
+        u32 size;
+        u16 flags;
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(size);
+        cmd_buffer.Read(flags);
+        if (_gi) _gi->CreateDynamicIndexBuffer(handle, size, flags);
+        break;
+      }
+      case CommandBuffer::UPDATE_DYNAMIC_INDEX_BUFFER: {
+        IndexBufferHandle handle;
+        u32 offset, size;
+        const MemoryRegion* mem;
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(offset);
+        cmd_buffer.Read(size);
+        cmd_buffer.Read(mem);
+        if (_gi) _gi->UpdateDynamicIndexBuffer(handle, offset, size, mem);
+        mem_free(mem);
+        break;
+      }
+      case CommandBuffer::CREATE_DYNAMIC_VERTEX_BUFFER: {
+        VertexBufferHandle handle;
+        u32 size;
+        u16 flags;
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(size);
+        cmd_buffer.Read(flags);
+        if (_gi) _gi->CreateDynamicVertexBuffer(handle, size, flags);
+        break;
+      }
+      case CommandBuffer::UPDATE_DYNAMIC_VERTEX_BUFFER: {
+        VertexBufferHandle handle;
+        u32 offset, size;
+        const MemoryRegion* mem;
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(offset);
+        cmd_buffer.Read(size);
+        cmd_buffer.Read(mem);
+        if (_gi) _gi->UpdateDynamicVertexBuffer(handle, offset, size, mem);
+        mem_free(mem);
+        break;
+      }
+      case CommandBuffer::CREATE_SHADER: {
+        ShaderHandle handle;
+        const MemoryRegion* mem;
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(mem);
+        if (_gi) _gi->CreateShader(handle, mem);
+        mem_free(mem);
+        break;
+      }
+      case CommandBuffer::DESTROY_SHADER: {
+        ShaderHandle handle;
+        cmd_buffer.Read(handle);
+        if (_gi) _gi->DestroyShader(handle);
+        break;
+      }
+      case CommandBuffer::CREATE_PROGRAM: {
+        ProgramHandle handle;
+        ShaderHandle vsh, fsh;
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(vsh);
+        cmd_buffer.Read(fsh);
+        if (_gi) _gi->CreateProgram(handle, vsh, fsh);
+        break;
+      }
+      case CommandBuffer::DESTROY_PROGRAM: {
+        ProgramHandle handle;
+        cmd_buffer.Read(handle);
+        if (_gi) _gi->DestroyProgram(handle);
+        break;
+      }
+      case CommandBuffer::CREATE_TEXTURE: {
+        TextureHandle handle;
+        const MemoryRegion* mem;
+        u32 flags;
+        u8 skip;
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(mem);
+        cmd_buffer.Read(flags);
+        cmd_buffer.Read(skip);
+        if (_gi) _gi->CreateTexture(handle, mem, flags, skip);
+        // CreateTexture2D wraps its pixels in a TextureCreate chunk.
+        BlobReader blob(mem->data, mem->size);
+        u32 magic;
+        blob.Read(magic);
+        if (magic == C3_CHUNK_MAGIC_TEX) {
+          TextureCreate tc;
+          blob.Read(tc);
+          if (tc.mem) mem_free(tc.mem);
+        }
+        mem_free(mem);
+        break;
+      }
+      case CommandBuffer::UPDATE_TEXTURE: {
+        TextureHandle handle;
+        u8 mip;
+        TextureRect rect;
+        u16 pitch;
+        const MemoryRegion* mem;
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(mip);
+        cmd_buffer.Read(rect);
+        cmd_buffer.Read(pitch);
+        cmd_buffer.Read(mem);
+        if (_gi) {
+          _gi->UpdateTextureBegin(handle, 0, mip);
+          _gi->UpdateTexture(handle, 0, mip, rect, 0, 1, pitch, mem);
+          _gi->UpdateTextureEnd();
+        }
+        mem_free(mem);
+        break;
+      }
+      case CommandBuffer::RESIZE_TEXTURE: {
+        TextureHandle handle;
+        u16 width, height;
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(width);
+        cmd_buffer.Read(height);
+        if (_gi) _gi->ResizeTexture(handle, width, height);
+        break;
+      }
+      case CommandBuffer::DESTROY_TEXTURE: {
+        TextureHandle handle;
+        cmd_buffer.Read(handle);
+        if (_gi) _gi->DestroyTexture(handle);
+        break;
+      }
+      case CommandBuffer::CREATE_FRAME_BUFFER: {
+        FrameBufferHandle handle;
+        u8 num;
+        TextureHandle texture_handles[ATTACHMENT_POINT_COUNT];
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(num);
+        cmd_buffer.Read(texture_handles, sizeof(TextureHandle) * num);
+        if (_gi) _gi->CreateFrameBuffer(handle, num, texture_handles);
+        break;
+      }
+      case CommandBuffer::DESTROY_FRAME_BUFFER: {
+        FrameBufferHandle handle;
+        cmd_buffer.Read(handle);
+        if (_gi) _gi->DestroyFrameBuffer(handle);
+        break;
+      }
+      case CommandBuffer::CREATE_CONSTANT: {
+        ConstantHandle handle;
+        ConstantType type;
+        u16 num;
+        stringid name;
+        cmd_buffer.Read(handle);
+        cmd_buffer.Read(type);
+        cmd_buffer.Read(num);
+        cmd_buffer.Read(name);
+        if (_gi) _gi->CreateConstant(handle, type, num, name);
+        break;
+      }
+      case CommandBuffer::DESTROY_CONSTANT: {
+        ConstantHandle handle;
+        cmd_buffer.Read(handle);
+        if (_gi) _gi->DestroyConstant(handle);
+        break;
+      }
+      case CommandBuffer::UPDATE_VIEW_NAME: {
+        u8 view;
+        u16 len;
+        char name[C3_MAX_VIEW_NAME];
+        cmd_buffer.Read(view);
+        cmd_buffer.Read(len);
+        cmd_buffer.Read(name, len);
+        name[len] = '\0';
+        if (_gi) _gi->UpdateViewName(view, name);
+        break;
+      }
+      case CommandBuffer::END:
+        return;
+      default:
+        c3_assert(!"Unknown render command.");
+        return;
+    }
+  }
 }
 
 void GraphicsRenderer::TextureIncRef(TextureHandle handle) {
@@ -804,7 +1496,12 @@ void GraphicsRenderer::TextureIncRef(TextureHandle handle) {
 void GraphicsRenderer::TextureDecRef(TextureHandle handle) {
   TextureRef& ref = _texture_ref[handle.idx];
   i16 refs = --ref.ref_count;
-  if (refs == 0) _texture_handles.Free(handle);
+  if (refs == 0) {
+    SpinLockGuard lock(&_cmd_lock);
+    RequireUpload(ref.upload);
+    GetCommandBuffer(CommandBuffer::DESTROY_TEXTURE).Write(handle);
+    _submit->Free(handle);
+  }
 }
 
 void GraphicsRenderer::TextureOwn(TextureHandle handle) {
@@ -823,8 +1520,9 @@ void GraphicsRenderer::ShaderDecRef(ShaderHandle handle) {
   ShaderRef& ref = _shader_ref[handle.idx];
   i16 refs = --ref.ref_count;
   if (refs == 0) {
-    _gi->DestroyShader(handle);
-    _shader_handles.Free(handle);
+    SpinLockGuard lock(&_cmd_lock);
+    GetCommandBuffer(CommandBuffer::DESTROY_SHADER).Write(handle);
+    _submit->Free(handle);
   }
 }
 
@@ -841,25 +1539,42 @@ VertexDeclHandle GraphicsRenderer::FindVertexDecl(const VertexDecl& decl) {
 
   if (!decl_handle) {
     decl_handle = _vertex_decl_handles.Alloc();
-    _gi->CreateVertexDecl(decl_handle, decl);
+    SpinLockGuard lock(&_cmd_lock);
+    auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_VERTEX_DECL);
+    cmd.Write(decl_handle);
+    cmd.Write(decl);
   }
 
   return decl_handle;
 }
 
 void GraphicsRenderer::FreeAllHandles(RenderFrame* frame) {
+  for (u16 i = 0; i < frame->num_free_index_buffer_handles; ++i) _index_buffer_handles.Free(frame->free_index_buffer_handle[i]);
+  for (u16 i = 0; i < frame->num_free_vertex_decl_handles; ++i) _vertex_decl_handles.Free(frame->free_vertex_decl_handle[i]);
+  for (u16 i = 0; i < frame->num_free_vertex_buffer_handles; ++i) _vertex_buffer_handles.Free(frame->free_vertex_buffer_handle[i]);
+  for (u16 i = 0; i < frame->num_free_shader_handles; ++i) _shader_handles.Free(frame->free_shader_handle[i]);
+  for (u16 i = 0; i < frame->num_free_program_handles; ++i) _program_handles.Free(frame->free_program_handle[i]);
+  for (u16 i = 0; i < frame->num_free_texture_handles; ++i) _texture_handles.Free(frame->free_texture_handle[i]);
+  for (u16 i = 0; i < frame->num_free_frame_buffer_handles; ++i) _frame_buffer_handles.Free(frame->free_frame_buffer_handle[i]);
+  for (u16 i = 0; i < frame->num_free_constant_handles; ++i) _constant_handles.Free(frame->free_constant_handle[i]);
 }
 
-TransientIndexBuffer* GraphicsRenderer::CreateTransientIndexBuffer(u32 size) {
+TransientIndexBuffer* GraphicsRenderer::CreateTransientIndexBuffer(u32 size, u8* data) {
   TransientIndexBuffer* tib = nullptr;
 
   IndexBufferHandle handle = _index_buffer_handles.Alloc();
   if (!handle) c3_log("Failed to allocate transient index buffer handle.\n");
   else {
-    _gi->CreateDynamicIndexBuffer(handle, size, C3_BUFFER_NONE);
+    {
+      SpinLockGuard lock(&_cmd_lock);
+      auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_DYNAMIC_INDEX_BUFFER);
+      cmd.Write(handle);
+      cmd.Write(size);
+      cmd.Write((u16)C3_BUFFER_NONE);
+    }
 
-    tib = (TransientIndexBuffer*)C3_ALLOC(g_allocator, sizeof(TransientIndexBuffer) + size);
-    tib->data = (u8*)&tib[1];
+    tib = (TransientIndexBuffer*)C3_ALLOC(mem_allocator(MEMORY_TAG_GRAPHICS), sizeof(TransientIndexBuffer) + (data ? 0 : size));
+    tib->data = data ? data : (u8*)&tib[1];
     tib->size = size;
     tib->handle = handle;
   }
@@ -868,12 +1583,15 @@ TransientIndexBuffer* GraphicsRenderer::CreateTransientIndexBuffer(u32 size) {
 }
 
 void GraphicsRenderer::DestroyTransientIndexBuffer(TransientIndexBuffer* tib) {
-  _gi->DestroyIndexBuffer(tib->handle);
-  _index_buffer_handles.Free(tib->handle);
-  C3_FREE(g_allocator, tib);
+  {
+    SpinLockGuard lock(&_cmd_lock);
+    GetCommandBuffer(CommandBuffer::DESTROY_INDEX_BUFFER).Write(tib->handle);
+    _submit->Free(tib->handle);
+  }
+  C3_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), tib);
 }
 
-TransientVertexBuffer* GraphicsRenderer::CreateTransientVertexBuffer(u32 size, const VertexDecl* decl) {
+TransientVertexBuffer* GraphicsRenderer::CreateTransientVertexBuffer(u32 size, const VertexDecl* decl, u8* data) {
   TransientVertexBuffer* tvb = NULL;
 
   VertexBufferHandle handle = _vertex_buffer_handles.Alloc();
@@ -890,10 +1608,16 @@ TransientVertexBuffer* GraphicsRenderer::CreateTransientVertexBuffer(u32 size, c
       stride = decl->stride;
     }
 
-    _gi->CreateDynamicVertexBuffer(handle, size, C3_BUFFER_NONE);
+    {
+      SpinLockGuard lock(&_cmd_lock);
+      auto& cmd = GetCommandBuffer(CommandBuffer::CREATE_DYNAMIC_VERTEX_BUFFER);
+      cmd.Write(handle);
+      cmd.Write(size);
+      cmd.Write((u16)C3_BUFFER_NONE);
+    }
 
-    tvb = (TransientVertexBuffer*)C3_ALLOC(g_allocator, sizeof(TransientVertexBuffer) + size);
-    tvb->data = (u8*)&tvb[1];
+    tvb = (TransientVertexBuffer*)C3_ALLOC(mem_allocator(MEMORY_TAG_GRAPHICS), sizeof(TransientVertexBuffer) + (data ? 0 : size));
+    tvb->data = data ? data : (u8*)&tvb[1];
     tvb->size = size;
     tvb->start_vertex = 0;
     tvb->stride = stride;
@@ -905,9 +1629,12 @@ TransientVertexBuffer* GraphicsRenderer::CreateTransientVertexBuffer(u32 size, c
 }
 
 void GraphicsRenderer::DestroyTransientVertexBuffer(TransientVertexBuffer* tvb) {
-  _gi->DestroyVertexBuffer(tvb->handle);
-  _vertex_buffer_handles.Free(tvb->handle);
-  C3_FREE(g_allocator, tvb);
+  {
+    SpinLockGuard lock(&_cmd_lock);
+    GetCommandBuffer(CommandBuffer::DESTROY_VERTEX_BUFFER).Write(tvb->handle);
+    _submit->Free(tvb->handle);
+  }
+  C3_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), tvb);
 }
 
 void calc_texture_size(TextureInfo& info_out, u16 width_, u16 height_, u16 depth_, bool cube_map, u8 num_mips, TextureFormat format) {
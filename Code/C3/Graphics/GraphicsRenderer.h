@@ -1,5 +1,6 @@
 #pragma once
 #include "Platform/C3Platform.h"
+#include "Data/MPSCQueue.h"
 #include "RenderKey.h"
 #include "RenderFrame.h"
 #include "Pattern/Handle.h"
@@ -90,25 +91,29 @@ struct TextureCreate {
 struct ShaderRef {
   ConstantHandle* constants;
   u32 hash;
-  i16 ref_count;
+  atomic<i16> ref_count;   // released by loader jobs concurrently, destroyed by the one reaching 0.
   u16 num_constants;
   bool owned;
+  bool instanced;       // vertex shader takes the model matrix from i_data0-3.
 };
 
 struct ProgramRef {
   ShaderHandle vsh;
   ShaderHandle fsh;
-  i16 ref_count;
+  i16 ref_count;        // under _map_lock.
+  bool instanced;
+  ProgramHandle instanced_program;  // variant batched draws are drawn with, holds a reference.
 };
 
 struct ConstantRef {
   ConstantType type;
   u16 num;
-  i16 ref_count;
+  i16 ref_count;        // under _map_lock.
 };
 
 struct TextureRef {
-  i16 ref_count;
+  u32 upload;           // upload queue ticket, 0 if created by a command.
+  atomic<i16> ref_count;   // released by loader jobs concurrently, destroyed by the one reaching 0.
   u8 bb_ratio;
   u8 format;
   bool owned;
@@ -140,16 +145,57 @@ struct VertexDeclRef {
 };
 
 struct VertexBuffer {
+  u32 upload;
   u32 size;
   u16 stride;
   u16 flags;
 };
 
 struct IndexBuffer {
+  u32 upload;
   u32 size;
   u16 flags;
 };
 
+// Resource creation waiting in the upload queue, see GraphicsRenderer::UploadTexture.
+struct PendingUpload {
+  u32 ticket;
+  u32 handle;               // raw handle of the cmd's type.
+  u32 flags;
+  u32 decl;                 // raw VertexDeclHandle of vertex buffers.
+  u8 cmd;                   // CommandBuffer::CREATE_TEXTURE, CREATE_VERTEX_BUFFER or CREATE_INDEX_BUFFER.
+  u8 skip;
+  const MemoryRegion* mem;
+};
+
+struct UploadStats {
+  u32 num_queued;           // waiting for the render thread.
+  u32 queued_bytes;
+  u32 num_uploads;          // last frame.
+  u32 upload_bytes;         // last frame.
+  double upload_ms;         // last frame.
+  u64 total_uploads;
+  u64 total_bytes;
+  double total_ms;          // render thread time spent creating them.
+  u32 num_unqueued;         // queue was full, created by a command outside the budget.
+};
+
+/*
+* GraphicsRenderer is the game side of the renderer. Draws are recorded into
+* the RenderFrame being built (_submit), resource create/update/destroy calls
+* are recorded into its cmd_pre/cmd_post CommandBuffers. Frame() hands that
+* frame to the render thread, which owns the GraphicsInterface, and the game
+* carries on building the next frame into the other RenderFrame.
+*
+* Create/Update functions take ownership of mem, it is released once the
+* render thread consumed it. Handles are recycled after the frame which
+* destroyed them has been rendered.
+*
+* Upload* functions create asset textures and buffers through a queue
+* instead, the render thread creates at most C3_UPLOAD_BUDGET bytes of them a
+* frame. Handles are valid right away, IsUploaded tells when the resource
+* exists.
+*/
 class GraphicsRenderer {
 public:
   GraphicsRenderer();
@@ -194,6 +240,9 @@ public:
   void DestroyShader(ShaderHandle handle);
   ProgramHandle CreateProgram(ShaderHandle vsh, ShaderHandle fsh, bool destroy_shaders = true);
   void DestroyProgram(ProgramHandle handle);
+  // Draws of program merged by auto-instancing are drawn with instanced, a
+  // variant taking the model matrix from i_data0-3.
+  void SetInstancedProgram(ProgramHandle program, ProgramHandle instanced);
   TextureHandle CreateTexture(const MemoryRegion* mem, u32 flags = C3_TEXTURE_NONE, u8 skip = 0,
                               TextureInfo* info_out = nullptr,
                               BackbufferRatio ratio = BACKBUFFER_RATIO_COUNT);
@@ -206,6 +255,17 @@ public:
                        const MemoryRegion* mem, u16 pitch = UINT16_MAX);
   void ResizeTexture(TextureHandle handle, u16 width, u16 height);
   void DestroyTexture(TextureHandle handle);
+  // Upload queue of loaded resources. Like the Create functions, but the render
+  // thread creates them in a later frame, at most C3_UPLOAD_BUDGET bytes per frame
+  // so a level load does not stall rendering. ticket_out is done by IsUploaded,
+  // the handle must not be drawn before. Destroying it earlier is fine.
+  TextureHandle UploadTexture(const MemoryRegion* mem, u32 flags, u8 skip, TextureInfo* info_out, u32* ticket_out);
+  VertexBufferHandle UploadVertexBuffer(const MemoryRegion* mem, const VertexDecl& decl, u16 flags, u32* ticket_out);
+  IndexBufferHandle UploadIndexBuffer(const MemoryRegion* mem, u16 flags, u32* ticket_out);
+  // Thread safe. Ticket 0 is always done.
+  bool IsUploaded(u32 ticket) const { return ticket <= _uploaded.load(memory_order_acquire); }
+  // Thread safe. Queue depth and throughput, per frame numbers are of the last rendered frame.
+  void GetUploadStats(UploadStats* stats);
   ConstantHandle CreateConstant(stringid name, ConstantType type, u16 num = 1);
   void DestroyConstant(ConstantHandle handle);
 
@@ -216,12 +276,11 @@ public:
   u16 AllocTransform(float4x4*& mtx_out, u16& num_in_out);
   void SetTransform(u16 cache, u16 num = 1);
 
+  // Instance data lives in the frame's transient vertex buffer.
   const InstanceDataBuffer* AllocInstanceDataBuffer(u32 num, u16 stride);
   bool CheckAvailInstanceDataBuffer(u32 num, u16 stride);
-#if 0
   void SetInstanceDataBuffer(const InstanceDataBuffer* idb, u32 num = UINT32_MAX);
-  void SetInstanceDataBuffer(Handle handle, u32 start_vertex, u32 num);
-#endif
+  void SetInstanceDataBuffer(VertexBufferHandle handle, u32 start_vertex, u32 num, u16 stride);
 
   void SetVertexBuffer(const TransientVertexBuffer* tvb) { SetVertexBuffer(tvb, 0, UINT32_MAX); }
   void SetVertexBuffer(const TransientVertexBuffer* tvb, u32 start_vertex, u32 num_vertices);
@@ -259,17 +318,47 @@ public:
   void SetMarker(const char* marker);
   void Submit(u8 view, ProgramHandle program, i32 tag = 0);
   void Discard();
+  // Encoder of calling thread for the frame being built, valid until Frame().
+  // Lets job workers record draws in parallel, see DrawEncoder.
+  DrawEncoder* GetThreadEncoder();
+  // Waits for the render thread to finish the previous frame, then hands it
+  // the frame just built. Game and render thread overlap by one frame.
   void Frame();
+  // Draws merged into the last finished frame, from all encoders.
+  u32 GetNumDraws() const { return _last_frame_draws; }
+  // Thread safe. Counters of the last frame the graphics interface submitted.
+  void GetStats(GraphicsStats* stats);
+  // Game thread. Transient vertex, index and constant usage with high-water marks.
+  void GetFrameRingStats(FrameRingStats* stats);
 
   float2 GetWindowSize() const { return float2(_resolution.width, _resolution.height); }
   float GetWindowAspect() const { return float(_resolution.width) / float(_resolution.height); }
+  // Frame being built, the previous one may still be on the render thread.
+  u32 GetFrameNumber() const { return _frame_counter; }
 
 private:
   TextureHandle CreateTexture2D(BackbufferRatio ratio, u16 width, u16 height, u8 mipmap_count,
                                 TextureFormat format, u32 flags, const MemoryRegion* mem, TextureInfo* info_out);
+  // Handle and TextureRef of an image file, frees mem on failure.
+  TextureHandle AllocTexture(const MemoryRegion* mem, TextureInfo* info_out, BackbufferRatio ratio);
+  // Queues the creation, returns its ticket. Writes the create command instead
+  // when the queue is full, returns 0 then.
+  u32 PushUpload(PendingUpload* upload);
+  // Caller holds _cmd_lock. A resource with the ticket is destroyed in the frame being built.
+  void RequireUpload(u32 ticket);
+  // Render thread, creates queued resources within the budget.
+  void ExecUploads();
   i32 RenderOneFrame();
   void Swap();
   void FrameNoRenderWait();
+  void RenderWait();
+  static i32 RenderThreadEntry(void* user_data);
+  static void SortJob(void* arg);
+  // Render thread, before the frame is submitted.
+  void WaitSort();
+  // Caller holds _cmd_lock and writes the command arguments.
+  CommandBuffer& GetCommandBuffer(CommandBuffer::CommandType cmd);
+  void ExecCommands(CommandBuffer& cmd_buffer);
   void TextureIncRef(TextureHandle handle);
   void TextureDecRef(TextureHandle handle);
   void TextureOwn(TextureHandle handle);
@@ -279,16 +368,39 @@ private:
   VertexDeclHandle FindVertexDecl(const VertexDecl& decl);
   u64 AllocDynamicIndexBuffer(u32 size, u16 flags);
   void FreeAllHandles(RenderFrame* frame);
-  TransientIndexBuffer* CreateTransientIndexBuffer(u32 size);
+  // data is memory owned by the caller, e.g. a FrameRingSegment, otherwise it comes with the buffer.
+  TransientIndexBuffer* CreateTransientIndexBuffer(u32 size, u8* data = nullptr);
   void DestroyTransientIndexBuffer(TransientIndexBuffer* tib);
-  TransientVertexBuffer* CreateTransientVertexBuffer(u32 size, const VertexDecl* decl = nullptr);
+  TransientVertexBuffer* CreateTransientVertexBuffer(u32 size, const VertexDecl* decl = nullptr, u8* data = nullptr);
   void DestroyTransientVertexBuffer(TransientVertexBuffer* tvb);
 
   bool _ok;
-  GraphicsInterface* _gi;
+  GraphicsInterface* _gi;           // render thread only.
+  GraphicsAPI _api;
   Resolution _resolution;
   u32 _frame_counter;
-  RenderFrame* _frame;
+  u32 _last_frame_draws;
+  RenderFrame* _submit;             // built by game and job threads.
+  RenderFrame* _render;             // consumed by render thread.
+  Thread _render_thread;
+  Semaphore _render_sem;            // frame handed to render thread.
+  Semaphore _game_sem;              // render thread done with frame.
+  Semaphore _sort_sem;              // sort job done with _render.
+  atomic_int* _sort_label;          // game thread, sort job of _render or nullptr.
+  bool _sort_pending;               // handed with the frame to the render thread.
+  SpinLock _cmd_lock;               // loader jobs create resources concurrently.
+  SpinLock _map_lock;               // _program_map, _constant_map and their refs, taken before _cmd_lock.
+  GraphicsStats _stats;             // written by render thread after Submit.
+  SpinLock _stats_lock;
+  FrameRing _frame_ring;            // transient data of _submit and _render.
+  MPSCQueue<PendingUpload> _upload_queue;   // pushed under _cmd_lock, drained by render thread.
+  u32 _upload_ticket;               // last queued, under _cmd_lock.
+  u32 _upload_required;             // under _cmd_lock, see RenderFrame::upload_required.
+  atomic_u32 _uploaded;             // last created.
+  atomic_u32 _upload_queued_bytes;
+  UploadStats _upload_stats;        // under _stats_lock.
+  bool _render_pending;
+  bool _exit;
   ClearQuad _clear_quad;
   VertexBuffer _vertex_buffers[C3_MAX_VERTEX_BUFFERS];
   IndexBuffer _index_buffers[C3_MAX_INDEX_BUFFERS];
@@ -305,7 +417,7 @@ private:
   float4x4 _view[C3_MAX_VIEWS];
   float4x4 _proj[2][C3_MAX_VIEWS];
   u8 _view_flags[C3_MAX_VIEWS];
-  u16 _seq[C3_MAX_VIEWS];
+  atomic_u32 _seq[C3_MAX_VIEWS];
   bool _seq_enabled[C3_MAX_VIEWS];
   u8 _view_remap[C3_MAX_VIEWS];
   ViewClear _view_clear[C3_MAX_VIEWS];
@@ -328,6 +440,7 @@ private:
   u8 _color_palette_dirty;
 
   friend struct RenderFrame;
+  friend class DrawEncoder;
   friend struct ClearQuad;
   SUPPORT_SINGLETON(GraphicsRenderer);
 };
@@ -395,6 +395,35 @@ bool image_get_raw_data(const ImageContainer& image_container, u8 side_, u8 lod_
   return false;
 }
 
+u32 image_get_mip_offset(const ImageContainer& image_container, u8 lod_) {
+  const ImageBlockInfo& ibi = s_image_block_info[image_container.format];
+  const u16 block_width = ibi.block_width;
+  const u16 block_height = ibi.block_height;
+  u32 offset = image_container.offset == UINT32_MAX ? 0 : image_container.offset;
+  u16 width = image_container.width;
+  u16 height = image_container.height;
+  u16 depth = max<u16>(1, image_container.depth);
+  for (u8 lod = 0; lod < lod_ && lod < image_container.num_mips; ++lod) {
+    u32 lod_width = max(block_width * ibi.min_block_x, (width + block_width - 1) / block_width * block_width);
+    u32 lod_height = max(block_height * ibi.min_block_y, (height + block_height - 1) / block_height * block_height);
+    offset += lod_width * lod_height * depth * ibi.bits_per_pixel / 8;
+    width = max<u16>(1, width / 2);
+    height = max<u16>(1, height / 2);
+    depth = max<u16>(1, depth / 2);
+  }
+  return offset;
+}
+
+void image_dds_set_top_mip(void* data, const ImageContainer& image_container, u8 lod) {
+  // magic, size, flags, height, width, pitch, depth, mips.
+  u32* header = (u32*)data;
+  header[3] = max(1u, (u32)image_container.height >> lod);
+  header[4] = max(1u, (u32)image_container.width >> lod);
+  header[5] = 0;    // pitch
+  if (image_container.depth > 1) header[6] = max(1u, (u32)image_container.depth >> lod);
+  header[7] = image_container.num_mips - lod;
+}
+
 void image_get_rgba8_data(void* dst, const void* src, u16 width, u16 height, u32 pitch, u8 type) {
   switch (type) {
   case RGBA_8_TEXTURE_FORMAT:
@@ -2,8 +2,16 @@
 #include "ImageContainer.h"
 #include "Graphics/GraphicsTypes.h"
 
+// Bytes of a DDS file before its pixel data at most, magic and DX10 header included.
+#define IMAGE_DDS_MAX_HEADER_SIZE 148
+
 bool image_parse(ImageContainer& image_container_out, const void* data, u32 size);
 bool image_get_raw_data(const ImageContainer& image_container, u8 side, u8 lod, const void* data, u32 size, ImageMip& mip_out);
+// Offset of mip lod of side 0 from the start of the file, lod num_mips is the end of side 0.
+u32 image_get_mip_offset(const ImageContainer& image_container, u8 lod);
+// Rewrites the DDS header of image_container in data to describe its mip chain
+// starting at lod, the pixel data of those mips may then follow the header.
+void image_dds_set_top_mip(void* data, const ImageContainer& image_container, u8 lod);
 void image_get_rgba8_data(void* dst, const void* src, u16 width, u16 height, u32 pitch, u8 type);
 void image_get_bgra8_data(void* dst, const void* src, u16 width, u16 height, u32 pitch, u8 type);
 void image_checkerboard(u16 width, u16 height, u16 step, u32 _0, u32 _1, void* dst);
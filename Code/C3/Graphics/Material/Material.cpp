@@ -1,7 +1,7 @@
 #include "C3PCH.h"
 #include "Material.h"
 
-ProgramHandle Material::Apply(const char* tech, const char* pass) {
+ProgramHandle Material::Apply(DrawEncoder* encoder, const char* tech, const char* pass) {
   if (!_shader_asset) return ProgramHandle();
   SpinLockGuard lock_guard(&_shader_asset->_lock);
   if (_shader_asset->_state != ASSET_STATE_READY) return ProgramHandle();
@@ -9,23 +9,23 @@ ProgramHandle Material::Apply(const char* tech, const char* pass) {
   for (u32 i = 0; i < shader->_num_sub_shaders; ++i) {
     auto& sub_shader = shader->_sub_shaders[i];
     if (strcmp(sub_shader._technique, tech) == 0 && strcmp(sub_shader._pass, pass) == 0) {
-      ApplyParams(&sub_shader);
+      ApplyParams(encoder, &sub_shader);
       return sub_shader._program;
     }
   }
   return ProgramHandle();
 }
 
-void Material::ApplyParams(SubShader* sub_shader) {
-  auto GR = GraphicsRenderer::Instance();
+void Material::ApplyParams(DrawEncoder* encoder, SubShader* sub_shader) {
   Texture* texture = nullptr;
   u32 flags;
+  u8 unit;
   for (u32 i = 0; i < sub_shader->_num_params; ++i) {
-    // check material override
-    MaterialParam* p = sub_shader->_params + i;
+    // check material override, texture unit always comes from the shader.
+    const MaterialParam* shader_param = sub_shader->_params + i;
+    const MaterialParam* p = shader_param;
     for (u32 j = 0; j < _num_params; ++j) {
       if (strcmp(_params[j]._name, p->_name) == 0) {
-        _params[j]._tex2d._unit = p->_tex2d._unit;
         p = _params + j;
         break;
       }
@@ -36,17 +36,26 @@ void Material::ApplyParams(SubShader* sub_shader) {
     case MATERIAL_PARAM_VEC2:
     case MATERIAL_PARAM_VEC3:
     case MATERIAL_PARAM_VEC4:
-      GR->SetConstant(p->_constant_handle, p->_vec);
+      encoder->SetConstant(p->_constant_handle, p->_vec);
       break;
     case MATERIAL_PARAM_TEXTURE2D:
       texture = (Texture*)p->_tex2d._asset->_header->GetData();
       flags = p->_tex2d._flags;
       // TODO: dirty workaround.
       if (strstr(p->_name, "normal") == nullptr) flags |= C3_TEXTURE_SRGB;
-      if (p->_tex2d._unit != UINT8_MAX) GR->SetTexture(p->_tex2d._unit, texture->_handle, flags);
+      unit = shader_param->_tex2d._unit;
+      if (unit != UINT8_MAX) encoder->SetTexture(unit, texture->_handle, flags);
       break;
     default:
       ;
     }
   }
 }
+
+void Material::StreamTextures(u32 screen_size) {
+  for (u32 i = 0; i < _num_params; ++i) {
+    if (_params[i]._type != MATERIAL_PARAM_TEXTURE2D) continue;
+    auto texture = (Texture*)_params[i]._tex2d._asset->_header->GetData();
+    if (texture->_stream) TextureStreamer::Request(texture->_stream, screen_size);
+  }
+}
@@ -4,6 +4,8 @@
 #include "Graphics/GraphicsTypes.h"
 #include "Asset/AssetManager.h"
 
+class DrawEncoder;
+
 #define MAX_MATERIAL_TECHNIQUE_NAME_LEN 64
 #define MAX_MATERIAL_PASS_NAME_LEN 64
 #define MAX_MATERIAL_KEY_LEN 64
@@ -51,6 +53,10 @@ struct Material {
   u32 _num_params;
   MaterialParam _params[MAX_MATERIAL_PARAMS];
 
-  ProgramHandle Apply(const char* tech, const char* pass);
-  void ApplyParams(SubShader* sub_shader);
+  // Records params into encoder, may be called from several threads at once.
+  ProgramHandle Apply(DrawEncoder* encoder, const char* tech, const char* pass);
+  void ApplyParams(DrawEncoder* encoder, SubShader* sub_shader);
+  // Asks for the mips of its streamed textures drawn screen_size pixels large,
+  // may be called from several threads at once.
+  void StreamTextures(u32 screen_size);
 };
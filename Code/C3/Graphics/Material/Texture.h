@@ -2,7 +2,10 @@
 #include "Pattern/Handle.h"
 #include "Graphics/GraphicsInterface.h"
 
+struct TextureStream;
+
 struct Texture {
   TextureHandle _handle;
-  TextureInfo _info;
+  TextureInfo _info;          // of the mips on the GPU.
+  TextureStream* _stream;     // nullptr if all mips are resident, see TextureStreamer.
 };
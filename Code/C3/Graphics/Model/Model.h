@@ -15,6 +15,7 @@ struct Model {
   char _filename[MAX_ASSET_NAME];
   VertexBufferHandle _vb;
   IndexBufferHandle _ib;
+  u32 _upload;              // drawable once GraphicsRenderer::IsUploaded.
   AABB _aabb;
   u16 _num_materials;
   u16 _num_parts;
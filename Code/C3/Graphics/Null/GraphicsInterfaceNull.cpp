@@ -0,0 +1,405 @@
+#include "C3PCH.h"
+#include "GraphicsInterfaceNull.h"
+#include "Graphics/ConstantBuffer.h"
+#include "Graphics/GraphicsRenderer.h"
+#include "Graphics/RenderFrame.h"
+#include "Data/Blob.h"
+#include "Debug/C3Debug.h"
+
+static GraphicsInterfaceNull* g_null_interface = nullptr;
+
+static_assert((sizeof(NullGraphicsStats) - offsetof(NullGraphicsStats, num_creates)) % sizeof(u32) == 0,
+              "NullGraphicsStats counters after num_creates must be u32.");
+
+void ShaderNull::Create(const MemoryRegion* mem) {
+  BlobReader blob(mem->data, mem->size);
+  ShaderInfo::Header header;
+
+  blob.Read(header);
+  c3_assert_return(header.magic == C3_CHUNK_MAGIC_VSH || header.magic == C3_CHUNK_MAGIC_FSH);
+  u8 fragment_bit = C3_CHUNK_MAGIC_FSH == header.magic ? CONSTANT_FRAGMENTBIT : 0;
+
+  _num_predefined = 0;
+  for (u32 i = 0; i < header.num_constants; ++i) {
+    auto& c = header.constants[i];
+    PredefinedConstantType predefined = PredefinedConstant::NameToType(c.name);
+    if (PREDEFINED_CONSTANT_COUNT != predefined) {
+      _predefined[_num_predefined].loc = c.loc;
+      _predefined[_num_predefined].count = c.num;
+      _predefined[_num_predefined].type = u8(predefined | fragment_bit);
+      _num_predefined++;
+    }
+  }
+  _created = true;
+}
+
+void ProgramNull::Create(const ShaderNull* vsh, const ShaderNull* fsh) {
+  c3_assert(vsh->_created && "Vertex shader doesn't exist.");
+  _vsh = vsh;
+  memcpy(&_predefined[0], vsh->_predefined, vsh->_num_predefined * sizeof(PredefinedConstant));
+  _num_predefined = vsh->_num_predefined;
+  _fsh = fsh;
+  if (fsh) {
+    memcpy(&_predefined[_num_predefined], fsh->_predefined, fsh->_num_predefined * sizeof(PredefinedConstant));
+    _num_predefined += fsh->_num_predefined;
+  }
+}
+
+GraphicsInterfaceNull::GraphicsInterfaceNull(GraphicsAPI api, int major_version, int minor_version)
+: GraphicsInterface(api, major_version, minor_version) {
+  g_null_interface = this;
+  memset(&_resolution, 0, sizeof(_resolution));
+  memset(_uniforms, 0, sizeof(_uniforms));
+  _vs_scratch = (u8*)c3_alloc(mem_allocator(MEMORY_TAG_GRAPHICS), C3_MAX_CONSTANT_BUFER_SIZE, 16);
+  _fs_scratch = (u8*)c3_alloc(mem_allocator(MEMORY_TAG_GRAPHICS), C3_MAX_CONSTANT_BUFER_SIZE, 16);
+  memset(&_stats, 0, sizeof(_stats));
+  memset(&_last_frame, 0, sizeof(_last_frame));
+  memset(&_total, 0, sizeof(_total));
+}
+
+GraphicsInterfaceNull::~GraphicsInterfaceNull() {
+  {
+    SpinLockGuard lock(&_stats_lock);
+    g_null_interface = nullptr;
+  }
+  c3_free(mem_allocator(MEMORY_TAG_GRAPHICS), _vs_scratch, 16);
+  c3_free(mem_allocator(MEMORY_TAG_GRAPHICS), _fs_scratch, 16);
+}
+
+bool GraphicsInterfaceNull::GetStats(NullGraphicsStats* last_frame, NullGraphicsStats* total) {
+  auto gi = g_null_interface;
+  if (!gi) return false;
+  SpinLockGuard lock(&gi->_stats_lock);
+  if (last_frame) *last_frame = gi->_last_frame;
+  if (total) *total = gi->_total;
+  return true;
+}
+
+void GraphicsInterfaceNull::Init() {
+  c3_log("[C3] Null graphics interface, nothing is drawn.\n");
+}
+
+void GraphicsInterfaceNull::Shutdown() {
+  for (u32 i = 0; i < C3_MAX_CONSTANTS; ++i) {
+    if (_uniforms[i]) C3_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), _uniforms[i]);
+    _uniforms[i] = nullptr;
+  }
+}
+
+void GraphicsInterfaceNull::CreateIndexBuffer(IndexBufferHandle handle, const MemoryRegion* mem, u16 flags) {
+  ++_stats.num_creates;
+  _stats.bytes_uploaded += mem->size;
+}
+
+void GraphicsInterfaceNull::DestroyIndexBuffer(IndexBufferHandle handle) {
+  ++_stats.num_destroys;
+}
+
+void GraphicsInterfaceNull::CreateVertexDecl(VertexDeclHandle handle, const VertexDecl& decl) {
+  ++_stats.num_creates;
+}
+
+void GraphicsInterfaceNull::DestroyVertexDecl(VertexDeclHandle handle) {
+  ++_stats.num_destroys;
+}
+
+void GraphicsInterfaceNull::CreateVertexBuffer(VertexBufferHandle handle, const MemoryRegion* mem, VertexDeclHandle decl_handle, u16 flags) {
+  ++_stats.num_creates;
+  _stats.bytes_uploaded += mem->size;
+}
+
+void GraphicsInterfaceNull::DestroyVertexBuffer(VertexBufferHandle handle) {
+  ++_stats.num_destroys;
+}
+
+void GraphicsInterfaceNull::CreateDynamicIndexBuffer(IndexBufferHandle handle, u32 size, u16 flags) {
+  ++_stats.num_creates;
+}
+
+void GraphicsInterfaceNull::UpdateDynamicIndexBuffer(IndexBufferHandle handle, u32 offset, u32 size, const MemoryRegion* mem) {
+  _stats.bytes_uploaded += min(size, mem->size);
+}
+
+void GraphicsInterfaceNull::CreateDynamicVertexBuffer(VertexBufferHandle handle, u32 size, u16 flags) {
+  ++_stats.num_creates;
+}
+
+void GraphicsInterfaceNull::UpdateDynamicVertexBuffer(VertexBufferHandle handle, u32 offset, u32 size, const MemoryRegion* mem) {
+  _stats.bytes_uploaded += min(size, mem->size);
+}
+
+void GraphicsInterfaceNull::CreateShader(ShaderHandle handle, const MemoryRegion* mem) {
+  ++_stats.num_creates;
+  _shaders[handle.idx].Create(mem);
+}
+
+void GraphicsInterfaceNull::DestroyShader(ShaderHandle handle) {
+  ++_stats.num_destroys;
+  _shaders[handle.idx].Destroy();
+}
+
+void GraphicsInterfaceNull::CreateProgram(ProgramHandle handle, ShaderHandle vsh, ShaderHandle fsh) {
+  ++_stats.num_creates;
+  _programs[handle.idx].Create(&_shaders[vsh.idx], fsh ? &_shaders[fsh.idx] : nullptr);
+}
+
+void GraphicsInterfaceNull::DestroyProgram(ProgramHandle handle) {
+  ++_stats.num_destroys;
+  _programs[handle.idx].Destroy();
+}
+
+void GraphicsInterfaceNull::CreateTexture(TextureHandle handle, const MemoryRegion* mem, u32 flags, u8 skip) {
+  ++_stats.num_creates;
+  _stats.bytes_uploaded += mem->size;
+}
+
+void GraphicsInterfaceNull::UpdateTextureBegin(TextureHandle handle, u8 side, u8 mip) {}
+
+void GraphicsInterfaceNull::UpdateTexture(TextureHandle handle, u8 side, u8 mip, const TextureRect& rect, u16 z, u16 depth, u16 pitch, const MemoryRegion* mem) {
+  _stats.bytes_uploaded += mem->size;
+}
+
+void GraphicsInterfaceNull::UpdateTextureEnd() {}
+
+void GraphicsInterfaceNull::ResizeTexture(TextureHandle handle, u16 width, u16 height) {}
+
+void GraphicsInterfaceNull::DestroyTexture(TextureHandle handle) {
+  ++_stats.num_destroys;
+}
+
+void GraphicsInterfaceNull::CreateFrameBuffer(FrameBufferHandle handle, u8 num, const TextureHandle* texture_handles) {
+  ++_stats.num_creates;
+}
+
+void GraphicsInterfaceNull::CreateFrameBuffer(FrameBufferHandle handle, void* nwh, u32 width, u32 height, TextureFormat depth_format) {
+  ++_stats.num_creates;
+}
+
+void GraphicsInterfaceNull::DestroyFrameBuffer(FrameBufferHandle handle) {
+  ++_stats.num_destroys;
+}
+
+void GraphicsInterfaceNull::CreateConstant(ConstantHandle handle, ConstantType type, u16 num, stringid name) {
+  if (_uniforms[handle.idx]) C3_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), _uniforms[handle.idx]);
+  else ++_stats.num_creates;
+
+  u32 size = ALIGN_16(CONSTANT_TYPE_SIZE[type] * num);
+  void* data = C3_ALLOC(mem_allocator(MEMORY_TAG_GRAPHICS), size);
+  memset(data, 0, size);
+  _uniforms[handle.idx] = data;
+}
+
+void GraphicsInterfaceNull::DestroyConstant(ConstantHandle handle) {
+  ++_stats.num_destroys;
+  C3_FREE(mem_allocator(MEMORY_TAG_GRAPHICS), _uniforms[handle.idx]);
+  _uniforms[handle.idx] = nullptr;
+}
+
+bool GraphicsInterfaceNull::UpdateConstant(u16 loc, const void* data, u32 size) {
+  if (!_uniforms[loc] || memcmp(_uniforms[loc], data, size) == 0) return false;
+  memcpy(_uniforms[loc], data, size);
+  ++_stats.num_constant_updates;
+  _stats.constant_bytes += size;
+  return true;
+}
+
+void GraphicsInterfaceNull::SetMarker(const char* marker, u32 size) {}
+
+void GraphicsInterfaceNull::Submit(RenderFrame* render, ClearQuad& clear_quad) {
+  _resolution = render->resolution;
+
+  render->Sort();
+  memset(&_frame_stats, 0, sizeof(_frame_stats));
+
+  _stats.bytes_uploaded += render->index_segment->GetUsed() + render->vertex_segment->GetUsed();
+  _stats.num_batched_items += render->num_batched_items;
+
+  RenderItem current_state;
+  current_state.Clear();
+  current_state.flags = C3_STATE_NONE;
+
+  ViewState& view_state = _view_state;
+  view_state.Reset(render, false);
+
+  u16 program_idx = UINT16_MAX;
+  SortKey key;
+  u16 view = UINT16_MAX;
+  FrameBufferHandle fbh;
+  u8 prim_index = 0;
+  u8 current_prim = 0;
+  u8 eye = 0;
+  view_state._rect = render->rect[0];
+
+  i32 num_items = render->render_item_count;
+  _stats.num_items += num_items;
+  for (i32 item = 0; item < num_items;) {
+    key.Decode(render->sort_keys[item], render->view_remap);
+    const bool view_changed = key.view != view;
+
+    const RenderItem& draw = render->render_items[render->sort_values[item]];
+    ++item;
+
+    if (view_changed) {
+      view = key.view;
+      program_idx = UINT16_MAX;
+      ++_stats.num_views;
+
+      if (render->fb[view].idx != fbh.idx) {
+        fbh = render->fb[view];
+        ++_stats.num_frame_buffer_changes;
+      }
+
+      eye = 0;
+      view_state._rect = render->rect[view];
+
+      ViewClear& clr = render->view_clear[view];
+      if (C3_CLEAR_NONE != (clr.flags & C3_CLEAR_MASK)) {
+        ++_stats.num_clears;
+        current_prim = UINT8_MAX; // Clear quad changes the primitive type.
+      }
+    }
+
+    const u64 new_flags = draw.flags;
+    u64 changed_flags = current_state.flags ^ draw.flags;
+    changed_flags |= current_state.rgba != draw.rgba ? C3_NULL_BLEND_STATE_MASK : 0;
+    current_state.flags = new_flags;
+
+    if (view_changed) {
+      current_state.Clear();
+      current_state.scissor = !draw.scissor;
+      changed_flags = C3_STATE_MASK;
+      current_state.flags = new_flags;
+      ++_stats.num_blend_changes;
+      ++_stats.num_depth_stencil_changes;
+      prim_index = u8((new_flags & C3_STATE_PT_MASK) >> C3_STATE_PT_SHIFT);
+    }
+
+    if (current_prim != prim_index) {
+      current_prim = prim_index;
+      ++_stats.num_primitive_changes;
+    }
+
+    if (current_state.scissor != draw.scissor) {
+      current_state.scissor = draw.scissor;
+      ++_stats.num_scissor_changes;
+      ++_stats.num_rasterizer_changes;
+    }
+
+    if (C3_NULL_DEPTH_STENCIL_MASK & changed_flags) ++_stats.num_depth_stencil_changes;
+
+    if (C3_NULL_BLEND_STATE_MASK & changed_flags) {
+      ++_stats.num_blend_changes;
+      current_state.rgba = draw.rgba;
+    }
+
+    if ((C3_STATE_CULL_MASK | C3_STATE_ALPHA_REF_MASK | C3_STATE_PT_MASK | C3_STATE_POINT_SIZE_MASK | C3_STATE_MSAA) & changed_flags) {
+      if ((C3_STATE_CULL_MASK | C3_STATE_MSAA) & changed_flags) ++_stats.num_rasterizer_changes;
+
+      if (C3_STATE_ALPHA_REF_MASK & changed_flags) {
+        u32 ref = (new_flags & C3_STATE_ALPHA_REF_MASK) >> C3_STATE_ALPHA_REF_SHIFT;
+        view_state._alpha_ref = ref / 255.0f;
+      }
+
+      prim_index = u8((new_flags & C3_STATE_PT_MASK) >> C3_STATE_PT_SHIFT);
+      if (current_prim != prim_index) {
+        current_prim = prim_index;
+        ++_stats.num_primitive_changes;
+      }
+    }
+
+    bool program_changed = false;
+
+    UpdateConstants(render->GetConstantBuffer(), draw.constant_begin, draw.constant_end);
+
+    if (key.program != program_idx) {
+      program_idx = key.program;
+      program_changed = true;
+      ++_stats.num_program_changes;
+    }
+
+    if (UINT16_MAX == program_idx) continue;
+
+    ProgramNull& program = _programs[program_idx];
+    view_state.SetPredefined<4>(this, view, eye, program, render, draw);
+
+    if (memcmp(current_state.bind, draw.bind, sizeof(draw.bind)) != 0) {
+      u32 changes = 0;
+      for (u8 stage = 0; stage < MAX_RENDER_ITEM_BINDING_COUNT; ++stage) {
+        const Binding& bind = draw.bind[stage];
+        Binding& current = current_state.bind[stage];
+        if (current.idx != bind.idx || current.flags != bind.flags) ++changes;
+        current = bind;
+      }
+      _stats.num_texture_changes += changes;
+    }
+
+    if (program_changed || current_state.vertex_decl.idx != draw.vertex_decl.idx ||
+        current_state.vertex_buffer.idx != draw.vertex_buffer.idx ||
+        current_state.instance_data_buffer.idx != draw.instance_data_buffer.idx ||
+        current_state.instance_data_offset != draw.instance_data_offset ||
+        current_state.instance_data_stride != draw.instance_data_stride) {
+      current_state.vertex_decl = draw.vertex_decl;
+      current_state.vertex_buffer = draw.vertex_buffer;
+      current_state.instance_data_buffer = draw.instance_data_buffer;
+      current_state.instance_data_offset = draw.instance_data_offset;
+      current_state.instance_data_stride = draw.instance_data_stride;
+      ++_stats.num_vertex_buffer_changes;
+    }
+
+    if (current_state.index_buffer.idx != draw.index_buffer.idx) {
+      current_state.index_buffer = draw.index_buffer;
+      ++_stats.num_index_buffer_changes;
+    }
+
+    if (current_state.vertex_buffer) {
+      ++_stats.num_draws;
+      _stats.num_instances += draw.num_instances;
+    }
+  }
+
+  // Flip ran before Submit, _stats holds this frame only. Constant counters are kept by UpdateConstants.
+  _frame_stats.constant_bytes = _stats.constant_bytes;
+  _frame_stats.num_items = _stats.num_items;
+  _frame_stats.num_draws = _stats.num_draws;
+  _frame_stats.num_instances = _stats.num_instances;
+  _frame_stats.num_batched_items = _stats.num_batched_items;
+  _frame_stats.num_views = _stats.num_views;
+  _frame_stats.num_program_changes = _stats.num_program_changes;
+  _frame_stats.num_texture_binds = _stats.num_texture_changes;
+}
+
+void GraphicsInterfaceNull::Flip() {
+  ++_stats.num_frames;
+  SpinLockGuard lock(&_stats_lock);
+  _last_frame = _stats;
+  _total.bytes_uploaded += _stats.bytes_uploaded;
+  _total.constant_bytes += _stats.constant_bytes;
+  // Remaining counters are all u32.
+  u32* total = &_total.num_creates;
+  const u32* frame = &_stats.num_creates;
+  for (u32 i = 0; i < (sizeof(NullGraphicsStats) - offsetof(NullGraphicsStats, num_creates)) / sizeof(u32); ++i) {
+    total[i] += frame[i];
+  }
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void GraphicsInterfaceNull::SaveScreenshot(const String& path) {}
+
+void GraphicsInterfaceNull::_SetConstant(u8 flags, u32 loc, const void* val, u32 num) {
+  u8* scratch = (flags & CONSTANT_FRAGMENTBIT) ? _fs_scratch : _vs_scratch;
+  u32 size = min<u32>(num * 4, C3_MAX_CONSTANT_BUFER_SIZE - min<u32>(loc, C3_MAX_CONSTANT_BUFER_SIZE));
+  memcpy(scratch + loc, val, size);
+  _stats.constant_bytes += size;
+}
+
+void GraphicsInterfaceNull::_SetConstantFloat(u8 flags, u32 loc, const void* val, u32 num) {
+  _SetConstant(flags, loc, val, num);
+}
+
+void GraphicsInterfaceNull::_SetConstantVector4(u8 flags, u32 loc, const void* val, u32 num) {
+  _SetConstant(flags, loc, val, num * 4);
+}
+
+void GraphicsInterfaceNull::_SetConstantMatrix4(u8 flags, u32 loc, const void* val, u32 num) {
+  _SetConstant(flags, loc, val, num * 16);
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "Graphics/GraphicsInterface.h"
+#include "Graphics/ViewState.h"
+#include "Platform/PlatformSync.h"
+
+#define C3_NULL_BLEND_STATE_MASK (C3_STATE_BLEND_MASK | C3_STATE_BLEND_EQUATION_MASK | C3_STATE_BLEND_INDEPENDENT | \
+                                  C3_STATE_ALPHA_WRITE | C3_STATE_RGB_WRITE)
+#define C3_NULL_DEPTH_STENCIL_MASK (C3_STATE_DEPTH_WRITE | C3_STATE_DEPTH_TEST_MASK)
+
+// Counters of GraphicsInterfaceNull. State changes count the calls D3D11 would make.
+struct NullGraphicsStats {
+  u64 bytes_uploaded;       // buffer, texture and transient data.
+  u64 constant_bytes;       // user and predefined constants.
+  u32 num_creates;
+  u32 num_destroys;
+  u32 num_frames;
+  u32 num_items;
+  u32 num_draws;
+  u32 num_views;
+  u32 num_clears;
+  u32 num_frame_buffer_changes;
+  u32 num_program_changes;
+  u32 num_blend_changes;
+  u32 num_depth_stencil_changes;
+  u32 num_rasterizer_changes;
+  u32 num_scissor_changes;
+  u32 num_primitive_changes;
+  u32 num_texture_changes;
+  u32 num_vertex_buffer_changes;
+  u32 num_index_buffer_changes;
+  u32 num_constant_updates;
+  u32 num_instances;          // drawn, a draw without instance data counts one.
+  u32 num_batched_items;      // draws merged into instanced draws by RenderFrame::Batch.
+};
+
+struct ShaderNull {
+  ShaderNull(): _created(false), _num_predefined(0) {}
+  void Create(const MemoryRegion* mem);
+  void Destroy() { _created = false; _num_predefined = 0; }
+
+  bool _created;
+  PredefinedConstant _predefined[PREDEFINED_CONSTANT_COUNT];
+  u8 _num_predefined;
+};
+
+struct ProgramNull {
+  ProgramNull(): _vsh(nullptr), _fsh(nullptr), _num_predefined(0) {}
+  void Create(const ShaderNull* vsh, const ShaderNull* fsh);
+  void Destroy() { _vsh = _fsh = nullptr; _num_predefined = 0; }
+
+  const ShaderNull* _vsh;
+  const ShaderNull* _fsh;
+  PredefinedConstant _predefined[PREDEFINED_CONSTANT_COUNT * 2];
+  u8 _num_predefined;
+};
+
+/*
+* GraphicsInterfaceNull accepts every resource call without a device and walks
+* Submit the way GraphicsInterfaceD3D11 does: sort, key decode, state diff,
+* constant decode and predefined constants. Resources are not kept, only counted.
+* Use NULL_GRAPHICS_API to run the renderer headless for benchmarks and tests.
+*/
+class GraphicsInterfaceNull : public GraphicsInterface {
+public:
+  GraphicsInterfaceNull(GraphicsAPI api, int major_version, int minor_version);
+  ~GraphicsInterfaceNull();
+
+  bool OK() const override { return true; }
+
+  // Thread safe. Counters of the last flipped frame and totals since creation.
+  static bool GetStats(NullGraphicsStats* last_frame, NullGraphicsStats* total);
+
+  void Init() override;
+  void Shutdown() override;
+  void CreateIndexBuffer(IndexBufferHandle handle, const MemoryRegion* mem, u16 flags) override;
+  void DestroyIndexBuffer(IndexBufferHandle handle) override;
+  void CreateVertexDecl(VertexDeclHandle handle, const VertexDecl& decl) override;
+  void DestroyVertexDecl(VertexDeclHandle handle) override;
+  void CreateVertexBuffer(VertexBufferHandle handle, const MemoryRegion* mem,
+                          VertexDeclHandle decl_handle, u16 flags) override;
+  void DestroyVertexBuffer(VertexBufferHandle handle) override;
+  void CreateDynamicIndexBuffer(IndexBufferHandle handle, u32 size, u16 flags) override;
+  void UpdateDynamicIndexBuffer(IndexBufferHandle handle, u32 offset, u32 size, const MemoryRegion* mem) override;
+  void CreateDynamicVertexBuffer(VertexBufferHandle handle, u32 size, u16 flags) override;
+  void UpdateDynamicVertexBuffer(VertexBufferHandle handle, u32 offset, u32 size, const MemoryRegion* mem) override;
+  void CreateShader(ShaderHandle handle, const MemoryRegion* mem) override;
+  void DestroyShader(ShaderHandle handle) override;
+  void CreateProgram(ProgramHandle handle, ShaderHandle vsh, ShaderHandle fsh) override;
+  void DestroyProgram(ProgramHandle handle) override;
+  void CreateTexture(TextureHandle handle, const MemoryRegion* mem, u32 flags, u8 skip) override;
+  void UpdateTextureBegin(TextureHandle handle, u8 side, u8 mip) override;
+  void UpdateTexture(TextureHandle handle, u8 side, u8 mip, const TextureRect& rect, u16 z, u16 depth, u16 pitch, const MemoryRegion* mem) override;
+  void UpdateTextureEnd() override;
+  void ResizeTexture(TextureHandle handle, u16 width, u16 height) override;
+  void DestroyTexture(TextureHandle handle) override;
+  void CreateFrameBuffer(FrameBufferHandle handle, u8 num, const TextureHandle* texture_handles) override;
+  void CreateFrameBuffer(FrameBufferHandle handle, void* nwh, u32 width, u32 height, TextureFormat depth_format) override;
+  void DestroyFrameBuffer(FrameBufferHandle handle) override;
+  void CreateConstant(ConstantHandle handle, ConstantType type, u16 num, stringid name) override;
+  void DestroyConstant(ConstantHandle handle) override;
+  bool UpdateConstant(u16 loc, const void* data, u32 size) override;
+  void SetMarker(const char* marker, u32 size) override;
+  void Submit(RenderFrame* render, ClearQuad& clear_quad) override;
+  void Flip() override;
+  void SaveScreenshot(const String& path) override;
+
+protected:
+  void _SetConstantFloat(u8 flags, u32 loc, const void* val, u32 num) override;
+  void _SetConstantVector4(u8 flags, u32 loc, const void* val, u32 num) override;
+  void _SetConstantMatrix4(u8 flags, u32 loc, const void* val, u32 num) override;
+
+private:
+  void _SetConstant(u8 flags, u32 loc, const void* val, u32 num);
+
+  ShaderNull _shaders[C3_MAX_SHADERS];
+  ProgramNull _programs[C3_MAX_PROGRAMS];
+  void* _uniforms[C3_MAX_CONSTANTS];
+  u8* _vs_scratch;
+  u8* _fs_scratch;
+  Resolution _resolution;
+  ViewState _view_state;
+
+  NullGraphicsStats _stats;
+  NullGraphicsStats _last_frame;
+  NullGraphicsStats _total;
+  SpinLock _stats_lock;
+
+  friend struct ViewState;
+};
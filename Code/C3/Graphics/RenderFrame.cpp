@@ -4,48 +4,82 @@
 #include "RenderKey.h"
 #include "Graphics/GraphicsRenderer.h"
 #include "Algorithm/C3Algorithm.h"
-
-static u64 s_temp_keys[C3_MAX_DRAW_CALLS];
-static u16 s_temp_values[C3_MAX_DRAW_CALLS];
-
-RenderFrame::RenderFrame(): constant_buffer(nullptr), constant_max(0), render_item_count(0) {}
+#include "Algorithm/ParallelRadixSort.h"
+
+// Sort scratch, one frame is sorted at a time: by the render thread or the sort job it waits for.
+static u64 s_temp_keys[C3_MAX_RENDER_ITEMS];
+static u16 s_temp_values[C3_MAX_RENDER_ITEMS];
+static RadixSortHistograms<u64> s_sort_histograms;
+static RadixSortParallelScratch<u64> s_parallel_sort_scratch;
+// Batch: next and last item of the batch, batch size (0 for members), hash table of leaders.
+static u16 s_batch_next[C3_MAX_RENDER_ITEMS];
+static u16 s_batch_tail[C3_MAX_RENDER_ITEMS];
+static u16 s_batch_count[C3_MAX_RENDER_ITEMS];
+// Smallest power of two >= n, at least 4, the batch table is probed with a mask.
+static constexpr u32 batch_table_size(u32 n, u32 size = 4) {
+  return size >= n ? size : batch_table_size(n, size << 1);
+}
+static u16 s_batch_table[batch_table_size(C3_MAX_RENDER_ITEMS * 2)];
+
+// Instance data of batched draws is the model matrix, i_data0-3.
+#define INSTANCE_MATRIX_STRIDE ((u16)sizeof(float4x4))
+
+RenderFrame::RenderFrame()
+: num_reserved_items(0), render_item_count(0), sorted(false), vertex_segment(nullptr), index_segment(nullptr),
+  constant_segment(nullptr), transient_ib(nullptr), transient_vb(nullptr), constant_buffer(nullptr),
+  upload_limit(0), upload_required(0), num_batched_items(0) {
+  for (u8 i = 0; i < C3_MAX_DRAW_ENCODERS; ++i) encoders[i].Init(this, i);
+  cmd_pre.Start();
+  cmd_post.Start();
+}
 
 RenderFrame::~RenderFrame() {}
 
 void RenderFrame::Create() {
-  constant_buffer = ConstantBuffer::Create();
   memset(scissor, 0, sizeof(scissor));
   memset(rect, 0, sizeof(rect));
-  memset(&current, 0, sizeof(current));
   Reset();
   Start();
 }
 
 void RenderFrame::Destroy() {
-  ConstantBuffer::Destroy(constant_buffer);
-  constant_buffer = nullptr;
+  for (auto& encoder : encoders) encoder.Destroy();
 }
 
 void RenderFrame::Start() {
-  constant_buffer->Reset();
-  constant_begin = 0;
-  constant_end = 0;
-  current.Clear();
+  for (auto& encoder : encoders) encoder.Start();
+  num_reserved_items = 0;
   render_item_count = 0;
   matrix_cache.Reset();
   rect_cache.Reset();
-  vb_offset = 0;
-  ib_offset = 0;
-  discard = false;
+  for (auto segment : {vertex_segment, index_segment, constant_segment}) {
+    if (segment) segment->Reset();
+  }
+  cmd_pre.Start();
+  cmd_post.Start();
 }
 
 void RenderFrame::Finish() {
-  constant_max = max(constant_max, constant_buffer->GetPos());
-  constant_buffer->Finish();
+  cmd_pre.Finish();
+  cmd_post.Finish();
+  for (auto& encoder : encoders) encoder.Finish();
+  // Merge: encoders wrote their items in reserved chunks, pack keys of
+  // submitted items, values point back at the slots.
+  u32 num = min<u32>(num_reserved_items.load(memory_order_relaxed), C3_MAX_RENDER_ITEMS);
+  u16 count = 0;
+  for (u32 i = 0; i < num; ++i) {
+    if (sort_keys[i] == RENDER_ITEM_HOLE) continue;
+    sort_keys[count] = sort_keys[i];
+    sort_values[count] = (u16)i;
+    ++count;
+  }
+  render_item_count = count;
+  sorted = false;
 }
 
 void RenderFrame::Clear() {
   render_item_count = 0;
+  sorted = false;
 }
 
 void RenderFrame::Reset() {
@@ -54,157 +88,171 @@ void RenderFrame::Reset() {
   Finish();
 }
 
-void RenderFrame::Sort() {
+void RenderFrame::SortKeys(bool parallel) {
   for (u16 i = 0, n = render_item_count; i < n; ++i) {
     sort_keys[i] = SortKey::RemapView(sort_keys[i], view_remap);
   }
-  radix_sort64(sort_keys, s_temp_keys, sort_values, s_temp_values, render_item_count);
-}
-
-void RenderFrame::Discard() {
-  discard = true;
-  current.Clear();
-}
-
-void RenderFrame::SetMarker(const char* marker) { constant_buffer->WriteMarker(marker); }
-
-void RenderFrame::SetVertexBuffer(VertexBufferHandle handle, u32 vertex_start, u32 vertex_size) {
-  current.start_vertex = vertex_start;
-  current.num_vertices = vertex_size;
-  current.vertex_buffer = handle;
-}
-
-void RenderFrame::SetVertexBuffer(const TransientVertexBuffer* tvb, u32 start_vertex, u32 num_vertices) {
-  current.start_vertex = tvb->start_vertex + start_vertex;
-  current.num_vertices = min(tvb->size / tvb->stride, num_vertices);
-  current.vertex_buffer = tvb->handle;
-  current.vertex_decl = tvb->decl;
-}
-
-void RenderFrame::SetState(u64 state, u32 rgba) {
-  // transparency sort order table
-  u8 blend = ((state & C3_STATE_BLEND_MASK) >> C3_STATE_BLEND_SHIFT) & 0xff;
-  //sort_key.trans = "\x0\x1\x1\x2\x2\x1\x2\x1\x2\x1\x1\x1\x1\x1\x1\x1\x1\x1\x1"[(blend & 0xf) + (!!blend)];
-  sort_key.trans = (!!blend);
-  current.flags = state;
-  current.rgba = rgba;
-}
-
-void RenderFrame::SetIndexBuffer(IndexBufferHandle handle, u32 start_index, u32 num_indices) {
-  current.start_index = start_index;
-  current.num_indices = num_indices;
-  current.index_buffer = handle;
-}
-
-void RenderFrame::SetIndexBuffer(const TransientIndexBuffer* tib, u32 first_index, u32 num_indices) {
-  current.start_index = tib->start_index + first_index;
-  current.num_indices = min(tib->size / 2, num_indices);
-  current.index_buffer = tib->handle;
-  discard = num_indices == 9;
+  if (parallel) {
+    radix_sort_parallel(sort_keys, s_temp_keys, sort_values, s_temp_values, render_item_count, &s_parallel_sort_scratch);
+  } else {
+    radix_sort64(sort_keys, s_temp_keys, sort_values, s_temp_values, render_item_count, &s_sort_histograms);
+  }
+  sorted = true;
 }
 
-void RenderFrame::SetTexture(u8 unit, TextureHandle handle, u32 flags) {
-  current.bind[unit].idx = (u16)handle.idx;
-  current.bind[unit].type = Binding::Texture;
-  current.bind[unit].flags = (flags & C3_SAMPLER_DEFAULT_FLAGS) ? C3_SAMPLER_DEFAULT_FLAGS : flags;
+void RenderFrame::Sort() {
+  if (!sorted) SortKeys(false);
+#if C3_AUTO_INSTANCING
+  Batch();
+#endif
 }
 
-void RenderFrame::SetConstant(ConstantHandle handle, ConstantType type, const void* value, u16 num) {
-  ConstantBuffer::Update(constant_buffer);
-  constant_buffer->WriteConstant(type, (u16)handle.idx, value, num);
+static u32 batch_hash(const RenderItem& item) {
+  u32 h = item.vertex_buffer.idx | ((u32)item.index_buffer.idx << 16);
+  h = h * 0x9E3779B1u ^ item.start_index;
+  h = h * 0x9E3779B1u ^ item.num_indices;
+  h = h * 0x9E3779B1u ^ item.start_vertex;
+  h = h * 0x9E3779B1u ^ (u32)item.flags ^ (u32)(item.flags >> 32);
+  h = h * 0x9E3779B1u ^ item.bind[0].idx ^ (item.constant_end - item.constant_begin);
+  return h ^ (h >> 15);
 }
 
-void RenderFrame::SetScissor(i16 x, i16 y, i16 width, i16 height) {
-  current.scissor = (u16)rect_cache.Add(x, y, width, height);
+static bool batch_can_instance(const RenderItem& item) {
+  return item.num <= 1 && item.num_instances == 1 && !item.instance_data_buffer && item.vertex_buffer;
 }
 
-u16 RenderFrame::SetTransform(const void* m, u16 num) {
-  current.matrix = matrix_cache.Add(m, num);
-  current.num = num;
-  return current.matrix;
+bool RenderFrame::BatchEqual(const RenderItem& a, const RenderItem& b) {
+  if (a.vertex_buffer.idx != b.vertex_buffer.idx || a.index_buffer.idx != b.index_buffer.idx ||
+      a.vertex_decl.idx != b.vertex_decl.idx || a.start_vertex != b.start_vertex ||
+      a.num_vertices != b.num_vertices || a.start_index != b.start_index || a.num_indices != b.num_indices ||
+      a.flags != b.flags || a.rgba != b.rgba || a.scissor != b.scissor ||
+      memcmp(a.bind, b.bind, sizeof(a.bind)) != 0) {
+    return false;
+  }
+  // Same material and per draw constants.
+  u32 size = a.constant_end - a.constant_begin;
+  if (size != b.constant_end - b.constant_begin) return false;
+  if (size == 0) return true;
+  return memcmp(constant_buffer->GetData(a.constant_begin), constant_buffer->GetData(b.constant_begin), size) == 0;
 }
 
-void RenderFrame::SetTransform(u16 cache, u16 num) {
-  current.matrix = cache;
-  current.num = num;
+void RenderFrame::Batch() {
+  num_batched_items = 0;
+  auto GR = GraphicsRenderer::Instance();
+  u16 n = render_item_count;
+  u16 out = 0;
+  for (u16 begin = 0; begin < n;) {
+    // Run of opaque draws of one view and program with an instanced variant,
+    // ordered by depth.
+    u64 prefix;
+    u16 program;
+    u16 instanced_program = 0;    // merged draws are drawn with it.
+    u16 end = begin + 1;
+    bool instancing = SortKey::DecodeInstancing(sort_keys[begin], &prefix, &program);
+    if (instancing) {
+      const ProgramRef& pr = GR->_program_ref[program];
+      if (pr.instanced) instanced_program = program;
+      else if (pr.instanced_program) instanced_program = pr.instanced_program.idx;
+      else instancing = false;
+    }
+    if (instancing) {
+      u64 p;
+      u16 prog;
+      while (end < n && SortKey::DecodeInstancing(sort_keys[end], &p, &prog) && p == prefix) ++end;
+    }
+    if (end - begin < 2) {
+      for (u16 i = begin; i < end; ++i, ++out) {
+        sort_keys[out] = sort_keys[i];
+        sort_values[out] = sort_values[i];
+      }
+      begin = end;
+      continue;
+    }
+
+    // Group identical items behind the first one (the leader) in depth order.
+    u32 table_size = batch_table_size(2u * (end - begin));
+    c3_assert(table_size <= ARRAY_SIZE(s_batch_table));
+    memset(s_batch_table, 0xff, table_size * sizeof(u16));
+    for (u16 i = begin; i < end; ++i) {
+      s_batch_next[i] = UINT16_MAX;
+      s_batch_tail[i] = i;
+      s_batch_count[i] = 1;
+      const RenderItem& item = render_items[sort_values[i]];
+      if (!batch_can_instance(item)) continue;
+      for (u32 slot = batch_hash(item) & (table_size - 1);; slot = (slot + 1) & (table_size - 1)) {
+        u16 leader = s_batch_table[slot];
+        if (leader == UINT16_MAX) {
+          s_batch_table[slot] = i;
+          break;
+        }
+        if (BatchEqual(render_items[sort_values[leader]], item)) {
+          s_batch_next[s_batch_tail[leader]] = i;
+          s_batch_tail[leader] = i;
+          s_batch_count[i] = 0;
+          ++s_batch_count[leader];
+          break;
+        }
+      }
+    }
+
+    // Leaders become instanced draws, members are dropped.
+    for (u16 i = begin; i < end; ++i) {
+      u16 count = s_batch_count[i];
+      if (count == 0) continue;
+      u64 key = sort_keys[i];
+      if (count > 1) {
+        u32 num = count;
+        u32 offset = AllocTransientVertexBuffer(num, INSTANCE_MATRIX_STRIDE);
+        if (num == count) {
+          u8* data = &transient_vb->data[offset];
+          for (u16 j = i; j != UINT16_MAX; j = s_batch_next[j], data += INSTANCE_MATRIX_STRIDE) {
+            memcpy(data, &matrix_cache._cache[render_items[sort_values[j]].matrix], INSTANCE_MATRIX_STRIDE);
+          }
+          RenderItem& leader = render_items[sort_values[i]];
+          leader.instance_data_buffer = transient_vb->handle;
+          leader.instance_data_offset = offset;
+          leader.instance_data_stride = INSTANCE_MATRIX_STRIDE;
+          leader.num_instances = count;
+          key = SortKey::ReplaceProgram(key, instanced_program);
+          num_batched_items += count - 1;
+        } else {
+          // Out of transient memory, draw them one by one.
+          for (u16 j = s_batch_next[i]; j != UINT16_MAX; j = s_batch_next[j]) s_batch_count[j] = 1;
+        }
+      }
+      sort_keys[out] = key;
+      sort_values[out] = sort_values[i];
+      ++out;
+    }
+    begin = end;
+  }
+  render_item_count = out;
 }
 
-u16 RenderFrame::AllocTransform(float4x4*& m_out, u16& num_in_out) {
-  u16 first = matrix_cache.Reserve(&num_in_out);
-  m_out = (float4x4*)matrix_cache.GetBuffer(first);
+u32 RenderFrame::ReserveItems(u32* num) {
+  u32 first = num_reserved_items.fetch_add(*num, memory_order_relaxed);
+  if (first >= C3_MAX_RENDER_ITEMS) {
+    *num = 0;
+    return C3_MAX_RENDER_ITEMS;
+  }
+  *num = min<u32>(*num, C3_MAX_RENDER_ITEMS - first);
   return first;
 }
 
 bool RenderFrame::CheckAvailTransientIndexBuffer(u32 num) {
-  u32 offset = ib_offset;
-  u32 iboffset = offset + num * sizeof(u16);
-  iboffset = min<u32>(iboffset, C3_TRANSIENT_INDEX_BUFFER_SIZE);
-  u32 n = (iboffset - offset) / sizeof(u16);
-  return n == num;
+  return index_segment->CheckAvail(num * sizeof(u16), sizeof(u16));
 }
 
 u32 RenderFrame::AllocTransientIndexBuffer(u32& num_in_out) {
-  u32 offset = num_align(ib_offset, sizeof(u16));
-  ib_offset = offset + num_in_out * sizeof(u16);
-  ib_offset = min<u32>(ib_offset, C3_TRANSIENT_INDEX_BUFFER_SIZE);
-  num_in_out = (ib_offset - offset) / sizeof(u16);
-  return offset;
+  return index_segment->AllocNum(&num_in_out, sizeof(u16));
 }
 
 bool RenderFrame::CheckAvailTransientVertexBuffer(u32 num, u16 stride) {
-  u32 offset = num_align(vb_offset, stride);
-  u32 vboffset = offset + num * stride;
-  u32 n = (vboffset - offset) / stride;
-  return n == num;
+  return vertex_segment->CheckAvail(num * stride, stride);
 }
 
 u32 RenderFrame::AllocTransientVertexBuffer(u32& num_in_out, u16 stride) {
-  u32 offset = num_align(vb_offset, stride);
-  vb_offset = offset + num_in_out * stride;
-  vb_offset = min<u32>(vb_offset, C3_TRANSIENT_VERTEX_BUFFER_SIZE);
-  num_in_out = (vb_offset - offset) / stride;
-  return offset;
-}
-
-#if 0
-void RenderFrame::SetInstanceDataBuffer(const InstanceDataBuffer* idb, u32 num) {
-  current.instance_data_offset = idb->offset;
-  current.instance_data_stride = idb->stride;
-  current.num_instances = (u16)min(idb->num, num);
-  current.instance_data_buffer = idb->handle;
-  C3_FREE(g_allocator, const_cast<InstanceDataBuffer*>(idb));
-}
-
-void RenderFrame::SetInstanceDataBuffer(Handle handle, u32 start_vertex, u32 num, u16 stride) {
-  current.instance_data_offset = start_vertex * stride;
-  current.instance_data_stride = stride;
-  current.num_vertices = num;
-  current.instance_data_buffer = handle;
-}
-#endif
-
-void RenderFrame::Submit(u8 view, ProgramHandle program, i32 depth) {
-  if (discard) {
-    Discard();
-    return;
-  }
-  constant_end = constant_buffer->GetPos();
-  current.constant_begin = constant_begin;
-  current.constant_end = constant_end;
-  render_items[render_item_count] = current;
-  
-  sort_key.depth = (u32)depth;
-  sort_key.view = view;
-  sort_key.program = (u16)program.idx;
-  sort_key.seq = GraphicsRenderer::Instance()->_seq[view]++;
-  if (!GraphicsRenderer::Instance()->_seq_enabled[view]) sort_key.seq = 0;
-  u64 key = sort_key.EncodeDraw();
-  sort_keys[render_item_count] = key;
-  sort_values[render_item_count] = render_item_count;
-  ++render_item_count;
-  
-  current.Clear();
-  constant_begin = constant_end;
+  return vertex_segment->AllocNum(&num_in_out, stride);
 }
 
 void RenderFrame::ResetFreeHandles() {
@@ -6,6 +6,14 @@
 #include "CommandBuffer.h"
 #include "GraphicsInterface.h"
 #include "RenderKey.h"
+#include "DrawEncoder.h"
+#include "FrameRing.h"
+
+// At least C3_MAX_DRAW_CALLS draws fit whatever holes encoders leave.
+#define C3_MAX_RENDER_ITEMS (C3_MAX_DRAW_CALLS + C3_DRAW_ENCODER_SLACK)
+#define C3_MAX_MATRIX_CACHE_SIZE (C3_MAX_MATRIX_CACHE + C3_DRAW_ENCODER_SLACK)
+// Sort key of item slots reserved but never submitted, view bits are out of range.
+#define RENDER_ITEM_HOLE UINT64_MAX
 
 class ConstantBuffer;
 
@@ -34,17 +42,20 @@ struct ViewClear {
   u16 flags;
 };
 
+// Reserve and Add are thread safe, DrawEncoders share one cache per frame.
 struct MatrixCache {
   MatrixCache(): _num(1) { _cache[0].SetIdentity(); }
   void Reset() { _num = 1; }
   u16 Reserve(u16* num_) {
-    u16 num = *num_;
-    c3_assert(_num + num < C3_MAX_MATRIX_CACHE && "Matrix cache overflow.");
-    num = min<u16>(num, C3_MAX_MATRIX_CACHE - _num);
-    u16 first = _num;
-    _num += num;
-    *num_ = num;
-    return first;
+    u32 num = *num_;
+    u32 first = _num.fetch_add(num, memory_order_relaxed);
+    c3_assert(first + num <= C3_MAX_MATRIX_CACHE_SIZE && "Matrix cache overflow.");
+    if (first >= C3_MAX_MATRIX_CACHE_SIZE) {
+      *num_ = 0;
+      return 0;
+    }
+    *num_ = (u16)min<u32>(num, C3_MAX_MATRIX_CACHE_SIZE - first);
+    return (u16)first;
   }
   u16 Add(const void* mtx, u16 num) {
     if (mtx != NULL) {
@@ -57,53 +68,50 @@ struct MatrixCache {
   float* GetBuffer(u16 cache_idx) { return _cache[cache_idx].ptr(); }
   u16 FromBuffer(const void* ptr) const { return u16((const float4x4*)ptr - _cache); }
 
-  float4x4 _cache[C3_MAX_MATRIX_CACHE];
-  u16 _num;
+  float4x4 _cache[C3_MAX_MATRIX_CACHE_SIZE];
+  atomic_u32 _num;
 };
 
 struct RectCache {
   RectCache(): _num(0) {}
   void Reset() { _num = 0; }
   u32 Add(i16 x, i16 y, i16 width, i16 height) {
-    c3_assert(_num + 1 < C3_MAX_RECT_CACHE && "Rect cache overflow.");
-
-    u32 first = _num;
-    Rect& rect = _cache[_num];
+    u32 first = _num.fetch_add(1, memory_order_relaxed);
+    c3_assert(first < C3_MAX_RECT_CACHE && "Rect cache overflow.");
+    if (first >= C3_MAX_RECT_CACHE) return UINT16_MAX;
+    Rect& rect = _cache[first];
 
     rect.left = x;
     rect.bottom = y;
     rect.right = x + width;
     rect.top = y + height;
-
-    _num++;
     return first;
   }
 
   Rect _cache[C3_MAX_RECT_CACHE];
-  u32 _num;
+  atomic_u32 _num;
 };
 
 struct RenderFrame {
-  ConstantBuffer* constant_buffer;
-  u32 constant_begin;
-  u32 constant_end;
-  u32 constant_max;
   float color_palette[C3_MAX_COLOR_PALETTE][4];
   bool color_palette_dirty;
   ClearQuad clear_quad;
 
-  RenderItem render_items[C3_MAX_DRAW_CALLS];
+  // Encoder 0 records the GraphicsRenderer calls, the others belong to threads.
+  DrawEncoder encoders[C3_MAX_DRAW_ENCODERS];
+  atomic_u32 num_reserved_items;
+  // Render items are written at their reserved slot, Finish packs the sort keys.
+  RenderItem render_items[C3_MAX_RENDER_ITEMS];
   u16 render_item_count;
-  RenderItem current;
+  bool sorted;              // keys sorted by SortKeys, Finish and Clear reset it.
 
   MatrixCache matrix_cache;
   RectCache rect_cache;
 
   u8 view_remap[C3_MAX_VIEWS];
   FrameBufferHandle fb[C3_MAX_VIEWS];
-  SortKey sort_key;
-  u64 sort_keys[C3_MAX_DRAW_CALLS];
-  u16 sort_values[C3_MAX_DRAW_CALLS];
+  u64 sort_keys[C3_MAX_RENDER_ITEMS];
+  u16 sort_values[C3_MAX_RENDER_ITEMS];
   Rect rect[C3_MAX_VIEWS];
   Rect scissor[C3_MAX_VIEWS];
   float4x4 _view[C3_MAX_VIEWS];
@@ -111,14 +119,25 @@ struct RenderFrame {
   u8 view_flags[C3_MAX_VIEWS];
   ViewClear view_clear[C3_MAX_VIEWS];
 
-  u32 ib_offset;
-  u32 vb_offset;
+  // Segments of GraphicsRenderer's FrameRing, reset by Start. Transient buffers
+  // and constant_buffer point into them.
+  FrameRingSegment* vertex_segment;
+  FrameRingSegment* index_segment;
+  FrameRingSegment* constant_segment;
   TransientIndexBuffer* transient_ib;
   TransientVertexBuffer* transient_vb;
+  ConstantBuffer* constant_buffer;    // constants of all encoders.
 
   Resolution resolution;
 
-  bool discard;
+  // Resource commands recorded by the game thread, executed by the render
+  // thread before (create/update) and after (destroy) drawing this frame.
+  CommandBuffer cmd_pre;
+  CommandBuffer cmd_post;
+  // Upload queue tickets: queued while this frame was built, and ones which must
+  // be created in it regardless of the budget because their resource is destroyed.
+  u32 upload_limit;
+  u32 upload_required;
 
   IndexBufferHandle free_index_buffer_handle[C3_MAX_INDEX_BUFFERS];
   VertexDeclHandle free_vertex_decl_handle[C3_MAX_VERTEX_DECLS];
@@ -147,29 +166,31 @@ struct RenderFrame {
   void Finish();
   void Clear();
   void Reset();
+  // Remaps views and sorts the keys. parallel uses job workers, call it from a job (or main).
+  void SortKeys(bool parallel);
+  // Called by GraphicsInterface::Submit, sorts unless already done and batches.
   void Sort();
-  void Discard();
-  void SetMarker(const char* marker);
-  void SetState(u64 state, u32 rgba);
-  void SetVertexBuffer(const TransientVertexBuffer* tvb, u32 start_vertex, u32 num_vertices);
-  void SetVertexBuffer(VertexBufferHandle handle, u32 start_vertex, u32 num_vertices);
-  void SetIndexBuffer(const TransientIndexBuffer* tib, u32 first_index, u32 num_indices);
-  void SetIndexBuffer(IndexBufferHandle handle, u32 start_index, u32 num_indices);
-  void SetTexture(u8 unit, TextureHandle handle, u32 flags);
-  void SetConstant(ConstantHandle handle, ConstantType type, const void* value, u16 num);
-  void SetScissor(i16 x, i16 y, i16 width, i16 height);
-  u16 SetTransform(const void* m, u16 num);
-  void SetTransform(u16 cache, u16 num);
-  u16 AllocTransform(float4x4*& m_out, u16& num_in_out);
+  u16 num_batched_items;    // draws folded into instanced draws by Batch.
+  // Thread safe, returns first slot and sets num to what is left.
+  u32 ReserveItems(u32* num);
+  ConstantBuffer* GetConstantBuffer() { return constant_buffer; }
+  // Thread safe. Allocs give what is left when num does not fit.
   bool CheckAvailTransientIndexBuffer(u32 num);
   u32 AllocTransientIndexBuffer(u32& num_in_out);
   bool CheckAvailTransientVertexBuffer(u32 num, u16 stride);
   u32 AllocTransientVertexBuffer(u32& num_in_out, u16 stride);
-#if 0
-  void SetInstanceDataBuffer(const InstanceDataBuffer* idb, u32 num);
-  void SetInstanceDataBuffer(Handle handle, u32 start_vertex, u32 num, u16 stride);
-#endif
-  void Submit(u8 view, ProgramHandle program, i32 tag);
-
+  // Called by Sort on the render thread, merges identical draws into instanced ones.
+  void Batch();
+  bool BatchEqual(const RenderItem& a, const RenderItem& b);
+
+  // Destroyed handles go back to their HandleAlloc once this frame is rendered.
+  void Free(IndexBufferHandle handle) { free_index_buffer_handle[num_free_index_buffer_handles++] = handle; }
+  void Free(VertexDeclHandle handle) { free_vertex_decl_handle[num_free_vertex_decl_handles++] = handle; }
+  void Free(VertexBufferHandle handle) { free_vertex_buffer_handle[num_free_vertex_buffer_handles++] = handle; }
+  void Free(ShaderHandle handle) { free_shader_handle[num_free_shader_handles++] = handle; }
+  void Free(ProgramHandle handle) { free_program_handle[num_free_program_handles++] = handle; }
+  void Free(TextureHandle handle) { free_texture_handle[num_free_texture_handles++] = handle; }
+  void Free(FrameBufferHandle handle) { free_frame_buffer_handle[num_free_frame_buffer_handles++] = handle; }
+  void Free(ConstantHandle handle) { free_constant_handle[num_free_constant_handles++] = handle; }
   void ResetFreeHandles();
 };
@@ -13,6 +13,7 @@ void RenderItem::Clear() {
   scissor = UINT16_MAX;
   matrix = 0;
   rgba = 0;
+  instance_data_buffer.Reset();
   instance_data_offset = 0;
   instance_data_stride = 0;
   num_instances = 1;
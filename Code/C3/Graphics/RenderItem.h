@@ -19,14 +19,14 @@ struct Binding {
 
 struct RenderItem {
   VertexBufferHandle vertex_buffer;
-  //Handle instance_data_buffer;
+  VertexBufferHandle instance_data_buffer;
   IndexBufferHandle index_buffer;
   VertexDeclHandle vertex_decl;
   u32 start_vertex;
   u32 num_vertices;
   u32 start_index;
   u32 num_indices;
-  u32 constant_begin;
+  u32 constant_begin;   // in RenderFrame::constant_buffer.
   u32 constant_end;
   u64 flags;
   u16 program;
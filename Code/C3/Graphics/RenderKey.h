@@ -5,22 +5,28 @@
 #define SORT_KEY_RENDER_DRAW (UINT64_C(1) << 0x36)
 #define SORT_KEY_VIEW_SHIFT  UINT8_C(0x37)
 #define SORT_KEY_VIEW_MASK   (u64(C3_MAX_VIEWS) << SORT_KEY_VIEW_SHIFT)
+// Opaque draws keep the upper depth bits below the material.
+#define SORT_KEY_MATERIAL_BITS 12
+#define SORT_KEY_MATERIAL_MASK ((1 << SORT_KEY_MATERIAL_BITS) - 1)
+#define SORT_KEY_OPAQUE_DEPTH_BITS (32 - SORT_KEY_MATERIAL_BITS)
+#define SORT_KEY_OPAQUE_DEPTH_MASK ((UINT64_C(1) << SORT_KEY_OPAQUE_DEPTH_BITS) - 1)
 
 struct SortKey {
   u32 depth;
   u16 program;
+  u16 material;   // textures and state, see DrawEncoder::Submit. Opaque only.
   u16 seq;
   u8 view;
   u8 trans;
 
   u64 EncodeDraw() {
-    // 1) non-transparent
+    // 1) non-transparent, depth is the upper 20 bits.
     // |               3               2               1               0|
     // |fedcba9876543210fedcba9876543210fedcba9876543210fedcba9876543210|
-    // | vvvvvvvvdsssssssssssttpppppppppdddddddddddddddddddddddddddddddd|
-    // |        ^^          ^ ^        ^                               ^|
-    // |        ||          | |        |                               ||
-    // |   view-+|      seq-+ +-trans  +-program                 depth-+|
+    // | vvvvvvvvdsssssssssssttpppppppppmmmmmmmmmmmmdddddddddddddddddddd|
+    // |        ^^          ^ ^        ^           ^                   ^|
+    // |        ||          | |        |           |                   ||
+    // |   view-+|      seq-+ +-trans  +-program   +-material    depth-+|
     // |         +-draw                                                 |
 
     // 2) transparent(blend enabled)
@@ -35,9 +41,10 @@ struct SortKey {
     const u64 trans_k = u64(trans) << 0x29;
     const u64 seq_k = u64(seq) << 0x2b;
     const u64 view_k = u64(view) << SORT_KEY_VIEW_SHIFT;
-    const u64 depth_k = trans ? (u64(depth) << 9) : depth;
+    const u64 depth_k = trans ? (u64(depth) << 9) : (depth >> SORT_KEY_MATERIAL_BITS);
+    const u64 material_k = trans ? 0 : u64(material & SORT_KEY_MATERIAL_MASK) << SORT_KEY_OPAQUE_DEPTH_BITS;
     const u64 program_k = trans ? (program  & (C3_MAX_PROGRAMS - 1)) : u64(program & (C3_MAX_PROGRAMS - 1)) << 0x20;
-    const u64 key = depth_k | program_k | trans_k | SORT_KEY_RENDER_DRAW | seq_k | view_k;
+    const u64 key = depth_k | material_k | program_k | trans_k | SORT_KEY_RENDER_DRAW | seq_k | view_k;
     return key;
   }
 
@@ -70,6 +77,21 @@ struct SortKey {
     return compute;
   }
 
+  // Opaque draws that differ only in depth share the prefix. Returns false
+  // for compute and transparent keys, their order has to be kept.
+  static bool DecodeInstancing(u64 key, u64* prefix, u16* program) {
+    if (!(key & SORT_KEY_RENDER_DRAW) || ((key >> 0x29) & 0x3)) return false;
+    *prefix = key & ~SORT_KEY_OPAQUE_DEPTH_MASK;
+    *program = (key >> 0x20) & (C3_MAX_PROGRAMS - 1);
+    return *program != C3_MAX_PROGRAMS - 1;
+  }
+
+  // Opaque draw key with the program replaced.
+  static u64 ReplaceProgram(u64 key, u16 program) {
+    const u64 program_mask = u64(C3_MAX_PROGRAMS - 1) << 0x20;
+    return (key & ~program_mask) | (u64(program & (C3_MAX_PROGRAMS - 1)) << 0x20);
+  }
+
   static u64 RemapView(u64 key, u8 view_remap[C3_MAX_VIEWS]) {
     const u8 old_view = u8((key & SORT_KEY_VIEW_MASK) >> SORT_KEY_VIEW_SHIFT);
     const u64 view = u64(view_remap[old_view]) << SORT_KEY_VIEW_SHIFT;
@@ -80,6 +102,7 @@ struct SortKey {
   void Reset() {
     depth = 0;
     program = 0;
+    material = 0;
     seq = 0;
     view = 0;
     trans = 0;
@@ -91,7 +114,8 @@ private:
     view = u8((key & SORT_KEY_VIEW_MASK) >> SORT_KEY_VIEW_SHIFT);
     if (key & SORT_KEY_RENDER_DRAW) {
       trans = (key >> 0x29) & 0x3;
-      depth = trans ? ((key >> 9) & 0xffffffff) : (key & 0xffffffff);
+      depth = trans ? ((key >> 9) & 0xffffffff) : u32((key & SORT_KEY_OPAQUE_DEPTH_MASK) << SORT_KEY_MATERIAL_BITS);
+      material = trans ? 0 : (key >> SORT_KEY_OPAQUE_DEPTH_BITS) & SORT_KEY_MATERIAL_MASK;
       program = (trans ? key : (key >> 0x20)) & (C3_MAX_PROGRAMS - 1);
       if (program == C3_MAX_PROGRAMS - 1) program = UINT16_MAX;
       return false; // draw
@@ -1,6 +1,21 @@
 #include "C3PCH.h"
 #include "RenderSystem.h"
 
+static_assert(C3_SHADOW_CASCADES <= 7, "Cascade bits must fit in _part_visible with CULL_MAIN_VIEW.");
+static_assert(C3_SHADOW_CASCADES == 4, "model.fs samples four shadow maps and reads their splits from a vec4.");
+// Texture unit of cascade 0's shadow map, see model.fs.
+static const u8 SHADOW_TEXTURE_UNIT = 12;
+
+// Pixels the longest side of a part's bounds covers, seen from its closest point.
+static u32 part_screen_size(const CullBounds& bounds, int i, const vec& eye, float near_dist, float pixels_per_unit) {
+  float dx = max(fabsf(bounds._cx[i] - eye.x) - bounds._ex[i], 0.f);
+  float dy = max(fabsf(bounds._cy[i] - eye.y) - bounds._ey[i], 0.f);
+  float dz = max(fabsf(bounds._cz[i] - eye.z) - bounds._ez[i], 0.f);
+  float dist = max(sqrtf(dx * dx + dy * dy + dz * dz), near_dist);
+  float size = 2.f * max(bounds._ex[i], max(bounds._ey[i], bounds._ez[i]));
+  return (u32)min(size * pixels_per_unit / dist, 65536.f);
+}
+
 RenderSystem::RenderSystem() {
   auto GR = GraphicsRenderer::Instance();
   _constant_light_type = GR->CreateConstant(String::GetID("light_type"), CONSTANT_INT);
@@ -8,13 +23,30 @@ RenderSystem::RenderSystem() {
   _constant_light_pos = GR->CreateConstant(String::GetID("light_pos"), CONSTANT_VEC3);
   _constant_light_dir = GR->CreateConstant(String::GetID("light_dir"), CONSTANT_VEC3);
   _constant_light_falloff = GR->CreateConstant(String::GetID("light_falloff"), CONSTANT_VEC4);
-  _constant_light_transform = GR->CreateConstant(String::GetID("light_transform"), CONSTANT_MAT4);
-  TextureHandle th = GR->CreateTexture2D(4096, 4096, 1, DEPTH_32_FLOAT_TEXTURE_FORMAT,
-                                         C3_TEXTURE_RT);
-  _shadow_fb = GR->CreateFrameBuffer(1, &th);
+  _constant_light_transform = GR->CreateConstant(String::GetID("light_transform"), CONSTANT_MAT4, C3_SHADOW_CASCADES);
+  _constant_shadow_splits = GR->CreateConstant(String::GetID("shadow_splits"), CONSTANT_VEC4);
+  for (auto& cascade : _cascades) {
+    TextureHandle th = GR->CreateTexture2D(C3_SHADOW_MAP_SIZE, C3_SHADOW_MAP_SIZE, 1, DEPTH_32_FLOAT_TEXTURE_FORMAT,
+                                           C3_TEXTURE_RT);
+    cascade._fb = GR->CreateFrameBuffer(1, &th);
+    cascade._valid = false;
+    cascade._split_far = 0.f;
+  }
+  _shadow_dirty_mask = 0;
 
   _num_lights = 0;
   _num_models = 0;
+  for (auto& entry : _cull_entries) {
+    entry._world = nullptr;
+    entry._world_version = 0;
+    entry._model = nullptr;
+    entry._part_offset = -1;
+    entry._num_parts = 0;
+  }
+  _bounds.Init(C3_MAX_DRAW_CALLS);
+  _num_visible_parts = 0;
+  _num_parts = 0;
+  memset(&_cull_stats, 0, sizeof(_cull_stats));
 }
 
 RenderSystem::~RenderSystem() {
@@ -25,6 +57,8 @@ RenderSystem::~RenderSystem() {
   GR->DestroyConstant(_constant_light_dir);
   GR->DestroyConstant(_constant_light_falloff);
   GR->DestroyConstant(_constant_light_transform);
+  GR->DestroyConstant(_constant_shadow_splits);
+  for (auto& cascade : _cascades) GR->DestroyFrameBuffer(cascade._fb);
 }
 
 bool RenderSystem::OwnComponentType(ComponentType type) const {
@@ -66,6 +100,7 @@ void RenderSystem::DestroyModelRenderer(EntityHandle e) {
   auto it = _model_map.find(e);
   if (it != _model_map.end()) {
     auto index = it->second;
+    if (_models[index]._asset) AssetManager::Instance()->Unload(_models[index]._asset);
     --_num_models;
     if (index != _num_models) {
       memcpy(_models + index, _models + _num_models, sizeof(ModelRenderer));
@@ -246,117 +281,321 @@ void RenderSystem::Render(float dt, bool paused) {
   camera->SetAspect(win_size.x / win_size.y);
   camera->SetClipPlane(1, 3000);
   auto camera_volume = camera->_frustum.ToPBVolume();
-
-  view = GR->PushView();
-  GR->SetViewFrameBuffer(view, _shadow_fb);
-  GR->SetViewRect(view, 0, 0, 4096, 4096);
-  GR->SetViewClear(view, C3_CLEAR_DEPTH, 0, 1.f);
-  Frustum light_frustum = GetLightFrustum(&sun_light, &camera->_frustum);
-  float4x4 light_view = light_frustum.ComputeViewMatrix();
-  float4x4 light_proj = light_frustum.ComputeProjectionMatrix();
-  GR->SetViewTransform(view, light_view.ptr(), light_proj.ptr());
-  for (int i = 0; i < _num_models; ++i) {
-    ModelRenderer* mr = _models + i;
-    if (!mr->_asset || mr->_asset->_state != ASSET_STATE_READY) continue;
-    auto transform = world->FindTransform(mr->_entity);
-    if (!transform) continue;
-    float4x4 m = float4x4::FromTRS(transform->_position, transform->_rotation, transform->_scale);
-    SpinLockGuard lock_guard(&mr->_asset->_lock);
-    if (mr->_asset->_state != ASSET_STATE_READY) continue;
-    auto model = (Model*)mr->_asset->_header->GetData();
-    for (auto part = model->_parts; part < model->_parts + model->_num_parts; ++part) {
-      //if (camera_volume.InsideOrIntersects(part->_aabb.Transform(m).MinimalEnclosingAABB()) == TestOutside) continue;
-      GR->SetTransform(&m);
-      GR->SetVertexBuffer(model->_vb);
-      GR->SetIndexBuffer(model->_ib, part->_start_index, part->_num_indices);
-      GR->SetState(C3_STATE_DEPTH_WRITE | C3_STATE_DEPTH_TEST_LESS | C3_STATE_CULL_CW);
-      float dist = light_frustum.Distance(m.TransformPos(part->_aabb.CenterPoint()));
-      auto material = (Material*)model->_materials[part->_material_index]->_header->GetData();
-      auto program = material->Apply("Forward", "Shadow");
-      GR->Submit(view, program, depth_to_bits(dist));
-    }
+  // Cascade frusta reach back to the casters of the world bounds.
+  UpdateBounds();
+
+  u32 cascade_mask = UpdateCascades(&sun_light, camera->_frustum);
+  u8 shadow_views[C3_SHADOW_CASCADES];
+  for (int c = 0; c < C3_SHADOW_CASCADES; ++c) {
+    if (!(cascade_mask & (1 << c))) continue;
+    auto& cascade = _cascades[c];
+    view = GR->PushView();
+    GR->SetViewFrameBuffer(view, cascade._fb);
+    GR->SetViewRect(view, 0, 0, C3_SHADOW_MAP_SIZE, C3_SHADOW_MAP_SIZE);
+    GR->SetViewClear(view, C3_CLEAR_DEPTH, 0, 1.f);
+    float4x4 light_view = cascade._frustum.ComputeViewMatrix();
+    float4x4 light_proj = cascade._frustum.ComputeProjectionMatrix();
+    GR->SetViewTransform(view, light_view.ptr(), light_proj.ptr());
+    // Cleared even if no caster is left in it.
+    GR->Touch(view);
+    shadow_views[c] = view;
   }
 
   view = GR->PushView();
   GR->SetViewRect(view, 0, 0, (u16)win_size.x, (u16)win_size.y);
   GR->SetViewClear(view, C3_CLEAR_COLOR | C3_CLEAR_DEPTH, 0, 1.f);
   GR->SetViewTransform(view, camera->GetViewMatrix().ptr(), camera->GetProjectionMatrix().ptr());
+  u8 main_view = view;
+
+  CullParts(camera_volume, cascade_mask);
+  u32 frame = GR->GetFrameNumber();
+  // Textures stream in the mips their parts need at this size on screen.
+  float pixels_per_unit = win_size.y * 0.5f / tanf(camera->GetVerticalFov() * 0.5f);
+  vec eye = camera->GetPos();
+  float near_dist = camera->GetNear();
+  // All views are recorded by job workers from the visible list, each into its thread's encoder.
+  JobScheduler::Instance()->ParallelFor(0, _num_visible_parts, 256, [&](int begin, int end) {
+    auto encoder = GR->GetThreadEncoder();
+    for (int i = begin; i < end;) {
+      int model_index = _part_model[_visible_parts[i]];
+      int run_end = i + 1;
+      while (run_end < end && _part_model[_visible_parts[run_end]] == model_index) ++run_end;
+      int run_begin = i;
+      i = run_end;
+      ModelRenderer* mr = _models + model_index;
+      auto& entry = _cull_entries[model_index];
+      const float4x4& m = *entry._world;
+      SpinLockGuard lock_guard(&mr->_asset->_lock);
+      if (mr->_asset->_state != ASSET_STATE_READY) continue;
+      auto model = (Model*)mr->_asset->_header->GetData();
+      if (model != entry._model) continue;
+      asset_touch(mr->_asset, frame);
+      // Every draw of the model shares one copy of its matrix.
+      u16 matrix = encoder->SetTransform(&m);
+      for (int j = run_begin; j < run_end; ++j) {
+        int part_index = _visible_parts[j];
+        auto part = model->_parts + (part_index - entry._part_offset);
+        auto material = (Material*)model->_materials[part->_material_index]->_header->GetData();
+        vec center(_bounds._cx[part_index], _bounds._cy[part_index], _bounds._cz[part_index]);
+        u8 visible = _part_visible[part_index];
+        for (int c = 0; c < C3_SHADOW_CASCADES; ++c) {
+          if (!(visible & (CULL_SHADOW_VIEW << c))) continue;
+          encoder->SetTransform(matrix);
+          encoder->SetVertexBuffer(model->_vb);
+          encoder->SetIndexBuffer(model->_ib, part->_start_index, part->_num_indices);
+          encoder->SetState(C3_STATE_DEPTH_WRITE | C3_STATE_DEPTH_TEST_LESS | C3_STATE_CULL_CW);
+          auto program = material->Apply(encoder, "Forward", "Shadow");
+          encoder->Submit(shadow_views[c], program, depth_to_bits(_cascades[c]._frustum.Distance(center)));
+        }
+        if (visible & CULL_MAIN_VIEW) {
+          ApplyLight(encoder, &sun_light);
+          encoder->SetTransform(matrix);
+          encoder->SetVertexBuffer(model->_vb);
+          encoder->SetIndexBuffer(model->_ib, part->_start_index, part->_num_indices);
+          for (int c = 0; c < C3_SHADOW_CASCADES; ++c) {
+            encoder->SetTexture(SHADOW_TEXTURE_UNIT + c, _cascades[c]._fb, 0,
+                                C3_TEXTURE_COMPARE_LESS | C3_TEXTURE_U_CLAMP | C3_TEXTURE_V_CLAMP);
+          }
+          encoder->SetState(C3_STATE_RGB_WRITE | C3_STATE_ALPHA_WRITE | C3_STATE_DEPTH_WRITE |
+                            C3_STATE_CULL_CW | C3_STATE_DEPTH_TEST_LEQUAL);
+          auto program = material->Apply(encoder, "Forward", "Geometry");
+          material->StreamTextures(part_screen_size(_bounds, part_index, eye, near_dist, pixels_per_unit));
+          encoder->Submit(main_view, program, depth_to_bits(camera->_frustum.Distance(center)));
+        }
+      }
+    }
+  });
+}
+
+void RenderSystem::UpdateBounds() {
+  // Cached shadow maps are redrawn when a caster in them moves, appears or goes away.
+  u32 cached_mask = 0;
+  for (int c = C3_SHADOW_FIRST_CACHED_CASCADE; c < C3_SHADOW_CASCADES; ++c) {
+    if (_cascades[c]._valid) cached_mask |= 1 << c;
+  }
+
+  // Serial: part offsets, an entry is dirty when its entity, model or offset changed.
+  int num_parts = 0;
+  int num_models = 0;
   for (int i = 0; i < _num_models; ++i) {
     ModelRenderer* mr = _models + i;
-    if (!mr->_asset || mr->_asset->_state != ASSET_STATE_READY) continue;
-    auto transform = world->FindTransform(mr->_entity);
-    if (!transform) continue;
-    
-    float4x4 m = float4x4::FromTRS(transform->_position, transform->_rotation, transform->_scale);
-    SpinLockGuard lock_guard(&mr->_asset->_lock);
-    if (mr->_asset->_state != ASSET_STATE_READY) continue;
-    auto model = (Model*)mr->_asset->_header->GetData();
-    for (auto part = model->_parts; part < model->_parts + model->_num_parts; ++part) {
-      if (camera_volume.InsideOrIntersects(part->_aabb.Transform(m).MinimalEnclosingAABB()) == TestOutside) continue;
-      ApplyLight(&sun_light, &light_frustum);
-      GR->SetTransform(&m);
-      GR->SetVertexBuffer(model->_vb);
-      GR->SetIndexBuffer(model->_ib, part->_start_index, part->_num_indices);
-      GR->SetTexture(15, _shadow_fb, 0, C3_TEXTURE_COMPARE_LESS);
-      GR->SetState(C3_STATE_RGB_WRITE | C3_STATE_ALPHA_WRITE | C3_STATE_DEPTH_WRITE |
-                    C3_STATE_CULL_CW | C3_STATE_DEPTH_TEST_LEQUAL);
-      float dist = camera->_frustum.Distance(m.TransformPos(part->_aabb.CenterPoint()));
-      auto material = (Material*)model->_materials[part->_material_index]->_header->GetData();
-      auto program = material->Apply("Forward", "Geometry");
-      GR->Submit(view, program, depth_to_bits(dist));
+    auto& entry = _cull_entries[i];
+    Model* model = nullptr;
+    if (mr->_asset) {
+      SpinLockGuard lock_guard(&mr->_asset->_lock);
+      if (mr->_asset->_state == ASSET_STATE_READY) model = (Model*)mr->_asset->_header->GetData();
+    }
+    // Not drawn until the render thread created its buffers.
+    if (model && !GraphicsRenderer::Instance()->IsUploaded(model->_upload)) model = nullptr;
+    if (model && num_parts + model->_num_parts > C3_MAX_DRAW_CALLS) {
+      if (entry._model) c3_log("[C3] RenderSystem: more than %d model parts, model skipped.\n", C3_MAX_DRAW_CALLS);
+      model = nullptr;
+    }
+    int num_model_parts = model ? model->_num_parts : 0;
+    if (model != entry._model || num_parts != entry._part_offset || mr->_entity.ToRaw() != entry._entity.ToRaw()) {
+      if (model || entry._model) _shadow_dirty_mask |= cached_mask;
+      entry._model = model;
+      entry._part_offset = num_parts;
+      entry._entity = mr->_entity;
+      entry._world_version = 0;
+    }
+    entry._num_parts = num_model_parts;
+    for (int p = 0; p < num_model_parts; ++p) _part_model[num_parts + p] = (u16)i;
+    num_parts += num_model_parts;
+    if (model) ++num_models;
+  }
+  _num_parts = num_parts;
+
+  // Parallel: part bounds of entries whose world matrix changed.
+  auto world = GameWorld::Instance();
+  atomic_int num_updated(0);
+  atomic_u32 dirty_mask(0);
+  JobScheduler::Instance()->ParallelFor(0, _num_models, 64, [&](int begin, int end) {
+    int updated = 0;
+    u32 dirty = 0;
+    for (int i = begin; i < end; ++i) {
+      auto& entry = _cull_entries[i];
+      if (!entry._model) continue;
+      u32 version;
+      entry._world = world->FindWorldMatrix(entry._entity, &version);
+      if (!entry._world) {
+        entry._model = nullptr;
+        entry._num_parts = 0;
+        dirty = cached_mask;
+        continue;
+      }
+      if (version == entry._world_version) continue;
+      // A reset entry already dirtied every cached cascade.
+      bool had_bounds = entry._world_version != 0;
+      entry._world_version = version;
+      ModelRenderer* mr = _models + i;
+      SpinLockGuard lock_guard(&mr->_asset->_lock);
+      if (mr->_asset->_state != ASSET_STATE_READY || (Model*)mr->_asset->_header->GetData() != entry._model) {
+        entry._model = nullptr;
+        entry._num_parts = 0;
+        dirty = cached_mask;
+        continue;
+      }
+      for (int p = 0; p < entry._num_parts; ++p) {
+        int part_index = entry._part_offset + p;
+        AABB aabb = entry._model->_parts[p]._aabb.Transform(*entry._world).MinimalEnclosingAABB();
+        if (had_bounds && (cached_mask & ~dirty)) {
+          dirty |= GetCascadesTouched(_bounds.Get(part_index), cached_mask & ~dirty);
+          dirty |= GetCascadesTouched(aabb, cached_mask & ~dirty);
+        }
+        _bounds.Set(part_index, aabb);
+      }
+      ++updated;
     }
+    num_updated += updated;
+    if (dirty) dirty_mask.fetch_or(dirty, memory_order_relaxed);
+  });
+  _shadow_dirty_mask |= dirty_mask.load(memory_order_relaxed);
+  _cull_stats.num_models = num_models;
+  _cull_stats.num_updated_models = num_updated;
+}
+
+void RenderSystem::CullParts(const PBVolume<6>& camera_volume, u32 cascade_mask) {
+  CullPlanes camera_planes;
+  CullPlanes cascade_planes[C3_SHADOW_CASCADES];
+  camera_planes.Set(camera_volume);
+  int num_cascades_drawn = 0;
+  for (int c = 0; c < C3_SHADOW_CASCADES; ++c) {
+    if (!(cascade_mask & (1 << c))) continue;
+    cascade_planes[c].Set(_cascades[c]._volume);
+    ++num_cascades_drawn;
   }
+  atomic_int num_visible(0), num_shadow_visible(0);
+  // Grain keeps every batch start on a SIMD boundary.
+  JobScheduler::Instance()->ParallelFor(0, _num_parts, 128 * C3_CULL_SIMD_WIDTH, [&](int begin, int end) {
+    memset(_part_visible + begin, 0, end - begin);
+    num_visible += cull_boxes(_bounds, begin, end, camera_planes, CULL_MAIN_VIEW, _part_visible);
+    // Cascades reusing their cached map need no casters.
+    int shadow_visible = 0;
+    for (int c = 0; c < C3_SHADOW_CASCADES; ++c) {
+      if (!(cascade_mask & (1 << c))) continue;
+      shadow_visible += cull_boxes(_bounds, begin, end, cascade_planes[c], (u8)(CULL_SHADOW_VIEW << c), _part_visible);
+    }
+    num_shadow_visible += shadow_visible;
+  });
+  // Parts of models dropped by UpdateBounds keep their slot but are never drawn.
+  int n = 0;
+  for (int i = 0; i < _num_parts; ++i) {
+    if (_part_visible[i] && _cull_entries[_part_model[i]]._model) _visible_parts[n++] = i;
+  }
+  _num_visible_parts = n;
+  _cull_stats.num_parts = _num_parts;
+  _cull_stats.num_visible = num_visible;
+  _cull_stats.num_shadow_visible = num_shadow_visible;
+  _cull_stats.num_culled = _num_parts - n;
+  _cull_stats.num_cascades_drawn = num_cascades_drawn;
 }
 
-void RenderSystem::ApplyLight(Light* light, Frustum* light_frustum) {
-  int type = light->_type;
-  float3 color = *(const float3*)&light->_color * light->_intensity;
-  float4 falloff(light->_dist_falloff.x, light->_dist_falloff.y,
-                 Cos(light->_angle_falloff.x), Cos(light->_angle_falloff.y));
-  auto GR = GraphicsRenderer::Instance();
-  GR->SetConstant(_constant_light_type, &type);
-  GR->SetConstant(_constant_light_color, &color);
-  GR->SetConstant(_constant_light_pos, &light->_pos);
-  GR->SetConstant(_constant_light_dir, &light->_dir);
-  GR->SetConstant(_constant_light_falloff, &falloff);
-  
-  float4x4 m = float4x4::Translate(0.5f, 0.5f, 0.f) * float4x4::Scale(0.5f, -0.5f, 1.f) * light_frustum->ComputeViewProjMatrix();
-  GR->SetConstant(_constant_light_transform, &m);
-}
-
-Frustum RenderSystem::GetLightFrustum(Light* light, Frustum* camera_frustum) const {
-  vec points[8];
-  camera_frustum->GetCornerPoints(points);
-  float3 r0, r1, r2;
-  r2 = light->_dir;
+u32 RenderSystem::UpdateCascades(const Light* light, const Frustum& camera_frustum) {
+  float3 r0, r1;
+  const float3& r2 = light->_dir;
   r2.PerpendicularBasis(r0, r1);
-  AABB axis_aabb;
-  axis_aabb.SetNegativeInfinity();
+  _light_axes[0] = r0;
+  _light_axes[1] = r1;
+  _light_axes[2] = r2;
+
+  // Casters between a split and the light shadow it too, cascades start at the nearest one.
+  float3 a2 = r2.Abs();
+  float scene_near = FLT_MAX;
+  for (int i = 0; i < _num_parts; ++i) {
+    if (!_cull_entries[_part_model[i]]._model) continue;
+    float d = _bounds._cx[i] * r2.x + _bounds._cy[i] * r2.y + _bounds._cz[i] * r2.z;
+    float e = _bounds._ex[i] * a2.x + _bounds._ey[i] * a2.y + _bounds._ez[i] * a2.z;
+    scene_near = min(scene_near, d - e);
+  }
 
-  for (int i = 0; i < _num_models; ++i) {
-    auto mr = _models + i;
-    if (!mr->_asset || mr->_asset->_state != ASSET_STATE_READY) continue;
-    auto transform = GameWorld::Instance()->FindTransform(mr->_entity);
-    if (!transform) continue;
-    float4x4 m = float4x4::FromTRS(transform->_position, transform->_rotation, transform->_scale);
-    auto model = (Model*)mr->_asset->_header->GetData();
-    model->_aabb.GetCornerPoints(points);
-    for (int j = 0; j < 8; ++j) {
-      float d1 = points[j].Dot(r0);
-      float d2 = points[j].Dot(r1);
-      float d3 = points[j].Dot(r2);
-      axis_aabb.Enclose(vec(d1, d2, d3));
+  // Splits blend logarithmic and uniform distances. Each is bounded by a sphere
+  // on the view axis, its size doesn't change when the camera turns.
+  float n = camera_frustum.NearPlaneDistance();
+  float f = camera_frustum.FarPlaneDistance();
+  float tan_x = Tan(camera_frustum.HorizontalFov() * 0.5f);
+  float tan_y = Tan(camera_frustum.VerticalFov() * 0.5f);
+  float k2 = tan_x * tan_x + tan_y * tan_y;
+  u32 draw_mask = 0;
+  float split_near = n;
+  for (int c = 0; c < C3_SHADOW_CASCADES; ++c) {
+    float t = (c + 1) / (float)C3_SHADOW_CASCADES;
+    float split_far = C3_SHADOW_SPLIT_LAMBDA * n * Pow(f / n, t) + (1.f - C3_SHADOW_SPLIT_LAMBDA) * (n + (f - n) * t);
+    if (c == C3_SHADOW_CASCADES - 1) split_far = f;
+    // Same distance to the near and far corners of the split, at most its far plane.
+    float z = min((split_near + split_far) * (1.f + k2) * 0.5f, split_far);
+    float radius = Sqrt((split_far - z) * (split_far - z) + split_far * split_far * k2);
+    vec p = camera_frustum.Pos() + camera_frustum.Front() * z;
+    float3 center(p.Dot(r0), p.Dot(r1), p.Dot(r2));
+    split_near = split_far;
+
+    auto& cascade = _cascades[c];
+    cascade._split_far = split_far;
+    if (c >= C3_SHADOW_FIRST_CACHED_CASCADE && cascade._valid && cascade._light_dir.Equals(r2, 1e-6f) &&
+        Abs(cascade._radius - radius) <= radius * 0.01f &&
+        Abs(center.x - cascade._center.x) + radius <= cascade._half_size &&
+        Abs(center.y - cascade._center.y) + radius <= cascade._half_size &&
+        center.z + radius <= cascade._far && scene_near >= cascade._near) {
+      // Split still inside the cached frustum, redrawn only if its casters changed.
+      if (_shadow_dirty_mask & (1 << c)) draw_mask |= 1 << c;
+      continue;
     }
+    float half_size = c >= C3_SHADOW_FIRST_CACHED_CASCADE ? radius * (1.f + C3_SHADOW_CACHE_MARGIN) : radius;
+    cascade._radius = radius;
+    FitCascade(&cascade, center, half_size, scene_near);
+    draw_mask |= 1 << c;
+  }
+  _shadow_dirty_mask = 0;
+  for (int c = 0; c < C3_SHADOW_CASCADES; ++c) {
+    _light_transforms[c] = _cascades[c]._light_transform;
+    _shadow_splits[c] = _cascades[c]._split_far;
+  }
+  return draw_mask;
+}
+
+void RenderSystem::FitCascade(ShadowCascade* cascade, const float3& center, float half_size, float scene_near) {
+  // Center moves in whole texels so edges don't crawl with the camera, half a
+  // texel more keeps the split inside after rounding.
+  float texel = 2.f * half_size / (C3_SHADOW_MAP_SIZE - 1);
+  half_size += texel * 0.5f;
+  cascade->_center.Set(Round(center.x / texel) * texel, Round(center.y / texel) * texel);
+  cascade->_half_size = half_size;
+  cascade->_near = min(scene_near, center.z - half_size);
+  cascade->_far = center.z + half_size;
+  cascade->_light_dir = _light_axes[2];
+
+  Frustum& frustum = cascade->_frustum;
+  frustum.SetKind(FrustumSpaceD3D, FrustumRightHanded);
+  float3 p = cascade->_center.x * _light_axes[0] + cascade->_center.y * _light_axes[1] + cascade->_near * _light_axes[2];
+  frustum.SetFrame(p, _light_axes[2], _light_axes[1]);
+  frustum.SetOrthographic(2.f * half_size, 2.f * half_size);
+  frustum.SetViewPlaneDistances(0.f, cascade->_far - cascade->_near);
+  cascade->_volume = frustum.ToPBVolume();
+  cascade->_light_transform = float4x4::Translate(0.5f, 0.5f, 0.f) * float4x4::Scale(0.5f, -0.5f, 1.f) *
+                              frustum.ComputeViewProjMatrix();
+  cascade->_valid = true;
+}
+
+u32 RenderSystem::GetCascadesTouched(const AABB& aabb, u32 mask) const {
+  u32 touched = 0;
+  for (int c = 0; c < C3_SHADOW_CASCADES; ++c) {
+    if ((mask & (1 << c)) && _cascades[c]._volume.InsideOrIntersects(aabb) != TestOutside) touched |= 1 << c;
   }
-  Frustum light_frustum;
-  light_frustum.SetKind(FrustumSpaceD3D, FrustumRightHanded);
-  auto axis_size = axis_aabb.Size();
-  auto center = axis_aabb.CenterPoint();
-  float3 p = center.x * r0 + center.y * r1 + axis_aabb.minPoint.z * r2;
-  light_frustum.SetFrame(p, r2, r1);
-  light_frustum.SetOrthographic(axis_size.x, axis_size.y);
-  light_frustum.SetViewPlaneDistances(0.f, axis_size.z);
-  return light_frustum;
+  return touched;
+}
+
+void RenderSystem::ApplyLight(DrawEncoder* encoder, Light* light) {
+  int type = light->_type;
+  float3 color = *(const float3*)&light->_color * light->_intensity;
+  float4 falloff(light->_dist_falloff.x, light->_dist_falloff.y,
+                 Cos(light->_angle_falloff.x), Cos(light->_angle_falloff.y));
+  encoder->SetConstant(_constant_light_type, &type);
+  encoder->SetConstant(_constant_light_color, &color);
+  encoder->SetConstant(_constant_light_pos, &light->_pos);
+  encoder->SetConstant(_constant_light_dir, &light->_dir);
+  encoder->SetConstant(_constant_light_falloff, &falloff);
+  encoder->SetConstant(_constant_light_transform, _light_transforms, C3_SHADOW_CASCADES);
+  encoder->SetConstant(_constant_shadow_splits, &_shadow_splits);
 }
 
 void RenderSystem::SerializeModels(BlobWriter& writer) {
@@ -404,6 +643,7 @@ void RenderSystem::DeserializeModels(BlobReader& reader, EntityResourceDeseriali
     mr->_entity = ctx._entities[idx];
     uintptr_t asset_iptr = (uintptr_t)mr->_asset;
     mr->_asset = ctx._assets[asset_iptr];
+    if (mr->_asset) AssetManager::Instance()->AddRef(mr->_asset);
   }
 }
 
@@ -4,6 +4,18 @@
 #include "ECS/System.h"
 #include "Graphics/Model/ModelRenderer.h"
 #include "Graphics/Light/Light.h"
+#include "Graphics/Culling.h"
+
+// Counted in parts, a model part is one draw per view.
+struct RenderCullStats {
+  int num_models;             // renderable this frame.
+  int num_updated_models;     // world bounds recomputed.
+  int num_parts;
+  int num_visible;            // main view.
+  int num_shadow_visible;     // shadow casters drawn, summed over cascades.
+  int num_culled;             // in neither view.
+  int num_cascades_drawn;     // the other cascades reused their cached map.
+};
 
 class RenderSystem : public ISystem {
 public:
@@ -43,10 +55,46 @@ public:
   Light* GetLights(int* num_lights) const;
 
   void Render(float dt, bool paused) override;
+  // Of the last Render.
+  const RenderCullStats& GetCullStats() const { return _cull_stats; }
 
 private:
-  void ApplyLight(Light* light, Frustum* light_frustum);
-  Frustum GetLightFrustum(Light* light, Frustum* camera_frustum) const;
+  enum {
+    CULL_MAIN_VIEW = 1,
+    CULL_SHADOW_VIEW = 2,     // of cascade 0, cascade c is CULL_SHADOW_VIEW << c.
+  };
+  // Light frustum fit to one split of the camera frustum. Cached cascades keep
+  // it and their map until the split leaves it or a caster inside it moves.
+  struct ShadowCascade {
+    Frustum _frustum;
+    PBVolume<6> _volume;
+    float4x4 _light_transform;  // world to shadow map uv and depth.
+    float3 _light_dir;
+    float2 _center;             // light space, along _light_axes[0] and [1].
+    float _half_size;
+    float _near;                // light space depth of the near and far planes.
+    float _far;
+    float _radius;              // of the split sphere it was fit to.
+    float _split_far;           // view depth where its split ends.
+    FrameBufferHandle _fb;
+    bool _valid;
+  };
+  // Same index as _models, bounds are kept until the world matrix version changes.
+  struct ModelCullEntry {
+    const float4x4* _world;   // GameWorld cache, valid for this frame.
+    u32 _world_version;       // 0 forces a bounds update.
+    EntityHandle _entity;
+    Model* _model;          // nullptr if not renderable this frame.
+    int _part_offset;       // into _bounds.
+    int _num_parts;
+  };
+  void UpdateBounds();
+  void CullParts(const PBVolume<6>& camera_volume, u32 cascade_mask);
+  // Fits the cascades to the camera splits, returns the mask of cascades to draw this frame.
+  u32 UpdateCascades(const Light* light, const Frustum& camera_frustum);
+  void FitCascade(ShadowCascade* cascade, const float3& center, float half_size, float scene_near);
+  u32 GetCascadesTouched(const AABB& aabb, u32 mask) const;
+  void ApplyLight(DrawEncoder* encoder, Light* light);
   void SerializeModels(BlobWriter& writer);
   void SerializeLights(BlobWriter& writer);
   void DeserializeModels(BlobReader& reader, EntityResourceDeserializeContext& ctx);
@@ -55,6 +103,15 @@ private:
   ModelRenderer _models[C3_MAX_MODEL_RENDERERS];
   int _num_models;
   unordered_map<EntityHandle, int> _model_map;
+  // Filled by UpdateBounds and CullParts, parts of a model are contiguous.
+  ModelCullEntry _cull_entries[C3_MAX_MODEL_RENDERERS];
+  CullBounds _bounds;
+  u16 _part_model[C3_MAX_DRAW_CALLS];
+  u8 _part_visible[C3_MAX_DRAW_CALLS];      // CULL_MAIN_VIEW | CULL_SHADOW_VIEW << cascade
+  int _visible_parts[C3_MAX_DRAW_CALLS];    // ascending part index.
+  int _num_visible_parts;
+  int _num_parts;
+  RenderCullStats _cull_stats;
 
   Light _lights[C3_MAX_LIGHTS];
   int _num_lights;
@@ -65,7 +122,13 @@ private:
   ConstantHandle _constant_light_pos;
   ConstantHandle _constant_light_dir;
   ConstantHandle _constant_light_falloff;
-  ConstantHandle _constant_light_transform;
+  ConstantHandle _constant_light_transform;  // one per cascade.
+  ConstantHandle _constant_shadow_splits;
+  // Of all cascades for model.fs, which picks one per pixel. Set by UpdateCascades.
+  float4x4 _light_transforms[C3_SHADOW_CASCADES];
+  float4 _shadow_splits;
 
-  FrameBufferHandle _shadow_fb;
+  ShadowCascade _cascades[C3_SHADOW_CASCADES];
+  float3 _light_axes[3];          // light space basis, [2] is the light dir.
+  u32 _shadow_dirty_mask;         // cached cascades whose casters moved since they were drawn.
 };
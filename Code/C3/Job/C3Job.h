@@ -1,5 +1,6 @@
 #pragma once
 
 #include "Job/Job.h"
+#include "Job/FiberPool.h"
 #include "Job/JobScheduler.h"
 #include "Job/ThreadAffinity.h"
\ No newline at end of file
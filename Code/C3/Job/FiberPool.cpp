@@ -0,0 +1,129 @@
+#include "C3PCH.h"
+#include "FiberPool.h"
+
+FiberPool::FiberPool() {
+  for (int i = 0; i < NUM_FIBER_STACK_CLASSES; ++i) {
+    auto& c = _classes[i];
+    c._free_fibers.reserve(C3_MAX_FIBERS);
+    c._num_created = 0;
+    c._num_in_use = 0;
+    c._high_water = 0;
+    _reserved_size[i] = Fiber::GetReservedSize(GetStackSize((FiberStackClass)i));
+  }
+  _max_reserved_bytes = C3_FIBER_STACK_ADDRESS_SPACE;
+  _reserved_bytes = 0;
+  _num_fibers = 0;
+  _num_cap_waits = 0;
+  _num_failed_reserves = 0;
+}
+
+FiberPool::~FiberPool() {
+  for (auto& c : _classes) {
+    for (auto fiber : c._free_fibers) C3_DELETE(mem_allocator(MEMORY_TAG_JOB), fiber);
+    c._free_fibers.clear();
+  }
+}
+
+u32 FiberPool::GetStackSize(FiberStackClass stack_class) {
+  return stack_class == FIBER_STACK_LARGE ? C3_FIBER_LARGE_STACK_SIZE : C3_FIBER_SMALL_STACK_SIZE;
+}
+
+Fiber* FiberPool::Get(FiberStackClass stack_class) {
+  auto& c = _classes[stack_class];
+  Fiber* fiber = nullptr;
+  for (;;) {
+    {
+      SpinLockGuard lock_guard(&c._lock);
+      if (!c._free_fibers.empty()) {
+        fiber = c._free_fibers.back();
+        c._free_fibers.pop_back();
+      }
+    }
+    if (fiber) break;
+    if (ClaimReserve(stack_class)) {
+      fiber = C3_NEW(mem_allocator(MEMORY_TAG_JOB), Fiber)(GetStackSize(stack_class));
+      if (!fiber->Reserve()) {
+        C3_DELETE(mem_allocator(MEMORY_TAG_JOB), fiber);
+        ReleaseReserve(stack_class);
+        ++_num_failed_reserves;
+        c3_log("[C3] FiberPool: failed to reserve a %u KB stack, %.1f MB reserved by fibers.\n",
+               GetStackSize(stack_class) >> 10, _reserved_bytes.load() / (1024.0 * 1024.0));
+        return nullptr;
+      }
+      ++c._num_created;
+      break;
+    }
+    // The cap may be taken by free fibers of the other class.
+    if (ReleaseFreeFiber(stack_class)) continue;
+    ++_num_cap_waits;
+    return nullptr;
+  }
+  int num_in_use = ++c._num_in_use;
+  int high_water = c._high_water;
+  while (num_in_use > high_water && !c._high_water.compare_exchange_weak(high_water, num_in_use));
+  return fiber;
+}
+
+void FiberPool::Put(Fiber* fiber) {
+  auto& c = _classes[fiber->GetStackSize() == C3_FIBER_LARGE_STACK_SIZE ? FIBER_STACK_LARGE : FIBER_STACK_SMALL];
+  --c._num_in_use;
+  SpinLockGuard lock_guard(&c._lock);
+  c._free_fibers.push_back(fiber);
+}
+
+bool FiberPool::ClaimReserve(FiberStackClass stack_class) {
+  u64 size = _reserved_size[stack_class];
+  if (_num_fibers.fetch_add(1) >= C3_MAX_FIBERS) {
+    --_num_fibers;
+    return false;
+  }
+  if (_reserved_bytes.fetch_add(size) + size > _max_reserved_bytes) {
+    _reserved_bytes.fetch_sub(size);
+    --_num_fibers;
+    return false;
+  }
+  return true;
+}
+
+void FiberPool::ReleaseReserve(FiberStackClass stack_class) {
+  _reserved_bytes.fetch_sub(_reserved_size[stack_class]);
+  --_num_fibers;
+}
+
+bool FiberPool::ReleaseFreeFiber(FiberStackClass stack_class) {
+  for (int i = 0; i < NUM_FIBER_STACK_CLASSES; ++i) {
+    if (i == stack_class) continue;
+    auto& c = _classes[i];
+    Fiber* fiber = nullptr;
+    {
+      SpinLockGuard lock_guard(&c._lock);
+      if (!c._free_fibers.empty()) {
+        fiber = c._free_fibers.back();
+        c._free_fibers.pop_back();
+      }
+    }
+    if (!fiber) continue;
+    C3_DELETE(mem_allocator(MEMORY_TAG_JOB), fiber);
+    --c._num_created;
+    ReleaseReserve((FiberStackClass)i);
+    return true;
+  }
+  return false;
+}
+
+void FiberPool::GetStats(FiberPoolStats* stats) const {
+  for (int i = 0; i < NUM_FIBER_STACK_CLASSES; ++i) {
+    auto& c = _classes[i];
+    stats->num_created[i] = c._num_created;
+    stats->num_in_use[i] = c._num_in_use;
+    stats->high_water[i] = c._high_water;
+  }
+  stats->num_cap_waits = _num_cap_waits;
+  stats->num_failed_reserves = _num_failed_reserves;
+  stats->reserved_bytes = _reserved_bytes.load(memory_order_relaxed);
+  stats->max_reserved_bytes = _max_reserved_bytes;
+}
+
+void FiberPool::ResetHighWater() {
+  for (auto& c : _classes) c._high_water = c._num_in_use.load();
+}
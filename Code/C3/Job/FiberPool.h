@@ -0,0 +1,58 @@
+#pragma once
+#include "Platform/C3Platform.h"
+
+struct FiberPoolStats {
+  u32 num_created[NUM_FIBER_STACK_CLASSES];    // live, free or in use.
+  u32 num_in_use[NUM_FIBER_STACK_CLASSES];
+  u32 high_water[NUM_FIBER_STACK_CLASSES];    // max fibers in use at the same time.
+  u32 num_cap_waits;                          // Get calls which found the pool at its cap.
+  u32 num_failed_reserves;                    // stacks the platform could not reserve.
+  u64 reserved_bytes;                         // stack address space of created fibers.
+  u64 max_reserved_bytes;
+};
+
+/*
+* FiberPool keeps a free list per stack size class. When a class runs empty a
+* new fiber is created, so only hitting C3_MAX_FIBERS or the stack address
+* space cap makes Get fail. At the cap, free fibers of the other class are
+* released to make room first. Stacks are reserved with lazy commit, unused
+* parts cost address space only.
+*/
+class FiberPool {
+public:
+  FiberPool();
+  ~FiberPool();
+
+  // nullptr at the cap or if the platform failed to reserve a new stack,
+  // never waits.
+  Fiber* Get(FiberStackClass stack_class);
+  void Put(Fiber* fiber);
+  void GetStats(FiberPoolStats* stats) const;
+  void ResetHighWater();
+  static u32 GetStackSize(FiberStackClass stack_class);
+
+private:
+  FiberPool(const FiberPool&);
+  FiberPool& operator =(const FiberPool&);
+
+  struct SizeClass {
+    SpinLock _lock;
+    vector<Fiber*> _free_fibers;
+    atomic_int _num_created;
+    atomic_int _num_in_use;
+    atomic_int _high_water;
+  };
+  // Reserves the stack address space of a new fiber of the class, false at the cap.
+  bool ClaimReserve(FiberStackClass stack_class);
+  void ReleaseReserve(FiberStackClass stack_class);
+  // Deletes a free fiber of another class, false if there is none.
+  bool ReleaseFreeFiber(FiberStackClass stack_class);
+
+  SizeClass _classes[NUM_FIBER_STACK_CLASSES];
+  u64 _reserved_size[NUM_FIBER_STACK_CLASSES];    // per fiber.
+  u64 _max_reserved_bytes;
+  atomic<u64> _reserved_bytes;
+  atomic_int _num_fibers;
+  atomic_int _num_cap_waits;
+  atomic_int _num_failed_reserves;
+};
@@ -12,14 +12,18 @@ struct Job {
   JobFn _fn;
   void* _user_data;
   JobType _type;
+  FiberStackClass _stack_class;
 
-  void Init(JobFn fn, void* user_data, JobType type) {
+  void Init(JobFn fn, void* user_data, JobType type, FiberStackClass stack_class = FIBER_STACK_SMALL) {
     _fn = fn;
     _user_data = user_data;
     _type = type;
-    _type = JOB_TYPE_WORKER;
+    _stack_class = stack_class;
+  }
+  // Use FIBER_STACK_LARGE for loaders and parsers with deep call stacks.
+  void InitWorkerJob(JobFn fn, void* user_data, FiberStackClass stack_class = FIBER_STACK_SMALL) {
+    Init(fn, user_data, JOB_TYPE_WORKER, stack_class);
   }
-  void InitWorkerJob(JobFn fn, void* user_data) { Init(fn, user_data, JOB_TYPE_WORKER); }
   void InitMainJob(JobFn fn, void* user_data) { Init(fn, user_data, JOB_TYPE_MAIN); }
 };
 
@@ -0,0 +1,93 @@
+#pragma once
+#include "Platform/PlatformSync.h"
+#include "Memory/Allocator.h"
+
+struct JobNode;
+
+/*
+* JobDeque is a Chase-Lev work-stealing deque of JobNode pointers.
+* Only the owner thread may call Push/Pop (LIFO end), any thread
+* may call Steal (FIFO end).
+*
+* The buffer is not growable: SIZE must be a power of two not less than
+* the number of JobNodes alive at the same time (C3_MAX_JOBS).
+*/
+template <u32 SIZE>
+class JobDequeT {
+public:
+  static_assert((SIZE & (SIZE - 1)) == 0, "JobDeque size must be power of two.");
+
+  JobDequeT(): _top(0), _bottom(0) {
+    for (u32 i = 0; i < SIZE; ++i) _entries[i].store(nullptr, memory_order_relaxed);
+  }
+
+  // Owner only.
+  void Push(JobNode* job_node) {
+    i64 b = _bottom.load(memory_order_relaxed);
+    i64 t = _top.load(memory_order_acquire);
+    c3_assert(b - t < (i64)SIZE && "JobDeque overflow.");
+    _entries[b & (SIZE - 1)].store(job_node, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    _bottom.store(b + 1, memory_order_relaxed);
+  }
+
+  // Owner only.
+  JobNode* Pop() {
+    i64 b = _bottom.load(memory_order_relaxed) - 1;
+    _bottom.store(b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    i64 t = _top.load(memory_order_relaxed);
+    JobNode* job_node = nullptr;
+    if (t <= b) {
+      job_node = _entries[b & (SIZE - 1)].load(memory_order_relaxed);
+      if (t == b) {
+        // Last entry, race against thieves.
+        if (!_top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+          job_node = nullptr;
+        }
+        _bottom.store(b + 1, memory_order_relaxed);
+      }
+    } else {
+      _bottom.store(b + 1, memory_order_relaxed);
+    }
+    return job_node;
+  }
+
+  // Any thread. Returns nullptr if empty or lost the race.
+  JobNode* Steal() {
+    i64 t = _top.load(memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    i64 b = _bottom.load(memory_order_acquire);
+    if (t >= b) return nullptr;
+    JobNode* job_node = _entries[t & (SIZE - 1)].load(memory_order_relaxed);
+    if (!_top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+      return nullptr;
+    }
+    return job_node;
+  }
+
+  bool IsEmpty() const {
+    i64 b = _bottom.load(memory_order_relaxed);
+    i64 t = _top.load(memory_order_relaxed);
+    return b <= t;
+  }
+
+  i64 SizeGuess() const {
+    i64 b = _bottom.load(memory_order_relaxed);
+    i64 t = _top.load(memory_order_relaxed);
+    return b > t ? b - t : 0;
+  }
+
+private:
+  JobDequeT(const JobDequeT&) = delete;
+  JobDequeT& operator =(const JobDequeT&) = delete;
+
+  // Keep thieves (_top) and owner (_bottom) on separate cache lines.
+  atomic_i64 _top;
+  u8 _pad0[CACHELINE_SIZE - sizeof(atomic_i64)];
+  atomic_i64 _bottom;
+  u8 _pad1[CACHELINE_SIZE - sizeof(atomic_i64)];
+  atomic<JobNode*> _entries[SIZE];
+};
+
+typedef JobDequeT<C3_MAX_JOBS> JobDeque;
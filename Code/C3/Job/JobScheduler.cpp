@@ -8,14 +8,22 @@ DEFINE_SINGLETON_INSTANCE(JobScheduler);
 JobScheduler::JobScheduler() {
   _num_workers = 0;
   _require_exit = 0;
-  _wait_allocator.Init(sizeof(JobWaitListNode), ALIGN_OF(JobWaitListNode), C3_MAX_JOBS, g_allocator);
-  _job_allocator.Init(sizeof(JobNode), ALIGN_OF(JobNode), C3_MAX_JOBS, g_allocator);
-  for (int t = 0; t < NUM_JOB_TYPES; ++t) {
-    INIT_LIST_HEAD(&_job_queues[t]);
+  _wait_allocator.Init(sizeof(JobWaitListNode), ALIGN_OF(JobWaitListNode), C3_MAX_JOBS, mem_allocator(MEMORY_TAG_JOB));
+  _job_allocator.Init(sizeof(JobNode), ALIGN_OF(JobNode), C3_MAX_JOBS, mem_allocator(MEMORY_TAG_JOB));
+  INIT_LIST_HEAD(&_main_queue);
+  INIT_LIST_HEAD(&_global_queue);
+  _num_global_jobs = 0;
+  _num_parked = 0;
+  for (int i = 0; i < C3_MAX_WORKER_THREADS; ++i) {
+    _parking[i]._parked = false;
+    _parking[i]._wake_tick = 0;
   }
+  ResetStats();
   INIT_LIST_HEAD(&_wait_list);
+  INIT_LIST_HEAD(&_fiber_wait_list);
+  _num_fiber_waits = 0;
 
-  _fiber_pool = C3_NEW(g_allocator, FiberPool);
+  _fiber_pool = C3_NEW(mem_allocator(MEMORY_TAG_JOB), FiberPool);
   _root_job = C3_NEW(&_job_allocator, JobNode);
   memset(_root_job, 0, sizeof(JobNode));
   _root_job->_type = JOB_TYPE_MAIN;
@@ -28,44 +36,197 @@ JobScheduler::JobScheduler() {
 JobScheduler::~JobScheduler() {}
 
 void JobScheduler::Init(int num_workers) {
+  _num_workers = clamp<int>(num_workers, 1, C3_MAX_WORKER_THREADS);
   RegisterWorkerThread(0);
-  auto sched_fiber = _fiber_pool->GetWait();
+  auto sched_fiber = _fiber_pool->Get(FIBER_STACK_SMALL);
+  c3_assert(sched_fiber && "No address space for the main schedule fiber.");
   sched_fiber->Prepare(&JobScheduler::MainScheduleFiber, sched_fiber);
   _root_job->_fiber->SetState(FIBER_STATE_SUSPENDED);
   sched_fiber->Resume();
 
-  _num_workers = min<int>(C3_MAX_WORKER_THREADS, num_workers);
   for (int i = 1; i < _num_workers; ++i) {
     char thread_name[128];
     snprintf(thread_name, sizeof(thread_name), "Worker%d", i);
-    _worker_threads[i].Init(&JobScheduler::WorkerThread, (void*)i, 0, thread_name, i);
+    _worker_threads[i].Init(&JobScheduler::WorkerThread, (void*)(intptr_t)i, 0, thread_name, i);
   }
 }
 
-atomic_int* JobScheduler::SubmitJobs(Job* start_job, int num_jobs) {
-  if (num_jobs <= 0) return nullptr;
-  _wait_lock.Lock();
+JobWaitListNode* JobScheduler::NewWaitList(int num_jobs) {
+  SpinLockGuard lock_guard(&_wait_lock);
   JobWaitListNode* wait_list = C3_NEW(&_wait_allocator, JobWaitListNode);
   wait_list->_label = num_jobs;
+  wait_list->_drained = 0;
+  wait_list->_join = false;
   wait_list->_wait_value = 0;
   INIT_LIST_HEAD(&wait_list->_job_list);
   list_add_tail(&wait_list->_link, &_wait_list);
-  _wait_lock.Unlock();
-  JobNode* job_node;
+  return wait_list;
+}
+
+JobNode* JobScheduler::NewJobNode(const Job& job, atomic_int* label) {
+  JobNode* job_node = C3_NEW(&_job_allocator, JobNode);
+  c3_assert(job_node && "More than C3_MAX_JOBS jobs alive.");
+  job_node->_fn = job._fn;
+  job_node->_user_data = job._user_data;
+  job_node->_type = job._type;
+  job_node->_stack_class = job._stack_class;
+  job_node->_fiber = nullptr;
+  job_node->_label = label;
+  job_node->_reschedule = false;
+  INIT_LIST_HEAD(&job_node->_link);
+  return job_node;
+}
+
+atomic_int* JobScheduler::SubmitJobs(Job* start_job, int num_jobs) {
+  if (num_jobs <= 0) return nullptr;
+  JobWaitListNode* wait_list = NewWaitList(num_jobs);
   for (Job* job = start_job; job < start_job + num_jobs; ++job) {
-    job_node = C3_NEW(&_job_allocator, JobNode);
-    job_node->_fn = job->_fn;
-    job_node->_user_data = job->_user_data;
-    job_node->_type = job->_type;
-    job_node->_fiber = nullptr;
-    job_node->_label = &wait_list->_label;
-    job_node->_reschedule = false;
-    INIT_LIST_HEAD(&job_node->_link);
-    AddJob(job_node);
+    AddJob(NewJobNode(*job, &wait_list->_label));
+  }
+  WakeWorkers(start_job->_type, num_jobs);
+  return &wait_list->_label;
+}
+
+atomic_int* JobScheduler::SubmitJobsAfter(atomic_int* dependency, Job* start_job, int num_jobs) {
+  if (!dependency) return SubmitJobs(start_job, num_jobs);
+  if (num_jobs <= 0) return nullptr;
+  JobWaitListNode* wait_list = NewWaitList(num_jobs);
+  JobWaitListNode* dep_wait_list = container_of(dependency, JobWaitListNode, _label);
+  dep_wait_list->_lock.Lock();
+  if (*dependency != dep_wait_list->_wait_value) {
+    // Parked on dependency's job list without fiber, DoJob queues them on completion.
+    for (Job* job = start_job; job < start_job + num_jobs; ++job) {
+      JobNode* job_node = NewJobNode(*job, &wait_list->_label);
+      list_add_tail(&job_node->_link, &dep_wait_list->_job_list);
+    }
+    dep_wait_list->_lock.Unlock();
+  } else {
+    dep_wait_list->_lock.Unlock();
+    for (Job* job = start_job; job < start_job + num_jobs; ++job) {
+      AddJob(NewJobNode(*job, &wait_list->_label));
+    }
+    WakeWorkers(start_job->_type, num_jobs);
+  }
+  return &wait_list->_label;
+}
+
+atomic_int* JobScheduler::SubmitJobsAfter(atomic_int* const* dependencies, int num_dependencies, Job* start_job,
+                                          int num_jobs) {
+  if (num_dependencies <= 1) return SubmitJobsAfter(num_dependencies > 0 ? dependencies[0] : nullptr, start_job, num_jobs);
+  if (num_jobs <= 0) return nullptr;
+  JobWaitListNode* wait_list = NewWaitList(num_jobs);
+  // Jobs park on a join label each dependency counts down. Nothing signals it
+  // before the first dependency is hooked up, so no lock is needed here.
+  JobWaitListNode* join = NewWaitList(num_dependencies);
+  join->_join = true;
+  atomic_int* join_label = &join->_label;
+  for (Job* job = start_job; job < start_job + num_jobs; ++job) {
+    JobNode* job_node = NewJobNode(*job, &wait_list->_label);
+    list_add_tail(&job_node->_link, &join->_job_list);
+  }
+  // join may be freed once the last dependency is hooked up.
+  for (int i = 0; i < num_dependencies; ++i) {
+    atomic_int* dependency = dependencies[i];
+    if (!dependency) {
+      ReleaseLabel(join_label);
+      continue;
+    }
+    JobWaitListNode* dep_wait_list = container_of(dependency, JobWaitListNode, _label);
+    dep_wait_list->_lock.Lock();
+    if (*dependency != dep_wait_list->_wait_value) {
+      // Node without job, ReleaseLabel counts join down instead of queuing it.
+      Job signal;
+      signal.InitWorkerJob(nullptr, nullptr);
+      JobNode* signal_node = NewJobNode(signal, join_label);
+      list_add_tail(&signal_node->_link, &dep_wait_list->_job_list);
+      dep_wait_list->_lock.Unlock();
+    } else {
+      dep_wait_list->_lock.Unlock();
+      ReleaseLabel(join_label);
+    }
   }
   return &wait_list->_label;
 }
 
+atomic_int* JobScheduler::NewLabel(int count) {
+  if (count <= 0) return nullptr;
+  return &NewWaitList(count)->_label;
+}
+
+void JobScheduler::SignalLabel(atomic_int* label) {
+  c3_assert_return(label);
+  ReleaseLabel(label);
+}
+
+void JobScheduler::ReleaseLabel(atomic_int* label) {
+  auto cur_value = --(*label);
+  JobWaitListNode* wait_list = container_of(label, JobWaitListNode, _label);
+  if (cur_value == wait_list->_wait_value) {
+    {
+      JobNode* job_wake, *tmp;
+      SpinLockGuard wait_guard(&wait_list->_lock);
+      list_for_each_entry_safe(job_wake, tmp, &wait_list->_job_list, _link) {
+        //c3_log("%d: wakeup job %p\n", GetWorkerThreadIndex(), job_wake);
+        list_del_init(&job_wake->_link);
+        if (!job_wake->_fn) {
+          atomic_int* join_label = job_wake->_label;
+          C3_DELETE(&_job_allocator, job_wake);
+          ReleaseLabel(join_label);
+          continue;
+        }
+        AddJob(job_wake);
+        WakeWorkers(job_wake->_type, 1);
+      }
+    }
+    if (wait_list->_join) {
+      // Nobody waits for a join label.
+      SpinLockGuard lock_guard(&_wait_lock);
+      list_del(&wait_list->_link);
+      C3_DELETE(&_wait_allocator, wait_list);
+      return;
+    }
+    wait_list->_drained.store(1, memory_order_release);
+  }
+}
+
+void JobScheduler::RunParallelFor(ParallelForData* data) {
+  for (;;) {
+    int begin = data->_next.fetch_add(data->_grain);
+    if (begin >= data->_end) break;
+    data->_fn(begin, min(begin + data->_grain, data->_end), data->_user_data);
+  }
+}
+
+void JobScheduler::ParallelForJob(void* arg) {
+  RunParallelFor((ParallelForData*)arg);
+}
+
+void JobScheduler::ParallelFor(int begin, int end, int grain, ParallelForFn fn, void* user_data) {
+  if (begin >= end) return;
+  grain = max(grain, 1);
+  int num_batches = (end - begin + grain - 1) / grain;
+  int num_jobs = min(num_batches, _num_workers) - 1;
+  if (num_jobs <= 0) {
+    fn(begin, end, user_data);
+    return;
+  }
+  // Helpers pull batches from a shared cursor, so one job per worker is enough
+  // to balance the load and only one wait list is used.
+  ParallelForData data;
+  data._fn = fn;
+  data._user_data = user_data;
+  data._next = begin;
+  data._end = end;
+  data._grain = grain;
+  Job job;
+  job.InitWorkerJob(&JobScheduler::ParallelForJob, &data);
+  JobWaitListNode* wait_list = NewWaitList(num_jobs);
+  for (int i = 0; i < num_jobs; ++i) AddJob(NewJobNode(job, &wait_list->_label));
+  WakeWorkers(JOB_TYPE_WORKER, num_jobs);
+  RunParallelFor(&data);
+  WaitJobs(&wait_list->_label, true);
+}
+
 void JobScheduler::WaitJobs(atomic_int* label, bool free_wait_list) {
   if (!label) return;
   JobWaitListNode* wait_list = container_of(label, JobWaitListNode, _label);
@@ -79,9 +240,11 @@ void JobScheduler::WaitJobs(atomic_int* label, bool free_wait_list) {
     self->Suspend();
   } else wait_list->_lock.Unlock();
   if (free_wait_list) {
-    _wait_lock.Lock();
+    // Last job may still be inside its wake-up section.
+    while (!wait_list->_drained.load(memory_order_acquire)) std::this_thread::yield();
+    // _wait_allocator is not thread safe, free under _wait_lock as NewWaitList does.
+    SpinLockGuard lock_guard(&_wait_lock);
     list_del(&wait_list->_link);
-    _wait_lock.Unlock();
     C3_DELETE(&_wait_allocator, wait_list);
   }
 }
@@ -90,6 +253,15 @@ void JobScheduler::WaitCounter(atomic_int* label, int value) {
   while (*label != value) Yield();
 }
 
+bool JobScheduler::IsInJob() const {
+  if (!IsWorkerThread()) return false;
+  auto fiber = Fiber::GetCurrentFiber();
+  if (fiber == Fiber::GetScheduleFiber()) return false;
+  // Main thread's root job runs no job function.
+  auto job_node = (JobNode*)fiber->GetData();
+  return job_node->_fn != nullptr;
+}
+
 void JobScheduler::Yield() {
   auto self = Fiber::GetCurrentFiber();
   self->SetState(FIBER_STATE_SUSPENDED);
@@ -99,18 +271,136 @@ void JobScheduler::Yield() {
 }
 
 JobNode* JobScheduler::GetJob(JobType type) {
-  SpinLockGuard lock_guard(&_job_queues_lock);
-  auto& l = _job_queues[type];
-  if (list_empty(&l)) return nullptr;
-  JobNode* job_node = list_first_entry(&l, JobNode, _link);
-  //c3_log("%d: GetJob %p\n", GetWorkerThreadIndex(), job_node);
-  list_del_init(&job_node->_link);
-  return job_node;
+  JobNode* job_node = nullptr;
+  if (type == JOB_TYPE_MAIN) {
+    SpinLockGuard lock_guard(&_main_queue_lock);
+    if (list_empty(&_main_queue)) return nullptr;
+    job_node = list_first_entry(&_main_queue, JobNode, _link);
+    list_del_init(&job_node->_link);
+    return job_node;
+  }
+
+  int index = GetWorkerThreadIndex();
+  if (job_node = _job_deques[index].Pop()) return job_node;
+  if (_num_global_jobs > 0) {
+    SpinLockGuard lock_guard(&_global_queue_lock);
+    if (!list_empty(&_global_queue)) {
+      job_node = list_first_entry(&_global_queue, JobNode, _link);
+      list_del_init(&job_node->_link);
+      --_num_global_jobs;
+      return job_node;
+    }
+  }
+  return StealJob(index);
+}
+
+JobNode* JobScheduler::StealJob(int thief_index) {
+  for (int i = 1; i < _num_workers; ++i) {
+    int victim = (thief_index + i) % _num_workers;
+    JobNode* job_node = _job_deques[victim].Steal();
+    if (job_node) {
+      //c3_log("%d: steal %p from %d\n", thief_index, job_node, victim);
+      return job_node;
+    }
+  }
+  return nullptr;
+}
+
+bool JobScheduler::HasJob(int worker_index) {
+  if (worker_index == 0 && !list_empty(&_main_queue)) return true;
+  if (_num_global_jobs > 0) return true;
+  for (int i = 0; i < _num_workers; ++i) {
+    if (!_job_deques[i].IsEmpty()) return true;
+  }
+  return false;
+}
+
+void JobScheduler::ParkWorker(int worker_index) {
+  auto& parking = _parking[worker_index];
+  parking._parked = true;
+  ++_num_parked;
+  // Pairs with the fence in WakeWorkers, either we see the new job or the waker sees us parked.
+  atomic_thread_fence(memory_order_seq_cst);
+  if (HasJob(worker_index)) {
+    if (parking._parked.exchange(false)) {
+      --_num_parked;
+      return;
+    }
+    // A waker already claimed us, consume its post below.
+  }
+  // Only the owner can flush the magazine, don't sit on job nodes while asleep.
+  _job_allocator.FlushThreadCache();
+  auto start_tick = Clock::Tick();
+  parking._sem.Wait();
+  auto end_tick = Clock::Tick();
+  auto latency = Clock::TicksInBetween(end_tick, parking._wake_tick.load(memory_order_acquire));
+  ++parking._num_parks;
+  parking._idle_ticks += Clock::TicksInBetween(end_tick, start_tick);
+  parking._wake_latency_ticks += latency;
+  parking._max_wake_latency_ticks = max(parking._max_wake_latency_ticks, latency);
+}
+
+bool JobScheduler::WakeWorker(int worker_index) {
+  auto& parking = _parking[worker_index];
+  if (!parking._parked.exchange(false)) return false;
+  --_num_parked;
+  ++parking._num_wakeups;
+  parking._wake_tick.store(Clock::Tick(), memory_order_release);
+  parking._sem.Post();
+  return true;
+}
+
+void JobScheduler::WakeWorkers(JobType type, int count) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (_num_parked == 0) return;
+  if (type == JOB_TYPE_MAIN) {
+    WakeWorker(0);
+    return;
+  }
+  // Prefer background workers, main thread has its own work most of the time.
+  for (int i = 1; i < _num_workers && count > 0; ++i) {
+    if (WakeWorker(i)) --count;
+  }
+  if (count > 0) WakeWorker(0);
+}
+
+void JobScheduler::GetWorkerStats(int worker_index, JobWorkerStats* stats) const {
+  auto& parking = _parking[worker_index];
+  stats->num_parks = parking._num_parks;
+  stats->num_wakeups = parking._num_wakeups;
+  stats->idle_ms = Clock::TicksToMillisecondsD(parking._idle_ticks);
+  stats->wake_latency_ms = Clock::TicksToMillisecondsD(parking._wake_latency_ticks);
+  stats->max_wake_latency_ms = Clock::TicksToMillisecondsD(parking._max_wake_latency_ticks);
+}
+
+void JobScheduler::GetStats(JobWorkerStats* stats) const {
+  memset(stats, 0, sizeof(JobWorkerStats));
+  for (int i = 0; i < _num_workers; ++i) {
+    JobWorkerStats worker_stats;
+    GetWorkerStats(i, &worker_stats);
+    stats->num_parks += worker_stats.num_parks;
+    stats->num_wakeups += worker_stats.num_wakeups;
+    stats->idle_ms += worker_stats.idle_ms;
+    stats->wake_latency_ms += worker_stats.wake_latency_ms;
+    stats->max_wake_latency_ms = max(stats->max_wake_latency_ms, worker_stats.max_wake_latency_ms);
+  }
+}
+
+void JobScheduler::ResetStats() {
+  for (int i = 0; i < C3_MAX_WORKER_THREADS; ++i) {
+    auto& parking = _parking[i];
+    parking._num_parks = 0;
+    parking._num_wakeups = 0;
+    parking._idle_ticks = 0;
+    parking._wake_latency_ticks = 0;
+    parking._max_wake_latency_ticks = 0;
+  }
 }
 
 void JobScheduler::MainScheduleFiber(void* arg) {
   auto JS = JobScheduler::Instance();
   JobNode* self_job = C3_NEW(&JS->_job_allocator, JobNode);
+  c3_assert(self_job && "More than C3_MAX_JOBS jobs alive.");
   self_job->_fiber = (Fiber*)arg;
   Fiber::SetScheduleFiber(self_job->_fiber);
   self_job->_reschedule = false;
@@ -120,14 +410,19 @@ void JobScheduler::MainScheduleFiber(void* arg) {
   JS->_root_job->_fiber->Resume();
 
   JobNode* job_node = nullptr;
+  int spin_count = 0;
   while (!JS->_require_exit) {
     if ((job_node = JS->GetJob(JOB_TYPE_MAIN)) || 
         (job_node = JS->GetJob(JOB_TYPE_WORKER))) {
       JS->DoJob(job_node);
       job_node = nullptr;
-    } else {
+      spin_count = 0;
+    } else if (++spin_count < C3_JOB_SPIN_COUNT) {
       //c3_log("%d: no job\n", (int)arg);
       std::this_thread::yield();
+    } else {
+      JS->ParkWorker(0);
+      spin_count = 0;
     }
   }
 }
@@ -138,43 +433,41 @@ void JobScheduler::DoJobFiber(void* arg) {
 }
 
 void JobScheduler::AddJob(JobNode* job_node) {
-  SpinLockGuard lock_guard(&_job_queues_lock);
-  auto& job_list = _job_queues[job_node->_type];
   //c3_log("%d: AddJob %p\n", GetWorkerThreadIndex(), job_node);
-  list_add_tail(&job_node->_link, &job_list);
+  if (job_node->_type == JOB_TYPE_MAIN) {
+    SpinLockGuard lock_guard(&_main_queue_lock);
+    list_add_tail(&job_node->_link, &_main_queue);
+  } else if (IsWorkerThread()) {
+    _job_deques[GetWorkerThreadIndex()].Push(job_node);
+  } else {
+    SpinLockGuard lock_guard(&_global_queue_lock);
+    list_add_tail(&job_node->_link, &_global_queue);
+    ++_num_global_jobs;
+  }
 }
 
 void JobScheduler::DoJob(JobNode* job_node) {
   auto sched_fiber = Fiber::GetCurrentFiber();
   sched_fiber->Suspend();
-  if (!job_node->_fiber) {
-    job_node->_fiber = _fiber_pool->GetWait();
-    //c3_log("%d: run job %p, @%p\n", GetWorkerThreadIndex(), job_node, job_node->_fiber);
-    job_node->_fiber->Prepare(&JobScheduler::DoJobFiber, job_node);
+  if (!job_node->_fiber && !PrepareJobFiber(job_node)) {
+    // Pool is at its cap, the job runs once a running one frees its fiber.
+    sched_fiber->SetState(FIBER_STATE_RUNNING);
+    WaitForFiber(job_node);
+    return;
   }
   job_node->_fiber->Resume();
 
   auto fiber_state = job_node->_fiber->GetState();
   if (fiber_state == FIBER_STATE_FINISHED) {
     //c3_log("%d: finish job %p, @%p\n", GetWorkerThreadIndex(), job_node, job_node->_fiber);
-    auto cur_value = --(*job_node->_label);
-    JobWaitListNode* wait_list = container_of(job_node->_label, JobWaitListNode, _label);
-    if (cur_value == wait_list->_wait_value) {
-      JobNode* job_wake, *tmp;
-      SpinLockGuard wait_guard(&wait_list->_lock);
-      list_for_each_entry_safe(job_wake, tmp, &wait_list->_job_list, _link) {
-        //c3_log("%d: wakeup job %p\n", GetWorkerThreadIndex(), job_wake);
-        list_del_init(&job_wake->_link);
-        AddJob(job_wake);
-      }
-    }
-    _fiber_pool->Put(job_node->_fiber);
+    ReleaseLabel(job_node->_label);
+    PutFiber(job_node->_fiber);
     job_node->_fiber = nullptr;
     C3_DELETE(&_job_allocator, job_node);
   } else if (fiber_state == FIBER_STATE_SUSPENDED) {
     if (job_node->_reschedule) {
       job_node->_reschedule = false;
-      _fiber_pool->Put(job_node->_fiber);
+      PutFiber(job_node->_fiber);
       job_node->_fiber = nullptr;
       AddJob(job_node);
     }
@@ -184,22 +477,70 @@ void JobScheduler::DoJob(JobNode* job_node) {
   }
 }
 
+bool JobScheduler::PrepareJobFiber(JobNode* job_node) {
+  job_node->_fiber = _fiber_pool->Get(job_node->_stack_class);
+  if (!job_node->_fiber) return false;
+  //c3_log("%d: run job %p, @%p\n", GetWorkerThreadIndex(), job_node, job_node->_fiber);
+  job_node->_fiber->Prepare(&JobScheduler::DoJobFiber, job_node);
+  return true;
+}
+
+void JobScheduler::WaitForFiber(JobNode* job_node) {
+  {
+    SpinLockGuard lock_guard(&_fiber_wait_lock);
+    ++_num_fiber_waits;
+    // Pairs with the fence in PutFiber, either we get the freed fiber or the putter sees us waiting.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!PrepareJobFiber(job_node)) {
+      list_add_tail(&job_node->_link, &_fiber_wait_list);
+      return;
+    }
+    --_num_fiber_waits;
+  }
+  AddJob(job_node);
+}
+
+void JobScheduler::PutFiber(Fiber* fiber) {
+  _fiber_pool->Put(fiber);
+  atomic_thread_fence(memory_order_seq_cst);
+  if (_num_fiber_waits.load(memory_order_relaxed) == 0) return;
+  JobNode* job_node = nullptr;
+  {
+    SpinLockGuard lock_guard(&_fiber_wait_lock);
+    if (list_empty(&_fiber_wait_list)) return;
+    job_node = list_first_entry(&_fiber_wait_list, JobNode, _link);
+    // Another thread may have taken the fiber, the next Put retries.
+    if (!PrepareJobFiber(job_node)) return;
+    list_del_init(&job_node->_link);
+    --_num_fiber_waits;
+  }
+  JobType type = job_node->_type;
+  AddJob(job_node);
+  WakeWorkers(type, 1);
+}
+
 i32 JobScheduler::WorkerThread(void* arg) {
-  RegisterWorkerThread((int)arg);
+  int worker_index = (int)(intptr_t)arg;
+  RegisterWorkerThread(worker_index);
 
   auto JS = JobScheduler::Instance();
   JobNode* self_job = C3_NEW(&JS->_job_allocator, JobNode);
+  c3_assert(self_job && "More than C3_MAX_JOBS jobs alive.");
   self_job->_fiber = Fiber::ConvertFromThread(self_job);
   self_job->_reschedule = false;
-  //c3_log("%d: self job %p\n", (int)arg, self_job);
+  //c3_log("%d: self job %p\n", worker_index, self_job);
   JobNode* job_node = nullptr;
+  int spin_count = 0;
   while (!JS->_require_exit) {
     if (job_node = JS->GetJob(JOB_TYPE_WORKER)) {
       JS->DoJob(job_node);
       job_node = nullptr;
-    } else {
+      spin_count = 0;
+    } else if (++spin_count < C3_JOB_SPIN_COUNT) {
       std::this_thread::yield();
-      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } else {
+      JS->ParkWorker(worker_index);
+      spin_count = 0;
     }
   }
   return 0;
@@ -3,11 +3,14 @@
 #include "Platform/C3Platform.h"
 #include "Pattern/Singleton.h"
 #include "Job.h"
+#include "JobDeque.h"
+#include "FiberPool.h"
 
 struct JobNode {
   JobFn _fn;
   void* _user_data;
   JobType _type;
+  FiberStackClass _stack_class;
   Fiber* _fiber;
   atomic_int* _label;
   list_head _link;
@@ -18,11 +21,24 @@ typedef MPMCQueue<JobNode> JobQueue;
 struct JobWaitListNode {
   SpinLock _lock;
   atomic_int _label;
+  atomic_int _drained;    // set after last job stops touching this node.
+  bool _join;             // of SubmitJobsAfter, freed once it queued its jobs.
   int _wait_value;
   list_head _job_list;
   list_head _link;
 };
 
+// Process items [begin, end).
+typedef void (*ParallelForFn)(int begin, int end, void* user_data);
+
+struct JobWorkerStats {
+  u64 num_parks;
+  u64 num_wakeups;
+  double idle_ms;               // time spent parked.
+  double wake_latency_ms;       // sum of wake request -> worker running.
+  double max_wake_latency_ms;
+};
+
 class JobScheduler {
 public:
   JobScheduler();
@@ -30,30 +46,105 @@ public:
 
   void Init(int num_workers);
   atomic_int* SubmitJobs(Job* start_job, int num_jobs);
+  // Jobs are queued once dependency label reaches zero, nothing waits meanwhile.
+  atomic_int* SubmitJobsAfter(atomic_int* dependency, Job* start_job, int num_jobs);
+  // Jobs are queued once all dependency labels reach zero, null ones are done.
+  atomic_int* SubmitJobsAfter(atomic_int* const* dependencies, int num_dependencies, Job* start_job, int num_jobs);
+  // Label of count units of work done outside the scheduler, e.g. file reads.
+  // Waited for and depended on like job labels, SignalLabel counts it down.
+  atomic_int* NewLabel(int count);
+  // Any thread.
+  void SignalLabel(atomic_int* label);
+  // Split [begin, end) into batches of grain items, calling thread helps and
+  // returns after all batches are done. Must be called from a job (or main).
+  void ParallelFor(int begin, int end, int grain, ParallelForFn fn, void* user_data);
+  template <typename Fn>
+  void ParallelFor(int begin, int end, int grain, const Fn& fn) {
+    ParallelFor(begin, end, grain, [](int b, int e, void* arg) { (*(const Fn*)arg)(b, e); }, (void*)&fn);
+  }
   void WaitAndFreeJobs(atomic_int* label) { WaitJobs(label, true); }
   void WaitJobs(atomic_int* label) { WaitJobs(label, false); }
   void WaitCounter(atomic_int* external_label, int value);
   void Yield();
+  // Running a job fiber, the only place Yield may be called. False on the
+  // main thread outside jobs and on threads the scheduler doesn't own.
+  bool IsInJob() const;
+  int GetNumWorkers() const { return _num_workers; }
+  void GetWorkerStats(int worker_index, JobWorkerStats* stats) const;
+  void GetStats(JobWorkerStats* stats) const;
+  void ResetStats();
+  void GetFiberPoolStats(FiberPoolStats* stats) const { _fiber_pool->GetStats(stats); }
+  void GetJobAllocatorStats(PoolAllocatorStats* stats) const { _job_allocator.GetStats(stats); }
 
 private:
+  struct ParallelForData {
+    ParallelForFn _fn;
+    void* _user_data;
+    atomic_int _next;
+    int _end;
+    int _grain;
+  };
+  struct WorkerParking {
+    Semaphore _sem;
+    atomic_bool _parked;
+    atomic<tick_t> _wake_tick;
+    // Written by owner worker, or by the single waker which cleared _parked.
+    u64 _num_parks;
+    u64 _num_wakeups;
+    tick_t _idle_ticks;
+    tick_t _wake_latency_ticks;
+    tick_t _max_wake_latency_ticks;
+  };
+
+  JobWaitListNode* NewWaitList(int num_jobs);
+  JobNode* NewJobNode(const Job& job, atomic_int* label);
+  static void RunParallelFor(ParallelForData* data);
+  static void ParallelForJob(void* arg);
+  // Counts the label down, queues its waiting jobs when it is done.
+  void ReleaseLabel(atomic_int* label);
   void AddJob(JobNode* job_node);
   void DoJob(JobNode* job_node);
+  // Gets a fiber for the job and prepares it, false if the pool is at its cap.
+  bool PrepareJobFiber(JobNode* job_node);
+  // Parks a job which found no fiber until PutFiber hands it one.
+  void WaitForFiber(JobNode* job_node);
+  // Returns a fiber to the pool and starts the first job waiting for one.
+  void PutFiber(Fiber* fiber);
   void WaitJobs(atomic_int* label, bool free_wait_list);
   JobNode* GetJob(JobType type);
+  JobNode* StealJob(int thief_index);
+  bool HasJob(int worker_index);
+  void ParkWorker(int worker_index);
+  bool WakeWorker(int worker_index);
+  void WakeWorkers(JobType type, int count);
   static void MainScheduleFiber(void* arg);
   static void DoJobFiber(void* arg);
   static i32 WorkerThread(void* arg);
-  SpinLock _job_queues_lock;
-  list_head _job_queues[NUM_JOB_TYPES];
+  // Per-worker work-stealing deques, indexed by worker thread index.
+  JobDeque _job_deques[C3_MAX_WORKER_THREADS];
+  // JOB_TYPE_MAIN jobs, only consumed by main thread.
+  SpinLock _main_queue_lock;
+  list_head _main_queue;
+  // Worker jobs submitted from threads not owning a deque.
+  SpinLock _global_queue_lock;
+  list_head _global_queue;
+  atomic_int _num_global_jobs;
+  // Idle workers sleep on their own semaphore, see ParkWorker/WakeWorkers.
+  WorkerParking _parking[C3_MAX_WORKER_THREADS];
+  atomic_int _num_parked;
   Thread _worker_threads[C3_MAX_WORKER_THREADS];
   int _num_workers;
   int _require_exit;
-  typedef ThreadSafePool<Fiber, C3_MAX_FIBERS> FiberPool;
   FiberPool* _fiber_pool;
+  // Jobs which found the fiber pool at its cap, see WaitForFiber/PutFiber.
+  SpinLock _fiber_wait_lock;
+  list_head _fiber_wait_list;
+  atomic_int _num_fiber_waits;
   SpinLock _wait_lock;
   list_head _wait_list;
   PoolAllocator _wait_allocator;
-  ThreadSafePoolAllocator _job_allocator;
+  // Job nodes churn on every submit and completion, served from per-thread magazines.
+  ThreadCachedPoolAllocator _job_allocator;
   JobNode* _root_job;
   SUPPORT_SINGLETON(JobScheduler);
 };
@@ -2,12 +2,17 @@
 #include "ThreadAffinity.h"
 
 static thread::id g_worker_thread_id[C3_MAX_WORKER_THREADS];
+static thread_local int g_tls_worker_index = -1;
 
 namespace ThreadAffinity {
 bool IsMainThread() {
   return std::this_thread::get_id() == g_worker_thread_id[0];
 }
+bool IsWorkerThread() {
+  return g_tls_worker_index >= 0;
+}
 int GetWorkerThreadIndex() {
+  if (g_tls_worker_index >= 0) return g_tls_worker_index;
   auto id = std::this_thread::get_id();
   for (int i = 0; i < C3_MAX_WORKER_THREADS; ++i) {
     if (id == g_worker_thread_id[i]) return i;
@@ -18,6 +23,7 @@ int GetWorkerThreadIndex() {
 void RegisterWorkerThread(int worker_index) {
   if (worker_index >= 0 && worker_index < C3_MAX_WORKER_THREADS) {
     g_worker_thread_id[worker_index] = std::this_thread::get_id();
+    g_tls_worker_index = worker_index;
     atomic_thread_fence(memory_order_seq_cst);
   }
 }
@@ -2,6 +2,8 @@
 
 namespace ThreadAffinity {
 bool IsMainThread();
+// True if current thread is registered by RegisterWorkerThread.
+bool IsWorkerThread();
 int GetWorkerThreadIndex();
 void RegisterWorkerThread(int worker_index);
 }
@@ -2,3 +2,28 @@
 #include "Allocator.h"
 
 IAllocator* g_allocator = nullptr;
+
+static atomic_int g_num_memory_threads(0);
+static thread_local int g_tls_memory_thread_index = -2;
+static atomic_u64 g_num_heap_allocs(0);
+
+int mem_thread_index() {
+  int index = g_tls_memory_thread_index;
+  if (index == -2) {
+    index = g_num_memory_threads.fetch_add(1, memory_order_relaxed);
+    if (index >= C3_MAX_MEMORY_THREADS) {
+      c3_log("[C3] Out of memory thread slots, thread falls back to shared caches.\n");
+      index = -1;
+    }
+    g_tls_memory_thread_index = index;
+  }
+  return index;
+}
+
+u64 mem_num_heap_allocs() {
+  return g_num_heap_allocs.load(memory_order_relaxed);
+}
+
+void mem_count_heap_alloc() {
+  g_num_heap_allocs.fetch_add(1, memory_order_relaxed);
+}
@@ -46,6 +46,27 @@ inline IAllocator::~IAllocator() {}
 
 extern IAllocator* g_allocator;
 
+enum MemoryTag {
+  MEMORY_TAG_DEFAULT,
+  MEMORY_TAG_ASSET,
+  MEMORY_TAG_GRAPHICS,
+  MEMORY_TAG_ECS,
+  MEMORY_TAG_JOB,
+  MEMORY_TAG_TOOL,
+  NUM_MEMORY_TAGS,
+};
+
+// Allocator accounting to tag, same as g_allocator without C3_MEMORY_TRACKING.
+// Blocks may be freed through any tag allocator or g_allocator.
+IAllocator* mem_allocator(MemoryTag tag);
+
+// Small per-thread index assigned on first call and kept for life, -1 once
+// more than C3_MAX_MEMORY_THREADS threads asked. Used to pick thread-private caches.
+int mem_thread_index();
+// Number of allocations served by the CRT heap (CrtAllocator) so far.
+u64 mem_num_heap_allocs();
+void mem_count_heap_alloc();
+
 inline void* align_ptr(void* ptr, size_t extra, size_t align = sizeof(ptrdiff_t)) {
 	union { void* ptr; size_t addr; } un;
 	un.ptr = ptr;
@@ -113,7 +134,8 @@ inline void c3_delete(IAllocator* allocator, T* object, size_t align, const char
 
 struct CrtAllocator: public IAllocator {
   ~CrtAllocator() {}
-  void* Alloc(size_t size, size_t align, const char* /*file*/, u32 line) override {
+  void* Alloc(size_t size, size_t align, const char* file, u32 line) override {
+    mem_count_heap_alloc();
     if (align <= sizeof(ptrdiff_t)) return ::malloc(size);
     else {
 #if ON_WINDOWS
@@ -134,6 +156,7 @@ struct CrtAllocator: public IAllocator {
     }
   }
   void* Realloc(void* ptr, size_t size, size_t align, const char* file, u32 line) override {
+    mem_count_heap_alloc();
     if (align <= sizeof(ptrdiff_t)) return ::realloc(ptr, size);
     else {
 #if ON_WINDOWS
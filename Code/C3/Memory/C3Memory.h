@@ -7,3 +7,5 @@
 #include "Memory/PoolAllocator.h"
 #include "Memory/Pool.h"
 #include "Memory/LinearAllocator.h"
+#include "Memory/FrameAllocator.h"
+#include "Memory/TrackingAllocator.h"
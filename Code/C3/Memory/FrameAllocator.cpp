@@ -0,0 +1,178 @@
+#include "C3PCH.h"
+#include "FrameAllocator.h"
+
+// Latest allocation of the thread, for Realloc. Arenas may be shared by
+// threads, so it is not kept in the arena.
+struct FrameLastAlloc {
+  FrameAllocator* arena;
+  void* ptr;
+  size_t size;
+};
+static thread_local FrameLastAlloc g_tls_frame_last = { nullptr, nullptr, 0 };
+
+FrameAllocator::FrameAllocator()
+: _allocator(nullptr), _size(0), _data(nullptr), _used(0),
+  _overflow_blocks(nullptr), _num_overflows(0), _overflow_bytes(0), _overflow_logged(false) {}
+
+FrameAllocator::~FrameAllocator() {
+  Reset();
+  u8* data = _data.load(memory_order_relaxed);
+  if (data) C3_ALIGNED_FREE(_allocator, data, CACHELINE_SIZE);
+}
+
+void FrameAllocator::Init(size_t size, IAllocator* allocator) {
+  _allocator = allocator;
+  _size = size;
+}
+
+u8* FrameAllocator::GetData() {
+  u8* data = _data.load(memory_order_acquire);
+  if (!data) {
+    SpinLockGuard lock_guard(&_lock);
+    data = _data.load(memory_order_relaxed);
+    if (!data) {
+      data = (u8*)C3_ALIGNED_ALLOC(_allocator, _size, CACHELINE_SIZE);
+      _data.store(data, memory_order_release);
+    }
+  }
+  return data;
+}
+
+void* FrameAllocator::AllocOverflow(size_t size, size_t align) {
+  SpinLockGuard lock_guard(&_lock);
+  if (!_overflow_logged) {
+    c3_log("[C3] Frame arena (%u bytes) overflow, fall back to heap.\n", (u32)_size);
+    _overflow_logged = true;
+  }
+  u8* raw = (u8*)C3_ALLOC(_allocator, sizeof(OverflowBlock) + size + align);
+  auto block = (OverflowBlock*)raw;
+  block->_next = _overflow_blocks;
+  _overflow_blocks = block;
+  ++_num_overflows;
+  _overflow_bytes += size;
+  return (void*)(((uintptr_t)(raw + sizeof(OverflowBlock)) + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+void* FrameAllocator::Alloc(size_t size, size_t align, const char* file, u32 line) {
+  align = max<size_t>(align, POINTER_SIZE);
+  u8* data = GetData();
+  uintptr_t base = (uintptr_t)data;
+  size_t old = _used.load(memory_order_relaxed);
+  size_t offset;
+  void* p;
+  do {
+    offset = ((base + old + align - 1) & ~(uintptr_t)(align - 1)) - base;
+    if (offset + size > _size) {
+      p = AllocOverflow(size, align);
+      break;
+    }
+    p = data + offset;
+  } while (!_used.compare_exchange_weak(old, offset + size, memory_order_relaxed));
+  g_tls_frame_last = { this, p, size };
+  return p;
+}
+
+void* FrameAllocator::Realloc(void* ptr, size_t size, size_t align, const char* file, u32 line) {
+  if (!ptr) return Alloc(size, align, file, line);
+  FrameLastAlloc& last = g_tls_frame_last;
+  if (last.arena != this || last.ptr != ptr) {
+    c3_assert(!"FrameAllocator only resizes the latest allocation of the thread.");
+    c3_log("[C3] FrameAllocator: %s(%u) resizes an allocation it can not size.\n", file ? file : "", line);
+    return nullptr;
+  }
+  if (size == 0) return nullptr;
+  u8* data = _data.load(memory_order_relaxed);
+  size_t old_size = last.size;
+  if ((u8*)ptr >= data && (u8*)ptr < data + _size) {
+    // In place only while nothing was allocated after it, by any thread.
+    size_t offset = (u8*)ptr - data;
+    size_t old_end = offset + old_size;
+    if (offset + size <= _size && _used.compare_exchange_strong(old_end, offset + size, memory_order_relaxed)) {
+      last.size = size;
+      return ptr;
+    }
+  }
+  void* p = Alloc(size, align, file, line);
+  memcpy(p, ptr, min(old_size, size));
+  return p;
+}
+
+void FrameAllocator::Reset() {
+  SpinLockGuard lock_guard(&_lock);
+  _used = 0;
+  while (_overflow_blocks) {
+    auto next = _overflow_blocks->_next;
+    C3_FREE(_allocator, _overflow_blocks);
+    _overflow_blocks = next;
+  }
+  _num_overflows = 0;
+  _overflow_bytes = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static const int NUM_FRAME_ARENAS = C3_MAX_MEMORY_THREADS + 1;    // last one is shared.
+// Never released, frame memory is used until process exit.
+static FrameAllocator* g_frame_arenas = nullptr;
+static atomic_u32 g_frame_index(0);
+static FrameMemoryStats g_frame_stats;
+static u64 g_frame_heap_allocs_mark = 0;
+
+static FrameAllocator* get_frame_arenas(u32 frame) {
+  return g_frame_arenas + (frame % C3_FRAME_ARENA_BUFFERS) * NUM_FRAME_ARENAS;
+}
+
+void frame_mem_init(size_t arena_size) {
+  c3_assert_return(!g_frame_arenas);
+  int num = C3_FRAME_ARENA_BUFFERS * NUM_FRAME_ARENAS;
+  g_frame_arenas = (FrameAllocator*)C3_ALIGNED_ALLOC(g_allocator, sizeof(FrameAllocator) * num, CACHELINE_SIZE);
+  for (int i = 0; i < num; ++i) {
+    new (g_frame_arenas + i) FrameAllocator;
+    g_frame_arenas[i].Init(arena_size, g_allocator);
+  }
+  memset(&g_frame_stats, 0, sizeof(g_frame_stats));
+  g_frame_heap_allocs_mark = mem_num_heap_allocs();
+}
+
+IAllocator* frame_allocator() {
+  c3_assert(g_frame_arenas);
+  int index = mem_thread_index();
+  if (index < 0) index = C3_MAX_MEMORY_THREADS;
+  return get_frame_arenas(g_frame_index.load(memory_order_acquire)) + index;
+}
+
+void frame_mem_next_frame() {
+  c3_assert_return(g_frame_arenas);
+  u32 frame = g_frame_index.load(memory_order_relaxed);
+  auto arenas = get_frame_arenas(frame);
+  size_t used_bytes = 0;
+  u32 num_overflows = 0;
+  size_t overflow_bytes = 0;
+  for (int i = 0; i < NUM_FRAME_ARENAS; ++i) {
+    used_bytes += arenas[i].GetUsed();
+    num_overflows += arenas[i].GetNumOverflows();
+    overflow_bytes += arenas[i].GetOverflowBytes();
+  }
+  u64 heap_allocs = mem_num_heap_allocs();
+  g_frame_stats.frame = frame + 1;
+  g_frame_stats.used_bytes = used_bytes;
+  g_frame_stats.peak_bytes = max(g_frame_stats.peak_bytes, used_bytes);
+  g_frame_stats.num_overflows = num_overflows;
+  g_frame_stats.overflow_bytes = overflow_bytes;
+  g_frame_stats.num_heap_allocs = heap_allocs - g_frame_heap_allocs_mark;
+
+  // Oldest frame slot is reused, release it before anyone can see the new index.
+  auto next_arenas = get_frame_arenas(frame + 1);
+  for (int i = 0; i < NUM_FRAME_ARENAS; ++i) next_arenas[i].Reset();
+  g_frame_heap_allocs_mark = mem_num_heap_allocs();
+  g_frame_index.store(frame + 1, memory_order_release);
+}
+
+void frame_mem_get_stats(FrameMemoryStats* stats) {
+  *stats = g_frame_stats;
+  stats->num_arenas = 0;
+  if (!g_frame_arenas) return;
+  for (int i = 0; i < C3_FRAME_ARENA_BUFFERS * NUM_FRAME_ARENAS; ++i) {
+    if (g_frame_arenas[i].HasData()) ++stats->num_arenas;
+  }
+}
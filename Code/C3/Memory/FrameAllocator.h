@@ -0,0 +1,77 @@
+#pragma once
+#include "Platform/PlatformSync.h"
+#include "Allocator.h"
+
+/*
+* FrameAllocator is a linear arena. Free is a no-op, everything is released
+* together by Reset. Once the arena is full, allocations fall back to the heap
+* and are released by the next Reset too.
+*
+* The buffer is allocated on first Alloc, arenas never used cost nothing.
+*/
+class FrameAllocator: public IAllocator {
+public:
+  FrameAllocator();
+  ~FrameAllocator();
+  void Init(size_t size, IAllocator* allocator = g_allocator);
+  void* Alloc(size_t size, size_t align, const char* file, u32 line) override;
+  void Free(void* ptr, size_t align, const char* file, u32 line) override {}
+  // Only the calling thread's latest allocation can be resized, in place if
+  // nothing was allocated after it and it still fits. nullptr for others.
+  void* Realloc(void* ptr, size_t size, size_t align, const char* file, u32 line) override;
+  void Reset();
+  size_t GetUsed() const { return _used; }
+  size_t GetSize() const { return _size; }
+  bool HasData() const { return _data.load(memory_order_relaxed) != nullptr; }
+  u32 GetNumOverflows() const { return _num_overflows; }
+  size_t GetOverflowBytes() const { return _overflow_bytes; }
+
+private:
+  FrameAllocator(const FrameAllocator&);
+  FrameAllocator& operator =(const FrameAllocator&);
+
+  struct OverflowBlock {
+    OverflowBlock* _next;
+  };
+  u8* GetData();
+  void* AllocOverflow(size_t size, size_t align);
+
+  IAllocator* _allocator;
+  size_t _size;
+  atomic<u8*> _data;
+  atomic_size_t _used;
+  SpinLock _lock;
+  // Guarded by _lock.
+  OverflowBlock* _overflow_blocks;
+  u32 _num_overflows;
+  size_t _overflow_bytes;
+  bool _overflow_logged;
+};
+
+struct FrameMemoryStats {
+  u32 frame;                  // frames finished by frame_mem_next_frame.
+  u32 num_arenas;             // arenas with a buffer, over all buffered frames.
+  size_t used_bytes;          // arena bytes used by last frame.
+  size_t peak_bytes;          // max used_bytes so far.
+  u32 num_overflows;          // last frame allocations which went to the heap.
+  size_t overflow_bytes;
+  u64 num_heap_allocs;        // CRT allocations during last frame, zero in steady state.
+};
+
+/*
+* Frame memory: one FrameAllocator per thread (mem_thread_index) and per
+* buffered frame. Memory allocated during a frame stays valid for
+* C3_FRAME_ARENA_BUFFERS - 1 more frame_mem_next_frame calls, so data built
+* on frame N can be consumed while frame N + 1 is produced.
+*/
+void frame_mem_init(size_t arena_size = C3_FRAME_ARENA_SIZE);
+// Arena of calling thread for current frame.
+IAllocator* frame_allocator();
+// Called once per frame by GraphicsRenderer::Frame, from one thread.
+void frame_mem_next_frame();
+void frame_mem_get_stats(FrameMemoryStats* stats);
+
+template <typename T>
+inline T* frame_alloc_array(size_t num) {
+  return (T*)C3_ALIGNED_ALLOC(frame_allocator(), sizeof(T) * num, ALIGN_OF(T));
+}
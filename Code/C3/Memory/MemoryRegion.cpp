@@ -1,7 +1,12 @@
 #include "C3PCH.h"
 #include "MemoryRegion.h"
 
-void mem_init() {
+void mem_init(MemoryTag default_tag) {
   static CrtAllocator s_allocator;
+#if C3_MEMORY_TRACKING
+  mem_tracking_init(&s_allocator, default_tag);
+#else
   g_allocator = &s_allocator;
+#endif
+  frame_mem_init();
 }
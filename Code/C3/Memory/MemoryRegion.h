@@ -68,4 +68,5 @@ inline MemoryRef* mem_ref(const void* data, u32 size, ReleaseFn release_fn = nul
 	return ref;
 }
 
-void mem_init();
+// default_tag is the tag of g_allocator when C3_MEMORY_TRACKING is on.
+void mem_init(MemoryTag default_tag = MEMORY_TAG_DEFAULT);
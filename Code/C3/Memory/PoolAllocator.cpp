@@ -0,0 +1,190 @@
+#include "C3PCH.h"
+#include "PoolAllocator.h"
+#include <thread>
+
+// Depot checks while Reclaim waits for other owners to flush.
+static const int POOL_RECLAIM_YIELDS = 1000;
+
+ThreadCachedPoolAllocator::ThreadCachedPoolAllocator()
+: _obj_size(0), _num(0), _align(0), _allocator(nullptr), _data(nullptr), _free_list(nullptr), _num_free(0),
+  _num_refills(0), _num_flushes(0), _num_reclaims(0), _num_failed(0), _num_depot_allocs(0), _num_depot_frees(0) {
+  for (auto& cache : _caches) {
+    cache._num_objs = 0;
+    cache._num_cached = 0;
+    cache._flush_requested = false;
+    cache._num_allocs = 0;
+    cache._num_frees = 0;
+  }
+}
+
+ThreadCachedPoolAllocator::~ThreadCachedPoolAllocator() {
+  if (_data) C3_ALIGNED_FREE(_allocator, _data, _align);
+}
+
+void ThreadCachedPoolAllocator::Init(size_t obj_size, size_t align, size_t num, IAllocator* allocator) {
+  c3_assert(num > 0);
+  _obj_size = ALIGN_MASK(max(obj_size, sizeof(void*)), align - 1);
+  _align = align;
+  _num = num;
+  _allocator = allocator;
+  _data = C3_ALIGNED_ALLOC(allocator, _obj_size * num, align);
+  _free_list = (void**)_data;
+  void** p = _free_list;
+  for (size_t i = 0; i < _num - 1; ++i) {
+    *p = (void*)((u8*)p + _obj_size);
+    p = (void**)(*p);
+  }
+  *p = nullptr;
+  _num_free = num;
+}
+
+int ThreadCachedPoolAllocator::Refill(void** objs, int count) {
+  SpinLockGuard lock_guard(&_depot_lock);
+  int n = 0;
+  while (n < count && _free_list) {
+    objs[n++] = _free_list;
+    _free_list = (void**)*_free_list;
+  }
+  _num_free -= n;
+  if (n > 0) ++_num_refills;
+  return n;
+}
+
+void ThreadCachedPoolAllocator::Flush(void* const* objs, int count) {
+  // Chain outside the lock, splice in one go.
+  for (int i = 0; i < count - 1; ++i) *(void**)objs[i] = objs[i + 1];
+  SpinLockGuard lock_guard(&_depot_lock);
+  *(void**)objs[count - 1] = _free_list;
+  _free_list = (void**)objs[0];
+  _num_free += count;
+  ++_num_flushes;
+}
+
+void ThreadCachedPoolAllocator::Reclaim(int except_index) {
+  // Owners flush on their next Alloc or Free, idle ones flushed already.
+  bool requested = false;
+  for (int i = 0; i < C3_MAX_MEMORY_THREADS; ++i) {
+    auto& cache = _caches[i];
+    if (i == except_index || cache._num_cached.load(memory_order_relaxed) == 0) continue;
+    cache._flush_requested.store(true, memory_order_relaxed);
+    requested = true;
+  }
+  {
+    SpinLockGuard lock_guard(&_depot_lock);
+    ++_num_reclaims;
+  }
+  for (int i = 0; requested && i < POOL_RECLAIM_YIELDS; ++i) {
+    {
+      SpinLockGuard lock_guard(&_depot_lock);
+      if (_free_list) return;
+    }
+    std::this_thread::yield();
+  }
+}
+
+void ThreadCachedPoolAllocator::FlushCache(ThreadCacheData& cache) {
+  cache._flush_requested.store(false, memory_order_relaxed);
+  if (cache._num_objs > 0) Flush(cache._objs, cache._num_objs);
+  cache._num_objs = 0;
+  cache._num_cached.store(0, memory_order_relaxed);
+}
+
+void* ThreadCachedPoolAllocator::DepotAlloc() {
+  SpinLockGuard lock_guard(&_depot_lock);
+  void* p = _free_list;
+  if (p) {
+    _free_list = (void**)*_free_list;
+    --_num_free;
+    ++_num_depot_allocs;
+  }
+  return p;
+}
+
+void* ThreadCachedPoolAllocator::Alloc(size_t size, size_t align, const char* file, u32 line) {
+  c3_assert(size <= _obj_size);
+  int index = mem_thread_index();
+  void* p = nullptr;
+  if (index < 0) {
+    p = DepotAlloc();
+    if (!p) {
+      Reclaim(index);
+      p = DepotAlloc();
+    }
+  } else {
+    auto& cache = _caches[index];
+    if (cache._num_objs == 0) cache._num_objs = Refill(cache._objs, C3_POOL_MAGAZINE_SIZE);
+    if (cache._num_objs == 0) {
+      Reclaim(index);
+      cache._num_objs = Refill(cache._objs, C3_POOL_MAGAZINE_SIZE);
+    }
+    if (cache._num_objs > 0) {
+      p = cache._objs[--cache._num_objs];
+      cache._num_allocs.store(cache._num_allocs.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    }
+    if (cache._flush_requested.load(memory_order_relaxed)) FlushCache(cache);
+    else cache._num_cached.store(cache._num_objs, memory_order_relaxed);
+  }
+  if (!p) {
+    SpinLockGuard lock_guard(&_depot_lock);
+    ++_num_failed;
+  }
+  return p;
+}
+
+void ThreadCachedPoolAllocator::Free(void* ptr, size_t align, const char* file, u32 line) {
+  if (!ptr) return;
+  c3_assert((u8*)ptr >= (u8*)_data && (u8*)ptr < (u8*)_data + _obj_size * _num);
+  int index = mem_thread_index();
+  if (index < 0) {
+    SpinLockGuard lock_guard(&_depot_lock);
+    *(void**)ptr = _free_list;
+    _free_list = (void**)ptr;
+    ++_num_free;
+    ++_num_depot_frees;
+    return;
+  }
+  auto& cache = _caches[index];
+  if (cache._num_objs == 2 * C3_POOL_MAGAZINE_SIZE) {
+    // Keep the most recently freed (cache hot) half.
+    Flush(cache._objs, C3_POOL_MAGAZINE_SIZE);
+    memmove(cache._objs, cache._objs + C3_POOL_MAGAZINE_SIZE, C3_POOL_MAGAZINE_SIZE * sizeof(void*));
+    cache._num_objs = C3_POOL_MAGAZINE_SIZE;
+  }
+  cache._objs[cache._num_objs++] = ptr;
+  cache._num_frees.store(cache._num_frees.load(memory_order_relaxed) + 1, memory_order_relaxed);
+  if (cache._flush_requested.load(memory_order_relaxed)) FlushCache(cache);
+  else cache._num_cached.store(cache._num_objs, memory_order_relaxed);
+}
+
+void* ThreadCachedPoolAllocator::Realloc(void* ptr, size_t size, size_t align, const char* file, u32 line) {
+  Free(ptr, align, file, line);
+  if (size > 0) return Alloc(size, align, file, line);
+  else return nullptr;
+}
+
+void ThreadCachedPoolAllocator::FlushThreadCache() {
+  int index = mem_thread_index();
+  if (index < 0) return;
+  FlushCache(_caches[index]);
+}
+
+void ThreadCachedPoolAllocator::GetStats(PoolAllocatorStats* stats) const {
+  u64 num_allocs = 0;
+  u64 num_frees = 0;
+  for (auto& cache : _caches) {
+    num_allocs += cache._num_allocs.load(memory_order_relaxed);
+    num_frees += cache._num_frees.load(memory_order_relaxed);
+  }
+  SpinLockGuard lock_guard(const_cast<SpinLock*>(&_depot_lock));
+  stats->capacity = _num;
+  stats->num_allocs = num_allocs + _num_depot_allocs;
+  stats->num_frees = num_frees + _num_depot_frees;
+  // Counters are sampled without stopping other threads, clamp the snapshot.
+  stats->num_used = stats->num_allocs > stats->num_frees ? (size_t)(stats->num_allocs - stats->num_frees) : 0;
+  stats->num_used = min(stats->num_used, _num - _num_free);
+  stats->num_cached = _num - _num_free - stats->num_used;
+  stats->num_refills = _num_refills;
+  stats->num_flushes = _num_flushes;
+  stats->num_reclaims = _num_reclaims;
+  stats->num_failed = _num_failed;
+}
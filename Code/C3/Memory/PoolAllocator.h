@@ -12,12 +12,13 @@ public:
     _obj_size = ALIGN_MASK(obj_size, align - 1);
     _align = align;
     _num = num;
+    _allocator = allocator;
     _data = C3_ALIGNED_ALLOC(allocator, _obj_size * num, align);
     _used_nums = 0;
     _free_list = (void**)_data;
     void** p = _free_list;
     for (size_t i = 0; i < _num - 1; ++i) {
-      *p = (void*)((u8*)p + obj_size);
+      *p = (void*)((u8*)p + _obj_size);
       p = (void**)(*p);
     }
     *p = nullptr;
@@ -29,7 +30,10 @@ public:
   void* Alloc(size_t size, size_t align, const char* file, u32 line) override {
     c3_assert(size <= _obj_size);
     if (THREAD_SAFE) _lock.Lock();
-    if (!_free_list) return nullptr;
+    if (!_free_list) {
+      if (THREAD_SAFE) _lock.Unlock();
+      return nullptr;
+    }
     void* p = _free_list;
     _free_list = (void**)*_free_list;
     ++_used_nums;
@@ -52,6 +56,8 @@ public:
     else return nullptr;
   }
   void* GetData() const { return _data; }
+  size_t GetNumUsed() const { return _used_nums; }
+  size_t GetCapacity() const { return _num; }
 private:
   size_t _obj_size;
   size_t _num;
@@ -65,3 +71,87 @@ private:
 
 typedef BasePoolAllocator<false> PoolAllocator;
 typedef BasePoolAllocator<true> ThreadSafePoolAllocator;
+
+struct PoolAllocatorStats {
+  size_t capacity;
+  size_t num_used;          // handed out to callers.
+  size_t num_cached;        // parked in thread magazines.
+  u64 num_allocs;
+  u64 num_frees;
+  u64 num_refills;          // depot -> magazine batches.
+  u64 num_flushes;          // magazine -> depot batches.
+  u64 num_reclaims;         // empty depot refilled from other threads' magazines.
+  u64 num_failed;           // Alloc returned nullptr, pool exhausted.
+};
+
+/*
+* ThreadCachedPoolAllocator is a thread safe fixed size pool. Each thread
+* owns a magazine of up to 2 * C3_POOL_MAGAZINE_SIZE free objects, only the
+* owner touches it, so Alloc and Free take no lock while it has room. An
+* empty magazine refills C3_POOL_MAGAZINE_SIZE objects from the shared depot,
+* a full one flushes as many back, each under a single lock. When the depot
+* is empty too, Alloc asks the other owners to flush their magazines, they
+* do on their next Alloc or Free, and waits a while for the depot to refill
+* before it fails. Threads going idle flush with FlushThreadCache first.
+*
+* Magazines are indexed by mem_thread_index(), threads beyond
+* C3_MAX_MEMORY_THREADS go to the depot directly.
+*/
+class ThreadCachedPoolAllocator: public IAllocator {
+public:
+  ThreadCachedPoolAllocator();
+  ~ThreadCachedPoolAllocator();
+  void Init(size_t obj_size, size_t align, size_t num, IAllocator* allocator = g_allocator);
+  void* Alloc(size_t size, size_t align, const char* file, u32 line) override;
+  void Free(void* ptr, size_t align, const char* file, u32 line) override;
+  void* Realloc(void* ptr, size_t size, size_t align, const char* file, u32 line) override;
+  // Return calling thread's magazine to depot, e.g. before the thread exits
+  // or sleeps.
+  void FlushThreadCache();
+  void GetStats(PoolAllocatorStats* stats) const;
+  void* GetData() const { return _data; }
+
+private:
+  ThreadCachedPoolAllocator(const ThreadCachedPoolAllocator&);
+  ThreadCachedPoolAllocator& operator =(const ThreadCachedPoolAllocator&);
+
+  struct ThreadCacheData {
+    // Owner thread only.
+    int _num_objs;
+    void* _objs[2 * C3_POOL_MAGAZINE_SIZE];
+    atomic_int _num_cached;       // _num_objs published for Reclaim.
+    atomic_bool _flush_requested; // by Reclaim, owner flushes on its next call.
+    // Written by owner thread only, atomic so GetStats can read them.
+    atomic_u64 _num_allocs;
+    atomic_u64 _num_frees;
+  };
+  // Padded so magazines of different threads never share a cache line.
+  struct ThreadCache: ThreadCacheData {
+    u8 _pad[CACHELINE_SIZE - sizeof(ThreadCacheData) % CACHELINE_SIZE];
+  };
+
+  int Refill(void** objs, int count);
+  void Flush(void* const* objs, int count);
+  // Asks owners of all magazines but except_index to flush them, waits until
+  // the depot has objects or they had time to.
+  void Reclaim(int except_index);
+  void FlushCache(ThreadCacheData& cache);
+  void* DepotAlloc();
+
+  size_t _obj_size;
+  size_t _num;
+  size_t _align;
+  IAllocator* _allocator;
+  void* _data;
+  ThreadCache _caches[C3_MAX_MEMORY_THREADS];
+  SpinLock _depot_lock;
+  // Guarded by _depot_lock.
+  void** _free_list;
+  size_t _num_free;
+  u64 _num_refills;
+  u64 _num_flushes;
+  u64 _num_reclaims;
+  u64 _num_failed;
+  u64 _num_depot_allocs;
+  u64 _num_depot_frees;
+};
@@ -0,0 +1,225 @@
+#include "C3PCH.h"
+#include "TrackingAllocator.h"
+#include <algorithm>
+
+static_assert((C3_MAX_MEMORY_SITES & (C3_MAX_MEMORY_SITES - 1)) == 0, "C3_MAX_MEMORY_SITES must be power of two.");
+static_assert(C3_MAX_MEMORY_SITES <= 65536, "Site index is stored in 16 bits.");
+
+static const char* MEMORY_TAG_NAMES[NUM_MEMORY_TAGS] = {
+  "Default",
+  "Asset",
+  "Graphics",
+  "ECS",
+  "Job",
+  "Tool",
+};
+
+// Sits right before the user pointer.
+struct AllocHeader {
+  u64 _size;
+  u32 _offset;          // user pointer - block pointer.
+  u16 _site;
+  u8 _tag;
+  u8 _pad;
+};
+static_assert(sizeof(AllocHeader) == 16, "AllocHeader must keep 16 byte alignment.");
+
+struct TagCounters {
+  atomic_i64 _current_bytes;
+  atomic_i64 _peak_bytes;
+  atomic_u64 _num_allocs;
+  atomic_u64 _num_frees;
+  atomic_i32 _num_live;
+  atomic_u32 _frame_allocs;
+  u32 _last_frame_allocs;
+  u8 _pad[CACHELINE_SIZE - 4 * 8 - 3 * 4];
+};
+
+enum SiteState {
+  SITE_EMPTY,
+  SITE_WRITING,
+  SITE_READY,
+};
+
+// Site 0 collects blocks without call site, and sites beyond the table.
+struct SiteEntry {
+  atomic_u32 _state;
+  u32 _line;
+  const char* _file;
+  MemoryTag _tag;
+  atomic_i64 _current_bytes;
+  atomic_u64 _num_allocs;
+  atomic_i32 _num_live;
+};
+
+static TrackingAllocator g_tracking_allocators[NUM_MEMORY_TAGS];
+static bool g_tracking_enabled = false;
+static TagCounters g_tag_counters[NUM_MEMORY_TAGS];
+static SiteEntry g_sites[C3_MAX_MEMORY_SITES];
+
+static u16 find_site(const char* file, u32 line, MemoryTag tag) {
+  if (!file) return 0;
+  // __FILE__ of the same file may be a different pointer in each translation unit.
+  u64 h = ((u64)hash_string(file) * 0x9E3779B97F4A7C15ull) ^ ((u64)line * 0x85EBCA6Bull) ^ (u64)tag;
+  h ^= h >> 29;
+  for (u32 i = 0; i < C3_MAX_MEMORY_SITES; ++i) {
+    u32 index = (u32)(h + i) & (C3_MAX_MEMORY_SITES - 1);
+    if (index == 0) continue;
+    SiteEntry& site = g_sites[index];
+    u32 state = site._state.load(memory_order_acquire);
+    if (state == SITE_EMPTY) {
+      if (site._state.compare_exchange_strong(state, SITE_WRITING, memory_order_acquire)) {
+        site._file = file;
+        site._line = line;
+        site._tag = tag;
+        site._state.store(SITE_READY, memory_order_release);
+        return (u16)index;
+      }
+    }
+    while (state == SITE_WRITING) state = site._state.load(memory_order_acquire);
+    if (site._line == line && site._tag == tag && (site._file == file || strcmp(site._file, file) == 0)) {
+      return (u16)index;
+    }
+  }
+  return 0;
+}
+
+void TrackingAllocator::Init(IAllocator* backing, MemoryTag tag) {
+  _backing = backing;
+  _tag = tag;
+}
+
+void* TrackingAllocator::Alloc(size_t size, size_t align, const char* file, u32 line) {
+  size_t header_size = max<size_t>(align, sizeof(AllocHeader));
+  u8* block = (u8*)_backing->Alloc(size + header_size, align, file, line);
+  if (!block) return nullptr;
+  u8* p = block + header_size;
+  AllocHeader* header = (AllocHeader*)p - 1;
+  header->_size = size;
+  header->_offset = (u32)header_size;
+  header->_site = find_site(file, line, _tag);
+  header->_tag = (u8)_tag;
+
+  auto& counters = g_tag_counters[_tag];
+  i64 current = counters._current_bytes.fetch_add(size, memory_order_relaxed) + size;
+  i64 peak = counters._peak_bytes.load(memory_order_relaxed);
+  while (current > peak && !counters._peak_bytes.compare_exchange_weak(peak, current, memory_order_relaxed));
+  counters._num_allocs.fetch_add(1, memory_order_relaxed);
+  counters._num_live.fetch_add(1, memory_order_relaxed);
+  counters._frame_allocs.fetch_add(1, memory_order_relaxed);
+  auto& site = g_sites[header->_site];
+  site._current_bytes.fetch_add(size, memory_order_relaxed);
+  site._num_allocs.fetch_add(1, memory_order_relaxed);
+  site._num_live.fetch_add(1, memory_order_relaxed);
+  return p;
+}
+
+void TrackingAllocator::Free(void* ptr, size_t align, const char* file, u32 line) {
+  if (!ptr) return;
+  AllocHeader* header = (AllocHeader*)ptr - 1;
+  auto& counters = g_tag_counters[header->_tag];
+  counters._current_bytes.fetch_sub(header->_size, memory_order_relaxed);
+  counters._num_frees.fetch_add(1, memory_order_relaxed);
+  counters._num_live.fetch_sub(1, memory_order_relaxed);
+  auto& site = g_sites[header->_site];
+  site._current_bytes.fetch_sub(header->_size, memory_order_relaxed);
+  site._num_live.fetch_sub(1, memory_order_relaxed);
+  _backing->Free((u8*)ptr - header->_offset, align, file, line);
+}
+
+void* TrackingAllocator::Realloc(void* ptr, size_t size, size_t align, const char* file, u32 line) {
+  if (!ptr) return Alloc(size, align, file, line);
+  if (size == 0) {
+    Free(ptr, align, file, line);
+    return nullptr;
+  }
+  size_t old_size = (size_t)((AllocHeader*)ptr - 1)->_size;
+  void* p = Alloc(size, align, file, line);
+  if (p) {
+    memcpy(p, ptr, min(old_size, size));
+    Free(ptr, align, file, line);
+  }
+  return p;
+}
+
+void mem_tracking_init(IAllocator* backing, MemoryTag default_tag) {
+  for (int i = 0; i < NUM_MEMORY_TAGS; ++i) g_tracking_allocators[i].Init(backing, (MemoryTag)i);
+  g_allocator = &g_tracking_allocators[default_tag];
+  g_tracking_enabled = true;
+}
+
+bool mem_tracking_enabled() {
+  return g_tracking_enabled;
+}
+
+IAllocator* mem_allocator(MemoryTag tag) {
+  return g_tracking_enabled ? &g_tracking_allocators[tag] : g_allocator;
+}
+
+const char* mem_tag_name(MemoryTag tag) {
+  return (tag >= 0 && tag < NUM_MEMORY_TAGS) ? MEMORY_TAG_NAMES[tag] : "Unknown";
+}
+
+void mem_get_tag_stats(MemoryTag tag, MemoryTagStats* stats) {
+  auto& counters = g_tag_counters[tag];
+  stats->current_bytes = (size_t)max<i64>(counters._current_bytes.load(memory_order_relaxed), 0);
+  stats->peak_bytes = (size_t)counters._peak_bytes.load(memory_order_relaxed);
+  stats->num_allocs = counters._num_allocs.load(memory_order_relaxed);
+  stats->num_frees = counters._num_frees.load(memory_order_relaxed);
+  stats->num_live = (u32)max<i32>(counters._num_live.load(memory_order_relaxed), 0);
+  stats->frame_allocs = counters._last_frame_allocs;
+}
+
+int mem_get_site_stats(MemorySiteStats* sites, int max_sites) {
+  vector<MemorySiteStats> all;
+  for (u32 i = 0; i < C3_MAX_MEMORY_SITES; ++i) {
+    auto& site = g_sites[i];
+    if (i > 0 && site._state.load(memory_order_acquire) != SITE_READY) continue;
+    u64 num_allocs = site._num_allocs.load(memory_order_relaxed);
+    if (num_allocs == 0) continue;
+    MemorySiteStats s;
+    s.file = i > 0 ? site._file : nullptr;
+    s.line = i > 0 ? site._line : 0;
+    s.tag = i > 0 ? site._tag : MEMORY_TAG_DEFAULT;
+    s.current_bytes = (size_t)max<i64>(site._current_bytes.load(memory_order_relaxed), 0);
+    s.num_allocs = num_allocs;
+    s.num_live = (u32)max<i32>(site._num_live.load(memory_order_relaxed), 0);
+    all.push_back(s);
+  }
+  std::sort(all.begin(), all.end(), [](const MemorySiteStats& a, const MemorySiteStats& b) {
+    return a.current_bytes > b.current_bytes;
+  });
+  int n = min<int>(max_sites, (int)all.size());
+  for (int i = 0; i < n; ++i) sites[i] = all[i];
+  return n;
+}
+
+void mem_tracking_next_frame() {
+  for (auto& counters : g_tag_counters) {
+    counters._last_frame_allocs = counters._frame_allocs.exchange(0, memory_order_relaxed);
+  }
+}
+
+void mem_dump_report(int max_sites) {
+  if (!g_tracking_enabled) {
+    c3_log("[C3] Memory tracking is disabled, build with C3_MEMORY_TRACKING.\n");
+    return;
+  }
+  c3_log("[C3] Memory report\n");
+  c3_log("  %-10s %12s %12s %10s %12s %8s\n", "tag", "current KB", "peak KB", "live", "allocs", "frame");
+  for (int i = 0; i < NUM_MEMORY_TAGS; ++i) {
+    MemoryTagStats stats;
+    mem_get_tag_stats((MemoryTag)i, &stats);
+    c3_log("  %-10s %12.1f %12.1f %10u %12llu %8u\n", mem_tag_name((MemoryTag)i),
+           stats.current_bytes / 1024.0, stats.peak_bytes / 1024.0, stats.num_live, stats.num_allocs,
+           stats.frame_allocs);
+  }
+  vector<MemorySiteStats> sites(max(max_sites, 1));
+  int n = mem_get_site_stats(sites.data(), (int)sites.size());
+  c3_log("  %12s %10s %12s  %-8s %s\n", "current KB", "live", "allocs", "tag", "site");
+  for (int i = 0; i < n; ++i) {
+    auto& s = sites[i];
+    c3_log("  %12.1f %10u %12llu  %-8s %s(%u)\n", s.current_bytes / 1024.0, s.num_live, s.num_allocs,
+           mem_tag_name(s.tag), s.file ? s.file : "<unknown>", s.line);
+  }
+}
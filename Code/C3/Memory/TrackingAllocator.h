@@ -0,0 +1,54 @@
+#pragma once
+#include "Platform/PlatformSync.h"
+#include "Allocator.h"
+
+/*
+* TrackingAllocator decorates a backing allocator and records every block
+* under its MemoryTag and call site (__FILE__/__LINE__ with C3_MEMORY_DEBUG).
+* Each block carries a 16 byte header (more for larger alignments), so Free
+* accounts to the tag and site of the Alloc whichever tracking allocator
+* releases it. Counters are relaxed atomics, cheap enough for profiling builds.
+*/
+class TrackingAllocator: public IAllocator {
+public:
+  TrackingAllocator(): _backing(nullptr), _tag(MEMORY_TAG_DEFAULT) {}
+  void Init(IAllocator* backing, MemoryTag tag);
+  void* Alloc(size_t size, size_t align, const char* file, u32 line) override;
+  void Free(void* ptr, size_t align, const char* file, u32 line) override;
+  void* Realloc(void* ptr, size_t size, size_t align, const char* file, u32 line) override;
+  MemoryTag GetTag() const { return _tag; }
+
+private:
+  IAllocator* _backing;
+  MemoryTag _tag;
+};
+
+struct MemoryTagStats {
+  size_t current_bytes;
+  size_t peak_bytes;
+  u64 num_allocs;
+  u64 num_frees;
+  u32 num_live;                 // blocks allocated and not freed yet.
+  u32 frame_allocs;             // allocations during last frame.
+};
+
+struct MemorySiteStats {
+  const char* file;             // nullptr for unknown/overflow site.
+  u32 line;
+  MemoryTag tag;
+  size_t current_bytes;
+  u64 num_allocs;
+  u32 num_live;
+};
+
+// Installs tracking allocators on top of backing, g_allocator gets default_tag.
+void mem_tracking_init(IAllocator* backing, MemoryTag default_tag);
+bool mem_tracking_enabled();
+const char* mem_tag_name(MemoryTag tag);
+void mem_get_tag_stats(MemoryTag tag, MemoryTagStats* stats);
+// Sites sorted by current bytes, largest first. Returns number written.
+int mem_get_site_stats(MemorySiteStats* sites, int max_sites);
+// Called once per frame by GraphicsRenderer::Frame.
+void mem_tracking_next_frame();
+// Logs tag totals and the top max_sites call sites.
+void mem_dump_report(int max_sites = 32);
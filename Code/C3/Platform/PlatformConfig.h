@@ -3,16 +3,20 @@
 #define WINDOWS_PLATFORM 1
 #define IOS_PLATFORM 2
 #define PS4_PLATFORM 3
+#define LINUX_PLATFORM 4
 
 #if defined(_WIN32) || defined(_WIN64)
 #define PLATFORM WINDOWS_PLATFORM
 #elif defined(__ORBIS__)
 #define PLATFORM PS4_PLATFORM
+#elif defined(__linux__)
+#define PLATFORM LINUX_PLATFORM
 #endif
 
 #define ON_WINDOWS (PLATFORM == WINDOWS_PLATFORM)
 #define ON_IOS (PLATFORM == IOS_PLATFORM)
 #define ON_PS4 (PLATFORM == PS4_PLATFORM)
+#define ON_LINUX (PLATFORM == LINUX_PLATFORM)
 
 #if ON_WINDOWS
 #define SYSTEM_ENCODING UTF_16
@@ -40,19 +44,68 @@
 #define C3_MAX_COLOR_PALETTE 16
 #define C3_MAX_MATRIX_CACHE (C3_MAX_DRAW_CALLS + 1)
 #define C3_MAX_RECT_CACHE (16 << 10)
-#define C3_MAX_COMMAND_BUFFER_SIZE (64 << 10)
+#define C3_MAX_COMMAND_BUFFER_SIZE (256 << 10)   // per frame, loaders create resources in bursts.
+#define C3_MAX_DRAW_ENCODERS (C3_MAX_MEMORY_THREADS + 1)    // immediate one plus one per thread.
+#define C3_DRAW_ENCODER_CHUNK 32    // draws/matrices an encoder takes from the frame at once.
+#define C3_DRAW_ENCODER_CONSTANT_CHUNK (4 << 10)  // constant bytes an encoder takes from the frame at once.
+// Partially used chunks leave holes, arrays get this much extra room.
+#define C3_DRAW_ENCODER_SLACK (C3_MAX_DRAW_ENCODERS * C3_DRAW_ENCODER_CHUNK)
+#ifndef C3_RENDER_THREAD
+#define C3_RENDER_THREAD 1          // GraphicsInterface runs on its own thread, one frame behind.
+#endif
+// Merge identical opaque draws of programs with an instanced variant after the sort.
+// Off until the USE_INSTANCING variants listed as vs_instanced_defines in the .mas
+// files are compiled with shaderc, without their .vsb no program has one.
+#ifndef C3_AUTO_INSTANCING
+#define C3_AUTO_INSTANCING 0
+#endif
+#ifndef C3_PARALLEL_SORT_MIN_ITEMS
+#define C3_PARALLEL_SORT_MIN_ITEMS (4 << 10)  // larger frames are sorted by job workers beside the render thread, 0 disables.
+#endif
 
 #define C3_RESOLUTION_DEFAULT_WIDTH 1280
 #define C3_RESOLUTION_DEFAULT_HEIGHT 720
 #define C3_RESOLUTION_DEFAULT_FLAGS C3_RESET_NONE
 #define C3_TRANSIENT_INDEX_BUFFER_SIZE (2 << 16)
 #define C3_TRANSIENT_VERTEX_BUFFER_SIZE (6 << 20)
+#define C3_TRANSIENT_CONSTANT_BUFFER_SIZE (4 << 20)   // draw constants of all encoders per frame.
+#define C3_UPLOAD_BUDGET (4 << 20)            // loaded resource bytes the render thread creates per frame.
+#define C3_MAX_PENDING_UPLOADS (8 << 10)      // upload queue, resources are created at once when it is full.
 
 //////////////////////////////////////////////////////////////////////////
 #define C3_MAX_ASSETS 4096
+// Resident bytes per asset type, unreferenced assets are evicted above it.
+#define C3_ASSET_BUDGET_TEXTURE (512 << 20)
+#define C3_ASSET_BUDGET_MATERIAL_SHADER (4 << 20)
+#define C3_ASSET_BUDGET_MATERIAL (4 << 20)
+#define C3_ASSET_BUDGET_MODEL (256 << 20)
+// Mips of 2D DDS textures above their tails are streamed in when drawn, see TextureStreamer.
+#define C3_TEXTURE_STREAM_POOL (256 << 20)      // streamed mip bytes, on top of the texture budget.
+#define C3_TEXTURE_STREAM_TAIL_SIZE 64          // largest mip loaded with a texture, 0 loads whole textures.
+#define C3_TEXTURE_STREAM_REQUESTS 8            // textures being re-created at once.
+#define C3_TEXTURE_STREAM_KEEP_FRAMES 120       // undrawn frames before a texture drops back to its tail.
+#define C3_ASSET_IO_WINDOW 8                // files read ahead of the decode jobs.
+#define C3_MAX_ASSET_IO_REQUESTS 4096       // reads waiting for the I/O thread.
 #define C3_MAX_JOBS 2048
 #define C3_MAX_WORKER_THREADS 8
-#define C3_MAX_FIBERS 256
+#define C3_MAX_FIBERS 4096                          // FiberPool grows on demand up to this.
+#define C3_FIBER_SMALL_STACK_SIZE (128 << 10)       // reserved, leaf jobs.
+#define C3_FIBER_LARGE_STACK_SIZE (1 << 20)         // reserved, loaders and parsers.
+#define C3_FIBER_STACK_COMMIT_SIZE (16 << 10)       // committed up front, rest on demand.
+// Address space all fiber stacks may reserve, FiberPool caps C3_MAX_FIBERS by it.
+#define C3_FIBER_STACK_ADDRESS_SPACE (sizeof(void*) == 4 ? (u64)256 << 20 : (u64)8 << 30)
+#define C3_JOB_SPIN_COUNT 64    // GetJob retries before an idle worker parks.
+#define C3_MAX_MEMORY_THREADS 32        // threads with private pool magazines and frame arenas.
+#define C3_POOL_MAGAZINE_SIZE 16        // objects moved per depot refill or flush.
+#define C3_FRAME_ARENA_SIZE (1 << 20)   // per thread, per buffered frame.
+#define C3_FRAME_ARENA_BUFFERS 3        // frame memory lives until this many Frame() calls.
+#if defined(PROFILING_ENABLED) && !defined(C3_MEMORY_TRACKING)
+#define C3_MEMORY_TRACKING 1            // per tag and per call site allocation stats.
+#endif
+#if C3_MEMORY_TRACKING && !defined(C3_MEMORY_DEBUG)
+#define C3_MEMORY_DEBUG                 // pass __FILE__/__LINE__ down to allocators.
+#endif
+#define C3_MAX_MEMORY_SITES 4096
 
 //////////////////////////////////////////////////////////////////////////
 #define C3_MAX_ENTITIES           (10 << 10)
@@ -60,3 +113,8 @@
 #define C3_MAX_MODEL_RENDERERS    (10 << 10)
 #define C3_MAX_TRANSFORMS         (10 << 10)
 #define C3_MAX_LIGHTS             (10 << 10)
+#define C3_SHADOW_CASCADES        4         // splits of the camera frustum, a shadow map each.
+#define C3_SHADOW_MAP_SIZE        2048      // per cascade.
+#define C3_SHADOW_SPLIT_LAMBDA    0.8f      // 1 logarithmic splits, 0 uniform.
+#define C3_SHADOW_FIRST_CACHED_CASCADE 2    // it and farther cascades are redrawn only when refit or casters move.
+#define C3_SHADOW_CACHE_MARGIN    0.25f     // cached cascades cover this much more than their split.
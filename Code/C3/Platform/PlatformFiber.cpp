@@ -2,16 +2,195 @@
 #include "PlatformFiber.h"
 #include "Debug/C3Debug.h"
 
-#define FIBER_STACK_SIZE 0
+#define FIBER_DEFAULT_STACK_SIZE C3_FIBER_LARGE_STACK_SIZE
+
+// Fibers may migrate between threads, on Linux keep TLS access out of line
+// so the compiler can not cache the TLS address across a switch.
+#if ON_WINDOWS
+#define FIBER_TLS_ACCESS
+#else
+#define FIBER_TLS_ACCESS __attribute__((noinline))
+#endif
 
 static thread_local Fiber* g_tls_fiber = nullptr;
+static FIBER_TLS_ACCESS Fiber* get_schedule_fiber() { return g_tls_fiber; }
+static FIBER_TLS_ACCESS void set_schedule_fiber(Fiber* fiber) { g_tls_fiber = fiber; }
+
+#if ON_LINUX
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Hand written context switch is x86-64 SysV only, other targets use ucontext.
+#if !defined(C3_FIBER_USE_UCONTEXT)
+#if defined(__x86_64__)
+#define C3_FIBER_USE_UCONTEXT 0
+#else
+#define C3_FIBER_USE_UCONTEXT 1
+#endif
+#endif
+
+#if C3_FIBER_USE_UCONTEXT
+#include <ucontext.h>
+#else
+extern "C" void c3_fiber_switch(void** from_sp, void* to_sp);
+extern "C" void c3_fiber_start();
+
+// Saves callee-saved registers, MXCSR and x87 control word on the current
+// stack, then switches stack pointer. New fibers start in c3_fiber_start
+// with the Fiber* in rbx and the entry function in r12.
+asm(
+  ".text\n"
+  ".globl c3_fiber_switch\n"
+  ".hidden c3_fiber_switch\n"
+  ".type c3_fiber_switch, @function\n"
+  ".align 16\n"
+  "c3_fiber_switch:\n"
+  "  pushq %rbp\n"
+  "  pushq %rbx\n"
+  "  pushq %r12\n"
+  "  pushq %r13\n"
+  "  pushq %r14\n"
+  "  pushq %r15\n"
+  "  subq $8, %rsp\n"
+  "  stmxcsr (%rsp)\n"
+  "  fnstcw 4(%rsp)\n"
+  "  movq %rsp, (%rdi)\n"
+  "  movq %rsi, %rsp\n"
+  "  ldmxcsr (%rsp)\n"
+  "  fldcw 4(%rsp)\n"
+  "  addq $8, %rsp\n"
+  "  popq %r15\n"
+  "  popq %r14\n"
+  "  popq %r13\n"
+  "  popq %r12\n"
+  "  popq %rbx\n"
+  "  popq %rbp\n"
+  "  ret\n"
+  ".size c3_fiber_switch, .-c3_fiber_switch\n"
+  ".globl c3_fiber_start\n"
+  ".hidden c3_fiber_start\n"
+  ".type c3_fiber_start, @function\n"
+  ".align 16\n"
+  "c3_fiber_start:\n"
+  "  movq %rbx, %rdi\n"
+  "  callq *%r12\n"
+  "  ud2\n"
+  ".size c3_fiber_start, .-c3_fiber_start\n"
+);
+#endif
+
+static thread_local Fiber* g_tls_current_fiber = nullptr;
+static FIBER_TLS_ACCESS Fiber* get_current_fiber() { return g_tls_current_fiber; }
+static FIBER_TLS_ACCESS void set_current_fiber(Fiber* fiber) { g_tls_current_fiber = fiber; }
+
+// Stacks are mmap'd with a PROT_NONE guard page below. MAP_NORESERVE only
+// reserves address space, pages are committed when first touched.
+// Fibers themselves are recycled by FiberPool.
+static void* alloc_fiber_stack(size_t size) {
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  u8* p = (u8*)mmap(nullptr, size + page_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_NORESERVE, -1, 0);
+  if (p == MAP_FAILED) return nullptr;
+  mprotect(p, page_size, PROT_NONE);
+  return p + page_size;
+}
+
+static void free_fiber_stack(void* p, size_t size) {
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  munmap((u8*)p - page_size, size + page_size);
+}
+
+#if C3_FIBER_USE_UCONTEXT
+// makecontext only passes int arguments, pointers are split in halves.
+static void ucontext_entry(u32 fn_hi, u32 fn_lo, u32 arg_hi, u32 arg_lo) {
+  auto fn = (void (*)(void*))(((uintptr_t)fn_hi << 32) | fn_lo);
+  fn((void*)(((uintptr_t)arg_hi << 32) | arg_lo));
+}
+#endif
+#endif
+
+// Stack and context are created on first Prepare, thread fibers never need them.
+#if ON_WINDOWS
+Fiber::Fiber(u32 stack_size): _fn(nullptr), _handle(nullptr), _user_data(nullptr), _state(FIBER_STATE_INITIALIZED) {
+  _stack_size = stack_size ? stack_size : FIBER_DEFAULT_STACK_SIZE;
+}
+
+Fiber::~Fiber() {
+  // Thread fibers (zero stack size) are released with their thread.
+  if (_handle && _stack_size) DeleteFiber(_handle);
+}
 
-Fiber::Fiber(): _fn(nullptr), _user_data(nullptr), _state(FIBER_STATE_INITIALIZED) {
-  _handle = CreateFiber(FIBER_STACK_SIZE, &Fiber::FiberProc, this);
+bool Fiber::InitContext() {
+  _handle = CreateFiberEx(min<u32>(C3_FIBER_STACK_COMMIT_SIZE, _stack_size), _stack_size,
+                          FIBER_FLAG_FLOAT_SWITCH, &Fiber::FiberProc, this);
+  return _handle != nullptr;
+}
+
+u64 Fiber::GetReservedSize(u32 stack_size) {
+  // Reservations are rounded up to the allocation granularity, the guard page is inside.
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  u64 granularity = info.dwAllocationGranularity;
+  return ((stack_size ? stack_size : FIBER_DEFAULT_STACK_SIZE) + granularity - 1) / granularity * granularity;
+}
+#elif ON_LINUX
+Fiber::Fiber(u32 stack_size)
+: _fn(nullptr), _handle(nullptr), _stack(nullptr), _user_data(nullptr), _state(FIBER_STATE_INITIALIZED) {
+  _stack_size = stack_size ? stack_size : FIBER_DEFAULT_STACK_SIZE;
+}
+
+Fiber::~Fiber() {
+  if (_stack) free_fiber_stack(_stack, _stack_size);
+#if C3_FIBER_USE_UCONTEXT
+  delete (ucontext_t*)_handle;
+#endif
+}
+
+bool Fiber::InitContext() {
+  _stack = alloc_fiber_stack(_stack_size);
+  if (!_stack) return false;
+#if C3_FIBER_USE_UCONTEXT
+  auto ctx = new ucontext_t;
+  getcontext(ctx);
+  ctx->uc_stack.ss_sp = _stack;
+  ctx->uc_stack.ss_size = _stack_size;
+  ctx->uc_link = nullptr;
+  uintptr_t fn = (uintptr_t)&Fiber::FiberProc;
+  uintptr_t self = (uintptr_t)this;
+  makecontext(ctx, (void (*)())&ucontext_entry, 4, (u32)(fn >> 32), (u32)fn, (u32)(self >> 32), (u32)self);
+  _handle = ctx;
+#else
+  u64* top = (u64*)(((uintptr_t)_stack + _stack_size) & ~(uintptr_t)15);
+  u64* sp = top - 8;
+  sp[0] = 0x1F80 | ((u64)0x037F << 32);   // default MXCSR, x87 control word.
+  sp[1] = 0;                              // r15
+  sp[2] = 0;                              // r14
+  sp[3] = 0;                              // r13
+  sp[4] = (u64)&Fiber::FiberProc;         // r12
+  sp[5] = (u64)this;                      // rbx
+  sp[6] = 0;                              // rbp
+  sp[7] = (u64)&c3_fiber_start;           // return address
+  _handle = sp;
+#endif
+  return true;
+}
+
+u64 Fiber::GetReservedSize(u32 stack_size) {
+  u64 page_size = (u64)sysconf(_SC_PAGESIZE);
+  u64 size = stack_size ? stack_size : FIBER_DEFAULT_STACK_SIZE;
+  // Plus the guard page.
+  return (size + page_size - 1) / page_size * page_size + page_size;
+}
+#endif
+
+bool Fiber::Reserve() {
+  return _handle || InitContext();
 }
 
 void Fiber::Prepare(FiberFn fn, void* user_data) {
   c3_assert(_state == FIBER_STATE_INITIALIZED || _state == FIBER_STATE_FINISHED);
+  // Pooled fibers are reserved by FiberPool::Get, which reports failures.
+  if (!Reserve()) c3_assert(!"Fiber stack could not be reserved.");
   _fn = fn;
   _user_data = user_data;
   _state = FIBER_STATE_SUSPENDED;
@@ -20,21 +199,34 @@ void Fiber::Prepare(FiberFn fn, void* user_data) {
 void Fiber::Suspend() {
   c3_assert(_state == FIBER_STATE_RUNNING);
   _state = FIBER_STATE_SUSPENDED;
-  if (g_tls_fiber != this) g_tls_fiber->Resume();
+  Fiber* sched_fiber = get_schedule_fiber();
+  if (sched_fiber != this) sched_fiber->Resume();
 }
 
 void Fiber::Finish() {
   c3_assert(_state == FIBER_STATE_RUNNING);
   _state = FIBER_STATE_FINISHED;
-  if (g_tls_fiber != this) g_tls_fiber->Resume();
+  Fiber* sched_fiber = get_schedule_fiber();
+  if (sched_fiber != this) sched_fiber->Resume();
 }
 
 void Fiber::Resume() {
   c3_assert(_state == FIBER_STATE_SUSPENDED);
   _state = FIBER_STATE_RUNNING;
+#if ON_WINDOWS
   SwitchToFiber(_handle);
+#elif ON_LINUX
+  Fiber* from = get_current_fiber();
+  set_current_fiber(this);
+#if C3_FIBER_USE_UCONTEXT
+  swapcontext((ucontext_t*)from->_handle, (ucontext_t*)_handle);
+#else
+  c3_fiber_switch(&from->_handle, _handle);
+#endif
+#endif
 }
 
+#if ON_WINDOWS
 VOID CALLBACK Fiber::FiberProc(_In_ PVOID lpParameter) {
   auto fiber = (Fiber*)lpParameter;
   do {
@@ -42,26 +234,49 @@ VOID CALLBACK Fiber::FiberProc(_In_ PVOID lpParameter) {
     fiber->Finish();
   } while (1);
 }
+#elif ON_LINUX
+void Fiber::FiberProc(void* arg) {
+  auto fiber = (Fiber*)arg;
+  do {
+    fiber->_fn(fiber->_user_data);
+    fiber->Finish();
+  } while (1);
+}
+#endif
 
 Fiber* Fiber::ConvertFromThread(void* user_data) {
-  if (!g_tls_fiber) {
-    g_tls_fiber = new Fiber();
-    g_tls_fiber->_user_data = user_data;
-    g_tls_fiber->_handle = ConvertThreadToFiber(g_tls_fiber);
-    c3_assert(g_tls_fiber);
-    g_tls_fiber->_state = FIBER_STATE_RUNNING;
+  Fiber* fiber = get_schedule_fiber();
+  if (!fiber) {
+    fiber = new Fiber();
+    fiber->_user_data = user_data;
+    fiber->_stack_size = 0;
+#if ON_WINDOWS
+    fiber->_handle = ConvertThreadToFiber(fiber);
+#elif ON_LINUX
+#if C3_FIBER_USE_UCONTEXT
+    fiber->_handle = new ucontext_t;
+#endif
+    set_current_fiber(fiber);
+#endif
+    c3_assert(fiber);
+    fiber->_state = FIBER_STATE_RUNNING;
+    set_schedule_fiber(fiber);
   }
-  return g_tls_fiber;
+  return fiber;
 }
 
 Fiber* Fiber::GetScheduleFiber() {
-  return g_tls_fiber;
+  return get_schedule_fiber();
 }
 
 void Fiber::SetScheduleFiber(Fiber* fiber) {
-  g_tls_fiber = fiber;
+  set_schedule_fiber(fiber);
 }
 
 Fiber* Fiber::GetCurrentFiber() {
+#if ON_WINDOWS
   return (Fiber*)::GetFiberData();
+#elif ON_LINUX
+  return get_current_fiber();
+#endif
 }
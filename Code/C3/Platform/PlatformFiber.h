@@ -12,10 +12,21 @@ enum FiberState {
   FIBER_STATE_FINISHED,
 };
 
+enum FiberStackClass {
+  FIBER_STACK_SMALL,      // C3_FIBER_SMALL_STACK_SIZE
+  FIBER_STACK_LARGE,      // C3_FIBER_LARGE_STACK_SIZE
+  NUM_FIBER_STACK_CLASSES,
+};
+
 typedef void(*FiberFn)(void* user_data);
 class Fiber {
 public:
-  Fiber();
+  // stack_size is reserved, only C3_FIBER_STACK_COMMIT_SIZE is committed up front.
+  explicit Fiber(u32 stack_size = 0);
+  ~Fiber();
+  // Reserves the stack and creates the context, false if the address space
+  // is exhausted. Prepare reserves it if not done yet.
+  bool Reserve();
   // INITIALIZED -> SUSPENDED
   void Prepare(FiberFn fn, void* data);
   // RUNNING -> SUSPENDED, run thread major fiber
@@ -27,6 +38,9 @@ public:
   void* GetData() const { return _user_data; }
   FiberState GetState() const { return _state; }
   void SetState(FiberState state) { _state = state; }
+  u32 GetStackSize() const { return _stack_size; }
+  // Address space the stack of a fiber with stack_size takes, rounded and with guard pages.
+  static u64 GetReservedSize(u32 stack_size);
 
   static Fiber* ConvertFromThread(void* user_data);
   static Fiber* GetScheduleFiber();
@@ -39,10 +53,18 @@ private:
 
 #if ON_WINDOWS
   static VOID CALLBACK FiberProc(_In_ PVOID lpParameter);
+#elif ON_LINUX
+  static void FiberProc(void* arg);
 #endif;
+  bool InitContext();
 
   FiberFn _fn;
+  // Windows: fiber handle. Linux: saved stack pointer, or ucontext_t* with C3_FIBER_USE_UCONTEXT.
   void* _handle;
+#if ON_LINUX
+  void* _stack;
+#endif
   void* _user_data;
   FiberState _state;
+  u32 _stack_size;
 };
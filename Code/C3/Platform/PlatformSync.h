@@ -5,6 +5,14 @@
 #include "Debug/C3Debug.h"
 #if ON_WINDOWS
 #include "Windows/WindowsHeader.h"
+#elif ON_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
 #endif
 #include <atomic>
 #include <thread>
@@ -39,6 +47,9 @@ public:
 #elif ON_PS4
     auto ret = sceKernelCreateSema(&_handle, "sem", 0, 0, 65535, nullptr);
     c3_assert(ret == SCE_OK);
+#elif ON_LINUX
+    _count = 0;
+    _num_waiters = 0;
 #endif
   }
   ~Semaphore() {
@@ -53,6 +64,9 @@ public:
     ReleaseSemaphore(_handle, count, NULL);
 #elif ON_PS4
     sceKernelSignalSema(_handle, (int)count);
+#elif ON_LINUX
+    _count.fetch_add((i32)count);
+    if (_num_waiters > 0) syscall(SYS_futex, &_count, FUTEX_WAKE_PRIVATE, (int)count, nullptr, nullptr, 0);
 #endif
   }
   bool Wait(i32 msecs = -1) const {
@@ -65,6 +79,23 @@ public:
       SceKernelUseconds usecs = msecs * 1000;
       return sceKernelWaitSema(_handle, 1, &usecs) == SCE_OK;
     }
+#elif ON_LINUX
+    timespec ts;
+    ts.tv_sec = msecs / 1000;
+    ts.tv_nsec = (msecs % 1000) * 1000000;
+    for (;;) {
+      i32 count = _count.load(memory_order_acquire);
+      while (count > 0) {
+        if (_count.compare_exchange_weak(count, count - 1, memory_order_acquire)) return true;
+      }
+      ++_num_waiters;
+      long ret = syscall(SYS_futex, &_count, FUTEX_WAIT_PRIVATE, 0, (0 > msecs) ? nullptr : &ts, nullptr, 0);
+      --_num_waiters;
+      if (ret == -1 && errno == ETIMEDOUT) {
+        count = _count.load(memory_order_acquire);
+        return count > 0 && _count.compare_exchange_strong(count, count - 1, memory_order_acquire);
+      }
+    }
 #endif
   }
 
@@ -75,6 +106,10 @@ private:
   HANDLE _handle;
 #elif ON_PS4
   SceKernelSema _handle;
+#elif ON_LINUX
+  // Futex word is the semaphore count itself.
+  mutable atomic_i32 _count;
+  mutable atomic_i32 _num_waiters;
 #endif
 };
 
@@ -85,7 +120,7 @@ public:
   Thread()
 #if ON_WINDOWS
     : _handle(INVALID_HANDLE_VALUE), _thread_id(UINT32_MAX)
-#elif ON_PS4
+#elif ON_PS4 || ON_LINUX
     : _handle(0), _thread_id(0)
 #endif
     , _fn(NULL), _user_data(NULL), _stack_size(0), _exit_code(0), _running(false) {}
@@ -104,6 +139,13 @@ public:
 #elif ON_PS4
     auto ret = scePthreadCreate(&_handle, nullptr, threadFunc, this, name);
     c3_assert(ret == SCE_OK);
+#elif ON_LINUX
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (_stack_size > 0) pthread_attr_setstacksize(&attr, _stack_size);
+    auto ret = pthread_create(&_handle, &attr, threadFunc, this);
+    pthread_attr_destroy(&attr);
+    c3_assert(ret == 0);
 #endif
 
     _sem.Wait();
@@ -121,6 +163,12 @@ public:
     _handle = INVALID_HANDLE_VALUE;
     _running = false;
 #elif ON_PS4
+#elif ON_LINUX
+    void* exit_code = nullptr;
+    pthread_join(_handle, &exit_code);
+    _exit_code = (i32)(intptr_t)exit_code;
+    _handle = 0;
+    _running = false;
 #endif
   }
   bool IsRunning() const { return _running; }
@@ -145,11 +193,22 @@ public:
       RaiseException(0x406d1388, 0, sizeof(tn) / 4, (ULONG_PTR*)&tn);
     } __except (EXCEPTION_EXECUTE_HANDLER) {}
 #elif ON_PS4
+#elif ON_LINUX
+    // Linux limits thread name to 15 characters.
+    char name[16];
+    strncpy(name, _name, sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    pthread_setname_np(_handle, name);
 #endif
   }
   void SetThreadCore(int core) {
 #if ON_WINDOWS
     SetThreadIdealProcessor(_handle, core);
+#elif ON_LINUX
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core, &cpu_set);
+    pthread_setaffinity_np(_handle, sizeof(cpu_set), &cpu_set);
 #endif
   }
 
@@ -162,6 +221,8 @@ private:
     _thread_id = ::GetCurrentThreadId();
 #elif ON_PS4
     _thread_id = scePthreadGetthreadid();
+#elif ON_LINUX
+    _thread_id = (pid_t)syscall(SYS_gettid);
 #endif
     _sem.Post();
     return _fn(_user_data);
@@ -184,6 +245,15 @@ private:
   }
   ScePthread _handle;
   int _thread_id;
+
+#elif ON_LINUX
+  static void* threadFunc(void* arg) {
+    Thread* thread = (Thread*)arg;
+    i32 result = thread->Entry();
+    return (void*)(intptr_t)result;
+  }
+  pthread_t _handle;
+  pid_t _thread_id;
 #endif
 
   ThreadFn _fn;
@@ -200,6 +270,11 @@ public:
 #if ON_WINDOWS
     _id = TlsAlloc();
     c3_assert_return(TLS_OUT_OF_INDEXES != _id && "Failed to allocated TLS index.");
+#elif ON_LINUX
+    pthread_key_t key;
+    int result = pthread_key_create(&key, nullptr);
+    _id = (u32)key;
+    c3_assert_return(result == 0 && "Failed to allocated TLS index.");
 #endif
   }
 
@@ -207,18 +282,25 @@ public:
 #if ON_WINDOWS
     BOOL result = TlsFree(_id);
     c3_assert_return(result && "Failed to free TLS index.");
+#elif ON_LINUX
+    int result = pthread_key_delete((pthread_key_t)_id);
+    c3_assert_return(result == 0 && "Failed to free TLS index.");
 #endif
   }
 
   void* Get() const {
 #if ON_WINDOWS
     return TlsGetValue(_id);
+#elif ON_LINUX
+    return pthread_getspecific((pthread_key_t)_id);
 #endif
     return nullptr;
   }
   void Set(void* ptr) {
 #if ON_WINDOWS
     TlsSetValue(_id, ptr);
+#elif ON_LINUX
+    pthread_setspecific((pthread_key_t)_id, ptr);
 #endif
   }
 
@@ -120,6 +120,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 
     ImGui::Render();
 
+    AssetManager::Instance()->UpdateResidency(GraphicsRenderer::Instance()->GetFrameNumber());
     GraphicsRenderer::Instance()->Frame();
 
     IM->Forgot();
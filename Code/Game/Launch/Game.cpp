@@ -7,6 +7,7 @@ Game::Game() {
   auto world = GameWorld::CreateInstance();
   auto renderer = new RenderSystem;
   world->AddSystem(renderer);
+  _renderer = renderer;
 
   _debug_camera = world->CreateEntity();
   world->CreateCamera(_debug_camera);
@@ -78,5 +79,72 @@ void Game::UpdateDebugCamera(float dt) {
   }
   ImGui::Text("camera pos: %s\n", world->GetCameraPos(_debug_camera).ToString().c_str());
   ImGui::Text("camera v_fov: %.3f\n", RadToDeg(world->GetCameraVerticalFov(_debug_camera)));
+  FrameMemoryStats mem_stats;
+  frame_mem_get_stats(&mem_stats);
+  ImGui::Text("frame arena: %.1f KB (peak %.1f KB), overflows %u\n", mem_stats.used_bytes / 1024.0,
+              mem_stats.peak_bytes / 1024.0, mem_stats.num_overflows);
+  ImGui::Text("frame heap allocs: %llu\n", mem_stats.num_heap_allocs);
+  auto& cull_stats = _renderer->GetCullStats();
+  ImGui::Text("parts: %d visible, %d shadow, %d culled of %d (%d models, %d updated)\n", cull_stats.num_visible,
+              cull_stats.num_shadow_visible, cull_stats.num_culled, cull_stats.num_parts, cull_stats.num_models,
+              cull_stats.num_updated_models);
+  ImGui::Text("shadow cascades: %d of %d drawn\n", cull_stats.num_cascades_drawn, C3_SHADOW_CASCADES);
+  ImGui::Text("transforms updated: %d\n", world->GetNumUpdatedTransforms());
+  GraphicsStats gfx_stats;
+  GraphicsRenderer::Instance()->GetStats(&gfx_stats);
+  ImGui::Text("draws: %u (%u instances, %u batched), views %u\n", gfx_stats.num_draws, gfx_stats.num_instances,
+              gfx_stats.num_batched_items, gfx_stats.num_views);
+  ImGui::Text("program switches %u, texture binds %u\n", gfx_stats.num_program_changes, gfx_stats.num_texture_binds);
+  ImGui::Text("constants: %u updated, %u skipped, %.1f KB uploaded\n", gfx_stats.num_constant_updates,
+              gfx_stats.num_constants_skipped, gfx_stats.constant_bytes / 1024.0);
+  FrameRingStats ring_stats;
+  GraphicsRenderer::Instance()->GetFrameRingStats(&ring_stats);
+  static const char* RING_NAMES[FRAME_RING_COUNT] = {"vertices", "indices", "constants"};
+  for (int i = 0; i < FRAME_RING_COUNT; ++i) {
+    ImGui::Text("transient %s: %.1f KB (peak %.1f of %.1f KB), failed %u\n", RING_NAMES[i],
+                ring_stats.last_used[i] / 1024.0, ring_stats.high_water[i] / 1024.0, ring_stats.capacity[i] / 1024.0,
+                ring_stats.num_failed[i]);
+  }
+  AssetIOStats io_stats;
+  AssetManager::Instance()->GetIO()->GetStats(&io_stats);
+  ImGui::Text("asset reads: %u queued, %u in flight, %llu read, %.1f MB/s\n", io_stats.num_queued,
+              io_stats.num_in_flight, io_stats.num_reads,
+              io_stats.read_ms > 0.0 ? io_stats.bytes_read / (1024.0 * 1024.0) / (io_stats.read_ms / 1000.0) : 0.0);
+  ImGui::Text("asset decodes: %u running, %llu done, %.1f ms\n", io_stats.num_decoding, io_stats.num_decoded,
+              io_stats.decode_ms);
+  AssetResidencyStats residency_stats;
+  AssetManager::Instance()->GetResidencyStats(&residency_stats);
+  static const char* ASSET_TYPE_NAMES[ASSET_TYPE_COUNT] = {"textures", "shaders", "materials", "models"};
+  for (int i = 0; i < ASSET_TYPE_COUNT; ++i) {
+    ImGui::Text("%s: %u resident, %.1f of %.1f MB, evicted %u (%.1f MB)\n", ASSET_TYPE_NAMES[i],
+                residency_stats.num_resident[i], residency_stats.resident_bytes[i] / (1024.0 * 1024.0),
+                residency_stats.budget[i] / (1024.0 * 1024.0), residency_stats.num_evicted[i],
+                residency_stats.evicted_bytes[i] / (1024.0 * 1024.0));
+  }
+  TextureStreamStats stream_stats;
+  AssetManager::Instance()->GetTextureStreamer()->GetStats(&stream_stats);
+  ImGui::Text("texture streaming: %u textures, %u requests, %.1f (%.1f committed) of %.1f MB, %u streamed in, "
+              "%u dropped, %.1f MB read\n", stream_stats.num_streams, stream_stats.num_requests,
+              stream_stats.resident_bytes / (1024.0 * 1024.0), stream_stats.committed_bytes / (1024.0 * 1024.0),
+              stream_stats.budget / (1024.0 * 1024.0), stream_stats.num_streamed_in, stream_stats.num_dropped,
+              stream_stats.bytes_read / (1024.0 * 1024.0));
+  UploadStats upload_stats;
+  GraphicsRenderer::Instance()->GetUploadStats(&upload_stats);
+  ImGui::Text("uploads: %u queued (%.1f KB), %u last frame (%.1f KB, %.2f ms), %.1f MB/s, unqueued %u\n",
+              upload_stats.num_queued, upload_stats.queued_bytes / 1024.0, upload_stats.num_uploads,
+              upload_stats.upload_bytes / 1024.0, upload_stats.upload_ms,
+              upload_stats.total_ms > 0.0 ? upload_stats.total_bytes / (1024.0 * 1024.0) / (upload_stats.total_ms / 1000.0)
+                                          : 0.0,
+              upload_stats.num_unqueued);
+  if (mem_tracking_enabled() && ImGui::CollapsingHeader("Memory")) {
+    for (int i = 0; i < NUM_MEMORY_TAGS; ++i) {
+      MemoryTagStats tag_stats;
+      mem_get_tag_stats((MemoryTag)i, &tag_stats);
+      ImGui::Text("%-8s %.1f KB (peak %.1f KB), live %u, frame allocs %u\n", mem_tag_name((MemoryTag)i),
+                  tag_stats.current_bytes / 1024.0, tag_stats.peak_bytes / 1024.0, tag_stats.num_live,
+                  tag_stats.frame_allocs);
+    }
+    if (ImGui::Button("Dump report")) mem_dump_report();
+  }
   ImGui::End();
 }
\ No newline at end of file
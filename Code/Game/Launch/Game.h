@@ -2,6 +2,8 @@
 #include "Game/IGame.h"
 #include "Asset/AssetManager.h"
 
+class RenderSystem;
+
 class Game : public IGame {
 public:
   Game();
@@ -13,4 +15,5 @@ private:
 
   EntityHandle _debug_camera;
   EntityHandle _model;
+  RenderSystem* _renderer;
 };
@@ -0,0 +1,49 @@
+// bench.cpp : engine micro benchmarks.
+//
+
+#include "bench.h"
+
+static const BenchEntry BENCHMARKS[] = {
+  { "job", &bench_job, "submit many tiny jobs, report jobs/sec for 1..N workers" },
+  { "fiber", &bench_fiber, "fiber switch cost in ns" },
+  { "queue", &bench_queue, "locked vs lock-free MPMC/MPSC queue throughput for 1..N threads" },
+  { "draw", &bench_draw, "record 16k draws with the immediate API vs per-thread DrawEncoders on 1..N threads" },
+  { "sort", &bench_sort, "radix sort of 16k render sort keys, per pass histograms vs one pre-pass vs job workers" },
+  { "asset", &bench_asset, "asset lookup/create by filename, locked unordered_map vs lock-free registry on 1..N threads" },
+  { "pool", &bench_pool, "fixed size pool alloc/free, locked vs thread cached magazines on 1..N threads" },
+};
+
+const char* g_bench_exe = nullptr;
+
+int bench_spawn(const char* fmt, ...) {
+  char cmd[1024];
+  int n = snprintf(cmd, sizeof(cmd), "\"%s\" ", g_bench_exe);
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(cmd + n, sizeof(cmd) - n, fmt, args);
+  va_end(args);
+  fflush(stdout);
+  return system(cmd);
+}
+
+void usage() {
+  printf("Usage:\n"
+         "\tbench <benchmark> [options]\n"
+         "Benchmarks:\n");
+  for (auto& entry : BENCHMARKS) printf("\t%-12s %s\n", entry.name, entry.description);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    usage();
+    return -1;
+  }
+  mem_init(MEMORY_TAG_TOOL);
+  g_bench_exe = argv[0];
+  for (auto& entry : BENCHMARKS) {
+    if (strcmp(entry.name, argv[1]) == 0) return entry.fn(argc - 1, argv + 1);
+  }
+  printf("Unknown benchmark %s.\n", argv[1]);
+  usage();
+  return -1;
+}
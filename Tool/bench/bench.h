@@ -0,0 +1,31 @@
+#pragma once
+#include "C3PCH.h"
+#include <OptionParser.h>
+using namespace optparse;
+
+#ifdef _MSC_VER
+#pragma warning(disable:4996)
+#endif
+
+// Every benchmark gets the arguments after its name, argv[0] is the benchmark name.
+typedef int (*BenchFn)(int argc, char* argv[]);
+
+struct BenchEntry {
+  const char* name;
+  BenchFn fn;
+  const char* description;
+};
+
+int bench_job(int argc, char* argv[]);
+int bench_fiber(int argc, char* argv[]);
+int bench_queue(int argc, char* argv[]);
+int bench_draw(int argc, char* argv[]);
+int bench_sort(int argc, char* argv[]);
+int bench_asset(int argc, char* argv[]);
+int bench_pool(int argc, char* argv[]);
+
+// Path of bench executable, used by benchmarks which re-launch themselves
+// (e.g. one process per worker count since JobScheduler can not be re-initialized).
+extern const char* g_bench_exe;
+
+int bench_spawn(const char* fmt, ...);
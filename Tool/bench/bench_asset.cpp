@@ -0,0 +1,122 @@
+#include "bench.h"
+#include "Asset/AssetRegistry.h"
+
+// AssetManager before AssetRegistry: unordered_map and slab behind one SpinLock.
+struct LockedAssetMap {
+  LockedAssetMap(): _num_assets(0) { _map.reserve(C3_MAX_ASSETS); }
+
+  Asset* FindOrCreate(const AssetDesc& desc, AssetOperations* ops, bool* created_out) {
+    auto asset_id = String::GetID(desc._filename);
+    SpinLockGuard lock_guard(&_lock);
+    *created_out = false;
+    auto it = _map.find(asset_id);
+    if (it != _map.end()) return _assets + it->second;
+    if (_num_assets >= C3_MAX_ASSETS) return nullptr;
+    Asset* asset = _assets + _num_assets;
+    _map[asset_id] = _num_assets;
+    ++_num_assets;
+    asset->_desc = desc;
+    asset->_ops = ops;
+    asset->_ref = 1;
+    asset->_state = ASSET_STATE_EMPTY;
+    *created_out = true;
+    return asset;
+  }
+
+  u32 GetCount() const { return _num_assets; }
+
+  SpinLock _lock;
+  unordered_map<stringid, int> _map;
+  Asset _assets[C3_MAX_ASSETS];
+  u32 _num_assets;
+};
+
+// Every thread looks up num_lookups of the descs starting at its own offset,
+// the first lookups of a name race to create it. Returns elapsed milliseconds.
+template<class Registry>
+static double run_registry(Registry* registry, const vector<AssetDesc>& descs, int num_threads, int num_lookups,
+                           bool* ok) {
+  atomic_bool go(false);
+  atomic_u32 num_created(0);
+  atomic_u32 num_failed(0);
+  vector<thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      while (!go.load(memory_order_acquire)) std::this_thread::yield();
+      u32 created = 0;
+      u32 failed = 0;
+      size_t d = (size_t)t * 7919 % descs.size();
+      for (int i = 0; i < num_lookups; ++i) {
+        bool is_new;
+        Asset* asset = registry->FindOrCreate(descs[d], nullptr, &is_new);
+        if (!asset || strcmp(asset->_desc._filename, descs[d]._filename) != 0) ++failed;
+        if (is_new) ++created;
+        if (++d == descs.size()) d = 0;
+      }
+      num_created += created;
+      num_failed += failed;
+    });
+  }
+  auto start_time = Clock::Tick();
+  go.store(true, memory_order_release);
+  for (auto& t : threads) t.join();
+  auto end_time = Clock::Tick();
+  // Each name created exactly once, every lookup got its own file.
+  *ok = num_failed == 0 && num_created == registry->GetCount();
+  return Clock::TimespanToMillisecondsD(start_time, end_time);
+}
+
+template<class Registry>
+static double best_registry_run(int repeat, const vector<AssetDesc>& descs, int num_threads, int num_lookups,
+                                bool* ok) {
+  double best_ms = DBL_MAX;
+  *ok = true;
+  for (int i = 0; i < repeat; ++i) {
+    auto registry = new Registry;
+    bool run_ok;
+    best_ms = min(best_ms, run_registry(registry, descs, num_threads, num_lookups, &run_ok));
+    *ok &= run_ok;
+    delete registry;
+  }
+  return best_ms;
+}
+
+int bench_asset(int argc, char* argv[]) {
+  OptionParser parser;
+  parser.prog("bench asset");
+  parser.description("Asset lookups by filename from 1..N threads, the first lookup of a name creates it. "
+                     "The locked unordered_map AssetManager used vs the lock-free AssetRegistry, "
+                     "report million lookups/sec.");
+  parser.add_option("-t", "--threads").type("int").dest("threads").set_default(16).help("max threads");
+  parser.add_option("-n", "--num").type("int").dest("num").set_default(1 << 18).help("lookups per thread");
+  parser.add_option("-a", "--assets").type("int").dest("assets").set_default(2048).help("distinct filenames");
+  parser.add_option("-r", "--repeat").type("int").dest("repeat").set_default(3).help("repeat count, best is reported");
+  auto options = parser.parse_args(argc, (const char**)argv);
+  int max_threads = max((int)options.get("threads"), 1);
+  int num_lookups = max((int)options.get("num"), 1);
+  int num_assets = clamp((int)options.get("assets"), 1, C3_MAX_ASSETS);
+  int repeat = max((int)options.get("repeat"), 1);
+
+  // Paths like the ones levels load, sharing long prefixes.
+  vector<AssetDesc> descs(num_assets);
+  static const char* SUFFIXES[] = {"dds", "mat", "mex", "mas"};
+  for (int i = 0; i < num_assets; ++i) {
+    descs[i]._type = (u32)(i & 3);
+    descs[i]._flags = 0;
+    snprintf(descs[i]._filename, sizeof(descs[i]._filename), "Models/Level%02d/Props/prop_%05d.%s", i % 13, i,
+             SUFFIXES[i & 3]);
+  }
+
+  printf("%d filenames, %d lookups per thread\n", num_assets, num_lookups);
+  printf("%-8s %12s %12s\n", "threads", "locked", "lock-free");
+  for (int n = 1; n <= max_threads; n *= 2) {
+    double total = (double)num_lookups * n / 1000.0;    // lookups per ms -> M/sec
+    bool locked_ok, free_ok;
+    double locked_ms = best_registry_run<LockedAssetMap>(repeat, descs, n, num_lookups, &locked_ok);
+    double free_ms = best_registry_run<AssetRegistry>(repeat, descs, n, num_lookups, &free_ok);
+    printf("%-8d %12.2f %12.2f\n", n, total / locked_ms, total / free_ms);
+    if (!locked_ok || !free_ok) printf("  ERROR: %s lookups returned wrong or duplicate assets\n",
+                                       locked_ok ? "lock-free" : "locked");
+  }
+  return 0;
+}
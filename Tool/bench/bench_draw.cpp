@@ -0,0 +1,145 @@
+#include "bench.h"
+#include "Graphics/Null/GraphicsInterfaceNull.h"
+
+// Headless: without --submit GraphicsRenderer is created without Init, so
+// Frame() only merges the encoders. With --submit frames go through the null
+// graphics interface, Frame() then includes sort and submit of the last frame.
+
+// Recorder is GraphicsRenderer (immediate API) or DrawEncoder.
+template <class Recorder>
+static void record_draws(Recorder* recorder, int begin, int end) {
+  VertexBufferHandle vb(1);
+  IndexBufferHandle ib(1);
+  TextureHandle texture(1);
+  float4x4 m = float4x4::identity;
+  for (int i = begin; i < end; ++i) {
+    m.SetTranslatePart((float)i, 0.f, 0.f);
+    recorder->SetTransform(&m);
+    recorder->SetVertexBuffer(vb);
+    recorder->SetIndexBuffer(ib, i * 36, 36);
+    recorder->SetTexture(0, texture);
+    recorder->SetState(C3_STATE_RGB_WRITE | C3_STATE_DEPTH_WRITE | C3_STATE_DEPTH_TEST_LESS);
+    recorder->Submit((u8)(i & 1), ProgramHandle(i & 15), i);
+  }
+}
+
+// Worker threads live for the whole benchmark, DrawEncoders are per thread
+// and memory thread slots are never given back.
+struct DrawBenchWorkers {
+  vector<thread> threads;
+  atomic_int frame;
+  atomic_int num_done;
+  atomic_bool quit;
+  int num_active;
+  int num_draws;
+};
+
+static void draw_worker(DrawBenchWorkers* workers, int index) {
+  auto GR = GraphicsRenderer::Instance();
+  int last_frame = -1;
+  for (;;) {
+    int frame = workers->frame.load(memory_order_acquire);
+    if (workers->quit.load(memory_order_acquire)) break;
+    if (frame == last_frame) {
+      std::this_thread::yield();
+      continue;
+    }
+    last_frame = frame;
+    int n = workers->num_active;
+    if (index >= n) continue;
+    int begin = (int)((i64)workers->num_draws * index / n);
+    int end = (int)((i64)workers->num_draws * (index + 1) / n);
+    record_draws(GR->GetThreadEncoder(), begin, end);
+    workers->num_done.fetch_add(1, memory_order_release);
+  }
+}
+
+struct DrawBenchTimes {
+  double record_ms;
+  double frame_ms;
+};
+
+// num_threads 0 records on main thread with the immediate API.
+static DrawBenchTimes run_frames(DrawBenchWorkers* workers, int num_threads, int num_frames) {
+  auto GR = GraphicsRenderer::Instance();
+  DrawBenchTimes best = {DBL_MAX, DBL_MAX};
+  for (int f = 0; f < num_frames; ++f) {
+    auto start_time = Clock::Tick();
+    if (num_threads == 0) {
+      record_draws(GR, 0, workers->num_draws);
+    } else {
+      workers->num_active = num_threads;
+      workers->num_done = 0;
+      workers->frame.fetch_add(1, memory_order_release);
+      while (workers->num_done.load(memory_order_acquire) != num_threads) std::this_thread::yield();
+    }
+    auto record_time = Clock::Tick();
+    GR->Frame();
+    auto end_time = Clock::Tick();
+    best.record_ms = min(best.record_ms, Clock::TimespanToMillisecondsD(start_time, record_time));
+    best.frame_ms = min(best.frame_ms, Clock::TimespanToMillisecondsD(record_time, end_time));
+    if (GR->GetNumDraws() != (u32)workers->num_draws) {
+      printf("  ERROR: %u draws merged, expected %d\n", GR->GetNumDraws(), workers->num_draws);
+    }
+  }
+  return best;
+}
+
+int bench_draw(int argc, char* argv[]) {
+  OptionParser parser;
+  parser.prog("bench draw");
+  parser.description("Record <num> draws per frame with the immediate API, then with per-thread "
+                     "DrawEncoders on 1..N threads. Report best record and Frame() (merge) time.");
+  parser.add_option("-t", "--threads").type("int").dest("threads").set_default(0).help("max threads, 0 for hardware_concurrency");
+  parser.add_option("-n", "--num").type("int").dest("num").set_default(C3_MAX_DRAW_CALLS).help("draws per frame");
+  parser.add_option("-f", "--frames").type("int").dest("frames").set_default(50).help("frames per run, best is reported");
+  parser.add_option("-s", "--submit").type("int").dest("submit").set_default(0).help("1 to submit frames to the null graphics interface");
+  auto options = parser.parse_args(argc, (const char**)argv);
+  int max_threads = (int)options.get("threads");
+  if (max_threads <= 0) max_threads = (int)thread::hardware_concurrency();
+  // Main thread takes a memory thread slot too.
+  max_threads = min(max(max_threads, 1), C3_MAX_MEMORY_THREADS - 1);
+  int num_frames = max((int)options.get("frames"), 1);
+
+  GraphicsRenderer::CreateInstance();
+  bool submit = (int)options.get("submit") != 0;
+  if (submit && !GraphicsRenderer::Instance()->Init(NULL_GRAPHICS_API)) {
+    printf("Failed to init null graphics interface.\n");
+    GraphicsRenderer::ReleaseInstance();
+    return 1;
+  }
+  DrawBenchWorkers workers;
+  workers.frame = 0;
+  workers.num_done = 0;
+  workers.quit = false;
+  workers.num_active = 0;
+  workers.num_draws = min(max((int)options.get("num"), 1), C3_MAX_DRAW_CALLS);
+  for (int i = 0; i < max_threads; ++i) workers.threads.emplace_back(draw_worker, &workers, i);
+
+  printf("%-10s %12s %12s %12s\n", "threads", "record ms", "frame ms", "Mdraws/s");
+  auto times = run_frames(&workers, 0, num_frames);
+  printf("%-10s %12.3f %12.3f %12.2f\n", "immediate", times.record_ms, times.frame_ms,
+         workers.num_draws / times.record_ms / 1000.0);
+  for (int n = 1; n <= max_threads; n *= 2) {
+    times = run_frames(&workers, n, num_frames);
+    printf("%-10d %12.3f %12.3f %12.2f\n", n, times.record_ms, times.frame_ms,
+           workers.num_draws / times.record_ms / 1000.0);
+  }
+  workers.quit = true;
+  for (auto& t : workers.threads) t.join();
+  NullGraphicsStats stats;
+  if (submit && GraphicsInterfaceNull::GetStats(&stats, nullptr)) {
+    printf("last frame: %u draws (%u instances, %u batched), %u views, %u program, %u texture, %u blend, %u vb, "
+           "%u ib changes, %llu constant bytes\n",
+           stats.num_draws, stats.num_instances, stats.num_batched_items, stats.num_views, stats.num_program_changes,
+           stats.num_texture_changes, stats.num_blend_changes, stats.num_vertex_buffer_changes,
+           stats.num_index_buffer_changes, stats.constant_bytes);
+    GraphicsStats gfx_stats;
+    GraphicsRenderer::Instance()->GetStats(&gfx_stats);
+    printf("constants: %u updated, %u skipped as redundant\n", gfx_stats.num_constant_updates,
+           gfx_stats.num_constants_skipped);
+  }
+  GraphicsRenderer::Instance()->Shutdown();
+  GraphicsRenderer::ReleaseInstance();
+  return 0;
+}
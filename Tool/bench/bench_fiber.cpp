@@ -0,0 +1,32 @@
+#include "bench.h"
+
+static DEFINE_JOB_ENTRY(ping_fiber) {
+  auto count = (u64*)arg;
+  for (;;) {
+    ++*count;
+    Fiber::GetCurrentFiber()->Suspend();
+  }
+}
+
+int bench_fiber(int argc, char* argv[]) {
+  OptionParser parser;
+  parser.prog("bench fiber");
+  parser.description("Ping-pong between thread fiber and one fiber, report ns per switch.");
+  parser.add_option("-n", "--num").type("int").dest("num").set_default(10000000).help("number of round trips");
+  auto options = parser.parse_args(argc, (const char**)argv);
+  int num = max((int)options.get("num"), 1);
+
+  auto thread_fiber = Fiber::ConvertFromThread(nullptr);
+  Fiber fiber;
+  u64 count = 0;
+  fiber.Prepare(&ping_fiber, &count);
+  auto start_time = Clock::Tick();
+  for (int i = 0; i < num; ++i) {
+    thread_fiber->Suspend();
+    fiber.Resume();
+  }
+  auto end_time = Clock::Tick();
+  double ms = Clock::TimespanToMillisecondsD(start_time, end_time);
+  printf("%d round trips in %.3f ms, %.2f ns per switch\n", (int)count, ms, ms * 1e6 / (2.0 * num));
+  return 0;
+}
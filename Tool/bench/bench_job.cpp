@@ -0,0 +1,83 @@
+#include "bench.h"
+
+// Job submitted per batch, must stay well below C3_MAX_JOBS.
+static const int JOB_BATCH_SIZE = C3_MAX_JOBS / 2;
+
+struct JobBenchData {
+  u32 value;
+  u8 padding[CACHELINE_SIZE - sizeof(u32)];
+};
+
+static DEFINE_JOB_ENTRY(tiny_job) {
+  auto data = (JobBenchData*)arg;
+  ++data->value;
+}
+
+static double run_jobs(int num_jobs) {
+  auto JS = JobScheduler::Instance();
+  vector<JobBenchData> datas(JOB_BATCH_SIZE);
+  vector<Job> jobs(JOB_BATCH_SIZE);
+  for (int i = 0; i < JOB_BATCH_SIZE; ++i) {
+    datas[i].value = 0;
+    jobs[i].InitWorkerJob(&tiny_job, &datas[i]);
+  }
+  auto start_time = Clock::Tick();
+  for (int i = 0; i < num_jobs; i += JOB_BATCH_SIZE) {
+    auto label = JS->SubmitJobs(&jobs[0], min(num_jobs - i, JOB_BATCH_SIZE));
+    JS->WaitAndFreeJobs(label);
+  }
+  auto end_time = Clock::Tick();
+  return Clock::TimespanToMillisecondsD(start_time, end_time);
+}
+
+int bench_job(int argc, char* argv[]) {
+  OptionParser parser;
+  parser.prog("bench job");
+  parser.description("Submit <num> tiny jobs in batches from main thread and report jobs/sec. "
+                     "Without -w, run once per worker count in [1, hardware_concurrency].");
+  parser.add_option("-w", "--workers").type("int").dest("workers").set_default(0).help("number of worker threads");
+  parser.add_option("-n", "--num").type("int").dest("num").set_default(100000).help("number of jobs");
+  parser.add_option("-r", "--repeat").type("int").dest("repeat").set_default(5).help("repeat times, report best");
+  auto options = parser.parse_args(argc, (const char**)argv);
+  int num_workers = (int)options.get("workers");
+  int num_jobs = (int)options.get("num");
+  int repeat = max((int)options.get("repeat"), 1);
+
+  if (num_workers <= 0) {
+    int max_workers = min<int>(thread::hardware_concurrency(), C3_MAX_WORKER_THREADS);
+    for (int w = 1; w <= max_workers; ++w) {
+      bench_spawn("job -w %d -n %d -r %d", w, num_jobs, repeat);
+    }
+    return 0;
+  }
+
+  JobScheduler::CreateInstance();
+  JobScheduler::Instance()->Init(num_workers);
+  auto JS = JobScheduler::Instance();
+  run_jobs(JOB_BATCH_SIZE);   // warm up fiber and job pools.
+  JS->ResetStats();
+  double best_ms = DBL_MAX;
+  for (int i = 0; i < repeat; ++i) best_ms = min(best_ms, run_jobs(num_jobs));
+  JobWorkerStats stats;
+  JS->GetStats(&stats);
+  printf("workers %d: %d jobs in %.3f ms, %.0f jobs/sec\n",
+         num_workers, num_jobs, best_ms, num_jobs / best_ms * 1000.0);
+  printf("  parks %llu, wakeups %llu, idle %.3f ms, wake latency avg %.3f us max %.3f us\n",
+         stats.num_parks, stats.num_wakeups, stats.idle_ms,
+         stats.num_parks > 0 ? stats.wake_latency_ms * 1000.0 / stats.num_parks : 0.0,
+         stats.max_wake_latency_ms * 1000.0);
+  FiberPoolStats fiber_stats;
+  JS->GetFiberPoolStats(&fiber_stats);
+  printf("  fibers small %u (peak %u), large %u (peak %u), cap waits %u, failed reserves %u, "
+         "reserved %.1f of %.1f MB\n",
+         fiber_stats.num_created[FIBER_STACK_SMALL], fiber_stats.high_water[FIBER_STACK_SMALL],
+         fiber_stats.num_created[FIBER_STACK_LARGE], fiber_stats.high_water[FIBER_STACK_LARGE],
+         fiber_stats.num_cap_waits, fiber_stats.num_failed_reserves, fiber_stats.reserved_bytes / (1024.0 * 1024.0),
+         fiber_stats.max_reserved_bytes / (1024.0 * 1024.0));
+  PoolAllocatorStats alloc_stats;
+  JS->GetJobAllocatorStats(&alloc_stats);
+  printf("  job nodes allocs %llu, depot refills %llu, flushes %llu, reclaims %llu, failed %llu\n",
+         alloc_stats.num_allocs, alloc_stats.num_refills,
+         alloc_stats.num_flushes, alloc_stats.num_reclaims, alloc_stats.num_failed);
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include "bench.h"
+
+// Objects each thread holds at once, a full magazine worth.
+static const int POOL_BENCH_BATCH = C3_POOL_MAGAZINE_SIZE;
+
+// Threads are created once and run every phase, each new thread takes a
+// memory thread slot for good. Phase -1 tells them to exit.
+struct PoolBench {
+  atomic_int phase;
+  atomic_int num_done;
+  IAllocator* pool;
+  int num_batches;
+};
+
+static void pool_bench_thread(PoolBench* bench) {
+  void* objs[POOL_BENCH_BATCH];
+  int last_phase = 0;
+  for (;;) {
+    int phase;
+    while ((phase = bench->phase.load(memory_order_acquire)) == last_phase) std::this_thread::yield();
+    if (phase < 0) break;
+    last_phase = phase;
+    for (int i = 0; i < bench->num_batches; ++i) {
+      for (int j = 0; j < POOL_BENCH_BATCH; ++j) objs[j] = C3_ALLOC(bench->pool, 1);
+      for (int j = POOL_BENCH_BATCH - 1; j >= 0; --j) C3_FREE(bench->pool, objs[j]);
+    }
+    bench->num_done.fetch_add(1, memory_order_release);
+  }
+}
+
+// Returns elapsed milliseconds of one phase on all threads.
+static double run_pool_phase(PoolBench* bench, IAllocator* pool, int num_threads) {
+  bench->pool = pool;
+  bench->num_done.store(0, memory_order_relaxed);
+  auto start_time = Clock::Tick();
+  bench->phase.fetch_add(1, memory_order_release);
+  while (bench->num_done.load(memory_order_acquire) < num_threads) std::this_thread::yield();
+  auto end_time = Clock::Tick();
+  return Clock::TimespanToMillisecondsD(start_time, end_time);
+}
+
+static u64 pool_lock_count(const ThreadCachedPoolAllocator& pool) {
+  PoolAllocatorStats stats;
+  pool.GetStats(&stats);
+  return stats.num_refills + stats.num_flushes + stats.num_reclaims;
+}
+
+int bench_pool(int argc, char* argv[]) {
+  OptionParser parser;
+  parser.prog("bench pool");
+  parser.description("Each thread allocates and frees batches of a magazine worth of objects, report million "
+                     "allocs/sec of the locked pool vs the thread cached pool, and how often the latter took its "
+                     "depot lock. Without -t, run once per thread count in 1, 2, 4.. hardware_concurrency.");
+  parser.add_option("-t", "--threads").type("int").dest("threads").set_default(0).help("number of threads");
+  parser.add_option("-n", "--num").type("int").dest("num").set_default(1 << 20).help("allocs per thread");
+  parser.add_option("-r", "--repeat").type("int").dest("repeat").set_default(5).help("repeat times, report best");
+  auto options = parser.parse_args(argc, (const char**)argv);
+  int num_threads = (int)options.get("threads");
+  int num_allocs = max((int)options.get("num"), POOL_BENCH_BATCH);
+  int repeat = max((int)options.get("repeat"), 1);
+
+  if (num_threads <= 0) {
+    // Main thread takes a memory thread slot as well.
+    int max_threads = min<int>(thread::hardware_concurrency(), C3_MAX_MEMORY_THREADS - 1);
+    printf("%-8s %12s %12s %16s\n", "threads", "locked", "cached", "cached-locks/op");
+    for (int n = 1; n <= max_threads; n *= 2) bench_spawn("pool -t %d -n %d -r %d", n, num_allocs, repeat);
+    return 0;
+  }
+  num_threads = min(num_threads, C3_MAX_MEMORY_THREADS - 1);
+
+  size_t capacity = (size_t)num_threads * POOL_BENCH_BATCH * 4;
+  ThreadSafePoolAllocator locked_pool;
+  locked_pool.Init(64, CACHELINE_SIZE, capacity);
+  ThreadCachedPoolAllocator cached_pool;
+  cached_pool.Init(64, CACHELINE_SIZE, capacity);
+
+  PoolBench bench;
+  bench.phase = 0;
+  bench.num_done = 0;
+  bench.pool = nullptr;
+  bench.num_batches = num_allocs / POOL_BENCH_BATCH;
+  vector<thread> threads;
+  for (int i = 0; i < num_threads; ++i) threads.emplace_back(pool_bench_thread, &bench);
+
+  // Warm up, fills the magazines.
+  run_pool_phase(&bench, &locked_pool, num_threads);
+  run_pool_phase(&bench, &cached_pool, num_threads);
+  u64 start_locks = pool_lock_count(cached_pool);
+  double locked_ms = DBL_MAX;
+  double cached_ms = DBL_MAX;
+  for (int i = 0; i < repeat; ++i) {
+    locked_ms = min(locked_ms, run_pool_phase(&bench, &locked_pool, num_threads));
+    cached_ms = min(cached_ms, run_pool_phase(&bench, &cached_pool, num_threads));
+  }
+  u64 num_locks = pool_lock_count(cached_pool) - start_locks;
+  bench.phase.store(-1, memory_order_release);
+  for (auto& t : threads) t.join();
+
+  double total = (double)bench.num_batches * POOL_BENCH_BATCH * num_threads;
+  printf("%-8d %12.2f %12.2f %16.6f\n", num_threads,
+         total / locked_ms / 1000.0, total / cached_ms / 1000.0, num_locks / (total * repeat));
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include "bench.h"
+
+// Previous MPMCQueue/MPSCQueue: SPSCQueue behind one SpinLock.
+template<class T>
+struct LockedQueue {
+  explicit LockedQueue(u32 size): _spsc_queue(size) {}
+
+  bool Write(const T& record) {
+    SpinLockGuard lock_guard(&_lock);
+    return _spsc_queue.Write(record);
+  }
+
+  bool Read(T& record) {
+    SpinLockGuard lock_guard(&_lock);
+    return _spsc_queue.Read(record);
+  }
+
+  SpinLock _lock;
+  SPSCQueue<T> _spsc_queue;
+};
+
+static const i64 STOP_VALUE = -1;
+
+// Each producer writes num_items values, every consumer stops at its STOP_VALUE.
+// Failed reads/writes yield so oversubscribed runs still make progress.
+// Returns elapsed milliseconds.
+template<class Queue>
+static double run_queue(Queue& queue, int num_producers, int num_consumers, int num_items) {
+  atomic_bool go(false);
+  atomic_i64 sum(0);
+  vector<thread> threads;
+  for (int i = 0; i < num_consumers; ++i) {
+    threads.emplace_back([&]() {
+      while (!go.load(memory_order_acquire)) std::this_thread::yield();
+      i64 local_sum = 0;
+      i64 value;
+      for (;;) {
+        if (!queue.Read(value)) {
+          std::this_thread::yield();
+          continue;
+        }
+        if (value == STOP_VALUE) break;
+        local_sum += value;
+      }
+      sum += local_sum;
+    });
+  }
+  vector<thread> producers;
+  for (int i = 0; i < num_producers; ++i) {
+    producers.emplace_back([&]() {
+      while (!go.load(memory_order_acquire)) std::this_thread::yield();
+      for (i64 value = 0; value < num_items; ++value) {
+        while (!queue.Write(value)) std::this_thread::yield();
+      }
+    });
+  }
+  auto start_time = Clock::Tick();
+  go.store(true, memory_order_release);
+  for (auto& t : producers) t.join();
+  for (int i = 0; i < num_consumers; ++i) {
+    while (!queue.Write(STOP_VALUE)) std::this_thread::yield();
+  }
+  for (auto& t : threads) t.join();
+  auto end_time = Clock::Tick();
+  i64 expected = (i64)num_items * (num_items - 1) / 2 * num_producers;
+  if (sum != expected) printf("  ERROR: lost records, sum %lld, expected %lld\n", (long long)sum.load(), (long long)expected);
+  return Clock::TimespanToMillisecondsD(start_time, end_time);
+}
+
+template<class Queue>
+static double best_of(int repeat, u32 size, int num_producers, int num_consumers, int num_items) {
+  double best_ms = DBL_MAX;
+  for (int i = 0; i < repeat; ++i) {
+    Queue queue(size);
+    best_ms = min(best_ms, run_queue(queue, num_producers, num_consumers, num_items));
+  }
+  return best_ms;
+}
+
+int bench_queue(int argc, char* argv[]) {
+  OptionParser parser;
+  parser.prog("bench queue");
+  parser.description("Locked vs lock-free MPMC/MPSC queues, report million records/sec "
+                     "for 1..N producers (MPMC runs as many consumers as producers).");
+  parser.add_option("-t", "--threads").type("int").dest("threads").set_default(16).help("max producer threads");
+  parser.add_option("-n", "--num").type("int").dest("num").set_default(1 << 20).help("records per producer");
+  parser.add_option("-s", "--size").type("int").dest("size").set_default(1024).help("queue size");
+  parser.add_option("-r", "--repeat").type("int").dest("repeat").set_default(3).help("repeat count, best is reported");
+  auto options = parser.parse_args(argc, (const char**)argv);
+  int max_threads = max((int)options.get("threads"), 1);
+  int num_items = max((int)options.get("num"), 1);
+  u32 size = (u32)max((int)options.get("size"), 2);
+  int repeat = max((int)options.get("repeat"), 1);
+
+  printf("%-8s %12s %12s %12s %12s\n", "threads", "mpmc-lock", "mpmc-free", "mpsc-lock", "mpsc-free");
+  for (int n = 1; n <= max_threads; n *= 2) {
+    double total = (double)num_items * n / 1000.0;    // records per ms -> M/sec
+    double mpmc_lock = best_of<LockedQueue<i64>>(repeat, size, n, n, num_items);
+    double mpmc_free = best_of<MPMCQueue<i64>>(repeat, size, n, n, num_items);
+    double mpsc_lock = best_of<LockedQueue<i64>>(repeat, size, n, 1, num_items);
+    double mpsc_free = best_of<MPSCQueue<i64>>(repeat, size, n, 1, num_items);
+    printf("%-8d %12.2f %12.2f %12.2f %12.2f\n", n,
+           total / mpmc_lock, total / mpmc_free, total / mpsc_lock, total / mpsc_free);
+  }
+  return 0;
+}
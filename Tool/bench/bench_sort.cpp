@@ -0,0 +1,189 @@
+#include "bench.h"
+#include "Algorithm/ParallelRadixSort.h"
+#include "Graphics/RenderKey.h"
+#include <random>
+
+// Radix sort as RenderFrame::Sort did it before radix_sort: a histogram per
+// pass, every pass is scattered unless the keys are already sorted.
+static void radix_sort64_baseline(u64* keys, u64* temp_keys, u16* values, u16* temp_values, u32 size) {
+  static u32 histogram[RADIX_SORT_HISTOGRAM_SIZE];
+  u32 shift = 0;
+  u32 pass = 0;
+  for (; pass < 6; ++pass, shift += RADIX_SORT_BITS) {
+    memset(histogram, 0, sizeof(histogram));
+    bool sorted = true;
+    u64 prev_key = keys[0];
+    for (u32 ii = 0; ii < size; ++ii) {
+      u64 key = keys[ii];
+      ++histogram[(key >> shift) & RADIX_SORT_BIT_MASK];
+      sorted &= prev_key <= key;
+      prev_key = key;
+    }
+    if (sorted) break;
+    u32 offset = 0;
+    for (u32 ii = 0; ii < RADIX_SORT_HISTOGRAM_SIZE; ++ii) {
+      u32 count = histogram[ii];
+      histogram[ii] = offset;
+      offset += count;
+    }
+    for (u32 ii = 0; ii < size; ++ii) {
+      u64 key = keys[ii];
+      u32 dest = histogram[(key >> shift) & RADIX_SORT_BIT_MASK]++;
+      temp_keys[dest] = key;
+      temp_values[dest] = values[ii];
+    }
+    swap(keys, temp_keys);
+    swap(values, temp_values);
+  }
+  if (pass & 1) {
+    memcpy(temp_keys, keys, size * sizeof(u64));
+    memcpy(temp_values, values, size * sizeof(u16));
+  }
+}
+
+enum SortKeyDistribution {
+  SORT_KEYS_SCENE,        // shadow, main and ui views, few programs, 10% transparent.
+  SORT_KEYS_SEQUENTIAL,   // scene keys in a sequential view, seq grows with submit order.
+  SORT_KEYS_SORTED,       // scene keys sorted already.
+  SORT_KEYS_RANDOM,       // all 64 bits random, worst case.
+  NUM_SORT_KEY_DISTRIBUTIONS
+};
+
+static const char* SORT_KEY_DISTRIBUTION_NAMES[NUM_SORT_KEY_DISTRIBUTIONS] = {
+  "scene", "sequential", "sorted", "random"
+};
+
+static void generate_keys(SortKeyDistribution distribution, u64* keys, u32 num) {
+  mt19937_64 rng(1);
+  SortKey key;
+  for (u32 i = 0; i < num; ++i) {
+    if (distribution == SORT_KEYS_RANDOM) {
+      keys[i] = rng();
+      continue;
+    }
+    u64 r = rng();
+    key.Reset();
+    // 30% shadow view, 65% main view, 5% ui.
+    u32 view_roll = r % 100;
+    key.view = view_roll < 30 ? 1 : (view_roll < 95 ? 2 : 3);
+    key.program = (u16)((r >> 8) % 24);
+    key.material = (u16)((r >> 16) % 400);
+    key.trans = (key.view == 2 && ((r >> 32) % 10) == 0) ? 1 : 0;
+    key.depth = (u32)(rng() >> 32);
+    if (key.view == 3) {
+      // ui draws in submit order.
+      key.trans = 1;
+      key.depth = i;
+    }
+    if (distribution == SORT_KEYS_SEQUENTIAL) key.seq = (u16)(i & 0x7ff);
+    keys[i] = key.EncodeDraw();
+  }
+  if (distribution == SORT_KEYS_SORTED) sort(keys, keys + num);
+}
+
+struct SortBenchBuffers {
+  vector<u64> source;
+  vector<u64> keys;
+  vector<u64> temp_keys;
+  vector<u16> values;
+  vector<u16> temp_values;
+  vector<u64> expected_keys;
+  vector<u16> expected_values;
+};
+
+enum SortBenchMethod {
+  SORT_BENCH_BASELINE,
+  SORT_BENCH_SERIAL,
+  SORT_BENCH_PARALLEL,
+};
+
+// Best time of repeat runs in ms, passes of the last run.
+static double run_sort(SortBenchBuffers* buffers, SortBenchMethod method, int repeat, u32* num_passes) {
+  static RadixSortHistograms<u64> histograms;
+  static RadixSortParallelScratch<u64> scratch;
+  u32 num = (u32)buffers->source.size();
+  double best_ms = DBL_MAX;
+  for (int r = 0; r < repeat; ++r) {
+    memcpy(&buffers->keys[0], &buffers->source[0], num * sizeof(u64));
+    for (u32 i = 0; i < num; ++i) buffers->values[i] = (u16)i;
+    auto start_time = Clock::Tick();
+    switch (method) {
+    case SORT_BENCH_BASELINE:
+      radix_sort64_baseline(&buffers->keys[0], &buffers->temp_keys[0], &buffers->values[0], &buffers->temp_values[0], num);
+      *num_passes = 0;
+      break;
+    case SORT_BENCH_SERIAL:
+      *num_passes = radix_sort64(&buffers->keys[0], &buffers->temp_keys[0], &buffers->values[0], &buffers->temp_values[0],
+                                 num, &histograms);
+      break;
+    case SORT_BENCH_PARALLEL:
+      *num_passes = radix_sort_parallel(&buffers->keys[0], &buffers->temp_keys[0], &buffers->values[0],
+                                        &buffers->temp_values[0], num, &scratch);
+      break;
+    }
+    auto end_time = Clock::Tick();
+    best_ms = min(best_ms, Clock::TimespanToMillisecondsD(start_time, end_time));
+  }
+  return best_ms;
+}
+
+static bool check_sort(const SortBenchBuffers& buffers) {
+  return buffers.keys == buffers.expected_keys && buffers.values == buffers.expected_values;
+}
+
+int bench_sort(int argc, char* argv[]) {
+  OptionParser parser;
+  parser.prog("bench sort");
+  parser.description("Sort <num> render sort keys of several distributions with the per pass histogram "
+                     "radix sort, radix_sort64 and radix_sort_parallel. Without -w, run once per worker "
+                     "count 1, 2, 4.. up to hardware_concurrency.");
+  parser.add_option("-w", "--workers").type("int").dest("workers").set_default(0).help("number of worker threads");
+  parser.add_option("-n", "--num").type("int").dest("num").set_default(C3_MAX_DRAW_CALLS).help("number of keys, at most 65535");
+  parser.add_option("-r", "--repeat").type("int").dest("repeat").set_default(20).help("repeat times, report best");
+  auto options = parser.parse_args(argc, (const char**)argv);
+  int num_workers = (int)options.get("workers");
+  u32 num = (u32)clamp((int)options.get("num"), 1, (int)UINT16_MAX);
+  int repeat = max((int)options.get("repeat"), 1);
+
+  if (num_workers <= 0) {
+    int max_workers = min<int>(thread::hardware_concurrency(), C3_MAX_WORKER_THREADS);
+    for (int w = 1; w <= max_workers; w *= 2) bench_spawn("sort -w %d -n %u -r %d", w, num, repeat);
+    return 0;
+  }
+
+  JobScheduler::CreateInstance();
+  JobScheduler::Instance()->Init(num_workers);
+  SortBenchBuffers buffers;
+  buffers.source.resize(num);
+  buffers.keys.resize(num);
+  buffers.temp_keys.resize(num);
+  buffers.values.resize(num);
+  buffers.temp_values.resize(num);
+  printf("workers %d, %u keys\n", num_workers, num);
+  printf("%-12s %12s %12s %8s %12s %8s\n", "keys", "baseline ms", "serial ms", "passes", "parallel ms", "passes");
+  for (int d = 0; d < NUM_SORT_KEY_DISTRIBUTIONS; ++d) {
+    generate_keys((SortKeyDistribution)d, &buffers.source[0], num);
+    vector<pair<u64, u16>> expected(num);
+    for (u32 i = 0; i < num; ++i) expected[i] = make_pair(buffers.source[i], (u16)i);
+    stable_sort(expected.begin(), expected.end(),
+                [](const pair<u64, u16>& a, const pair<u64, u16>& b) { return a.first < b.first; });
+    buffers.expected_keys.resize(num);
+    buffers.expected_values.resize(num);
+    for (u32 i = 0; i < num; ++i) {
+      buffers.expected_keys[i] = expected[i].first;
+      buffers.expected_values[i] = expected[i].second;
+    }
+
+    u32 serial_passes, parallel_passes, unused;
+    double baseline_ms = run_sort(&buffers, SORT_BENCH_BASELINE, repeat, &unused);
+    bool ok = check_sort(buffers);
+    double serial_ms = run_sort(&buffers, SORT_BENCH_SERIAL, repeat, &serial_passes);
+    ok &= check_sort(buffers);
+    double parallel_ms = run_sort(&buffers, SORT_BENCH_PARALLEL, repeat, &parallel_passes);
+    ok &= check_sort(buffers);
+    printf("%-12s %12.3f %12.3f %8u %12.3f %8u\n", SORT_KEY_DISTRIBUTION_NAMES[d], baseline_ms, serial_ms,
+           serial_passes, parallel_ms, parallel_passes);
+    if (!ok) printf("  ERROR: %s keys sorted out of order\n", SORT_KEY_DISTRIBUTION_NAMES[d]);
+  }
+  return 0;
+}
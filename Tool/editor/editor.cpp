@@ -53,7 +53,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
   SetResourcesFolder();
   AppConfig::LoadConfig();
 
-  mem_init();
+  mem_init(MEMORY_TAG_TOOL);
   FileSystem::CreateInstance();
   FileSystem::Instance()->SetRootDir("../../../Assets");
   auto JS = JobScheduler::CreateInstance();
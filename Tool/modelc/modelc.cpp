@@ -13,6 +13,8 @@
 #include "Graphics/VertexFormat.h"
 #include "Graphics/GraphicsRenderer.h"
 #include "Graphics/Model/Mesh.h"
+#include "Memory/MemoryRegion.h"
+#include "Job/JobScheduler.h"
 
 static const stringid INPUT_TYPE_OBJ = String::GetID("obj");
 static const stringid INPUT_TYPE_FBX = String::GetID("fbx");
@@ -300,14 +302,16 @@ void process(const aiScene* scene) {
                          sub_mesh->mNumVertices, decl.stride,
                          sub_mesh->mTangents, sizeof(float) * 3);
         u8* start = vertex_buf + vstart_offset + decl.offsets[VERTEX_ATTR_TANGENT];
-        for (int i = 0; i < sub_mesh->mNumVertices; ++i) {
-          float3* tangent = (float3*)&sub_mesh->mTangents[i];
-          float3* bitangent = (float3*)&sub_mesh->mBitangents[i];
-          float3* normal = (float3*)&sub_mesh->mNormals[i];
-          float sign = Sign(Dot(Cross(*tangent, *bitangent), *normal));
-          float4* t4 = (float4*)(start + i * decl.stride);
-          t4->w = sign;
-        }
+        JobScheduler::Instance()->ParallelFor(0, sub_mesh->mNumVertices, 4096, [&](int begin, int end) {
+          for (int i = begin; i < end; ++i) {
+            float3* tangent = (float3*)&sub_mesh->mTangents[i];
+            float3* bitangent = (float3*)&sub_mesh->mBitangents[i];
+            float3* normal = (float3*)&sub_mesh->mNormals[i];
+            float sign = Sign(Dot(Cross(*tangent, *bitangent), *normal));
+            float4* t4 = (float4*)(start + i * decl.stride);
+            t4->w = sign;
+          }
+        });
 #else
         copy_vertex_attr(vertex_buf + vstart_offset + decl.offsets[VERTEX_ATTR_TANGENT],
                          sub_mesh->mNumVertices, decl.stride,
@@ -352,22 +356,24 @@ void process(const aiScene* scene) {
         index_size = 4;
         istart_offset *= 2;
       } else index_buf = (u8*)realloc(index_buf, index_size * num_indices);
-      for (u32 j = 0; j < sub_mesh->mNumFaces; ++j) {
-        aiFace* face = sub_mesh->mFaces + j;
-        if (face->mNumIndices != 3) error("Expect every face to have 3 indices.");
-        u32 start_vertex = vstart_offset / decl.stride;
-        if (index_size == 2) {
-          u16* index = (u16*)(index_buf + istart_offset) + j * 3;
-          *index++ = face->mIndices[0] + start_vertex;
-          *index++ = face->mIndices[1] + start_vertex;
-          *index++ = face->mIndices[2] + start_vertex;
-        } else {
-          u32* index = (u32*)(index_buf + istart_offset) + j * 3;
-          *index++ = face->mIndices[0] + start_vertex;
-          *index++ = face->mIndices[1] + start_vertex;
-          *index++ = face->mIndices[2] + start_vertex;
+      u32 start_vertex = vstart_offset / decl.stride;
+      JobScheduler::Instance()->ParallelFor(0, sub_mesh->mNumFaces, 8192, [&](int begin, int end) {
+        for (int j = begin; j < end; ++j) {
+          aiFace* face = sub_mesh->mFaces + j;
+          if (face->mNumIndices != 3) error("Expect every face to have 3 indices.");
+          if (index_size == 2) {
+            u16* index = (u16*)(index_buf + istart_offset) + j * 3;
+            *index++ = face->mIndices[0] + start_vertex;
+            *index++ = face->mIndices[1] + start_vertex;
+            *index++ = face->mIndices[2] + start_vertex;
+          } else {
+            u32* index = (u32*)(index_buf + istart_offset) + j * 3;
+            *index++ = face->mIndices[0] + start_vertex;
+            *index++ = face->mIndices[1] + start_vertex;
+            *index++ = face->mIndices[2] + start_vertex;
+          }
         }
-      }
+      });
     }
   }
   header.aabb_min = model_aabb.minPoint;
@@ -427,6 +433,9 @@ void process(const aiScene* scene) {
 
 int main(int argc, char* argv[]) {
   if (argc < 2) exit(-1);
+  mem_init(MEMORY_TAG_TOOL);
+  JobScheduler::CreateInstance();
+  JobScheduler::Instance()->Init(thread::hardware_concurrency());
 
   g_options.input_filename.Set(argv[1]);
   g_options.output_filename = g_options.input_filename.MakeWithAnotherSuffix(".mex");
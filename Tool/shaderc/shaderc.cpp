@@ -67,6 +67,10 @@ void process(const char* fname) {
     reader.ReadString("pass", pass, sizeof(pass));
     snprintf(out_dir, sizeof(out_dir), "%s/%s", tech, pass);
     compile_shader(reader, out_dir, "vs_source", "vs_defines");
+    if (reader.BeginReadArray("vs_instanced_defines")) {
+      reader.EndReadArray();
+      compile_shader(reader, out_dir, "vs_source", "vs_instanced_defines");
+    }
     compile_shader(reader, out_dir, "fs_source", "fs_defines");
     reader.EndReadObject();
   }
@@ -67,7 +67,7 @@ bool ParseArguments(int argc, char* argv[]) {
 }
 
 int main(int argc, char* argv[]) {
-  mem_init();
+  mem_init(MEMORY_TAG_TOOL);
   if (!ParseArguments(argc, argv)) {
     Usage();
     return -1;
@@ -236,29 +236,18 @@ void compress_image(const void* in_data, int width, int height, void* out_data)
   int bytes_per_block = ((g_args.flags & squish::kDxt1) != 0) ? 8 : 16;
 
   auto src_pitch = width * 4;
-  vector<CompressJobData> job_datas;
   auto JS = JobScheduler::Instance();
-  job_datas.reserve(height / 4 * width / 4);
-  for (int y = 0, m = height / 4; y < m; ++y) {
-    for (int x = 0, n = width / 4; x < n; ++x) {
-      job_datas.emplace_back(src + (y * 4 * src_pitch + x * 4 * 4), src_pitch,
-                              dst + (y * n + x) * bytes_per_block, g_args.flags);
+  int n = width / 4;
+  // One batch is a row of blocks.
+  JS->ParallelFor(0, height / 4, 1, [&](int y_begin, int y_end) {
+    for (int y = y_begin; y < y_end; ++y) {
+      for (int x = 0; x < n; ++x) {
+        CompressJobData job_data(src + (y * 4 * src_pitch + x * 4 * 4), src_pitch,
+                                 dst + (y * n + x) * bytes_per_block, g_args.flags);
+        do_compress_job(&job_data);
+      }
     }
-  }
-  vector<Job> jobs(job_datas.size());
-  for (int i = 0, n = (int)job_datas.size(); i < n; ++i) {
-    jobs[i].InitWorkerJob(&do_compress_job, &job_datas[i]);
-  }
-  Job* start_job = &jobs[0];
-  int i = 0;
-  int n = jobs.size();
-  while (i < n) {
-    int m = min(n - i, 2000);
-    auto label = JS->SubmitJobs(start_job, m);
-    JS->WaitJobs(label);
-    start_job += m;
-    i += m;
-  }
+  });
 }
 
 void compress() {
@@ -396,7 +385,7 @@ void parse_arguments(int argc, char* argv[]) {
 }
 
 int main(int argc, char* argv[]) {
-  mem_init();
+  mem_init(MEMORY_TAG_TOOL);
   JobScheduler::CreateInstance();
   JobScheduler::Instance()->Init(thread::hardware_concurrency());
   FreeImage_Initialise();